@@ -0,0 +1,129 @@
+#ifndef ARDUINO_H_
+#define ARDUINO_H_
+
+/*
+ * Host shim of the Arduino AVR core. Just enough of it to build firmware
+ * sources and libs on a PC for firmware/bench/host benchmarks.
+ *
+ * Time is virtual: clock reads and polling of an empty serial port move it
+ * forward, so firmware busy-wait loops terminate the same way they do on MCU.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include <avr/pgmspace.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+// binary constants used by libs
+#define B00000001 1
+#define B00000010 2
+#define B00000100 4
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// ATmega2560 analog pins
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+#define A4 58
+#define A5 59
+#define A6 60
+#define A7 61
+#define A8 62
+#define A9 63
+#define A10 64
+#define A11 65
+#define A12 66
+#define A13 67
+#define A14 68
+#define A15 69
+
+#define NUM_PINS 70
+
+#define abs(x) ((x)>0?(x):-(x))
+
+template<class T, class L>
+auto min(const T& a, const L& b) -> decltype((b < a) ? b : a) {
+    return (b < a) ? b : a;
+}
+
+template<class T, class L>
+auto max(const T& a, const L& b) -> decltype((b < a) ? b : a) {
+    return (a < b) ? b : a;
+}
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+
+#define interrupts() hostInterrupts(true)
+#define noInterrupts() hostInterrupts(false)
+#define cli() hostInterrupts(false)
+#define sei() hostInterrupts(true)
+
+#define clockCyclesPerMicrosecond() (16L)
+#define microsecondsToClockCycles(a) ((a) * clockCyclesPerMicrosecond())
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+void analogReference(uint8_t mode);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/*============================= Host side controls ==========================*/
+
+// move virtual clock forward
+void hostAdvanceMicros(unsigned long us);
+// global interrupt flag. while it is clear, micros() and millis() lose timer0
+// overflows past the first one the way they do on AVR
+void hostInterrupts(bool enabled);
+// interrupt handler that takes cost us of virtual time every period us while
+// interrupts are enabled, 0 period for none
+void hostSetInterruptLoad(unsigned long period, unsigned long cost);
+// set level of digital input / ADC reading of analog input
+void hostSetPin(uint8_t pin, int value);
+// level driven by firmware on output pin
+int hostGetPin(uint8_t pin);
+// digitalRead() levels from a waveform of virtual time instead of pin levels
+void hostSetDigitalSource(int (*source)(uint8_t pin, unsigned long us));
+// analogRead() values from a waveform of virtual time instead of pin levels
+void hostSetAnalogSource(int (*source)(uint8_t pin, unsigned long us));
+// ADC conversion time with default prescaler
+const unsigned long ADC_READ_USEC = 112;
+// virtual time of one analogRead(), sets sample rate of busy-polling code
+void hostSetAnalogReadMicros(unsigned long us);
+
+#include "HardwareSerial.h"
+
+#endif /* ARDUINO_H_ */
@@ -0,0 +1,81 @@
+#include "HardwareSerial.h"
+
+#include <Arduino.h>
+
+// polling of empty port costs about one byte time at 57600
+const unsigned long IDLE_POLL_USEC = 100;
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+HardwareSerial Serial2;
+HardwareSerial Serial3;
+
+// true when input is empty after the device had its chance
+bool HardwareSerial::poll() {
+    if (rxHead != rxTail) {
+        return false;
+    }
+    hostAdvanceMicros(IDLE_POLL_USEC);
+    if (idleHook) {
+        idleHook(*this);
+    }
+    return rxHead == rxTail;
+}
+
+int HardwareSerial::available() {
+    if (poll()) {
+        return 0;
+    }
+    return (rxHead + SERIAL_RX_BUFFER_SIZE - rxTail) % SERIAL_RX_BUFFER_SIZE;
+}
+
+int HardwareSerial::read() {
+    if (poll()) {
+        return -1;
+    }
+    uint8_t c = rxBuff[rxTail];
+    rxTail = (rxTail + 1) % SERIAL_RX_BUFFER_SIZE;
+    return c;
+}
+
+int HardwareSerial::peek() {
+    if (rxHead == rxTail) {
+        return -1;
+    }
+    return rxBuff[rxTail];
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    tx++;
+    if (txHook) {
+        txHook(*this, c);
+    }
+    return 1;
+}
+
+void HardwareSerial::inject(const char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        size_t next = (rxHead + 1) % SERIAL_RX_BUFFER_SIZE;
+        if (next == rxTail) {
+            break; // overflow, drop the rest like real UART does
+        }
+        rxBuff[rxHead] = data[i];
+        rxHead = next;
+    }
+}
+
+void HardwareSerial::inject(const char *data) {
+    inject(data, strlen(data));
+}
+
+void HardwareSerial::onTx(TxHook hook) {
+    txHook = hook;
+}
+
+void HardwareSerial::onIdle(IdleHook hook) {
+    idleHook = hook;
+}
+
+void HardwareSerial::clear() {
+    rxHead = rxTail = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef HARDWARESERIAL_H_
+#define HARDWARESERIAL_H_
+
+#include "Stream.h"
+
+#define SERIAL_RX_BUFFER_SIZE 1024
+
+/*
+ * Host serial port. Input is injected by the benchmark, output is counted and
+ * optionally passed to a hook which plays the device on the other end. Idle
+ * hook is called when firmware polls empty input, so the device can deliver
+ * output which is due by now.
+ */
+class HardwareSerial: public Stream {
+public:
+    typedef void (*TxHook)(HardwareSerial &port, uint8_t c);
+    typedef void (*IdleHook)(HardwareSerial &port);
+
+    void begin(unsigned long baud) {
+    }
+    void end() {
+    }
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t c) override;
+    using Print::write;
+    operator bool() {
+        return true;
+    }
+
+    // host side
+    void inject(const char *data, size_t length);
+    void inject(const char *data);
+    void onTx(TxHook hook);
+    void onIdle(IdleHook hook);
+    unsigned long txCount() const {
+        return tx;
+    }
+    // drop unread input
+    void clear();
+
+private:
+    uint8_t rxBuff[SERIAL_RX_BUFFER_SIZE];
+    size_t rxHead = 0;
+    size_t rxTail = 0;
+    unsigned long tx = 0;
+    TxHook txHook = NULL;
+    IdleHook idleHook = NULL;
+    bool poll();
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+
+#endif /* HARDWARESERIAL_H_ */
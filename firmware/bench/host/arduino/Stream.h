@@ -0,0 +1,26 @@
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include "Print.h"
+
+class Stream: public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {
+    }
+
+    void setTimeout(unsigned long timeout) {
+        this->timeout = timeout;
+    }
+
+    size_t readBytes(char *buffer, size_t length);
+    size_t readBytesUntil(char terminator, char *buffer, size_t length);
+
+protected:
+    unsigned long timeout = 1000;
+    int timedRead();
+};
+
+#endif /* STREAM_H_ */
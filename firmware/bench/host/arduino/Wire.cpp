@@ -0,0 +1,55 @@
+#include <Wire.h>
+
+TwoWire Wire;
+
+static uint32_t clockHz = 100000;
+static uint8_t txAddress = 0;
+static uint8_t txBuffer[BUFFER_LENGTH];
+static uint8_t txLength = 0;
+static unsigned long transmissions = 0;
+static void (*wireSink)(uint8_t address, uint8_t data, unsigned long us) = NULL;
+
+void hostSetWireSink(void (*sink)(uint8_t address, uint8_t data, unsigned long us)) {
+    wireSink = sink;
+}
+
+unsigned long hostWireTransmissions() {
+    return transmissions;
+}
+
+void TwoWire::begin() {
+    // as AVR twi_init()
+    clockHz = 100000;
+}
+
+void TwoWire::setClock(uint32_t clock) {
+    clockHz = clock;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    txAddress = address;
+    txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (txLength >= BUFFER_LENGTH) {
+        return 0;
+    }
+    txBuffer[txLength++] = data;
+    return 1;
+}
+
+uint8_t TwoWire::endTransmission(uint8_t sendStop) {
+    // start bit, 9 clocks per byte (address first), stop bit
+    double bitUs = 1e6 / clockHz;
+    unsigned long t0 = micros();
+    for (uint8_t i = 0; i < txLength; i++) {
+        if (wireSink) {
+            wireSink(txAddress, txBuffer[i], t0 + (unsigned long) ((1 + 9 * (i + 2)) * bitUs));
+        }
+    }
+    hostAdvanceMicros((unsigned long) ((2 + 9 * (txLength + 1)) * bitUs));
+    transmissions++;
+    txLength = 0;
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef WIRE_H_
+#define WIRE_H_
+
+#include <Arduino.h>
+
+// AVR TWI library buffer size
+#define BUFFER_LENGTH 32
+
+/*
+ * Host I2C master. Transmissions take virtual time of the bus at set clock
+ * (start, address, data bytes with ACK, stop), each byte is passed to a sink
+ * with the moment slave latches it. Nothing is received.
+ */
+class TwoWire: public Print {
+public:
+    void begin();
+    void setClock(uint32_t clock);
+    void beginTransmission(uint8_t address);
+    uint8_t endTransmission(uint8_t sendStop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity) {
+        return 0;
+    }
+    int available() {
+        return 0;
+    }
+    int read() {
+        return -1;
+    }
+    size_t write(uint8_t data) override;
+    using Print::write;
+};
+
+extern TwoWire Wire;
+
+/*============================= Host side controls ==========================*/
+
+// called for each byte written to the bus, us is virtual time of its ACK
+void hostSetWireSink(void (*sink)(uint8_t address, uint8_t data, unsigned long us));
+// number of transmissions since start
+unsigned long hostWireTransmissions();
+
+#endif /* WIRE_H_ */
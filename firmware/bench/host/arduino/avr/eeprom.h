@@ -0,0 +1,34 @@
+#ifndef EEPROM_H_
+#define EEPROM_H_
+
+/*
+ * Host EEPROM is a RAM array, erased (0xFF) at start.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define E2END 0xFFF
+#define EEMEM
+
+#define eeprom_is_ready() true
+
+uint8_t eeprom_read_byte(const void *addr);
+uint16_t eeprom_read_word(const void *addr);
+uint32_t eeprom_read_dword(const void *addr);
+float eeprom_read_float(const void *addr);
+void eeprom_read_block(void *dst, const void *src, size_t n);
+
+void eeprom_write_byte(void *addr, uint8_t value);
+void eeprom_write_word(void *addr, uint16_t value);
+void eeprom_write_dword(void *addr, uint32_t value);
+void eeprom_write_float(void *addr, float value);
+void eeprom_write_block(const void *src, void *dst, size_t n);
+
+#define eeprom_update_byte eeprom_write_byte
+#define eeprom_update_word eeprom_write_word
+#define eeprom_update_dword eeprom_write_dword
+#define eeprom_update_float eeprom_write_float
+#define eeprom_update_block eeprom_write_block
+
+#endif /* EEPROM_H_ */
@@ -0,0 +1,199 @@
+#include <Arduino.h>
+#include <avr/eeprom.h>
+
+// virtual cost of reading the clock. micros() takes a few usec on 16MHz AVR
+const unsigned long CLOCK_READ_USEC = 4;
+
+// timer0 overflows every 1024us with 16MHz clock and 64 prescaler
+const unsigned long TIMER0_OVERFLOW_USEC = 1024;
+
+static unsigned long clockUsec = 0;
+static bool interruptsEnabled = true;
+static unsigned long maskedOverflows = 0; // counted by timer0 ISR until cli()
+static unsigned long loadPeriodUsec = 0;
+static unsigned long loadCostUsec = 0;
+static unsigned long loadNextUsec = 0;
+static unsigned long adcReadUsec = ADC_READ_USEC;
+static int (*analogSource)(uint8_t pin, unsigned long us) = NULL;
+static int (*digitalSource)(uint8_t pin, unsigned long us) = NULL;
+static int pins[NUM_PINS];
+static uint8_t eeprom[E2END + 1];
+
+static struct EepromInit {
+    EepromInit() {
+        memset(eeprom, 0xFF, sizeof(eeprom));
+    }
+} eepromInit;
+
+/*============================= Time ========================================*/
+
+// pending handler of interrupt load runs as soon as interrupts are enabled
+static void serviceInterrupts() {
+    if (!interruptsEnabled || loadPeriodUsec == 0 || clockUsec < loadNextUsec) {
+        return;
+    }
+    clockUsec += loadCostUsec;
+    loadNextUsec += loadPeriodUsec;
+    if (loadNextUsec <= clockUsec) {
+        // missed while masked, flag holds one of them
+        loadNextUsec = clockUsec - clockUsec % loadPeriodUsec + loadPeriodUsec;
+    }
+}
+
+// AVR micros() adds one pending overflow of timer0 to the count of its ISR
+static unsigned long clockRead() {
+    clockUsec += CLOCK_READ_USEC;
+    serviceInterrupts();
+    if (interruptsEnabled) {
+        return clockUsec;
+    }
+    unsigned long overflows = clockUsec / TIMER0_OVERFLOW_USEC;
+    if (overflows > maskedOverflows) {
+        overflows = maskedOverflows + 1;
+    }
+    return overflows * TIMER0_OVERFLOW_USEC + clockUsec % TIMER0_OVERFLOW_USEC;
+}
+
+void hostAdvanceMicros(unsigned long us) {
+    clockUsec += us;
+}
+
+void hostInterrupts(bool enabled) {
+    if (interruptsEnabled && !enabled) {
+        maskedOverflows = clockUsec / TIMER0_OVERFLOW_USEC;
+    }
+    interruptsEnabled = enabled;
+    serviceInterrupts();
+}
+
+void hostSetInterruptLoad(unsigned long period, unsigned long cost) {
+    loadPeriodUsec = period;
+    loadCostUsec = cost;
+    loadNextUsec = clockUsec + period;
+}
+
+unsigned long micros(void) {
+    return clockRead();
+}
+
+unsigned long millis(void) {
+    unsigned long us = clockRead();
+    // counted by timer0 ISR only
+    return (interruptsEnabled ? us : maskedOverflows * TIMER0_OVERFLOW_USEC) / 1000;
+}
+
+void delay(unsigned long ms) {
+    clockUsec += ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us) {
+    clockUsec += us;
+}
+
+/*============================= Pins ========================================*/
+
+void hostSetPin(uint8_t pin, int value) {
+    if (pin < NUM_PINS) {
+        pins[pin] = value;
+    }
+}
+
+int hostGetPin(uint8_t pin) {
+    return pin < NUM_PINS ? pins[pin] : 0;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    hostSetPin(pin, val);
+}
+
+void hostSetDigitalSource(int (*source)(uint8_t pin, unsigned long us)) {
+    digitalSource = source;
+}
+
+int digitalRead(uint8_t pin) {
+    serviceInterrupts();
+    if (digitalSource) {
+        return digitalSource(pin, clockUsec) ? HIGH : LOW;
+    }
+    return hostGetPin(pin) ? HIGH : LOW;
+}
+
+void hostSetAnalogSource(int (*source)(uint8_t pin, unsigned long us)) {
+    analogSource = source;
+}
+
+void hostSetAnalogReadMicros(unsigned long us) {
+    adcReadUsec = us;
+}
+
+int analogRead(uint8_t pin) {
+    if (pin < A0) {
+        pin += A0;
+    }
+    // sample is taken at the start of conversion
+    int v = analogSource ? analogSource(pin, clockUsec) : hostGetPin(pin);
+    clockUsec += adcReadUsec;
+    return v;
+}
+
+void analogWrite(uint8_t pin, int val) {
+    hostSetPin(pin, val);
+}
+
+void analogReference(uint8_t mode) {
+}
+
+/*============================= EEPROM ======================================*/
+
+uint8_t eeprom_read_byte(const void *addr) {
+    return eeprom[(uintptr_t) addr & E2END];
+}
+
+uint16_t eeprom_read_word(const void *addr) {
+    uint16_t v;
+    eeprom_read_block(&v, addr, sizeof(v));
+    return v;
+}
+
+uint32_t eeprom_read_dword(const void *addr) {
+    uint32_t v;
+    eeprom_read_block(&v, addr, sizeof(v));
+    return v;
+}
+
+float eeprom_read_float(const void *addr) {
+    float v;
+    eeprom_read_block(&v, addr, sizeof(v));
+    return v;
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        ((uint8_t*) dst)[i] = eeprom_read_byte((const uint8_t*) src + i);
+    }
+}
+
+void eeprom_write_byte(void *addr, uint8_t value) {
+    eeprom[(uintptr_t) addr & E2END] = value;
+}
+
+void eeprom_write_word(void *addr, uint16_t value) {
+    eeprom_write_block(&value, addr, sizeof(value));
+}
+
+void eeprom_write_dword(void *addr, uint32_t value) {
+    eeprom_write_block(&value, addr, sizeof(value));
+}
+
+void eeprom_write_float(void *addr, float value) {
+    eeprom_write_block(&value, addr, sizeof(value));
+}
+
+void eeprom_write_block(const void *src, void *dst, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        eeprom_write_byte((uint8_t*) dst + i, ((const uint8_t*) src)[i]);
+    }
+}
@@ -0,0 +1,110 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static unsigned long iterations = 100000;
+static const char *filter = NULL;
+static bool csv = false;
+
+static unsigned long allocCount = 0;
+static unsigned long allocBytes = 0;
+
+/*============================= Heap accounting =============================*/
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    allocCount++;
+    allocBytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    allocCount++;
+    allocBytes += n * size;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    allocCount++;
+    allocBytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+}
+#endif
+
+unsigned long benchAllocCount() {
+    return allocCount;
+}
+
+unsigned long benchAllocBytes() {
+    return allocBytes;
+}
+
+/*============================= Runner ======================================*/
+
+void benchInit(int argc, char *argv[], const char *title) {
+    int opt;
+    while ((opt = getopt(argc, argv, "n:f:c")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        case 'c':
+            csv = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n iterations] [-f filter] [-c]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (csv) {
+        printf("case,ns/op,bytes,allocs/op,alloc bytes/op\n");
+    } else {
+        printf("%s (%lu iterations)\n", title, iterations);
+        printf("%-40s %10s %8s %10s %14s\n", "case", "ns/op", "bytes", "allocs/op", "alloc bytes/op");
+    }
+}
+
+bool benchEnabled(const char *name) {
+    return filter == NULL || strstr(name, filter) != NULL;
+}
+
+unsigned long benchIterations() {
+    return iterations;
+}
+
+uint64_t benchNowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void benchReport(const char *name, unsigned long n, uint64_t ns, size_t bytes, unsigned long allocs,
+        unsigned long allocBytes) {
+    if (n == 0) {
+        return;
+    }
+    if (csv) {
+        printf("%s,%.1f,%zu,%.2f,%.1f\n", name, (double) ns / n, bytes, (double) allocs / n, (double) allocBytes / n);
+    } else {
+        printf("%-40s %10.1f %8zu %10.2f %14.1f\n", name, (double) ns / n, bytes, (double) allocs / n,
+                (double) allocBytes / n);
+    }
+}
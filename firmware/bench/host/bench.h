@@ -0,0 +1,43 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+/*
+ * Host microbenchmark harness.
+ *
+ * Each case is a callable returning number of bytes it produced. It's run once
+ * to warm up and take the byte count, then for fixed number of iterations to
+ * measure time and heap allocations per call.
+ *
+ * Command line: [-n iterations] [-f name-filter] [-c]   (-c prints CSV)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+void benchInit(int argc, char *argv[], const char *title);
+bool benchEnabled(const char *name);
+unsigned long benchIterations();
+uint64_t benchNowNs();
+unsigned long benchAllocCount();
+unsigned long benchAllocBytes();
+void benchReport(const char *name, unsigned long iterations, uint64_t ns, size_t bytes, unsigned long allocs,
+        unsigned long allocBytes);
+
+template<class F>
+void bench(const char *name, F fn) {
+    if (!benchEnabled(name)) {
+        return;
+    }
+    size_t bytes = fn();
+    unsigned long iterations = benchIterations();
+    unsigned long a0 = benchAllocCount();
+    unsigned long b0 = benchAllocBytes();
+    uint64_t t0 = benchNowNs();
+    for (unsigned long i = 0; i < iterations; i++) {
+        fn();
+    }
+    uint64_t t1 = benchNowNs();
+    benchReport(name, iterations, t1 - t0, bytes, benchAllocCount() - a0, benchAllocBytes() - b0);
+}
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,97 @@
+/*
+ * ACS712 background RMS: ISR side cost per sample, read cost and accuracy of
+ * getCurrentACmA().
+ *
+ * Samples are fed the way bro wires it: single channel, Timer0 triggered ADC
+ * (~976Hz). Zero point shift and drift are added to check that continuous
+ * zero point tracking replaces calibrate(). Blocking getCurrentAC() cost is
+ * shown for comparison. Checks are printed to stderr, exit
+ * status is non zero if any of them is off.
+ */
+#include <Arduino.h>
+#include <ACS712.h>
+
+#include "bench.h"
+
+static const uint8_t PIN = A0;
+static const double SAMPLE_RATE = 16e6 / 64 / 256;
+static const double MAINS_HZ = 50;
+static const double MA_PER_COUNT = 5000 / 1023.0 / 0.066; // ACS712_30A
+static const uint16_t WINDOW = 4096;
+
+static ACS712 acs(ACS712_30A, PIN);
+
+static unsigned long sampleNo = 0;
+
+// feeds one window of sine with zero point moving from zero0 to zero1
+static void feed(const double amplitude, const double zero0, const double zero1, const int noise) {
+    for (uint16_t i = 0; i < WINDOW; i++, sampleNo++) {
+        double zero = zero0 + (zero1 - zero0) * i / WINDOW;
+        long v = lround(zero + amplitude * sin(2 * M_PI * MAINS_HZ * sampleNo / SAMPLE_RATE));
+        if (noise > 0) {
+            v += (rand() % (2 * noise + 1)) - noise;
+        }
+        acs.sample(constrain(v, 0, 1023));
+    }
+}
+
+static int failures = 0;
+
+static void check(const char *name, const double actual, const double expected, const double tolerance) {
+    bool ok = fabs(actual - expected) <= tolerance;
+    if (!ok) {
+        failures++;
+    }
+    fprintf(stderr, "%-40s %10.1f (expected %.1f+-%.1f)%s\n", name, actual, expected, tolerance, ok ? "" : " FAIL");
+}
+
+static double rmsMa(const double amplitude) {
+    return amplitude / sqrt(2) * MA_PER_COUNT;
+}
+
+int main(int argc, char *argv[]) {
+    acs.setWindow(WINDOW);
+    check("empty:has", acs.hasCurrentAC(), 0, 0);
+    check("empty:mA", acs.getCurrentACmA(), 0, 0);
+
+    feed(100, 511, 511, 0);
+    check("sine 100:has", acs.hasCurrentAC(), 1, 0);
+    check("sine 100:mA", acs.getCurrentACmA(), rmsMa(100), rmsMa(100) * 0.01);
+    check("sine 100:zero", acs.getZeroPoint(), 511, 0);
+
+    // zero point shift, one window to settle
+    feed(10, 520, 520, 0);
+    feed(10, 520, 520, 0);
+    check("sine 10 zero 520:mA", acs.getCurrentACmA(), rmsMa(10), rmsMa(10) * 0.02);
+    check("sine 10 zero 520:zero", acs.getZeroPoint(), 520, 0);
+
+    // supply sag during the window
+    feed(10, 520, 505, 0);
+    check("sine 10 drift 15:mA", acs.getCurrentACmA(), rmsMa(10), rmsMa(10) * 0.05);
+    check("sine 10 drift 15:zero", acs.getZeroPoint(), 505, 1);
+
+    feed(0, 505, 505, 0);
+    check("no load:mA", acs.getCurrentACmA(), 0, 15);
+    feed(0, 505, 505, 4);
+    check("no load noise +-4:mA", acs.getCurrentACmA(), 2.58 * MA_PER_COUNT, 20);
+
+    // heater threshold is 100mA, about 1.4 counts
+    feed(2, 505, 505, 0);
+    check("sine 2:mA", acs.getCurrentACmA(), rmsMa(2), rmsMa(2) * 0.15);
+    fprintf(stderr, "\n");
+
+    benchInit(argc, argv, "acs712");
+
+    bench("sample", [] {
+        acs.sample(530);
+        return 0;
+    });
+    bench("getCurrentACmA", [] {
+        return (int) acs.getCurrentACmA();
+    });
+    hostSetPin(PIN, 511);
+    bench("getCurrentAC:blocking 20ms", [] {
+        return (int) acs.getCurrentAC();
+    });
+    return failures ? 1 : 0;
+}
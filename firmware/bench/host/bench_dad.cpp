@@ -0,0 +1,163 @@
+/*
+ * dad inbound commands: parseCommand() time, bytes sent to all ports and heap
+ * use per command. ESP8266 on Serial2 is emulated, broadcasts go through the
+ * full HTTP send path.
+ *
+ * Boot: virtual time of setup(), time to the first control decision (circuits
+ * toggle heartbeat LED) and to TCP server up with ESP joining AP in 3s are
+ * checked on stderr, exit status is non zero if any of them is off. With
+ * blocking init() they were 6s, 8.2s and 8.2s.
+ *
+ * nsc over HTTP: response carries resulting state of node (csr with forced
+ * mode expiry), so the gateway needs no query after the command. GET /status
+ * streams all status entries with ETag, poll with it gets 304; GET /config
+ * has no passwords.
+ */
+#include <Arduino.h>
+
+#include "dad.h"
+#include "bench.h"
+#include "esp_at.h"
+
+static char buff[256];
+static const uint8_t HEARTBEAT_LED = 13;
+static int failures = 0;
+
+static void check(const char *name, const double actual, const double expected, const double tolerance) {
+    bool ok = fabs(actual - expected) <= tolerance;
+    if (!ok) {
+        failures++;
+    }
+    fprintf(stderr, "%-48s %10.1f (expected %.1f+-%.1f)%s\n", name, actual, expected, tolerance, ok ? "" : " FAIL");
+}
+
+static unsigned long txTotal() {
+    return Serial.txCount() + Serial1.txCount() + Serial2.txCount() + Serial3.txCount();
+}
+
+static size_t command(const char *cmd) {
+    unsigned long tx = txTotal();
+    strcpy(buff, cmd); // parser modifies input in place
+    parseCommand(buff);
+    Serial2.clear();
+    return txTotal() - tx;
+}
+
+// loop() until node answers request on link
+static uint16_t get(uint8_t link, const char *request) {
+    espClientRequest(link, request, 64);
+    unsigned long start = micros();
+    while (espClientResponses(link) == 0 && micros() - start < 10000000UL) {
+        espClientPump();
+        loop();
+    }
+    return espClientStatus(link);
+}
+
+int main(int argc, char *argv[]) {
+    espAttach(Serial2);
+    espStation(true, 3000);
+    unsigned long start = micros();
+    setup();
+    check("boot:setup() ms", (micros() - start) / 1000.0, 0, 50);
+    while (digitalRead(HEARTBEAT_LED) == LOW && micros() - start < 60000000UL) {
+        loop();
+    }
+    // that's one pass of DS18B20 reads, WiFi isn't waited for
+    check("boot:ms to first control decision", (micros() - start) / 1000.0, 0, 2500);
+    while (!espListening() && micros() - start < 60000000UL) {
+        loop();
+    }
+    // join overlaps sensor passes, CWJAP result is taken after the second one
+    check("boot:s to TCP server up", (micros() - start) / 1e6, 7, 1);
+    espClientRequest(0, "POST / HTTP/1.1\r\nContent-Length: 34\r\n\r\n{\"m\":\"nsc\",\"id\":22,\"ns\":1,\"ft\":60}", 64);
+    start = micros();
+    while (espClientResponses(0) == 0 && micros() - start < 10000000UL) {
+        espClientPump();
+        loop();
+    }
+    const char *reply = strstr(espLastSent(), "\r\n\r\n");
+    check("nsc over HTTP:status", espClientStatus(0), 200, 0);
+    check("nsc over HTTP:state in response", reply && !strncmp(reply + 4, "{\"m\":\"csr\",\"n\":{\"id\":22,\"ns\":1,", 31)
+            && strstr(reply, "\"ff\":1,\"ft\":") != NULL, 1, 0);
+    check("GET /status:200", get(1, "GET /status HTTP/1.1\r\n\r\n"), 200, 0);
+    const char *received = espClientReceived(1);
+    const char *body = strstr(received, "\r\n\r\n");
+    check("GET /status:all entries", body && body[4] == '[' && received[strlen(received) - 1] == ']'
+            && strstr(body, "{\"m\":\"csr\",\"n\":{\"id\":40,") != NULL, 1, 0);
+    size_t full = strlen(received);
+    const char *tag = strstr(received, "ETag: ");
+    static char poll[64];
+    snprintf(poll, sizeof(poll), "GET /status HTTP/1.1\r\nIf-None-Match: %.10s\r\n\r\n", tag ? tag + 6 : "");
+    check("GET /status:poll with ETag:304", get(1, poll), 304, 0);
+    fprintf(stderr, "%-48s %10u\n", "GET /status:bytes of snapshot", (unsigned int) full);
+    fprintf(stderr, "%-48s %10u\n", "GET /status:bytes of 304", (unsigned int) strlen(espClientReceived(1)));
+    check("GET /config:no passwords", get(1, "GET /config HTTP/1.1\r\n\r\n") == 200
+            && strstr(espClientReceived(1), "\"lap\"") && !strstr(espClientReceived(1), "\"lpw\""), 1, 0);
+    fprintf(stderr, "\n");
+
+    benchInit(argc, argv, "dad parseCommand");
+
+    bench("cls", [] {
+        return command("{\"m\":\"cls\"}");
+    });
+    bench("csr", [] {
+        return command("{\"m\":\"csr\"}");
+    });
+    bench("csr:room temp", [] {
+        return command("{\"m\":\"csr\",\"s\":{\"id\":74,\"v\":21}}");
+    });
+    bench("nsc:force", [] {
+        return command("{\"m\":\"nsc\",\"id\":22,\"ns\":1,\"ft\":60}");
+    });
+    bench("nsc:force permanent", [] {
+        return command("{\"m\":\"nsc\",\"id\":22,\"ns\":1}");
+    });
+    bench("nsc:unforce", [] {
+        return command("{\"m\":\"nsc\",\"id\":22}");
+    });
+    bench("cfg:sensor cf", [] {
+        return command("{\"m\":\"cfg\",\"s\":{\"id\":54,\"cf\":1.05}}");
+    });
+    bench("cfg:sensor co", [] {
+        return command("{\"m\":\"cfg\",\"s\":{\"id\":54,\"co\":-5}}");
+    });
+    bench("cfg:sensor uid", [] {
+        return command("{\"m\":\"cfg\",\"s\":{\"id\":54,\"uid\":\"28FF6A8C6B1403A2\"}}");
+    });
+    bench("cfg:sensor th", [] {
+        return command("{\"m\":\"cfg\",\"s\":{\"id\":201,\"v\":20}}");
+    });
+    bench("cfg:rap", [] {
+        return command("{\"m\":\"cfg\",\"rap\":\"homekeeper\"}");
+    });
+    bench("cfg:rpw", [] {
+        return command("{\"m\":\"cfg\",\"rpw\":\"secret\"}");
+    });
+    bench("cfg:lap", [] {
+        return command("{\"m\":\"cfg\",\"lap\":\"dad\"}");
+    });
+    bench("cfg:lpw", [] {
+        return command("{\"m\":\"cfg\",\"lpw\":\"secret\"}");
+    });
+    bench("cfg:sip", [] {
+        return command("{\"m\":\"cfg\",\"sip\":\"192.168.0.2\"}");
+    });
+    bench("cfg:sp", [] {
+        return command("{\"m\":\"cfg\",\"sp\":8080}");
+    });
+    bench("cfg:report", [] {
+        return command("{\"m\":\"cfg\"}");
+    });
+    bench("AT", [] {
+        return command("AT+CIPSTATUS\r\n");
+    });
+    bench("invalid", [] {
+        return command("{\"m\":");
+    });
+    // turns debug output off, keep it last
+    bench("cfg:dsp", [] {
+        return command("{\"m\":\"cfg\",\"dsp\":-1}");
+    });
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Non-blocking DHT driver: loop side cost of update() and decoding of emulated
+ * sensor frames.
+ *
+ * Sensor answers on digitalRead() over virtual time the way DHT11/DHT22 do it
+ * after start signal. update() is called every 1ms of virtual time like a busy
+ * loop() would do. Longest virtual time spent in one update() call is checked
+ * against frame length: host has no pin interrupts, so frame is polled with
+ * interrupts disabled (the old driver blocked for ~275ms, ~5ms of that with
+ * interrupts disabled). Periodic interrupt handlers of the nodes are emulated
+ * to check that they do not break the frame. Checks are printed to stderr, exit status is non zero
+ * if any of them is off.
+ */
+#include <Arduino.h>
+#include <DHT.h>
+
+#include "bench.h"
+
+static const uint8_t PIN_DHT11 = 5;
+static const uint8_t PIN_DHT22 = 6;
+
+static DHT dht11(PIN_DHT11, DHT11);
+static DHT dht22(PIN_DHT22, DHT22);
+
+// emulated sensor
+static uint8_t frame[5];
+static bool responding = true;
+static unsigned long frameStart = 0;
+
+static void setFrame(const uint8_t b0, const uint8_t b1, const uint8_t b2, const uint8_t b3, const int csDelta) {
+    frame[0] = b0;
+    frame[1] = b1;
+    frame[2] = b2;
+    frame[3] = b3;
+    frame[4] = ((b0 + b1 + b2 + b3) & 0xFF) + csDelta;
+}
+
+static int sensor(uint8_t pin, unsigned long us) {
+    if (pin != PIN_DHT11 && pin != PIN_DHT22) {
+        return hostGetPin(pin);
+    }
+    if (!responding) {
+        return HIGH;
+    }
+    if (frameStart == 0) {
+        // first read after host released the line
+        frameStart = us;
+    }
+    unsigned long t = us - frameStart;
+    // host pull up, sensor response low and high
+    if (t < 30) {
+        return HIGH;
+    }
+    t -= 30;
+    if (t < 80) {
+        return LOW;
+    }
+    if (t < 160) {
+        return HIGH;
+    }
+    t -= 160;
+    for (uint8_t i = 0; i < 40; i++) {
+        unsigned long high = (frame[i / 8] & (0x80 >> (i % 8))) ? 70 : 27;
+        if (t < 50) {
+            return LOW;
+        }
+        if (t < 50 + high) {
+            return HIGH;
+        }
+        t -= 50 + high;
+    }
+    return t < 50 ? LOW : HIGH;
+}
+
+static unsigned long maxBlockUs = 0;
+
+// runs one transaction, returns update() result of its last step
+static bool transaction(DHT &dht) {
+    frameStart = 0;
+    // next read is due
+    hostAdvanceMicros(DHT_READ_INTERVAL * 1000UL);
+    bool good = false;
+    for (int i = 0; i < 100; i++) {
+        unsigned long t0 = micros();
+        good = dht.update();
+        unsigned long dt = micros() - t0;
+        if (dt > maxBlockUs) {
+            maxBlockUs = dt;
+        }
+        if (!dht.busy()) {
+            break;
+        }
+        hostAdvanceMicros(1000);
+    }
+    return good;
+}
+
+static int failures = 0;
+
+static void check(const char *name, const double actual, const double expected, const double tolerance) {
+    bool ok = (isnan(expected) && isnan(actual)) || fabs(actual - expected) <= tolerance;
+    if (!ok) {
+        failures++;
+    }
+    fprintf(stderr, "%-40s %10.1f (expected %.1f+-%.1f)%s\n", name, actual, expected, tolerance, ok ? "" : " FAIL");
+}
+
+int main(int argc, char *argv[]) {
+    hostSetDigitalSource(sensor);
+    dht11.begin();
+    dht22.begin();
+
+    check("dht11:before first read", dht11.readTemperature(), NAN, 0);
+    setFrame(45, 0, 23, 0, 0);
+    check("dht11:good", transaction(dht11), 1, 0);
+    check("dht11:temperature", dht11.readTemperature(), 23, 0);
+    check("dht11:humidity", dht11.readHumidity(), 45, 0);
+
+    setFrame(0x02, 0x8C, 0x80, 0x65, 0); // 65.2%, -10.1C
+    check("dht22:good", transaction(dht22), 1, 0);
+    check("dht22:temperature", dht22.readTemperature(), -10.1, 0.01);
+    check("dht22:humidity", dht22.readHumidity(), 65.2, 0.01);
+
+    setFrame(46, 0, 24, 0, 1);
+    check("dht11:bad checksum", transaction(dht11), 0, 0);
+    check("dht11:bad checksum:last good", dht11.readTemperature(), 23, 0);
+    responding = false;
+    check("dht11:no response", transaction(dht11), 0, 0);
+    check("dht11:no response:last good", dht11.readTemperature(), 23, 0);
+    check("dht11:no response x3", transaction(dht11), 0, 0);
+    check("dht11:no response x3:unknown", dht11.readTemperature(), NAN, 0);
+    responding = true;
+    setFrame(40, 0, 21, 0, 0);
+    check("dht11:recovered", transaction(dht11), 1, 0);
+    check("dht11:recovered:temperature", dht11.readTemperature(), 21, 0);
+
+    // interrupt handlers are held off while frame is polled. mom samples ADC
+    // in ~45us handler every 312us, SoftwareSerial RX takes ~170us per byte
+    hostSetInterruptLoad(312, 45);
+    setFrame(0x01, 0xF4, 0x00, 0xEB, 0); // 50.0%, 23.5C
+    check("dht22:adc isr", transaction(dht22), 1, 0);
+    check("dht22:adc isr:temperature", dht22.readTemperature(), 23.5, 0.01);
+    check("dht22:adc isr:humidity", dht22.readHumidity(), 50.0, 0.01);
+    hostSetInterruptLoad(1042, 170);
+    setFrame(55, 0, 19, 0, 0);
+    check("dht11:serial rx isr", transaction(dht11), 1, 0);
+    check("dht11:serial rx isr:temperature", dht11.readTemperature(), 19, 0);
+    hostSetInterruptLoad(0, 0);
+
+    // 30+160us response, 40 bits of 77-120us, 50us end
+    check("max virtual us per update()", maxBlockUs, 3000, 2500);
+    fprintf(stderr, "\n");
+
+    benchInit(argc, argv, "dht");
+
+    bench("update:idle", [] {
+        dht11.update();
+        return 0;
+    });
+    bench("transaction:dht11", [] {
+        transaction(dht11);
+        return 0;
+    });
+    bench("readTemperature", [] {
+        dht11.readTemperature();
+        return 0;
+    });
+    return failures ? 1 : 0;
+}
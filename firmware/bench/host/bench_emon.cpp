@@ -0,0 +1,289 @@
+/*
+ * EmonLib: continuous metering and calcVI() accuracy and cost.
+ *
+ * Metering samples go through the sampler the way mom wires it (voltage,
+ * current and one more channel round robin, free running ADC). Virtual clock
+ * is moved by the ADC conversion time, so energy is integrated over simulated
+ * time.
+ *
+ * calcVI() fixed point core is compared with the original double precision
+ * one (kept below as reference) on a recorded-like waveform: mains voltage
+ * with 3rd/5th harmonics, non-linear load current, ADC noise. Sample rate is
+ * set through virtual analogRead() time; on AVR it is bound by per sample
+ * math, which is what fixed point core cuts.
+ *
+ * Checks and accuracy table are printed to stderr, exit status is non zero if
+ * any check is off.
+ */
+#include <Arduino.h>
+#include <EmonLib.h>
+#include <sampler.h>
+
+#include "bench.h"
+
+static const uint8_t PIN_I = A0;
+static const uint8_t PIN_V = A1;
+static const uint8_t PIN_X = A2;
+static const uint8_t PINS[] = { PIN_V, PIN_I, PIN_X };
+static const uint8_t PIN_COUNT = sizeof(PINS) / sizeof(PINS[0]);
+
+static const double VCAL = 190;
+static const double ICAL = 42;
+static const double CONVERSION_US = 1e6 / (16e6 / 128 / 13);
+static const double MAINS_HZ = 50;
+static const double VCC = 3.3; // host readVcc()
+
+static EnergyMonitor emon;
+static EnergyMonitor emonVI;
+
+static double t = 0; // s
+
+static void onSample(const uint8_t pin, const uint16_t value) {
+    emon.meterSample(pin, value);
+}
+
+// feeds given time of mains with voltage/current amplitudes in ADC counts
+static void feed(const double seconds, const double vAmp, const double iAmp, const double phase, const int offset) {
+    double end = t + seconds;
+    while (t < end) {
+        double w = 2 * M_PI * MAINS_HZ * t;
+        samplerPush(0, offset + lround(vAmp * sin(w)));
+        samplerPush(1, offset + lround(iAmp * sin(w - phase)));
+        samplerPush(2, 0);
+        t += PIN_COUNT * CONVERSION_US / 1e6;
+        hostAdvanceMicros(lround(PIN_COUNT * CONVERSION_US));
+    }
+}
+
+static int failures = 0;
+
+static void check(const char *name, const double actual, const double expected, const double tolerance) {
+    bool ok = fabs(actual - expected) <= tolerance;
+    if (!ok) {
+        failures++;
+    }
+    fprintf(stderr, "%-40s %10.3f (expected %.3f+-%.3f)%s\n", name, actual, expected, tolerance, ok ? "" : " FAIL");
+}
+
+// vLead: voltage sensor is ahead of mains by given seconds, phase is of
+// current to sampled voltage. pTolerance: relative, of power and energy
+static void checkMains(const char *title, const double vAmp, const double iAmp, const double phase, const int offset,
+        const double vLead = 0, const double pTolerance = 0.01) {
+    char name[64];
+    double vRatio = VCAL * VCC / ADC_COUNTS;
+    double iRatio = ICAL * VCC / ADC_COUNTS;
+    double vrms = vRatio * vAmp / sqrt(2);
+    double irms = iRatio * iAmp / sqrt(2);
+    double p = vrms * irms * cos(phase - 2 * M_PI * MAINS_HZ * vLead);
+
+    // let offset filters settle
+    feed(2, vAmp, iAmp, phase, offset);
+    emon.meterRead();
+    feed(10, vAmp, iAmp, phase, offset);
+    emon.meterRead();
+
+    snprintf(name, sizeof(name), "%s:Vrms", title);
+    check(name, emon.Vrms, vrms, vrms * 0.005);
+    snprintf(name, sizeof(name), "%s:Irms", title);
+    check(name, emon.Irms, irms, irms * 0.005 + 0.01);
+    snprintf(name, sizeof(name), "%s:realPower", title);
+    check(name, emon.realPower, p, fabs(p) * pTolerance + 1);
+    snprintf(name, sizeof(name), "%s:realEnergy 10s", title);
+    check(name, emon.realEnergy, p * 10, fabs(p) * pTolerance * 10 + 10);
+}
+
+/*============================= calcVI accuracy ============================*/
+
+static const double REC_V_AMP = 300;
+static const double REC_I_AMP = 100;
+static const double REC_PHASE = M_PI / 6;
+
+static double recVoltage(const double w) {
+    return REC_V_AMP * (sin(w) + 0.03 * sin(3 * w) + 0.02 * sin(5 * w));
+}
+
+static double recCurrent(const double w) {
+    return REC_I_AMP * (sin(w - REC_PHASE) + 0.2 * sin(3 * (w - REC_PHASE)));
+}
+
+static int recorded(uint8_t pin, unsigned long us) {
+    double w = 2 * M_PI * MAINS_HZ * us / 1e6;
+    double v = (pin == PIN_V) ? recVoltage(w) : (pin == PIN_I) ? recCurrent(w) : 0;
+    // +-2 LSB noise, quantization, clipping
+    long s = 512 + lround(v) + (rand() % 5) - 2;
+    return constrain(s, 0, ADC_COUNTS - 1);
+}
+
+// original EmonLib calcVI() math, double precision
+struct DoubleVI {
+    double offsetV = ADC_COUNTS >> 1, offsetI = ADC_COUNTS >> 1;
+    double filteredV = 0, lastFilteredV = 0, filteredI = 0;
+    double sumV = 0, sumI = 0, sumP = 0;
+    double Vrms, Irms, realPower;
+
+    void calcVI(unsigned int crossings, unsigned int timeout, double phasecal) {
+        unsigned int crossCount = 0;
+        unsigned int numberOfSamples = 0;
+        bool lastVCross = false, checkVCross = false;
+        unsigned long start = millis();
+        int startV;
+        do {
+            startV = analogRead(PIN_V);
+        } while (!(startV < ADC_COUNTS * 0.55 && startV > ADC_COUNTS * 0.45) && millis() - start <= timeout);
+        start = millis();
+        while (crossCount < crossings && millis() - start < timeout) {
+            numberOfSamples++;
+            lastFilteredV = filteredV;
+            int sampleV = analogRead(PIN_V);
+            int sampleI = analogRead(PIN_I);
+            offsetV = offsetV + ((sampleV - offsetV) / 1024);
+            filteredV = sampleV - offsetV;
+            offsetI = offsetI + ((sampleI - offsetI) / 1024);
+            filteredI = sampleI - offsetI;
+            sumV += filteredV * filteredV;
+            sumI += filteredI * filteredI;
+            double phaseShiftedV = lastFilteredV + phasecal * (filteredV - lastFilteredV);
+            sumP += phaseShiftedV * filteredI;
+            lastVCross = checkVCross;
+            checkVCross = sampleV > startV;
+            if (numberOfSamples == 1) {
+                lastVCross = checkVCross;
+            }
+            if (lastVCross != checkVCross) {
+                crossCount++;
+            }
+        }
+        double vRatio = VCAL * VCC / ADC_COUNTS;
+        double iRatio = ICAL * VCC / ADC_COUNTS;
+        Vrms = vRatio * sqrt(sumV / numberOfSamples);
+        Irms = iRatio * sqrt(sumI / numberOfSamples);
+        realPower = vRatio * iRatio * sumP / numberOfSamples;
+        sumV = sumI = sumP = 0;
+    }
+};
+
+static DoubleVI doubleVI;
+
+static double errPct(const double actual, const double expected) {
+    return 100 * fabs(actual - expected) / fabs(expected);
+}
+
+static void checkNotWorse(const char *title, const unsigned int rate, const double actual, const double reference) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s %u", title, rate);
+    double limit = reference * 1.1 + 0.05;
+    bool ok = actual <= limit;
+    if (!ok) {
+        failures++;
+    }
+    fprintf(stderr, "%-40s %10.3f (expected <=%.3f)%s\n", name, actual, limit, ok ? "" : " FAIL");
+}
+
+static void accuracyTable() {
+    // true values of the continuous waveform
+    double vRatio = VCAL * VCC / ADC_COUNTS;
+    double iRatio = ICAL * VCC / ADC_COUNTS;
+    double sv = 0, si = 0, sp = 0;
+    const int steps = 100000;
+    for (int k = 0; k < steps; k++) {
+        double w = 2 * M_PI * k / steps;
+        sv += recVoltage(w) * recVoltage(w);
+        si += recCurrent(w) * recCurrent(w);
+        sp += recVoltage(w) * recCurrent(w);
+    }
+    double vrms = vRatio * sqrt(sv / steps);
+    double irms = iRatio * sqrt(si / steps);
+    double p = vRatio * iRatio * sp / steps;
+
+    fprintf(stderr, "calcVI(20, 2000) error vs waveform, %%, mean of 10 calls\n");
+    fprintf(stderr, "%10s %8s | %8s %8s %8s | %8s %8s %8s\n", "pairs/s", "samples", "dbl:V", "dbl:I", "dbl:P", "int:V",
+            "int:I", "int:P");
+    const unsigned int rates[] = { 500, 1000, 2000, 4000, 8000 };
+    hostSetAnalogSource(recorded);
+    for (unsigned int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        // calcVI loop: two analogRead() and one millis() per pair
+        unsigned long adcUs = (1000000 / rates[r] - 4) / 2;
+        hostSetAnalogReadMicros(adcUs);
+        // V is interpolated to the moment of I sample
+        double phasecal = 1 + (double) adcUs / (2 * adcUs + 4);
+        emonVI.voltage(PIN_V, VCAL, phasecal);
+        emonVI.current(PIN_I, ICAL);
+        double e[6] = { 0 };
+        const int calls = 10;
+        for (int n = 0; n < calls + 1; n++) {
+            doubleVI.calcVI(20, 2000, phasecal);
+            emonVI.calcVI(20, 2000);
+            if (n == 0) {
+                continue; // offset filters settle
+            }
+            e[0] += errPct(doubleVI.Vrms, vrms) / calls;
+            e[1] += errPct(doubleVI.Irms, irms) / calls;
+            e[2] += errPct(doubleVI.realPower, p) / calls;
+            e[3] += errPct(emonVI.Vrms, vrms) / calls;
+            e[4] += errPct(emonVI.Irms, irms) / calls;
+            e[5] += errPct(emonVI.realPower, p) / calls;
+        }
+        fprintf(stderr, "%10u %8u | %8.3f %8.3f %8.3f | %8.3f %8.3f %8.3f\n", rates[r], rates[r] / 5, e[0], e[1], e[2],
+                e[3], e[4], e[5]);
+        // fixed point core must not be worse than double one. both see
+        // different windows of the waveform, so allow for that
+        checkNotWorse("calcVI:int vs double V err", rates[r], e[3], e[0]);
+        checkNotWorse("calcVI:int vs double I err", rates[r], e[4], e[1]);
+        checkNotWorse("calcVI:int vs double P err", rates[r], e[5], e[2]);
+    }
+    hostSetAnalogSource(NULL);
+    hostSetAnalogReadMicros(ADC_READ_USEC);
+}
+
+int main(int argc, char *argv[]) {
+    emon.voltage(PIN_V, VCAL, 1); // no phase shift between synthetic V and I
+    emon.current(PIN_I, ICAL);
+    emon.meterBegin(lround(PIN_COUNT * CONVERSION_US));
+    samplerSetHook(onSample);
+    samplerBegin(PINS, PIN_COUNT, SAMPLER_TRIGGER_FREE);
+
+    checkMains("resistive", 300, 100, 0, 512);
+    checkMains("inductive 60deg", 300, 100, M_PI / 3, 512);
+    checkMains("export", 300, 60, M_PI, 512);
+    checkMains("offset 500", 300, 20, 0, 500);
+    checkMains("no load", 300, 0, 0, 512);
+    fprintf(stderr, "\n");
+    accuracyTable();
+    fprintf(stderr, "\n");
+    // mom calibration: -1.3 corrects voltage 2.3 calcVI() pairs ahead. linear
+    // extrapolation that far raises shifted voltage by ~2%, as in calcVI()
+    double lead = 2.3 * CALCVI_PAIR_USEC / 1e6;
+    emon.voltage(PIN_V, VCAL, -1.3);
+    emon.meterBegin(lround(PIN_COUNT * CONVERSION_US));
+    checkMains("calcVI PHASECAL", 300, 100, M_PI / 3 + 2 * M_PI * MAINS_HZ * lead, 512, lead, 0.025);
+    fprintf(stderr, "\n");
+
+    benchInit(argc, argv, "emon meter");
+
+    bench("meterSample:V+I pair", [] {
+        emon.meterSample(PIN_V, 700);
+        emon.meterSample(PIN_I, 600);
+        return 0;
+    });
+    bench("samplerPush+hook:V+I pair", [] {
+        samplerPush(0, 700);
+        samplerPush(1, 600);
+        return 0;
+    });
+    bench("meterRead", [] {
+        emon.meterSample(PIN_V, 700);
+        emon.meterSample(PIN_I, 600);
+        emon.meterRead();
+        return 0;
+    });
+    hostSetAnalogSource(recorded);
+    bench("calcVI:int 20 crossings", [] {
+        emonVI.calcVI(20, 2000);
+        return 0;
+    });
+    bench("calcVI:double 20 crossings", [] {
+        doubleVI.calcVI(20, 2000, 1.5);
+        return 0;
+    });
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,512 @@
+/*
+ * ESP8266 TCP server with concurrent clients against the AT emulator.
+ *
+ * Up to ESP_SERVER_LINKS clients send requests split into several +IPD
+ * packages; packages of different links interleave, and in the second round
+ * they also come while the driver waits for replies to its own commands (the
+ * way gateway retries collide with an Android client). Requests are served the
+ * way dad loop() does it: receive() whenever available() says so. Requests
+ * served and failed, responses on each link and virtual time per request are
+ * checked; checks are printed to stderr, exit status is non zero if any of
+ * them is off. Benchmarks report bytes sent to ESP per request.
+ *
+ * Response matcher: tokens with partial self overlap, the first of several
+ * tokens, ERROR reply ending a command at once instead of after its timeout,
+ * and readUntil() over long responses.
+ *
+ * Reply: respond() sends the state of node back in response to the request
+ * taken by receive(), with exact Content-Length; a request left without it is
+ * answered with plain 200 by update().
+ *
+ * Router: requests go to routes of request line, the rest get 404. GET
+ * /status streams JSON array of node states in CIPSEND of request buffer size
+ * with exact Content-Length and ETag; poll with that ETag gets 304 without
+ * body until a node switches.
+ *
+ * Client request: send() announces exact length of the request it streams
+ * from flash; the emulator ends data mode after that many bytes, so a wrong
+ * length leaves no HTTP response.
+ *
+ * Uplink: frames sent by stream() over persistent client link (node with TCP
+ * server) and in passthrough mode (node without it), and messages per second
+ * of both against HTTP request per message with the wire modeled at 57600
+ * baud and 5ms network round trip.
+ *
+ * Telemetry: datagram() prefixes message with sequence number and count of
+ * failed sends, a failed send is counted and send() still works after
+ * datagrams; datagrams per second are reported next to uplink rates.
+ *
+ * Breaker: requests fail without a byte sent to ESP after a few failures, a
+ * trial goes after backoff which doubles on failed trial. With AP out of reach
+ * for 10 minutes (reports every 5s, ESP gives up joining in 15s) recovery runs
+ * in update() steps: the longest single call, joins tried and time to recover
+ * once AP is back are checked.
+ */
+#include <Arduino.h>
+#include <ESP8266.h>
+
+#include "bench.h"
+#include "esp_at.h"
+
+static ESP8266 esp;
+static const esp_config_t SSID = "HOME";
+static const esp_config_t PASSWORD = "secret";
+static const esp_ip_t SERVER_IP = { 192, 168, 0, 1 };
+static const char *MESSAGE = "{\"s\":{\"id\":54,\"v\":215,\"ts\":1234567}}";
+
+static const char *REQUESTS[] = {
+    "POST / HTTP/1.1\r\nHost: 192.168.4.1\r\nContent-Type: application/json\r\nContent-Length: 11\r\n\r\n{\"m\":\"cls\"}",
+    "POST / HTTP/1.1\r\nHost: 192.168.4.1\r\nContent-Type: application/json\r\nContent-Length: 11\r\n\r\n{\"m\":\"csr\"}",
+    "POST / HTTP/1.1\r\nHost: 192.168.4.1\r\nContent-Length: 26\r\nConnection: close\r\n\r\n{\"m\":\"nsc\",\"id\":22,\"ns\":1}",
+    "POST / HTTP/1.1\r\ncontent-length: 19\r\n\r\n{\"m\":\"nsc\",\"id\":22}" };
+static const char *BODIES[] = {
+    "{\"m\":\"cls\"}",
+    "{\"m\":\"csr\"}",
+    "{\"m\":\"nsc\",\"id\":22,\"ns\":1}",
+    "{\"m\":\"nsc\",\"id\":22}" };
+
+static const char *REPLY = "{\"m\":\"csr\",\"n\":{\"id\":22,\"ns\":1,\"ts\":1234567,\"ff\":1,\"ft\":1237167}}";
+static const char *REPLY_RESPONSE = "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nContent-Length: 65\r\n\r\n"
+        "{\"m\":\"csr\",\"n\":{\"id\":22,\"ns\":1,\"ts\":1234567,\"ff\":1,\"ft\":1237167}}";
+
+static char oversized[300];
+
+static int received[ESP_SERVER_LINKS];
+static int unknown = 0;
+
+// dad loop() until clients are done, returns requests served
+static int serve() {
+    char message[ESP_REQUEST_SIZE + 1];
+    int served = 0;
+    bool more = true;
+    while (more) {
+        more = espClientPump();
+        if (esp.available() > 0) {
+            more = true;
+            if (esp.receive(message, ESP_REQUEST_SIZE) > 0) {
+                served++;
+                bool known = false;
+                for (uint8_t i = 0; i < ESP_SERVER_LINKS; i++) {
+                    if (!strcmp(message, BODIES[i])) {
+                        received[i]++;
+                        known = true;
+                    }
+                }
+                if (!known) {
+                    unknown++;
+                }
+                // state of node goes back with the command, as dad does
+                esp.respond(strncmp(message, "{\"m\":\"nsc\"", 10) ? NULL : REPLY);
+            }
+        }
+    }
+    return served;
+}
+
+static void queue(const size_t chunk) {
+    memset(received, 0, sizeof(received));
+    unknown = 0;
+    for (uint8_t i = 0; i < ESP_SERVER_LINKS; i++) {
+        espClientRequest(i, REQUESTS[i], chunk);
+    }
+}
+
+static int failures = 0;
+
+// index of token found in text, position after it in *end
+static int8_t match(const char *text, const char *t0, const char *t1, const char *t2, size_t *end) {
+    esp_matcher_t m;
+    matcherInit(m);
+    matcherAdd(m, t0);
+    matcherAdd(m, t1);
+    matcherAdd(m, t2);
+    for (size_t i = 0; text[i] != '\0'; i++) {
+        int8_t found = matcherFeed(m, text[i]);
+        if (found >= 0) {
+            *end = i + 1;
+            return found;
+        }
+    }
+    *end = strlen(text);
+    return -1;
+}
+
+static char response[512];
+
+// router: routes of dad, status snapshot of nodes
+static const char * const ROUTES[] = { "POST /", "POST /cmd", "GET /status", "GET /config" };
+static const uint8_t SNAPSHOT_NODES = 9;
+static uint8_t nodeStates[SNAPSHOT_NODES];
+static char routeRequest[128];
+static char snapshot[1024];
+
+static void statusItems(esp_json_out_t out) {
+    char json[64];
+    for (uint8_t i = 0; i < SNAPSHOT_NODES; i++) {
+        snprintf(json, sizeof(json), "{\"m\":\"csr\",\"n\":{\"id\":%d,\"ns\":%d,\"ts\":1234567,\"ff\":0}}",
+                20 + i, nodeStates[i]);
+        out(json);
+    }
+}
+
+static void collect(const char *json) {
+    strcat(snapshot, snapshot[0] ? "," : "[");
+    strcat(snapshot, json);
+}
+
+// loop() of node with routes, status is answered with snapshot
+static int8_t route(const char *request) {
+    strcpy(routeRequest, request);
+    espClientRequest(0, routeRequest, 64);
+    while (espClientPump())
+        ;
+    int8_t taken = esp.request(response, ESP_REQUEST_SIZE);
+    if (taken == 2) {
+        esp.respondItems(statusItems);
+    } else {
+        esp.respond();
+    }
+    return taken;
+}
+
+static const char *responseBody() {
+    const char *body = strstr(espClientReceived(0), "\r\n\r\n");
+    return body ? body + 4 : "";
+}
+
+static uint32_t responseTag() {
+    const char *tag = strstr(espClientReceived(0), "ETag: \"");
+    return tag ? strtoul(tag + 7, NULL, 16) : 0;
+}
+
+static void check(const char *name, const double actual, const double expected, const double tolerance) {
+    bool ok = fabs(actual - expected) <= tolerance;
+    if (!ok) {
+        failures++;
+    }
+    fprintf(stderr, "%-48s %10.1f (expected %.1f+-%.1f)%s\n", name, actual, expected, tolerance, ok ? "" : " FAIL");
+}
+
+// messages per second of virtual time
+static double rate(int16_t (ESP8266::*fn)(const esp_ip_t, const uint16_t, const char*), const uint16_t port) {
+    const int n = 20;
+    espLineRate(57600, 5000);
+    unsigned long start = micros();
+    for (int i = 0; i < n; i++) {
+        (esp.*fn)(SERVER_IP, port, MESSAGE);
+    }
+    unsigned long us = micros() - start;
+    espLineRate(0, 0);
+    return n * 1e6 / us;
+}
+
+static void round(const char *name, const size_t chunk) {
+    char label[64];
+    queue(chunk);
+    unsigned long start = micros();
+    int served = serve();
+    unsigned long us = micros() - start;
+    int ok = 0;
+    for (uint8_t i = 0; i < ESP_SERVER_LINKS; i++) {
+        ok += received[i] == 1 && espClientStatus(i) == 200 && espClientResponses(i) == 1;
+    }
+    snprintf(label, sizeof(label), "%s:served", name);
+    check(label, served, ESP_SERVER_LINKS, 0);
+    snprintf(label, sizeof(label), "%s:answered 200 once", name);
+    check(label, ok, ESP_SERVER_LINKS, 0);
+    snprintf(label, sizeof(label), "%s:failed", name);
+    check(label, unknown + ESP_SERVER_LINKS - ok, 0, 0);
+    // emulator answers at once, time is spent in driver polls
+    snprintf(label, sizeof(label), "%s:virtual ms per request", name);
+    check(label, us / 1000.0 / ESP_SERVER_LINKS, 1, 1);
+}
+
+int main(int argc, char *argv[]) {
+    espAttach(Serial2);
+    esp.init(&Serial2, MODE_STA_AP);
+    esp.connect(&SSID, &PASSWORD);
+    esp.startTcpServer(80);
+
+    size_t end;
+    check("match:overlap", match("\r\n\r\r\nOK\r\n", "\r\nOK\r\n", "ERROR", "x", &end), 0, 0);
+    check("match:overlap:end", end, 9, 0);
+    check("match:aabaab", match("aabaaabaab", "aabaab", "ERROR", "x", &end), 0, 0);
+    check("match:aabaab:end", end, 10, 0);
+    check("match:first of tokens", match("1,CONNECT\r\n4,CONNECT", "4,CONNECT", ",CONNECT", "ERROR", &end), 1, 0);
+    check("match:first of tokens:end", end, 9, 0);
+    check("match:tie goes to first added", match("4,CONNECT", "4,CONNECT", ",CONNECT", "ERROR", &end), 0, 0);
+    check("match:none", match("no ip\r\n", "4,CONNECT", ",CONNECT", "ERROR", &end), -1, 0);
+    espFail("AT+CIPSTO");
+    unsigned long start = millis();
+    check("write:ERROR reply", esp.write("AT+CIPSTO=10\r\n", EXPECT_OK), 0, 0);
+    check("write:ERROR reply:virtual ms", millis() - start, 0, 1);
+    espFail(NULL);
+    check("write:OK reply", esp.write("AT+CIPSTO=10\r\n", EXPECT_OK), 1, 0);
+
+    check("send:status", esp.send(SERVER_IP, 8080, MESSAGE), 200, 0);
+    check("send:request ends with body", !strcmp(espLastSent() + strlen(espLastSent()) - strlen(MESSAGE), MESSAGE), 1, 0);
+    check("send:Content-Length", strstr(espLastSent(), "\r\nContent-Length: 36\r\n") != NULL, 1, 0);
+
+    check("uplink:link:status", esp.stream(SERVER_IP, 8087, MESSAGE), strlen(MESSAGE), 0);
+    esp.stream(SERVER_IP, 8087, MESSAGE);
+    check("uplink:link:frames", espUplinkFrames(), 2, 0);
+    check("uplink:link:frame", !strcmp(espUplinkLastFrame(), MESSAGE), 1, 0);
+    check("uplink:link:send() after stream()", esp.send(SERVER_IP, 8080, MESSAGE), 200, 0);
+    esp.stopTcpServer();
+    check("uplink:passthrough:status", esp.stream(SERVER_IP, 8087, "{\"m\":\"cls\"}"), 11, 0);
+    esp.stream(SERVER_IP, 8087, MESSAGE);
+    check("uplink:passthrough:frames", espUplinkFrames(), 4, 0);
+    check("uplink:passthrough:frame", !strcmp(espUplinkLastFrame(), MESSAGE), 1, 0);
+    esp.closeUplink();
+    check("uplink:passthrough:AT after close", esp.write("AT\r\n", EXPECT_OK), 1, 0);
+    esp.startTcpServer(80);
+
+    check("udp:status", esp.datagram(SERVER_IP, 8089, MESSAGE), strlen(MESSAGE), 0);
+    check("udp:sequence", !strncmp(espLastSent(), "{\"q\":0,\"qf\":0,\"s\":", 18), 1, 0);
+    check("udp:message", !strcmp(espLastSent() + 14, MESSAGE + 1), 1, 0);
+    espFail("AT+CIPSEND");
+    check("udp:failed:status", esp.datagram(SERVER_IP, 8089, MESSAGE) <= 0, 1, 0);
+    espFail(NULL);
+    esp.datagram(SERVER_IP, 8089, "{}");
+    check("udp:empty object", !strcmp(espLastSent(), "{\"q\":2,\"qf\":1}"), 1, 0);
+    check("udp:datagrams", espDatagrams(), 2, 0);
+    check("udp:sent", esp.datagramsSent(), 3, 0);
+    check("udp:failed", esp.datagramsFailed(), 1, 0);
+    check("udp:send() after datagram()", esp.send(SERVER_IP, 8080, MESSAGE), 200, 0);
+
+    double http = rate(&ESP8266::send, 8080);
+    double link = rate(&ESP8266::stream, 8087);
+    double udp = rate(&ESP8266::datagram, 8089);
+    esp.closeUplink();
+    esp.stopTcpServer();
+    double passthrough = rate(&ESP8266::stream, 8087);
+    esp.closeUplink();
+    esp.startTcpServer(80);
+    fprintf(stderr, "%-48s %10.1f\n", "messages/s:HTTP per message", http);
+    fprintf(stderr, "%-48s %10.1f\n", "messages/s:uplink on client link", link);
+    fprintf(stderr, "%-48s %10.1f\n", "messages/s:uplink passthrough", passthrough);
+    fprintf(stderr, "%-48s %10.1f\n", "messages/s:UDP datagram", udp);
+    check("uplink on client link faster than HTTP", link > http, 1, 0);
+    check("passthrough faster than client link", passthrough > link, 1, 0);
+    check("UDP datagram faster than HTTP", udp > http, 1, 0);
+
+    round("clients:40 byte packages", 40);
+    round("clients:whole requests", 1024);
+    espClientInterleave(true);
+    round("clients:during AT replies", 16);
+    espClientInterleave(false);
+
+    // single client errors
+    memset(received, 0, sizeof(received));
+    espClientRequest(0, "GET /status HTTP/1.1\r\nHost: 192.168.4.1\r\n\r\n", 64);
+    check("GET:served", serve(), 0, 0);
+    check("GET:status", espClientStatus(0), 404, 0);
+    snprintf(oversized, sizeof(oversized), "POST / HTTP/1.1\r\nContent-Length: %d\r\n\r\n%*s", 200, 200, "}");
+    espClientRequest(0, oversized, 64);
+    check("oversized body:served", serve(), 0, 0);
+    check("oversized body:status", espClientStatus(0), 400, 0);
+    espClientRequest(0, REQUESTS[0], 64, true);
+    // whole request and hang up come before loop() gets to it
+    while (espClientPump())
+        ;
+    check("client hung up:served", serve(), 1, 0);
+    check("client hung up:responses", espClientResponses(0), 0, 0);
+    espClientRequest(0, REQUESTS[2], 64);
+    serve();
+    check("reply:status", espClientStatus(0), 200, 0);
+    check("reply:body with exact length", !strcmp(espLastSent(), REPLY_RESPONSE), 1, 0);
+    // loop() without respond(), update() answers it
+    espClientRequest(0, REQUESTS[0], 64);
+    while (espClientPump())
+        ;
+    esp.receive(response, ESP_REQUEST_SIZE);
+    check("reply:pending before update", espClientResponses(0), 0, 0);
+    esp.update();
+    check("reply:answered by update", espClientResponses(0) == 1 && espClientStatus(0) == 200, 1, 0);
+
+    esp.setRoutes(ROUTES, sizeof(ROUTES) / sizeof(ROUTES[0]));
+    snapshot[0] = '\0';
+    statusItems(collect);
+    strcat(snapshot, "]");
+    check("route:GET /status", route("GET /status HTTP/1.1\r\nHost: 192.168.4.1\r\n\r\n"), 2, 0);
+    check("route:GET /status:200", espClientStatus(0), 200, 0);
+    check("route:GET /status:snapshot", !strcmp(responseBody(), snapshot), 1, 0);
+    snprintf(routeRequest, sizeof(routeRequest), "\r\nContent-Length: %u\r\n", (unsigned int) strlen(snapshot));
+    check("route:GET /status:Content-Length", strstr(espClientReceived(0), routeRequest) != NULL, 1, 0);
+    uint32_t tag = responseTag();
+    size_t full = strlen(espClientReceived(0));
+    char poll[96];
+    snprintf(poll, sizeof(poll), "GET /status HTTP/1.1\r\nIf-None-Match: \"%08lx\"\r\n\r\n", (unsigned long) tag);
+    route(poll);
+    check("route:same snapshot:304", espClientStatus(0), 304, 0);
+    check("route:same snapshot:no body", strlen(responseBody()), 0, 0);
+    check("route:same snapshot:same ETag", responseTag() == tag, 1, 0);
+    size_t notModified = strlen(espClientReceived(0));
+    nodeStates[3] = 1;
+    route(poll);
+    check("route:node switched:200", espClientStatus(0), 200, 0);
+    check("route:node switched:new ETag", responseTag() != tag, 1, 0);
+    check("route:POST /cmd", route("POST /cmd HTTP/1.1\r\nContent-Length: 11\r\n\r\n{\"m\":\"cls\"}"), 1, 0);
+    check("route:POST /cmd:body", !strcmp(response, "{\"m\":\"cls\"}"), 1, 0);
+    check("route:GET /status?x", route("GET /status?x=1 HTTP/1.1\r\n\r\n"), 2, 0);
+    check("route:GET /statusx", route("GET /statusx HTTP/1.1\r\n\r\n"), -1, 0);
+    check("route:GET /statusx:404", espClientStatus(0), 404, 0);
+    check("route:POST /status:404", route("POST /status HTTP/1.1\r\n\r\n") < 0 && espClientStatus(0) == 404, 1, 0);
+    // link of the streamed snapshot is taken by a new client in the middle
+    strcpy(routeRequest, "GET /status HTTP/1.1\r\n\r\n");
+    espClientRequest(0, routeRequest, 64);
+    while (espClientPump())
+        ;
+    esp.request(response, ESP_REQUEST_SIZE);
+    espClientRequest(0, "GET /config HTTP/1.1\r\n\r\n", 64);
+    espClientInterleave(true);
+    esp.respondItems(statusItems);
+    espClientInterleave(false);
+    check("route:link reused:response ends at close", strlen(espClientReceived(0)) <= ESP_REQUEST_SIZE, 1, 0);
+    uint16_t chunks = espClientResponses(0);
+    while (espClientPump())
+        ;
+    check("route:link reused:new client served", esp.request(response, ESP_REQUEST_SIZE), 3, 0);
+    esp.respond();
+    check("route:link reused:new client answered", espClientResponses(0), chunks + 1, 0);
+    check("route:link reused:next request", route("GET /status HTTP/1.1\r\n\r\n") == 2 && espClientStatus(0) == 200, 1, 0);
+    fprintf(stderr, "%-48s %10u\n", "route:bytes of snapshot response", (unsigned int) full);
+    fprintf(stderr, "%-48s %10u\n", "route:bytes of 304 response", (unsigned int) notModified);
+    check("route:304 under 1/4 of snapshot", notModified * 4 < full, 1, 0);
+
+    // 30s grace period as nodes have
+    esp.init(&Serial2, MODE_STA_AP, 0, 30);
+    esp.connect(&SSID, &PASSWORD);
+    esp.startTcpServer(80);
+    espFail("AT+CIPSTART");
+    for (int i = 0; i < 3; i++) {
+        esp.send(SERVER_IP, 8080, MESSAGE);
+    }
+    check("breaker:open after 3 failures", esp.breakerState(), BREAKER_OPEN, 0);
+    unsigned long tx = Serial2.txCount();
+    start = millis();
+    check("breaker:open:send", esp.send(SERVER_IP, 8080, MESSAGE), -1, 0);
+    check("breaker:open:send:bytes to ESP", Serial2.txCount() - tx, 0, 0);
+    check("breaker:open:send:virtual ms", millis() - start, 0, 0);
+    hostAdvanceMicros(5000000);
+    esp.update();
+    check("breaker:half-open after 5s", esp.breakerState(), BREAKER_HALF_OPEN, 0);
+    esp.send(SERVER_IP, 8080, MESSAGE);
+    check("breaker:failed trial:open", esp.breakerState(), BREAKER_OPEN, 0);
+    hostAdvanceMicros(5000000);
+    esp.update();
+    check("breaker:failed trial:backoff doubled", esp.breakerState(), BREAKER_OPEN, 0);
+    espFail(NULL);
+    hostAdvanceMicros(5000000);
+    esp.update();
+    check("breaker:trial:status", esp.send(SERVER_IP, 8080, MESSAGE), 200, 0);
+    check("breaker:trial:closed", esp.breakerState(), BREAKER_CLOSED, 0);
+
+    // dad loop() with reports every 5s while AP is out of reach
+    espStation(false, 15000);
+    espLineRate(57600, 5000);
+    unsigned long joins = espJoins();
+    unsigned long worst = 0;
+    unsigned long sends = 0;
+    unsigned long failedFast = 0;
+    unsigned long outage = micros();
+    unsigned long report = outage;
+    while (micros() - outage < 600000000UL) {
+        unsigned long t = micros();
+        if (t - report >= 5000000UL) {
+            report = t;
+            tx = Serial2.txCount();
+            sends++;
+            if (esp.send(SERVER_IP, 8080, MESSAGE) < 0 && Serial2.txCount() == tx) {
+                failedFast++;
+            }
+        }
+        esp.update();
+        worst = max(worst, micros() - t);
+        hostAdvanceMicros(10000);
+    }
+    joins = espJoins() - joins;
+    espStation(true, 3000);
+    unsigned long back = micros();
+    report = back;
+    int16_t status = -1;
+    while (status != 200 && micros() - back < 900000000UL) {
+        if (micros() - report >= 5000000UL) {
+            report = micros();
+            status = esp.send(SERVER_IP, 8080, MESSAGE);
+        }
+        esp.update();
+        hostAdvanceMicros(10000);
+    }
+    espLineRate(0, 0);
+    fprintf(stderr, "%-48s %10lu\n", "AP out of reach 10 min:reports", sends);
+    fprintf(stderr, "%-48s %10lu\n", "AP out of reach 10 min:failed without AT", failedFast);
+    check("AP out of reach 10 min:longest call ms", worst / 1000.0, 0, 50);
+    // backoff of failed trials before grace period is over carries on
+    check("AP out of reach 10 min:joins tried", joins, 4, 2);
+    check("AP back:sent", status, 200, 0);
+    check("AP back:s to recover", (micros() - back) / 1e6, 160, 160);
+    check("AP back:closed", esp.breakerState(), BREAKER_CLOSED, 0);
+    fprintf(stderr, "\n");
+
+    benchInit(argc, argv, "ESP8266 server");
+
+    bench("4 clients:40 byte packages", [] {
+        unsigned long tx = Serial2.txCount();
+        queue(40);
+        serve();
+        return (Serial2.txCount() - tx) / ESP_SERVER_LINKS;
+    });
+    bench("4 clients:whole requests", [] {
+        unsigned long tx = Serial2.txCount();
+        queue(1024);
+        serve();
+        return (Serial2.txCount() - tx) / ESP_SERVER_LINKS;
+    });
+    bench("1 client", [] {
+        unsigned long tx = Serial2.txCount();
+        espClientRequest(0, REQUESTS[0], 1024);
+        serve();
+        return Serial2.txCount() - tx;
+    });
+    bench("send", [] {
+        unsigned long tx = Serial2.txCount();
+        esp.send(SERVER_IP, 8080, MESSAGE);
+        return Serial2.txCount() - tx;
+    });
+    bench("stream:client link", [] {
+        unsigned long tx = Serial2.txCount();
+        esp.stream(SERVER_IP, 8087, MESSAGE);
+        return Serial2.txCount() - tx;
+    });
+    bench("datagram", [] {
+        unsigned long tx = Serial2.txCount();
+        esp.datagram(SERVER_IP, 8089, MESSAGE);
+        return Serial2.txCount() - tx;
+    });
+    bench("readUntil:SEND OK after 400 bytes", [] {
+        memset(response, '.', 400);
+        strcpy(response + 400, "\r\nSEND OK\r\n");
+        Serial2.inject(response);
+        char buff[65];
+        return (size_t) esp.readUntil(buff, 64, F("SEND OK"));
+    });
+    bench("readUntil:any of 5 after 400 bytes", [] {
+        memset(response, '.', 400);
+        strcpy(response + 400, "\r\n4,CONNECT\r\n");
+        Serial2.inject(response);
+        char buff[65];
+        esp_matcher_t m;
+        matcherInit(m);
+        matcherAdd(m, F("ALREADY CONNECTED"));
+        matcherAdd(m, F("ERROR"));
+        matcherAdd(m, F("4,CLOSED"));
+        matcherAdd(m, F("no ip"));
+        matcherAdd(m, F("4,CONNECT"));
+        return (size_t) esp.readUntil(buff, 64, m);
+    });
+    bench("available:idle", [] {
+        return esp.available();
+    });
+    return failures ? 1 : 0;
+}
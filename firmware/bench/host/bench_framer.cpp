@@ -0,0 +1,149 @@
+/*
+ * Incremental framer of command input against readBytesUntil() it replaces.
+ *
+ * A 114 byte command comes at 57600 baud (bytes are delivered as virtual time
+ * goes by) while loop() polls the port every millisecond: the longest single
+ * call and the time from the last byte to dispatch are compared. Frames split
+ * across reads, several frames in one read, frame without terminator (taken
+ * after idle timeout), overrun and stray terminators are checked. Checks are
+ * printed to stderr, exit status is non zero if any of them is off.
+ * Benchmarks report frame bytes per call.
+ */
+#include <Arduino.h>
+#include <framer.h>
+
+#include "bench.h"
+
+static const unsigned long BYTE_US = 174; // 57600 baud, 10 bits
+static const char *COMMAND =
+        "{\"m\":\"cfg\",\"s\":{\"id\":54,\"uid\":\"28FF6A8C6B1403A2\"},\"rap\":\"homekeeper\",\"rpw\":\"secret\",\"sip\":\"192.168.0.2\",\"sp\":8080}";
+
+static char frame[128 + 1];
+static framer_t framer;
+
+// line: bytes of data go to port one by one as their time comes
+static const char *line = NULL;
+static size_t lineLen = 0;
+static size_t linePos = 0;
+static unsigned long lineStart = 0;
+
+static void lineIdle(HardwareSerial &port) {
+    while (linePos < lineLen && micros() - lineStart >= (linePos + 1) * BYTE_US) {
+        port.inject(line + linePos, 1);
+        linePos++;
+    }
+}
+
+static void lineSend(const char *data, size_t length) {
+    line = data;
+    lineLen = length;
+    linePos = 0;
+    lineStart = micros();
+}
+
+static int failures = 0;
+
+static void check(const char *name, const double actual, const double expected, const double tolerance) {
+    bool ok = fabs(actual - expected) <= tolerance;
+    if (!ok) {
+        failures++;
+    }
+    fprintf(stderr, "%-48s %10.1f (expected %.1f+-%.1f)%s\n", name, actual, expected, tolerance, ok ? "" : " FAIL");
+}
+
+// loop() polling every ms until command is dispatched; the longest call and
+// time from the last byte to dispatch, in ms
+template<class F>
+static void slowCommand(const char *name, F read) {
+    char label[64];
+    static char data[200];
+    size_t length = strlen(COMMAND) + 1;
+    memcpy(data, COMMAND, length);
+    lineSend(data, length);
+    unsigned long worst = 0;
+    unsigned long start = micros();
+    bool done = false;
+    while (!done && micros() - start < 5000000UL) {
+        unsigned long t = micros();
+        done = read();
+        worst = max(worst, micros() - t);
+        hostAdvanceMicros(1000);
+    }
+    snprintf(label, sizeof(label), "%s:dispatched", name);
+    check(label, done, 1, 0);
+    snprintf(label, sizeof(label), "%s:longest call ms", name);
+    check(label, worst / 1000.0, 0, 1);
+}
+
+int main(int argc, char *argv[]) {
+    Serial1.onIdle(lineIdle);
+    framerInit(framer, frame, sizeof(frame) - 1);
+
+    // the way loop() called readBytesUntil() whenever a byte was there
+    char buff[129];
+    unsigned long worst = 0;
+    size_t length = strlen(COMMAND) + 1;
+    static char data[200];
+    memcpy(data, COMMAND, length);
+    lineSend(data, length);
+    unsigned long start = micros();
+    size_t got = 0;
+    while (got == 0 && micros() - start < 5000000UL) {
+        unsigned long t = micros();
+        if (Serial1.available()) {
+            got = Serial1.readBytesUntil('\0', buff, 128);
+        }
+        worst = max(worst, micros() - t);
+        hostAdvanceMicros(1000);
+    }
+    fprintf(stderr, "%-48s %10.1f\n", "readBytesUntil:longest call ms", worst / 1000.0);
+    // partial command ends readBytesUntil() only after Stream timeout
+    Serial1.inject("{\"m\":", 5);
+    start = micros();
+    Serial1.readBytesUntil('\0', buff, 128);
+    fprintf(stderr, "%-48s %10.1f\n", "readBytesUntil:partial command ms", (micros() - start) / 1000.0);
+
+    slowCommand("framer:command at 57600", [] {
+        return framerRead(framer, &Serial1) > 0;
+    });
+    check("framer:frame", !strcmp(frame, COMMAND), 1, 0);
+    Serial1.inject("{\"m\":", 5);
+    start = micros();
+    check("framer:partial:read", framerRead(framer, &Serial1), 0, 0);
+    check("framer:partial:ms", (micros() - start) / 1000.0, 0, 1);
+    check("framer:partial:pending", framerPending(framer), 1, 0);
+    Serial1.inject("\"cls\"}\0", 7);
+    check("framer:rest:read", framerRead(framer, &Serial1), 11, 0);
+    check("framer:rest:frame", !strcmp(frame, "{\"m\":\"cls\"}"), 1, 0);
+
+    Serial1.inject("{\"m\":\"cls\"}\0\0{\"m\":\"csr\"}\0", 25);
+    check("framer:two frames:first", framerRead(framer, &Serial1) == 11 && !strcmp(frame, "{\"m\":\"cls\"}"), 1, 0);
+    check("framer:two frames:second", framerRead(framer, &Serial1) == 11 && !strcmp(frame, "{\"m\":\"csr\"}"), 1, 0);
+    check("framer:two frames:no more", framerRead(framer, &Serial1), 0, 0);
+
+    Serial1.inject("AT+CIPSTATUS\r\n");
+    check("framer:no terminator:read", framerRead(framer, &Serial1), 0, 0);
+    hostAdvanceMicros(FRAMER_IDLE_MS * 1000UL);
+    check("framer:no terminator:after idle", framerRead(framer, &Serial1), 14, 0);
+
+    static char oversized[300];
+    memset(oversized, 'x', 200);
+    Serial1.inject(oversized, 200);
+    Serial1.inject("\0{\"m\":\"cls\"}\0", 13);
+    check("framer:overrun:next frame", framerRead(framer, &Serial1), 11, 0);
+    check("framer:overrun:counted", framerOverruns(framer), 1, 0);
+    check("framer:overrun:pending", framerPending(framer), 0, 0);
+    fprintf(stderr, "\n");
+
+    benchInit(argc, argv, "framer");
+
+    bench("command frame", [] {
+        Serial1.inject(COMMAND);
+        Serial1.inject("", 1);
+        return (size_t) framerRead(framer, &Serial1);
+    });
+    bench("empty port", [] {
+        return (size_t) framerRead(framer, &Serial1);
+    });
+    return failures ? 1 : 0;
+}
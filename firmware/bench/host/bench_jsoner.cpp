@@ -0,0 +1,122 @@
+/*
+ * jsoner encoders: time, output size and heap use per message.
+ *
+ * "printf:" cases encode the same messages with snprintf_P and are kept as
+ * baseline for encoder changes.
+ */
+#include <Arduino.h>
+#include <jsoner.h>
+
+#include "bench.h"
+
+const size_t JSON_MAX_SIZE = 128;
+
+static char json[JSON_MAX_SIZE];
+
+static const uint8_t SENS_ID[] = { 54, 55, 56 };
+static const int16_t SENS_VAL[] = { 45, 38, -127 };
+static const int16_t SENS_VAL_DECI[] = { 452, -5, -1270 }; // 0.1C
+
+/*============================= Baseline encoders ===========================*/
+
+static void printfNodeStatus(const uint8_t id, const uint16_t ns, const unsigned long ts, const uint16_t ff,
+        const unsigned long tsf, char *buffer, const size_t bsize) {
+    int s = (ns == 0) ? 0 : (ns & NODE_STATE_ERROR_BIT) ? -1 : 1;
+    if (ff) {
+        snprintf_P(buffer, bsize, PSTR("{\"m\":\"csr\",\"n\":{\"id\":%u,\"ns\":%d,\"ts\":%lu,\"ff\":1,\"ft\":%lu}}"), id,
+                s, ts, tsf);
+    } else {
+        snprintf_P(buffer, bsize, PSTR("{\"m\":\"csr\",\"n\":{\"id\":%u,\"ns\":%d,\"ts\":%lu,\"ff\":0}}"), id, s, ts);
+    }
+}
+
+static void printfSensorValue(const uint8_t id, const int8_t value, char *buffer, const size_t bsize) {
+    snprintf_P(buffer, bsize, PSTR("{\"m\":\"csr\",\"s\":{\"id\":%u,\"v\":%d}}"), id, value);
+}
+
+static void printfClockSync(const unsigned long value, char *buffer, const size_t bsize) {
+    snprintf_P(buffer, bsize, PSTR("{\"m\":\"cls\",\"ts\":%lu}"), value);
+}
+
+int main(int argc, char *argv[]) {
+    benchInit(argc, argv, "jsoner");
+
+    bench("jsonifyNodeStatus", [] {
+        jsonifyNodeStatus(22, 1, 123456, 0, 0, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifyNodeStatus:forced", [] {
+        jsonifyNodeStatus(22, 1, 123456, 1, 123516, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifyNodeStateChange:3 sensors", [] {
+        jsonifyNodeStateChange(22, 1, 123456, 0, 0, SENS_ID, SENS_VAL, 3, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifyNodeStateChange:forced", [] {
+        jsonifyNodeStateChange(22, 1, 123456, 1, 123516, SENS_ID, SENS_VAL, 3, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifyNodeStateChange:3 sensors:0.1", [] {
+        jsonifyNodeStateChange(22, 1, 123456, 0, 0, SENS_ID, SENS_VAL_DECI, 3, json, JSON_MAX_SIZE, 1);
+        return strlen(json);
+    });
+    bench("jsonifySensorValue:int8", [] {
+        jsonifySensorValue(54, (int8_t) 45, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifySensorValue:double", [] {
+        jsonifySensorValue(80, 231.45, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifySensorValue:int8+ts", [] {
+        jsonifySensorValue(54, (int8_t) 45, 123456UL, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifySensorDecimal:0.1", [] {
+        jsonifySensorDecimal(54, 452, 1, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifySensorDecimal:0.1+ts", [] {
+        jsonifySensorDecimal(74, -5, 1, 123456UL, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifySensorConfig:double", [] {
+        jsonifySensorConfig(54, F("cf"), 1.05, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifySensorConfig:string", [] {
+        jsonifySensorConfig(54, F("uid"), "28FF6A8C6B1403A2", json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifySensorConfig:int16", [] {
+        jsonifySensorConfig(201, F("v"), (int16_t) 20, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifyConfig:int", [] {
+        jsonifyConfig(F("sp"), 8080, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifyConfig:string", [] {
+        jsonifyConfig(F("sip"), "192.168.0.2", json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("jsonifyClockSync", [] {
+        jsonifyClockSync(123456, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+
+    bench("printf:NodeStatus", [] {
+        printfNodeStatus(22, 1, 123456, 0, 0, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("printf:SensorValue:int8", [] {
+        printfSensorValue(54, 45, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    bench("printf:ClockSync", [] {
+        printfClockSync(123456, json, JSON_MAX_SIZE);
+        return strlen(json);
+    });
+    return 0;
+}
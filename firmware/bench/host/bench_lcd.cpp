@@ -0,0 +1,238 @@
+/*
+ * LiquidCrystal_I2C: virtual time of a full-screen refresh of bro's 40x4 panel
+ * and correctness of batched transfers.
+ *
+ * Wire shim takes bus time of each transmission at set clock and passes every
+ * byte to emulated PCF8574 + HD44780 with the moment it's latched. Controller
+ * decodes nibbles on enable falling edge, counts instructions latched before
+ * previous one was executed and Rs changing together with enable, then keeps
+ * DDRAM. The original driver (one transmission per expander write, fixed
+ * delays) is kept below as reference. Checks and timing table are printed to
+ * stderr, exit status is non zero if any check is off.
+ */
+#include <Arduino.h>
+#include <Wire.h>
+#include <LiquidCrystal_I2C.h>
+
+#include "bench.h"
+
+static const uint8_t LCD_ADDR = 0x27;
+static const uint8_t LCD_COLS = 40;
+static const uint8_t LCD_ROWS = 4;
+static const uint8_t ROW_OFFSETS[] = { 0x00, 0x40, 0x14, 0x54 };
+
+static LiquidCrystal_I2C lcd(LCD_ADDR, LCD_COLS, LCD_ROWS);
+
+/*============================= Emulated display ============================*/
+
+struct Hd44780 {
+    uint8_t ddram[128];
+    uint8_t addr;
+    uint8_t prev;
+    bool highNibble;
+    uint8_t high;
+    unsigned long highFall;
+    unsigned long readyAt;
+    unsigned long busyViolations;
+    unsigned long rsViolations;
+
+    void reset() {
+        memset(ddram, ' ', sizeof(ddram));
+        addr = 0;
+        prev = 0;
+        highNibble = true;
+        readyAt = 0;
+        busyViolations = 0;
+        rsViolations = 0;
+    }
+
+    void latch(const uint8_t data, const unsigned long us) {
+        if ((data & En) && !(prev & En) && (data & Rs) != (prev & Rs)) {
+            rsViolations++;
+        }
+        if (!(data & En) && (prev & En)) {
+            if (highNibble) {
+                high = prev & 0xF0;
+                highFall = us;
+            } else {
+                execute(high | (prev >> 4), prev & Rs, highFall);
+            }
+            highNibble = !highNibble;
+        }
+        prev = data;
+    }
+
+    void execute(const uint8_t value, const uint8_t rs, const unsigned long us) {
+        if ((long) (us - readyAt) < 0) {
+            busyViolations++;
+        }
+        readyAt = us + LCD_EXEC_USEC;
+        if (rs) {
+            ddram[addr] = value;
+            addr = (addr + 1) & 0x7F;
+        } else if (value & LCD_SETDDRAMADDR) {
+            addr = value & 0x7F;
+        } else if (value == LCD_CLEARDISPLAY) {
+            memset(ddram, ' ', sizeof(ddram));
+            addr = 0;
+            readyAt = us + 1520;
+        } else if (value == LCD_RETURNHOME) {
+            addr = 0;
+            readyAt = us + 1520;
+        }
+    }
+};
+
+static Hd44780 display;
+static uint8_t expected[128];
+
+static void sink(uint8_t address, uint8_t data, unsigned long us) {
+    if (address == LCD_ADDR) {
+        display.latch(data, us);
+    }
+}
+
+/*============================= Reference driver ============================*/
+
+// original LiquidCrystal_I2C write path
+struct LegacyLcd {
+    void expanderWrite(uint8_t data) {
+        Wire.beginTransmission(LCD_ADDR);
+        Wire.write((int) (data) | LCD_BACKLIGHT);
+        Wire.endTransmission();
+    }
+    void pulseEnable(uint8_t data) {
+        expanderWrite(data | En);
+        delayMicroseconds(1);
+        expanderWrite(data & ~En);
+        delayMicroseconds(50);
+    }
+    void write4bits(uint8_t value) {
+        expanderWrite(value);
+        pulseEnable(value);
+    }
+    void send(uint8_t value, uint8_t mode) {
+        write4bits((value & 0xf0) | mode);
+        write4bits(((value << 4) & 0xf0) | mode);
+    }
+    void setCursor(uint8_t col, uint8_t row) {
+        send(LCD_SETDDRAMADDR | (col + ROW_OFFSETS[row]), 0);
+    }
+    void print(const char *s) {
+        while (*s) {
+            send(*s++, Rs);
+        }
+    }
+};
+
+static LegacyLcd legacy;
+
+/*============================= Refresh =====================================*/
+
+static char frames[2][LCD_ROWS][LCD_COLS + 1];
+static uint8_t frame = 0;
+
+static void makeFrames() {
+    for (uint8_t f = 0; f < 2; f++) {
+        for (uint8_t r = 0; r < LCD_ROWS; r++) {
+            for (uint8_t c = 0; c < LCD_COLS; c++) {
+                frames[f][r][c] = 'A' + (f * 7 + r * 3 + c) % 26;
+            }
+            frames[f][r][LCD_COLS] = '\0';
+        }
+    }
+}
+
+template<class L>
+static void refresh(L &l) {
+    for (uint8_t r = 0; r < LCD_ROWS; r++) {
+        l.setCursor(0, r);
+        l.print(frames[frame][r]);
+        for (uint8_t c = 0; c < LCD_COLS; c++) {
+            expected[(ROW_OFFSETS[r] + c) & 0x7F] = frames[frame][r][c];
+        }
+    }
+    frame ^= 1;
+}
+
+static int failures = 0;
+
+static void check(const char *name, const double actual, const double expected, const double tolerance) {
+    bool ok = fabs(actual - expected) <= tolerance;
+    if (!ok) {
+        failures++;
+    }
+    fprintf(stderr, "%-40s %10.1f (expected %.1f+-%.1f)%s\n", name, actual, expected, tolerance, ok ? "" : " FAIL");
+}
+
+// returns virtual us per full-screen refresh
+template<class L>
+static double checkRefresh(const char *title, L &l) {
+    char name[64];
+    display.reset();
+    memcpy(expected, display.ddram, sizeof(expected));
+    const int refreshes = 4;
+    unsigned long n0 = hostWireTransmissions();
+    unsigned long t0 = micros();
+    for (int i = 0; i < refreshes; i++) {
+        refresh(l);
+    }
+    double us = (double) (micros() - t0) / refreshes;
+    double transmissions = (double) (hostWireTransmissions() - n0) / refreshes;
+
+    snprintf(name, sizeof(name), "%s:ddram mismatches", title);
+    int mismatches = 0;
+    for (uint8_t i = 0; i < sizeof(expected); i++) {
+        mismatches += display.ddram[i] != expected[i];
+    }
+    check(name, mismatches, 0, 0);
+    snprintf(name, sizeof(name), "%s:busy violations", title);
+    check(name, display.busyViolations, 0, 0);
+    snprintf(name, sizeof(name), "%s:rs setup violations", title);
+    check(name, display.rsViolations, 0, 0);
+    fprintf(stderr, "%-40s %10.0f us, %.0f transmissions\n", title, us, transmissions);
+    return us;
+}
+
+int main(int argc, char *argv[]) {
+    makeFrames();
+    lcd.begin();
+    hostSetWireSink(sink);
+
+    double legacy100 = checkRefresh("legacy 100kHz", legacy);
+    lcd.setClock(100000);
+    double batched100 = checkRefresh("batched 100kHz", lcd);
+    lcd.setClock(400000);
+    double batched400 = checkRefresh("batched 400kHz", lcd);
+    // 4 bytes per char at 90us and 22.5us
+    check("batched 100kHz:us per char", batched100 / (LCD_ROWS * LCD_COLS), 380, 30);
+    check("batched 400kHz:us per char", batched400 / (LCD_ROWS * LCD_COLS), 95, 10);
+    check("legacy/batched 100kHz", legacy100 / batched100, 3.7, 0.5);
+
+    // clear() leaves its wait to the next transfer
+    display.reset();
+    unsigned long t0 = micros();
+    lcd.clear();
+    check("clear:us before return", micros() - t0, 120, 60);
+    lcd.setCursor(0, 0);
+    lcd.print("x");
+    check("clear:busy violations", display.busyViolations, 0, 0);
+    check("clear:x at 0", display.ddram[0], 'x', 0);
+    fprintf(stderr, "\n");
+
+    benchInit(argc, argv, "lcd");
+
+    bench("refresh:batched", [] {
+        refresh(lcd);
+        return 0;
+    });
+    bench("refresh:legacy", [] {
+        refresh(legacy);
+        return 0;
+    });
+    bench("write:1 char", [] {
+        lcd.write('x');
+        return 0;
+    });
+    return failures ? 1 : 0;
+}
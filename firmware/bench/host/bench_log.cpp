@@ -0,0 +1,185 @@
+/*
+ * Binary debug log against printf-style dbgf(): call site cost, and round trip
+ * through logdecode.
+ *
+ * Debug port is Serial3 of the shim; its output is fed to the decoder, decoded
+ * text is compared with what dbgf() prints for the same message (prefix of
+ * ':' messages is compared by shape, clock moves between the two). Checks are
+ * printed to stderr, exit status is non zero if any of them is off.
+ */
+#include <Arduino.h>
+#include <debug.h>
+#include <log.h>
+
+#include "bench.h"
+#include "logdecode.h"
+
+static HardwareSerial *port = &Serial3;
+
+static char decoded[1024];
+static size_t decodedLen = 0;
+
+static void onDecoded(const char *text, size_t length) {
+    if (decodedLen + length < sizeof(decoded)) {
+        memcpy(decoded + decodedLen, text, length);
+        decodedLen += length;
+        decoded[decodedLen] = '\0';
+    }
+}
+
+static bool capture = false;
+
+static void onTx(HardwareSerial &port, uint8_t c) {
+    if (capture) {
+        logDecodeByte(c, onDecoded);
+    }
+}
+
+static void startCapture() {
+    decodedLen = 0;
+    decoded[0] = '\0';
+    capture = true;
+}
+
+static int failures = 0;
+
+static void checkText(const char *name, const char *actual, const char *expected) {
+    bool ok = strcmp(actual, expected) == 0;
+    if (!ok) {
+        failures++;
+    }
+    fprintf(stderr, "%-32s \"%s\"%s\n", name, actual, ok ? "" : " FAIL");
+    if (!ok) {
+        fprintf(stderr, "%-32s \"%s\"\n", "  expected", expected);
+    }
+}
+
+// n-th line of decoded output
+static const char *line(const int n) {
+    static char l[256];
+    const char *p = decoded;
+    for (int i = 0; i < n && p; i++) {
+        p = strchr(p, '\n');
+        p = p ? p + 1 : NULL;
+    }
+    if (!p) {
+        return "";
+    }
+    size_t len = strcspn(p, "\n");
+    len += p[len] == '\n';
+    snprintf(l, sizeof(l), "%.*s", (int) len, p);
+    return l;
+}
+
+// strips "<millis>:[<free memory>]" prefix
+static const char *body(const char *text) {
+    const char *p = text;
+    while (*p >= '0' && *p <= '9') {
+        p++;
+    }
+    if (p > text && strncmp(p, ":[", 2) == 0 && strchr(p, ']')) {
+        return strchr(p, ']') + 1;
+    }
+    return text;
+}
+
+static char reference[256];
+
+static void dbgfReference(const __FlashStringHelper *format, ...) {
+    char fmt[128];
+    strncpy(fmt, (const char*) format, sizeof(fmt));
+    va_list args;
+    va_start(args, format);
+    vsnprintf(reference, sizeof(reference), fmt, args);
+    va_end(args);
+}
+
+static const char *JSON = "{\"m\":\"csr\",\"s\":{\"id\":54,\"v\":45}}";
+
+int main(int argc, char *argv[]) {
+    port->onTx(onTx);
+
+    startCapture();
+    logMsg(port, WIFI_SEND, 200, JSON);
+    logFlush(port);
+    dbgfReference(F(":wifi:send:%d:%s\n"), 200, JSON);
+    checkText("WIFI_SEND", body(decoded), reference);
+
+    startCapture();
+    logMsg(port, WIFI_TCP_SRV_UP, (uint16_t) 80);
+    logMsg(port, WIFI_STA_CONN_FAIL, "home");
+    logFlush(port);
+    checkText("two records", body(line(0)), ":wifi:TCP_SRV:up:80\n");
+    checkText("two records:second", body(line(1)), ":wifi:STA:conn:FAIL:home\n");
+    checkText("prefix shape", line(0) + strspn(line(0), "0123456789"), ":[8192]:wifi:TCP_SRV:up:80\n");
+
+    // text of dbg() stays readable between frames
+    startCapture();
+    logMsg(port, WIFI_DROP_CONN);
+    logFlush(port);
+    dbg(port, "plain text\n");
+    logMsg(port, WIFI_SEND, -1, "");
+    logFlush(port);
+    checkText("mixed with text", line(1), "plain text\n");
+    checkText("mixed with text:after", body(line(2)), ":wifi:send:-1:\n");
+
+    // long strings are cut
+    char longMsg[100];
+    memset(longMsg, 'x', sizeof(longMsg) - 1);
+    longMsg[sizeof(longMsg) - 1] = '\0';
+    startCapture();
+    logMsg(port, WIFI_RECEIVE, 0, longMsg);
+    logFlush(port);
+    char cut[LOG_MAX_STRING + 32];
+    snprintf(cut, sizeof(cut), ":wifi:receive:0:%.*s\n", LOG_MAX_STRING, longMsg);
+    checkText("long string", body(decoded), cut);
+
+    // full buffer
+    startCapture();
+    for (int i = 0; i < LOG_BUFFER_SIZE; i++) {
+        logMsg(port, WIFI_DROP_CONN);
+    }
+    logFlush(port);
+    // id, millis, free memory and length byte
+    const int fit = LOG_BUFFER_SIZE / (2 + 4 + 2 + 1);
+    char dropped[64];
+    snprintf(dropped, sizeof(dropped), ":<%d log records dropped>\n", LOG_BUFFER_SIZE - fit);
+    checkText("dropped:first", body(line(0)), ":wifi:DROP_CONN\n");
+    checkText("dropped", line(fit), dropped);
+
+    // above LOG_LEVEL
+    startCapture();
+    logMsg(port, WIFI_OUT, "AT\r\n");
+    logFlush(port);
+    checkText("trace level stripped", decoded, "");
+
+    capture = false;
+    fprintf(stderr, "\n");
+
+    benchInit(argc, argv, "log");
+
+    // what ESP8266::read() did per received char
+    bench("dbgf:%c", [] {
+        unsigned long t0 = port->txCount();
+        dbgf(port, F("%c"), 'x');
+        return port->txCount() - t0;
+    });
+    bench("dbgf::wifi:send", [] {
+        unsigned long t0 = port->txCount();
+        dbgf(port, F(":wifi:send:%d:%s\n"), 200, JSON);
+        return port->txCount() - t0;
+    });
+    bench("logMsg+logFlush:WIFI_SEND", [] {
+        unsigned long t0 = port->txCount();
+        logMsg(port, WIFI_SEND, 200, JSON);
+        logFlush(port);
+        return port->txCount() - t0;
+    });
+    bench("logMsg+logFlush:WIFI_DROP_CONN", [] {
+        unsigned long t0 = port->txCount();
+        logMsg(port, WIFI_DROP_CONN);
+        logFlush(port);
+        return port->txCount() - t0;
+    });
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * mom inbound commands: parseCommand() time, bytes sent to all ports and heap
+ * use per command. ESP8266 on Serial3 is emulated, broadcasts go through the
+ * full HTTP send path.
+ */
+#include <Arduino.h>
+
+#include "mom.h"
+#include "bench.h"
+#include "esp_at.h"
+
+static char buff[256];
+
+static unsigned long txTotal() {
+    return Serial.txCount() + Serial1.txCount() + Serial2.txCount() + Serial3.txCount();
+}
+
+static size_t command(const char *cmd) {
+    unsigned long tx = txTotal();
+    strcpy(buff, cmd); // parser modifies input in place
+    parseCommand(buff);
+    Serial3.clear();
+    return txTotal() - tx;
+}
+
+int main(int argc, char *argv[]) {
+    espAttach(Serial3);
+    setup();
+    // WiFi comes up in loop()
+    while (millis() < 1000) {
+        loop();
+    }
+
+    benchInit(argc, argv, "mom parseCommand");
+
+    bench("cls", [] {
+        return command("{\"m\":\"cls\"}");
+    });
+    bench("csr", [] {
+        return command("{\"m\":\"csr\"}");
+    });
+    bench("nsc:force", [] {
+        return command("{\"m\":\"nsc\",\"id\":44,\"ns\":1,\"ft\":60}");
+    });
+    bench("nsc:force permanent", [] {
+        return command("{\"m\":\"nsc\",\"id\":44,\"ns\":1}");
+    });
+    bench("nsc:unforce", [] {
+        return command("{\"m\":\"nsc\",\"id\":44}");
+    });
+    bench("cfg:rap", [] {
+        return command("{\"m\":\"cfg\",\"rap\":\"homekeeper\"}");
+    });
+    bench("cfg:rpw", [] {
+        return command("{\"m\":\"cfg\",\"rpw\":\"secret\"}");
+    });
+    bench("cfg:sip", [] {
+        return command("{\"m\":\"cfg\",\"sip\":\"192.168.0.2\"}");
+    });
+    bench("cfg:sp", [] {
+        return command("{\"m\":\"cfg\",\"sp\":8080}");
+    });
+    bench("cfg:report", [] {
+        return command("{\"m\":\"cfg\"}");
+    });
+    bench("sstp", [] {
+        return command("{\"m\":\"sstp\",\"v\":0}");
+    });
+    bench("AT", [] {
+        return command("AT+CIPSTATUS\r\n");
+    });
+    bench("invalid", [] {
+        return command("{\"m\":");
+    });
+    // turns debug output off, keep it last
+    bench("cfg:dsp", [] {
+        return command("{\"m\":\"cfg\",\"dsp\":-1}");
+    });
+    return 0;
+}
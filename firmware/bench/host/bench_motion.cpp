@@ -0,0 +1,109 @@
+/*
+ * Timer driven stepper motion: ISR side cost per step and move profile.
+ *
+ * Timer interrupt is emulated by calling motionTick() and summing returned
+ * intervals, so move duration is exact regardless of host speed. Profile of
+ * mom's ventilation valve move (15 revolutions) and current/next move queue
+ * semantics are checked first (printed to stderr), exit status is non zero if
+ * any of them is off.
+ */
+#include <Arduino.h>
+#include <motion.h>
+
+#include "bench.h"
+
+static const uint8_t PINS[] = { 8, 10, 9, 11 };
+static const uint16_t MAX_SPEED = 427;
+static const uint16_t START_SPEED = 100;
+static const uint16_t RAMP_STEPS = 256;
+static const long VALVE_MOVE = 2048L * 15;
+
+static unsigned long firstInterval = 0;
+static unsigned long minInterval = 0;
+
+// runs timer until motor stops or given number of steps, returns virtual us
+static double run(const long maxSteps) {
+    double us = 0;
+    firstInterval = 0;
+    minInterval = -1;
+    for (long i = 0; i < maxSteps; i++) {
+        unsigned long dt = motionTick();
+        if (dt == 0) {
+            break;
+        }
+        if (firstInterval == 0) {
+            firstInterval = dt;
+        }
+        if (dt < minInterval) {
+            minInterval = dt;
+        }
+        us += dt;
+    }
+    return us;
+}
+
+static int failures = 0;
+
+static void check(const char *name, const double actual, const double expected, const double tolerance) {
+    bool ok = fabs(actual - expected) <= tolerance;
+    if (!ok) {
+        failures++;
+    }
+    fprintf(stderr, "%-40s %12.1f (expected %.1f+-%.1f)%s\n", name, actual, expected, tolerance, ok ? "" : " FAIL");
+}
+
+int main(int argc, char *argv[]) {
+    motionBegin(PINS, MAX_SPEED, START_SPEED, RAMP_STEPS);
+
+    // constant acceleration ramp: t = 2 * s / (v0 + v1), both ways
+    double rampSec = 2.0 * RAMP_STEPS / (START_SPEED + MAX_SPEED);
+    double cruiseSec = (double) (VALVE_MOVE - 2 * RAMP_STEPS) / MAX_SPEED;
+
+    motionMove(VALVE_MOVE);
+    check("valve close:busy", motionBusy(), 1, 0);
+    double sec = run(VALVE_MOVE * 2) / 1e6;
+    check("valve close:seconds", sec, 2 * rampSec + cruiseSec, 0.2);
+    check("valve close:position", motionPosition(), VALVE_MOVE, 0);
+    double v1 = sqrt(START_SPEED * START_SPEED + (double) (MAX_SPEED * MAX_SPEED - START_SPEED * START_SPEED) / RAMP_STEPS);
+    check("valve close:2nd step us", firstInterval, 1e6 / v1, 1e6 / v1 * 0.002);
+    check("valve close:cruise step us", minInterval, 1e6 / MAX_SPEED, 1);
+    check("valve close:busy after", motionBusy(), 0, 0);
+
+    // same direction request while running is cancelled
+    motionMove(-VALVE_MOVE);
+    run(1000);
+    motionMove(-VALVE_MOVE);
+    run(VALVE_MOVE * 2);
+    check("same direction:position", motionPosition(), 0, 0);
+
+    // opposite request runs after the running move
+    motionMove(-1000);
+    run(100);
+    motionMove(1000);
+    run(1000);
+    check("reversal:position mid", motionPosition(), VALVE_MOVE - VALVE_MOVE - 1000 + 100, 0);
+    run(10000);
+    check("reversal:position", motionPosition(), 0, 0);
+
+    // stop slows down along the ramp
+    motionMove(VALVE_MOVE);
+    run(5000);
+    motionStop();
+    check("stop:remaining", motionRemaining(), RAMP_STEPS, 0);
+    run(VALVE_MOVE);
+    check("stop:position", motionPosition(), 5000 + RAMP_STEPS, 0);
+    check("stop:busy", motionBusy(), 0, 0);
+    fprintf(stderr, "\n");
+
+    benchInit(argc, argv, "motion");
+
+    bench("motionTick:cruise", [] {
+        if (!motionBusy()) {
+            motionMove(VALVE_MOVE);
+            run(RAMP_STEPS);
+        }
+        motionTick();
+        return 0;
+    });
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * MQTT client on ESP8266 client link against the broker of the AT emulator.
+ *
+ * Connect (will, online state, command subscription), topics of reported
+ * messages, commands delivered with QoS 1 and acknowledged after handler, a
+ * command coming while the client waits for SEND OK of its own publish,
+ * keep alive ping, and reconnect after broker drops the connection (at most
+ * once per MQTT_RECONNECT_MS). Messages per second of publish are compared
+ * with HTTP request per message with the wire modeled at 57600 baud and 5ms
+ * network round trip. Checks are printed to stderr, exit status is non zero if
+ * any of them is off. Benchmarks report bytes sent to ESP per call.
+ */
+#include <Arduino.h>
+#include <ESP8266.h>
+#include <mqtt.h>
+
+#include "bench.h"
+#include "esp_at.h"
+
+static ESP8266 esp;
+static const esp_config_t SSID = "HOME";
+static const esp_config_t PASSWORD = "secret";
+static const esp_ip_t SERVER_IP = { 192, 168, 0, 1 };
+static const char *SENSOR = "{\"m\":\"csr\",\"s\":{\"id\":54,\"v\":21.5}}";
+static const char *NODE = "{\"m\":\"csr\",\"n\":{\"id\":22,\"ns\":1,\"ts\":1234567,\"ff\":0}}";
+static const char *EVENT = "{\"m\":\"nsc\",\"id\":22,\"ns\":1,\"ts\":1234567,\"ff\":0,\"s\":[]}";
+static const char *COMMAND = "{\"m\":\"cls\"}";
+
+static char lastTopic[MQTT_TOPIC_SIZE + 1];
+static char lastPayload[MQTT_PACKET_SIZE + 1];
+static int handled = 0;
+
+static void onMessage(const char *topic, char *payload) {
+    strcpy(lastTopic, topic);
+    strcpy(lastPayload, payload);
+    handled++;
+}
+
+static int failures = 0;
+
+static void check(const char *name, const double actual, const double expected, const double tolerance) {
+    bool ok = fabs(actual - expected) <= tolerance;
+    if (!ok) {
+        failures++;
+    }
+    fprintf(stderr, "%-48s %10.1f (expected %.1f+-%.1f)%s\n", name, actual, expected, tolerance, ok ? "" : " FAIL");
+}
+
+// messages per second of virtual time
+template<class F>
+static double rate(F fn) {
+    const int n = 20;
+    espLineRate(57600, 5000);
+    unsigned long start = micros();
+    for (int i = 0; i < n; i++) {
+        fn();
+    }
+    unsigned long us = micros() - start;
+    espLineRate(0, 0);
+    return n * 1e6 / us;
+}
+
+int main(int argc, char *argv[]) {
+    espAttach(Serial2);
+    esp.init(&Serial2, MODE_STA_AP);
+    esp.connect(&SSID, &PASSWORD);
+    esp.startTcpServer(80);
+    mqttBegin(&esp, "dad", SERVER_IP, 1883, onMessage);
+
+    check("connect", mqttConnect(), 1, 0);
+    check("connect:online retained", !strcmp(espMqttTopic(), "hk/dad/online") && espMqttRetained(), 1, 0);
+    check("connect:online", !strcmp(espMqttPayload(), "1"), 1, 0);
+    check("connect:subscribed", !strcmp(espMqttSubscribed(), "hk/dad/cmd"), 1, 0);
+
+    check("report:sensor", mqttReport(SENSOR), strlen(SENSOR), 0);
+    check("report:sensor:topic", !strcmp(espMqttTopic(), "hk/dad/s/54"), 1, 0);
+    check("report:sensor:retained", espMqttRetained(), 1, 0);
+    check("report:sensor:payload", !strcmp(espMqttPayload(), SENSOR), 1, 0);
+    mqttReport(NODE);
+    check("report:node:topic", !strcmp(espMqttTopic(), "hk/dad/n/22") && espMqttRetained(), 1, 0);
+    mqttReport(EVENT);
+    check("report:event:topic", !strcmp(espMqttTopic(), "hk/dad/nsc"), 1, 0);
+    check("report:event:not retained", espMqttRetained(), 0, 0);
+
+    espMqttCommand("hk/dad/cmd", COMMAND, 7);
+    mqttLoop();
+    check("command:handled", handled, 1, 0);
+    check("command:payload", !strcmp(lastTopic, "hk/dad/cmd") && !strcmp(lastPayload, COMMAND), 1, 0);
+    check("command:PUBACK", espMqttAcks() == 1 && espMqttAckId() == 7, 1, 0);
+    // comes before SEND OK of the publish
+    espMqttCommand("hk/dad/cmd", COMMAND, 8);
+    mqttReport(SENSOR);
+    mqttLoop();
+    check("command during publish:handled", handled, 2, 0);
+    check("command during publish:PUBACK", espMqttAckId(), 8, 0);
+    // HTTP server keeps working next to MQTT
+    espClientRequest(0, "POST / HTTP/1.1\r\nContent-Length: 11\r\n\r\n{\"m\":\"cls\"}", 64);
+    espMqttCommand("hk/dad/cmd", COMMAND, 9);
+    while (espClientPump())
+        ;
+    char body[ESP_REQUEST_SIZE + 1];
+    esp.receive(body, ESP_REQUEST_SIZE);
+    check("command next to HTTP request:HTTP", !strcmp(body, COMMAND), 1, 0);
+    mqttLoop();
+    check("command next to HTTP request:MQTT", espMqttAckId(), 9, 0);
+
+    unsigned long pings = espMqttPings();
+    hostAdvanceMicros(MQTT_KEEPALIVE_SEC * 500000UL);
+    mqttLoop();
+    check("keep alive:PINGREQ", espMqttPings() - pings, 1, 0);
+    check("keep alive:connected", mqttConnected(), 1, 0);
+
+    // the last attempt was long ago
+    espMqttClose();
+    mqttLoop();
+    check("broker closed:reconnected at once", mqttConnected(), 1, 0);
+    espMqttClose();
+    mqttLoop();
+    check("broker closed again:connected", mqttConnected(), 0, 0);
+    hostAdvanceMicros(MQTT_RECONNECT_MS * 1000UL);
+    mqttLoop();
+    check("broker closed again:reconnected", mqttConnected(), 1, 0);
+
+    double http = rate([] {
+        esp.send(SERVER_IP, 8080, SENSOR);
+    });
+    mqttConnect();
+    double mqtt = rate([] {
+        mqttReport(SENSOR);
+    });
+    fprintf(stderr, "%-48s %10.1f\n", "messages/s:HTTP per message", http);
+    fprintf(stderr, "%-48s %10.1f\n", "messages/s:MQTT publish", mqtt);
+    check("MQTT publish faster than HTTP", mqtt > http, 1, 0);
+    fprintf(stderr, "\n");
+
+    benchInit(argc, argv, "MQTT");
+
+    bench("publish:sensor", [] {
+        unsigned long tx = Serial2.txCount();
+        mqttReport(SENSOR);
+        return Serial2.txCount() - tx;
+    });
+    bench("loop:idle", [] {
+        unsigned long tx = Serial2.txCount();
+        mqttLoop();
+        return Serial2.txCount() - tx;
+    });
+    bench("command", [] {
+        unsigned long tx = Serial2.txCount();
+        espMqttCommand("hk/dad/cmd", COMMAND, 10);
+        mqttLoop();
+        return Serial2.txCount() - tx;
+    });
+    return failures ? 1 : 0;
+}
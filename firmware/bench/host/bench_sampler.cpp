@@ -0,0 +1,103 @@
+/*
+ * Background ADC sampler: ISR push cost and read side statistics.
+ *
+ * Synthetic waveforms are fed through samplerPush() the way ADC interrupt
+ * does it (~976Hz round robin over configured channels). Statistics of each
+ * waveform are checked against expected values first (printed to stderr),
+ * exit status is non zero if any of them is off.
+ */
+#include <Arduino.h>
+#include <sampler.h>
+
+#include "bench.h"
+
+static const uint8_t PIN_DC = A6;
+static const uint8_t PIN_SINE = A7;
+static const uint8_t PIN_NOISY = A2;
+static const uint8_t PINS[] = { PIN_DC, PIN_SINE, PIN_NOISY };
+static const uint8_t PIN_COUNT = sizeof(PINS) / sizeof(PINS[0]);
+
+// per channel sample rate, Timer0 overflow trigger shared by all channels
+static const double SAMPLE_RATE = 16e6 / 64 / 256 / PIN_COUNT;
+static const double MAINS_HZ = 50;
+
+static unsigned long sampleNo = 0;
+
+static uint16_t sine(const double amplitude, const unsigned long n) {
+    return 512 + lround(amplitude * sin(2 * M_PI * MAINS_HZ * n / SAMPLE_RATE));
+}
+
+static void feed(const unsigned long count) {
+    for (unsigned long i = 0; i < count; i++, sampleNo++) {
+        samplerPush(0, 300);
+        samplerPush(1, sine(200, sampleNo));
+        // ACS712 like: small signal plus +-8 LSB noise
+        samplerPush(2, sine(40, sampleNo) + (int) (rand() % 17) - 8);
+    }
+}
+
+static int failures = 0;
+
+static void check(const char *name, const unsigned int actual, const unsigned int expected,
+        const unsigned int tolerance) {
+    bool ok = abs((int) actual - (int) expected) <= (int) tolerance;
+    if (!ok) {
+        failures++;
+    }
+    fprintf(stderr, "%-40s %6u (expected %u+-%u)%s\n", name, actual, expected, tolerance, ok ? "" : " FAIL");
+}
+
+int main(int argc, char *argv[]) {
+    samplerBegin(PINS, PIN_COUNT);
+
+    sampler_stats_t stats;
+    check("empty:count", samplerStats(PIN_DC, &stats) ? 1 : 0, 0, 0);
+
+    feed(SAMPLER_BUFFER_SIZE / 2);
+    samplerStats(PIN_DC, &stats);
+    check("dc:warmup:count", stats.count, SAMPLER_BUFFER_SIZE / 2, 0);
+    check("dc:warmup:mean", stats.mean, 300, 0);
+
+    feed(SAMPLER_BUFFER_SIZE * 4);
+    samplerStats(PIN_DC, &stats);
+    check("dc:count", stats.count, SAMPLER_BUFFER_SIZE, 0);
+    check("dc:mean", samplerMean(PIN_DC), 300, 0);
+    check("dc:peak", stats.peak, 0, 0);
+    check("dc:rms", stats.rms, 0, 0);
+    check("dc:last", samplerLast(PIN_DC), 300, 0);
+
+    // window covers about 10 mains periods, sampling is not synchronous
+    samplerStats(PIN_SINE, &stats);
+    check("sine:mean", stats.mean, 512, 3);
+    check("sine:peak", stats.peak, 200, 4);
+    check("sine:rms", stats.rms, 141, 3);
+
+    samplerStats(PIN_NOISY, &stats);
+    check("noisy:mean", stats.mean, 512, 3);
+    check("noisy:peak", stats.peak, 44, 6);
+    check("noisy:rms", stats.rms, 29, 3);
+
+    check("unknown pin", samplerStats(A0, &stats) ? 1 : 0, 0, 0);
+    fprintf(stderr, "\n");
+
+    benchInit(argc, argv, "sampler");
+
+    bench("samplerPush", [] {
+        samplerPush(1, 700);
+        return 0;
+    });
+    bench("samplerLast", [] {
+        samplerLast(PIN_SINE);
+        return 0;
+    });
+    bench("samplerMean", [] {
+        samplerMean(PIN_SINE);
+        return 0;
+    });
+    bench("samplerStats", [] {
+        sampler_stats_t s;
+        samplerStats(PIN_NOISY, &s);
+        return 0;
+    });
+    return failures ? 1 : 0;
+}
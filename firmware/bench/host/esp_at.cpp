@@ -0,0 +1,517 @@
+#include "esp_at.h"
+
+const size_t ESP_LINE_SIZE = 512;
+const uint8_t ESP_LINKS = 5;
+const uint8_t CLIENT_LINK = 4;
+
+typedef struct {
+    const char *request;
+    size_t length;
+    size_t pos;
+    size_t chunk;
+    bool hangUp;
+    bool connected;
+    uint16_t status;
+    uint16_t responses;
+    char received[4096]; // data sent on link, cut when full
+    size_t receivedLen;
+} client_t;
+
+static HardwareSerial *esp = NULL;
+static char line[ESP_LINE_SIZE];
+static char lastSent[ESP_LINE_SIZE];
+static size_t lineLen = 0;
+static bool dataMode = false;
+static int dataLink = -1;
+static long dataLeft = -1; // -1 for CIPSENDEX terminated with "\0"
+static client_t clients[ESP_LINKS];
+static uint8_t nextClient = 0;
+static bool interleave = false;
+static const char *failing = NULL;
+
+// single connection and passthrough modes
+static bool mux = true;
+static bool transparent = false;
+static bool passthrough = false;
+static uint8_t escape = 0; // "+++" bytes seen at frame boundary
+
+// uplink frames: 2 byte length and message
+static char frame[ESP_LINE_SIZE];
+static size_t frameLen = 0;
+static size_t frameGot = 0;
+static uint8_t frameHeader = 0;
+static unsigned long frames = 0;
+
+// link 4 opened with "UDP": CIPSEND data is a datagram
+static bool udp = false;
+static unsigned long datagrams = 0;
+
+// MQTT broker on link 4 connected to port 1883
+const int MQTT_PORT = 1883;
+static bool mqtt = false;
+static unsigned long published = 0;
+static char mqttTopic[64];
+static char mqttPayload[ESP_LINE_SIZE];
+static bool mqttRetain = false;
+static char mqttSubscribed[64];
+static uint16_t mqttAcks = 0;
+static uint16_t mqttAckId = 0;
+static unsigned long mqttPings = 0;
+
+// station: join takes joinUs, the reply comes on the first poll after that
+static bool apDown = false;
+static unsigned long joinUs = 0;
+static char later[64];
+static unsigned long laterAt = 0;
+static unsigned long joins = 0;
+static bool listening = false;
+
+// line rate model, off by default
+static unsigned long byteUs = 0;
+static unsigned long rttUs = 0;
+
+/*============================= Server clients ==============================*/
+
+void espClientRequest(uint8_t link, const char *request, size_t chunk, bool hangUp) {
+    client_t &c = clients[link];
+    c.request = request;
+    c.length = strlen(request);
+    c.pos = 0;
+    c.chunk = chunk;
+    c.hangUp = hangUp;
+    c.connected = false;
+    c.status = 0;
+    c.responses = 0;
+    c.received[0] = '\0';
+    c.receivedLen = 0;
+}
+
+static bool clientStep(uint8_t link) {
+    client_t &c = clients[link];
+    char buff[32];
+    if (c.request == NULL) {
+        return false;
+    }
+    if (!c.connected && c.pos == 0) {
+        snprintf(buff, sizeof(buff), "%d,CONNECT\r\n", link);
+        esp->inject(buff);
+        c.connected = true;
+    } else if (c.pos < c.length) {
+        size_t n = min(c.chunk, c.length - c.pos);
+        snprintf(buff, sizeof(buff), "\r\n+IPD,%d,%d:", link, (int) n);
+        esp->inject(buff);
+        esp->inject(c.request + c.pos, n);
+        c.pos += n;
+    } else if (c.hangUp && c.connected) {
+        snprintf(buff, sizeof(buff), "%d,CLOSED\r\n", link);
+        esp->inject(buff);
+        c.connected = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool espClientPump() {
+    for (uint8_t i = 0; i < ESP_LINKS; i++) {
+        uint8_t link = nextClient;
+        nextClient = (nextClient + 1) % ESP_LINKS;
+        if (clientStep(link)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void espClientInterleave(bool on) {
+    interleave = on;
+}
+
+uint16_t espClientStatus(uint8_t link) {
+    return clients[link].status;
+}
+
+uint16_t espClientResponses(uint8_t link) {
+    return clients[link].responses;
+}
+
+const char *espClientReceived(uint8_t link) {
+    return clients[link].received;
+}
+
+/*============================= Line rate ===================================*/
+
+void espLineRate(unsigned long baud, unsigned long rtt) {
+    byteUs = baud > 0 ? 10000000UL / baud : 0;
+    rttUs = rtt;
+}
+
+// reply of ESP, delayed by network round trip when it depends on the peer
+static void reply(HardwareSerial &port, const char *data, bool network = false) {
+    if (network) {
+        hostAdvanceMicros(rttUs);
+    }
+    hostAdvanceMicros(byteUs * strlen(data));
+    port.inject(data);
+}
+
+static void replyLater(const char *data, unsigned long us) {
+    snprintf(later, sizeof(later), "%s", data);
+    laterAt = micros() + us;
+}
+
+static void idle(HardwareSerial &port) {
+    if (later[0] != '\0' && (long) (micros() - laterAt) >= 0) {
+        port.inject(later);
+        later[0] = '\0';
+    }
+}
+
+/*============================= MQTT broker =================================*/
+
+// packet to client in +IPD notice
+static void mqttSend(HardwareSerial &port, const uint8_t *packet, size_t length) {
+    char buff[32];
+    snprintf(buff, sizeof(buff), "\r\n+IPD,4,%d:", (int) length);
+    hostAdvanceMicros(rttUs + byteUs * (strlen(buff) + length));
+    port.inject(buff);
+    port.inject((const char*) packet, length);
+}
+
+static void mqttString(const uint8_t *p, char *s, size_t size) {
+    size_t n = min((size_t) ((p[0] << 8) | p[1]), size - 1);
+    memcpy(s, p + 2, n);
+    s[n] = '\0';
+}
+
+// CIPSEND data is one packet, remaining length fits one byte or two
+static void mqttPacket(HardwareSerial &port, const uint8_t *p, size_t length) {
+    size_t h = (p[1] & 0x80) ? 3 : 2;
+    const uint8_t *body = p + h;
+    size_t bodyLength = length - h;
+    switch (p[0] & 0xF0) {
+    case 0x10: {
+        const uint8_t connack[] = { 0x20, 2, 0, 0 };
+        mqttSend(port, connack, sizeof(connack));
+        break;
+    }
+    case 0x30: {
+        size_t topicLength = (body[0] << 8) | body[1];
+        size_t pos = 2 + topicLength + (((p[0] >> 1) & 0x03) ? 2 : 0);
+        mqttString(body, mqttTopic, sizeof(mqttTopic));
+        size_t n = min(bodyLength - pos, ESP_LINE_SIZE - 1);
+        memcpy(mqttPayload, body + pos, n);
+        mqttPayload[n] = '\0';
+        mqttRetain = p[0] & 0x01;
+        published++;
+        break;
+    }
+    case 0x40:
+        mqttAcks++;
+        mqttAckId = (body[0] << 8) | body[1];
+        break;
+    case 0x80: {
+        mqttString(body + 2, mqttSubscribed, sizeof(mqttSubscribed));
+        const uint8_t suback[] = { 0x90, 3, body[0], body[1], 1 };
+        mqttSend(port, suback, sizeof(suback));
+        break;
+    }
+    case 0xC0: {
+        const uint8_t pingresp[] = { 0xD0, 0 };
+        mqttPings++;
+        mqttSend(port, pingresp, sizeof(pingresp));
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void espMqttCommand(const char *topic, const char *payload, uint16_t id) {
+    uint8_t packet[ESP_LINE_SIZE];
+    size_t topicLength = strlen(topic);
+    size_t payloadLength = strlen(payload);
+    size_t length = 2 + topicLength + 2 + payloadLength;
+    size_t n = 0;
+    packet[n++] = 0x32;
+    if (length > 127) {
+        packet[n++] = (length & 0x7F) | 0x80;
+        packet[n++] = length >> 7;
+    } else {
+        packet[n++] = length;
+    }
+    packet[n++] = topicLength >> 8;
+    packet[n++] = topicLength;
+    memcpy(packet + n, topic, topicLength);
+    n += topicLength;
+    packet[n++] = id >> 8;
+    packet[n++] = id;
+    memcpy(packet + n, payload, payloadLength);
+    mqttSend(*esp, packet, n + payloadLength);
+}
+
+void espMqttClose() {
+    esp->inject("4,CLOSED\r\n");
+    mqtt = false;
+}
+
+unsigned long espMqttPublished() {
+    return published;
+}
+
+const char *espMqttTopic() {
+    return mqttTopic;
+}
+
+const char *espMqttPayload() {
+    return mqttPayload;
+}
+
+bool espMqttRetained() {
+    return mqttRetain;
+}
+
+const char *espMqttSubscribed() {
+    return mqttSubscribed;
+}
+
+uint16_t espMqttAcks() {
+    return mqttAcks;
+}
+
+uint16_t espMqttAckId() {
+    return mqttAckId;
+}
+
+unsigned long espMqttPings() {
+    return mqttPings;
+}
+
+/*============================= Uplink frames ===============================*/
+
+static void frameByte(uint8_t c) {
+    if (frameHeader < 2) {
+        frameLen = (frameLen << 8) | c;
+        frameHeader++;
+        frameGot = 0;
+    } else if (frameGot < frameLen) {
+        if (frameGot < ESP_LINE_SIZE - 1) {
+            frame[frameGot] = c;
+        }
+        frameGot++;
+    }
+    if (frameHeader == 2 && frameGot == frameLen) {
+        frame[min(frameLen, ESP_LINE_SIZE - 1)] = '\0';
+        frames++;
+        frameHeader = 0;
+        frameLen = 0;
+    }
+}
+
+unsigned long espUplinkFrames() {
+    return frames;
+}
+
+const char *espUplinkLastFrame() {
+    return frame;
+}
+
+unsigned long espDatagrams() {
+    return datagrams;
+}
+
+/*============================= AT commands =================================*/
+
+static void command(HardwareSerial &port, const char *cmd) {
+    int link;
+    int length;
+    if (interleave && strncmp(cmd, "AT", 2) == 0) {
+        espClientPump();
+    }
+    if (failing != NULL && strncmp(cmd, failing, strlen(failing)) == 0) {
+        reply(port, "\r\nERROR\r\n");
+    } else if (strcmp(cmd, "AT+CIPSEND") == 0 && transparent && !mux) {
+        reply(port, "\r\nOK\r\n\r\n>");
+        passthrough = true;
+        escape = 0;
+        frameHeader = 0;
+        frameLen = 0;
+    } else if (strncmp(cmd, "AT+CIPSEND", 10) == 0) {
+        reply(port, "\r\nOK\r\n>");
+        dataMode = true;
+        dataLink = -1;
+        dataLeft = -1;
+        if (sscanf(cmd, "AT+CIPSEND=%d,%d", &link, &length) == 2) {
+            dataLink = link;
+            dataLeft = length;
+        } else if (sscanf(cmd, "AT+CIPSENDEX=%d", &link) == 1) {
+            dataLink = link;
+        }
+    } else if (strncmp(cmd, "AT+CIPSTART", 11) == 0 && apDown) {
+        reply(port, "no ip\r\n\r\nERROR\r\n");
+    } else if (strncmp(cmd, "AT+CIPSTART", 11) == 0) {
+        // UDP has no handshake to wait for
+        udp = strstr(cmd, "\"UDP\"") != NULL;
+        int dstPort = 0;
+        sscanf(cmd, "AT+CIPSTART=4,\"%*[^\"]\",\"%*[^\"]\",%d", &dstPort);
+        mqtt = dstPort == MQTT_PORT;
+        reply(port, mux ? "4,CONNECT\r\n\r\nOK\r\n" : "CONNECT\r\n\r\nOK\r\n", !udp);
+    } else if (sscanf(cmd, "AT+CIPMUX=%d", &link) == 1) {
+        mux = link == 1;
+        reply(port, "\r\nOK\r\n");
+    } else if (sscanf(cmd, "AT+CIPMODE=%d", &link) == 1) {
+        transparent = link == 1;
+        reply(port, "\r\nOK\r\n");
+    } else if (sscanf(cmd, "AT+CIPCLOSE=%d", &link) == 1) {
+        char buff[32];
+        snprintf(buff, sizeof(buff), "%d,CLOSED\r\n\r\nOK\r\n", link);
+        reply(port, buff);
+        if (link >= 0 && link < ESP_LINKS) {
+            clients[link].connected = false;
+        }
+    } else if (strncmp(cmd, "AT+CWJAP", 8) == 0) {
+        joins++;
+        replyLater(apDown ? "+CWJAP:3\r\n\r\nFAIL\r\n" : "WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n", joinUs);
+    } else if (strncmp(cmd, "AT+CIPSTA?", 10) == 0) {
+        reply(port, apDown ? "+CIPSTA:ip:\"0.0.0.0\"\r\n\r\nOK\r\n" : "+CIPSTA:ip:\"192.168.0.10\"\r\n\r\nOK\r\n");
+    } else if (sscanf(cmd, "AT+CIPSERVER=%d", &link) == 1) {
+        listening = link == 1;
+        reply(port, "\r\nOK\r\n");
+    } else if (strcmp(cmd, "AT+RST") == 0) {
+        listening = false;
+        reply(port, "\r\nOK\r\n");
+        replyLater("\r\nready\r\n", 300000);
+    } else if (strncmp(cmd, "AT+CIPAP?", 9) == 0) {
+        reply(port, "+CIPAP:ip:\"192.168.4.1\"\r\n\r\nOK\r\n");
+    } else if (strncmp(cmd, "AT+CIPSTATUS", 12) == 0) {
+        reply(port, "STATUS:2\r\n\r\nOK\r\n");
+    } else if (strncmp(cmd, "AT", 2) == 0) {
+        reply(port, "\r\nOK\r\n");
+    }
+}
+
+const char *espLastSent() {
+    return lastSent;
+}
+
+static void sent(HardwareSerial &port) {
+    line[lineLen] = '\0';
+    memcpy(lastSent, line, lineLen + 1);
+    dataMode = false;
+    reply(port, "\r\nSEND OK\r\n", !(udp && dataLink == CLIENT_LINK));
+    if (dataLink == CLIENT_LINK && mqtt) {
+        mqttPacket(port, (const uint8_t*) line, lineLen);
+    } else if (dataLink == CLIENT_LINK && udp) {
+        // no response, lost datagrams are not modeled
+        datagrams++;
+    } else if (dataLink == CLIENT_LINK && strncmp(line, "POST ", 5) == 0) {
+        reply(port, "\r\n+IPD,4,19:HTTP/1.1 200 OK\r\n\r\n4,CLOSED\r\n", true);
+    } else if (dataLink == CLIENT_LINK) {
+        for (size_t i = 0; i < lineLen; i++) {
+            frameByte(line[i]);
+        }
+    } else if (dataLink >= 0 && dataLink < ESP_LINKS) {
+        client_t &c = clients[dataLink];
+        size_t n = min(lineLen, sizeof(c.received) - 1 - c.receivedLen);
+        memcpy(c.received + c.receivedLen, line, n);
+        c.receivedLen += n;
+        c.received[c.receivedLen] = '\0';
+        int status;
+        if (sscanf(line, "HTTP/1.%*d %d", &status) == 1) {
+            clients[dataLink].status = status;
+            clients[dataLink].responses++;
+        }
+    }
+    lineLen = 0;
+}
+
+static void tx(HardwareSerial &port, uint8_t c) {
+    hostAdvanceMicros(byteUs);
+    if (passthrough) {
+        // "+++" with silence around it; here it's taken between frames only
+        if (c == '+' && frameHeader == 0 && escape < 3) {
+            if (++escape == 3) {
+                passthrough = false;
+                lineLen = 0;
+            }
+            return;
+        }
+        for (; escape > 0; escape--) {
+            frameByte('+');
+        }
+        frameByte(c);
+        return;
+    }
+    if (dataMode) {
+        if (dataLeft < 0 && lineLen > 0 && line[lineLen - 1] == '\\' && c == '0') {
+            // CIPSENDEX data is terminated with literal "\0"
+            lineLen--;
+            sent(port);
+            return;
+        }
+        if (lineLen < ESP_LINE_SIZE - 1) {
+            line[lineLen++] = c;
+        } else {
+            line[lineLen - 1] = c;
+        }
+        if (dataLeft > 0 && --dataLeft == 0) {
+            sent(port);
+        }
+        return;
+    }
+    if (c == '\n') {
+        line[lineLen] = '\0';
+        if (lineLen > 0 && line[lineLen - 1] == '\r') {
+            line[lineLen - 1] = '\0';
+        }
+        command(port, line);
+        lineLen = 0;
+    } else if (lineLen < ESP_LINE_SIZE - 1) {
+        line[lineLen++] = c;
+    }
+}
+
+void espFail(const char *prefix) {
+    failing = prefix;
+}
+
+void espStation(bool reachable, unsigned long joinMs) {
+    apDown = !reachable;
+    joinUs = joinMs * 1000;
+}
+
+unsigned long espJoins() {
+    return joins;
+}
+
+bool espListening() {
+    return listening;
+}
+
+void espAttach(HardwareSerial &port) {
+    esp = &port;
+    failing = NULL;
+    apDown = false;
+    joinUs = 0;
+    later[0] = '\0';
+    joins = 0;
+    listening = false;
+    mux = true;
+    transparent = passthrough = false;
+    frames = 0;
+    udp = false;
+    datagrams = 0;
+    mqtt = false;
+    published = 0;
+    mqttAcks = mqttAckId = 0;
+    mqttPings = 0;
+    mqttTopic[0] = mqttPayload[0] = mqttSubscribed[0] = '\0';
+    frameHeader = 0;
+    frameLen = 0;
+    lineLen = 0;
+    dataMode = false;
+    interleave = false;
+    memset(clients, 0, sizeof(clients));
+    port.onTx(tx);
+    port.onIdle(idle);
+}
@@ -0,0 +1,76 @@
+#ifndef ESP_AT_H_
+#define ESP_AT_H_
+
+#include <Arduino.h>
+
+/*
+ * ESP8266 AT firmware emulator for host benchmarks. Answers the happy path of
+ * commands ESP8266 lib sends; HTTP request sent with CIPSEND or CIPSENDEX gets
+ * "200 OK" response on link 4. Replies are injected right away (but the ones
+ * of station join and restart), so firmware never waits on a timeout.
+ *
+ * Clients of TCP server: espClientRequest() queues a request on server link,
+ * espClientPump() injects its next notice or +IPD package. Packages of queued
+ * clients go round robin, so requests of concurrent clients interleave.
+ * With espClientInterleave() one package is also injected before each command
+ * reply, as if it came while firmware was waiting for the reply.
+ *
+ * Uplink: frames (2 byte length and message) are taken from CIPSEND data of
+ * link 4 that is not an HTTP request and from passthrough mode (CIPMUX=0,
+ * CIPMODE=1, CIPSEND until "+++"). Data sent on link 4 opened as UDP is
+ * counted as datagrams.
+ *
+ * MQTT: link 4 connected to port 1883 is a broker which accepts CONNECT and
+ * SUBSCRIBE and answers PINGREQ; PUBLISH and PUBACK of the client are
+ * recorded, espMqttCommand() sends PUBLISH with QoS 1 to the client.
+ *
+ * Station: CWJAP takes the time set with espStation(), its reply comes on
+ * the first poll of empty input after that. AP out of reach fails the join,
+ * leaves station without IP and connections with "no ip".
+ *
+ * espLineRate() turns on virtual time of the wire: each byte to and from ESP
+ * takes its time at baud, replies which need the peer (connect, SEND OK, HTTP
+ * response) come after rtt microseconds.
+ */
+void espAttach(HardwareSerial &port);
+// commands starting with prefix are answered with ERROR, NULL turns it off
+void espFail(const char *prefix);
+
+// request is split into +IPD packages of chunk bytes. client closes the link
+// after the last package when hangUp is set
+void espClientRequest(uint8_t link, const char *request, size_t chunk, bool hangUp = false);
+// injects next package, false if no client has anything to send
+bool espClientPump();
+void espClientInterleave(bool on);
+// AP reachable or not, time of CWJAP
+void espStation(bool reachable, unsigned long joinMs);
+unsigned long espJoins();
+// TCP server is up
+bool espListening();
+void espLineRate(unsigned long baud, unsigned long rtt);
+unsigned long espUplinkFrames();
+const char *espUplinkLastFrame();
+// CIPSEND data on link 4 opened with "UDP"
+unsigned long espDatagrams();
+unsigned long espMqttPublished();
+// topic and payload of the last PUBLISH from client
+const char *espMqttTopic();
+const char *espMqttPayload();
+bool espMqttRetained();
+const char *espMqttSubscribed();
+uint16_t espMqttAcks();
+uint16_t espMqttAckId();
+unsigned long espMqttPings();
+void espMqttCommand(const char *topic, const char *payload, uint16_t id);
+// broker drops the connection
+void espMqttClose();
+// data of the last CIPSEND on any link
+const char *espLastSent();
+// HTTP status of the last response sent on link, 0 if none
+uint16_t espClientStatus(uint8_t link);
+// responses sent on link since it was queued
+uint16_t espClientResponses(uint8_t link);
+// data of all CIPSEND on link since it was queued, as client gets it
+const char *espClientReceived(uint8_t link);
+
+#endif /* ESP_AT_H_ */
@@ -0,0 +1,141 @@
+#include "logdecode.h"
+
+#include <log.h>
+
+#define LOG_FORMAT(name, level, format) format,
+
+static const char *const FORMATS[] = { //
+        "<no message>\n", //
+        ":<%u log records dropped>\n", //
+        LOG_LIST(LOG_FORMAT) //
+        };
+
+static const uint8_t *pos;
+static const uint8_t *end;
+
+static bool take(void *value, const size_t size) {
+    if (pos + size > end) {
+        return false;
+    }
+    memcpy(value, pos, size);
+    pos += size;
+    return true;
+}
+
+// appends printf() of one argument, arguments are taken from the record the
+// way logArg() puts them
+static int conversion(char *text, const size_t tsize, const char *spec, const size_t slen) {
+    char fmt[16];
+    if (slen >= sizeof(fmt)) {
+        return snprintf(text, tsize, "<bad format>");
+    }
+    memcpy(fmt, spec, slen);
+    fmt[slen] = '\0';
+    char type = spec[slen - 1];
+    bool isLong = memchr(spec, 'l', slen) != NULL;
+    if (type == 's' || type == 'S') {
+        const uint8_t *z = (const uint8_t*) memchr(pos, 0, end - pos);
+        if (!z) {
+            return snprintf(text, tsize, "<missing>");
+        }
+        int n = snprintf(text, tsize, "%s", (const char*) pos);
+        pos = z + 1;
+        return n;
+    }
+    if (isLong) {
+        int32_t v;
+        if (!take(&v, sizeof(v))) {
+            return snprintf(text, tsize, "<missing>");
+        }
+        return (type == 'd' || type == 'i') ? snprintf(text, tsize, fmt, (long) v) :
+                snprintf(text, tsize, fmt, (unsigned long) (uint32_t) v);
+    }
+    int16_t v;
+    if (!take(&v, sizeof(v))) {
+        return snprintf(text, tsize, "<missing>");
+    }
+    return (type == 'd' || type == 'i' || type == 'c') ? snprintf(text, tsize, fmt, (int) v) :
+            snprintf(text, tsize, fmt, (unsigned int) (uint16_t) v);
+}
+
+size_t logDecodeRecord(const uint8_t *record, const size_t length, char *text, const size_t tsize) {
+    pos = record;
+    end = record + length;
+    uint16_t id;
+    if (!take(&id, sizeof(id)) || id >= LOG_COUNT) {
+        return snprintf(text, tsize, "<unknown log record>\n");
+    }
+    const char *f = FORMATS[id];
+    size_t n = 0;
+    if (f[0] == ':' && f[1] != '\0' && id != LOG_DROPPED) {
+        // dbg() prefix
+        uint32_t ts;
+        int16_t mem;
+        if (take(&ts, sizeof(ts)) && take(&mem, sizeof(mem))) {
+            n += snprintf(text + n, tsize - n, "%lu:[%d]", (unsigned long) ts, mem);
+        }
+    }
+    while (*f && n < tsize - 1) {
+        if (*f != '%') {
+            text[n++] = *f++;
+            continue;
+        }
+        if (f[1] == '%') {
+            text[n++] = '%';
+            f += 2;
+            continue;
+        }
+        size_t slen = strcspn(f + 1, "diuxXocsS") + 2;
+        n += conversion(text + n, tsize - n, f, slen);
+        f += slen;
+        if (n >= tsize) {
+            n = tsize - 1;
+        }
+    }
+    text[n] = '\0';
+    return n;
+}
+
+/*============================= Stream ======================================*/
+
+static uint8_t frame[512];
+static size_t frameLen = 0;
+static bool inFrame = false;
+
+void logDecodeByte(const uint8_t c, void (*out)(const char *text, size_t length)) {
+    if (!inFrame) {
+        if (c == 0) {
+            inFrame = true;
+            frameLen = 0;
+        } else {
+            out((const char*) &c, 1);
+        }
+        return;
+    }
+    if (c != 0) {
+        if (frameLen < sizeof(frame)) {
+            frame[frameLen++] = c;
+        }
+        return;
+    }
+    if (frameLen == 0) {
+        // closing zero of previous frame was taken as opening one
+        return;
+    }
+    inFrame = false;
+    // COBS
+    uint8_t record[512];
+    size_t len = 0;
+    for (size_t i = 0; i < frameLen;) {
+        uint8_t code = frame[i++];
+        for (uint8_t k = 1; k < code && i < frameLen; k++) {
+            record[len++] = frame[i++];
+        }
+        if (code < 0xFF && i < frameLen) {
+            record[len++] = 0;
+        }
+    }
+    char text[256];
+    size_t n = logDecodeRecord(record, len, text, sizeof(text));
+    out(text, n);
+}
@@ -0,0 +1,19 @@
+#ifndef LOGDECODE_H_
+#define LOGDECODE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Host decoder of binary debug log (libs/debug/log.h). Format table is built
+ * from the same LOG_LIST firmware is compiled with.
+ */
+
+// decodes one record (frame with COBS removed) to text, returns text length
+size_t logDecodeRecord(const uint8_t *record, const size_t length, char *text, const size_t tsize);
+
+// feeds bytes read from debug port: text between frames is passed as is,
+// frames are decoded. out is called for each piece of text
+void logDecodeByte(const uint8_t c, void (*out)(const char *text, size_t length));
+
+#endif /* LOGDECODE_H_ */
@@ -0,0 +1,27 @@
+/*
+ * Binary debug log decoder: reads debug port dump (stdin or file) and prints
+ * it as text.
+ *
+ *   logdecode [dump]            e.g. logdecode < /dev/ttyUSB0
+ */
+#include <stdio.h>
+
+#include "logdecode.h"
+
+static void print(const char *text, size_t length) {
+    fwrite(text, 1, length, stdout);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    FILE *in = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    int c;
+    while ((c = fgetc(in)) != EOF) {
+        logDecodeByte(c, print);
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef DALLASTEMPERATURE_H_
+#define DALLASTEMPERATURE_H_
+
+#include <Arduino.h>
+#include <OneWire.h>
+
+/*
+ * Host stub of DS18B20 driver. All sensors report the same temperature which
+ * benchmark sets with setHostTemp().
+ */
+
+#define DEVICE_DISCONNECTED_C -127
+#define DEVICE_DISCONNECTED_RAW -7040
+
+typedef uint8_t DeviceAddress[8];
+
+class DallasTemperature {
+public:
+    DallasTemperature(OneWire *bus) {
+    }
+    void begin() {
+    }
+    void setResolution(uint8_t resolution) {
+    }
+    bool requestTemperaturesByAddress(const uint8_t *addr) {
+        delay(94); // 9 bit conversion time
+        return true;
+    }
+    float getTempC(const uint8_t *addr) {
+        return raw == DEVICE_DISCONNECTED_RAW ? DEVICE_DISCONNECTED_C : raw / 128.0;
+    }
+    int16_t getTemp(const uint8_t *addr) {
+        return raw;
+    }
+    void setHostTemp(int16_t raw) {
+        this->raw = raw;
+    }
+
+private:
+    int16_t raw = DEVICE_DISCONNECTED_RAW;
+};
+
+#endif /* DALLASTEMPERATURE_H_ */
@@ -0,0 +1,11 @@
+#ifndef MEMORY_FREE_H
+#define MEMORY_FREE_H
+
+/*
+ * Host stub. Reports ATmega2560 RAM size.
+ */
+inline int freeMemory() {
+    return 8192;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef SERVO_H_
+#define SERVO_H_
+
+#include <Arduino.h>
+
+/*
+ * Host stub of timer driven servo lib.
+ */
+class Servo {
+public:
+    uint8_t attach(int pin) {
+        this->pin = pin;
+        return 0;
+    }
+    void detach() {
+        pin = -1;
+    }
+    void write(int value) {
+        this->value = value;
+    }
+    int read() {
+        return value;
+    }
+    bool attached() {
+        return pin >= 0;
+    }
+
+private:
+    int pin = -1;
+    int value = 0;
+};
+
+#endif /* SERVO_H_ */
@@ -0,0 +1,30 @@
+#ifndef SOFTWARESERIAL_H_
+#define SOFTWARESERIAL_H_
+
+#include <Arduino.h>
+
+/*
+ * Host stub of bit-banged serial port. Output is discarded.
+ */
+class SoftwareSerial: public Stream {
+public:
+    SoftwareSerial(uint8_t rx, uint8_t tx, bool inverse = false) {
+    }
+    void begin(long speed) {
+    }
+    int available() override {
+        return 0;
+    }
+    int read() override {
+        return -1;
+    }
+    int peek() override {
+        return -1;
+    }
+    size_t write(uint8_t c) override {
+        return 1;
+    }
+    using Print::write;
+};
+
+#endif /* SOFTWARESERIAL_H_ */
@@ -0,0 +1,554 @@
+/*
+ * Cycle accurate timing benchmark for HomeKeeper AVR firmware.
+ *
+ * Runs real firmware ELF (built with -D BENCH_PROBES, see dad_bench/mom_bench
+ * PlatformIO environments) under simavr, feeds it with scripted UART, ADC and
+ * pin stimuli, and reports cycles spent between PROBE_BEGIN/PROBE_END marks.
+ *
+ * usage: simbench [-m mcu] [-f freq] [-t msec] [-s stimuli] [-v] firmware.elf
+ *
+ * Stimuli file, one event per line:
+ *   <msec> uart <n> <text>      send text (C escapes allowed) to UARTn
+ *   <msec> adc <ch> <mV>        set ADC channel input voltage
+ *   <msec> pin <port><bit> <v>  drive digital input pin, e.g. "pin F7 1"
+ *   <msec> http <n> <link> <text>  client of TCP server on ESP of UARTn sends
+ *                               text on link: "<link>,CONNECT" and one
+ *                               "+IPD,<link>,<len>:" package
+ *   esp <n>                     answer AT commands on UARTn like ESP8266 does
+ *
+ * ESP takes exactly the bytes announced by "AT+CIPSEND=<link>,<n>" as data;
+ * HTTP request on link 4 is answered with 200. Bare "AT+CIPSEND" starts
+ * passthrough, everything up to "+++" is taken as uplink data. AT+RST says
+ * "ready" 300ms after OK.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_io.h>
+#include <sim_cycle_timers.h>
+#include <avr_uart.h>
+#include <avr_adc.h>
+#include <avr_ioport.h>
+
+#include <probe.h>
+
+// GPIOR1/GPIOR2 data space addresses (same on ATmega328P and ATmega2560)
+#define PROBE_BEGIN_ADDR 0x4A
+#define PROBE_END_ADDR 0x4B
+
+#define MAX_EVENTS 1024
+#define MAX_UARTS 4
+#define MAX_DEPTH 32
+#define UART_QUEUE_SIZE 4096
+#define UART_BYTE_USEC 200
+#define ESP_LINE_SIZE 256
+#define ESP_CLIENT_LINK 4
+#define ESP_READY_USEC 300000
+
+enum event_type {
+    EV_UART, EV_ADC, EV_PIN, EV_HTTP,
+};
+
+typedef struct {
+    unsigned long ms;
+    enum event_type type;
+    int target;
+    int bit; // pin bit, link of http
+    int value;
+    char *text;
+} event_t;
+
+typedef struct {
+    unsigned long calls;
+    avr_cycle_count_t total;
+    avr_cycle_count_t min;
+    avr_cycle_count_t max;
+} probe_stat_t;
+
+typedef struct {
+    avr_t *avr;
+    int n;
+    uint8_t queue[UART_QUEUE_SIZE];
+    int head;
+    int tail;
+    int feeding;
+    unsigned long rx;
+    unsigned long tx;
+    // ESP8266 AT responder
+    int esp;
+    int espData;
+    int espLink; // of CIPSEND data
+    long espLeft; // data bytes still to come
+    int espPassthrough;
+    int espEscape; // "+++" bytes seen in passthrough
+    char line[ESP_LINE_SIZE];
+    int lineLen;
+} uart_t;
+
+static const char *probe_names[] = { "NONE", //
+#define PROBE_NAME(name) #name,
+        PROBE_LIST(PROBE_NAME)
+#undef PROBE_NAME
+        };
+
+static event_t events[MAX_EVENTS];
+static int eventCount = 0;
+static int nextEvent = 0;
+
+static uart_t uarts[MAX_UARTS];
+
+static probe_stat_t stats[PROBE_COUNT];
+static struct {
+    uint8_t id;
+    avr_cycle_count_t start;
+} stack[MAX_DEPTH];
+static int depth = 0;
+static unsigned long unbalanced = 0;
+
+static int verbose = 0;
+
+/* ================================== Probes ================================== */
+
+static void probe_begin(avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param) {
+    avr->data[addr] = v;
+    if (depth < MAX_DEPTH) {
+        stack[depth].id = v;
+        stack[depth].start = avr->cycle;
+    }
+    depth++;
+}
+
+static void probe_end(avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param) {
+    avr->data[addr] = v;
+    // unwind to matching begin mark
+    while (depth > 0) {
+        depth--;
+        if (depth >= MAX_DEPTH) {
+            continue;
+        }
+        if (stack[depth].id == v) {
+            if (v < PROBE_COUNT) {
+                avr_cycle_count_t c = avr->cycle - stack[depth].start;
+                probe_stat_t *s = &stats[v];
+                if (s->calls == 0 || c < s->min) {
+                    s->min = c;
+                }
+                if (c > s->max) {
+                    s->max = c;
+                }
+                s->total += c;
+                s->calls++;
+            }
+            return;
+        }
+        unbalanced++;
+    }
+    unbalanced++;
+}
+
+/* ================================== UART ==================================== */
+
+static void uart_push(uart_t *u, const char *data, size_t len);
+
+static avr_cycle_count_t uart_feed(avr_t *avr, avr_cycle_count_t when, void *param) {
+    uart_t *u = (uart_t*) param;
+    if (u->head == u->tail) {
+        u->feeding = 0;
+        return 0;
+    }
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0' + u->n), UART_IRQ_INPUT), u->queue[u->tail]);
+    u->tail = (u->tail + 1) % UART_QUEUE_SIZE;
+    u->rx++;
+    return when + avr_usec_to_cycles(avr, UART_BYTE_USEC);
+}
+
+static void uart_push(uart_t *u, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        int next = (u->head + 1) % UART_QUEUE_SIZE;
+        if (next == u->tail) {
+            fprintf(stderr, "simbench: UART%d input queue overflow\n", u->n);
+            break;
+        }
+        u->queue[u->head] = data[i];
+        u->head = next;
+    }
+    if (!u->feeding) {
+        u->feeding = 1;
+        avr_cycle_timer_register_usec(u->avr, UART_BYTE_USEC, uart_feed, u);
+    }
+}
+
+static void uart_reply(uart_t *u, const char *s) {
+    uart_push(u, s, strlen(s));
+}
+
+static avr_cycle_count_t esp_ready(avr_t *avr, avr_cycle_count_t when, void *param) {
+    uart_reply((uart_t*) param, "\r\nready\r\n");
+    return 0;
+}
+
+static void esp_command(uart_t *u, const char *line) {
+    int link = ESP_CLIENT_LINK;
+    long length = 0;
+    char buff[32];
+    if (strcmp(line, "AT+CIPSEND") == 0) {
+        uart_reply(u, "\r\nOK\r\n\r\n>");
+        u->espPassthrough = 1;
+        u->espEscape = 0;
+    } else if (sscanf(line, "AT+CIPSEND=%d,%ld", &link, &length) == 2 || sscanf(line, "AT+CIPSEND=%ld", &length) == 1) {
+        uart_reply(u, "\r\nOK\r\n>");
+        u->espData = 1;
+        u->espLink = link;
+        u->espLeft = length;
+        u->lineLen = 0;
+    } else if (strncmp(line, "AT+CIPSTART", 11) == 0) {
+        // single connection mode has no link id
+        if (sscanf(line, "AT+CIPSTART=%d", &link) == 1) {
+            snprintf(buff, sizeof(buff), "%d,CONNECT\r\n\r\nOK\r\n", link);
+        } else {
+            snprintf(buff, sizeof(buff), "CONNECT\r\n\r\nOK\r\n");
+        }
+        uart_reply(u, buff);
+    } else if (sscanf(line, "AT+CIPCLOSE=%d", &link) == 1) {
+        snprintf(buff, sizeof(buff), "%d,CLOSED\r\n\r\nOK\r\n", link);
+        uart_reply(u, buff);
+    } else if (strcmp(line, "AT+CIPCLOSE") == 0) {
+        uart_reply(u, "CLOSED\r\n\r\nOK\r\n");
+    } else if (strncmp(line, "AT+RST", 6) == 0) {
+        uart_reply(u, "\r\nOK\r\n");
+        avr_cycle_timer_register_usec(u->avr, ESP_READY_USEC, esp_ready, u);
+    } else if (strncmp(line, "AT+CWJAP", 8) == 0) {
+        uart_reply(u, "\r\nWIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n");
+    } else if (strncmp(line, "AT+CIPSTA?", 10) == 0) {
+        uart_reply(u, "+CIPSTA:ip:\"192.168.0.10\"\r\n\r\nOK\r\n");
+    } else if (strncmp(line, "AT+CIPAP?", 9) == 0) {
+        uart_reply(u, "+CIPAP:ip:\"192.168.4.1\"\r\n\r\nOK\r\n");
+    } else if (strncmp(line, "AT+CIPSTATUS", 12) == 0) {
+        uart_reply(u, "STATUS:2\r\n\r\nOK\r\n");
+    } else if (strncmp(line, "AT", 2) == 0) {
+        uart_reply(u, "\r\nOK\r\n");
+    }
+}
+
+static void esp_data(uart_t *u, uint8_t c) {
+    // start of data tells HTTP request from the rest
+    if (u->lineLen < ESP_LINE_SIZE - 1) {
+        u->line[u->lineLen++] = c;
+    }
+    if (--u->espLeft > 0) {
+        return;
+    }
+    u->line[u->lineLen] = '\0';
+    u->espData = 0;
+    u->lineLen = 0;
+    uart_reply(u, "\r\nSEND OK\r\n");
+    if (u->espLink == ESP_CLIENT_LINK && strncmp(u->line, "POST ", 5) == 0) {
+        uart_reply(u, "\r\n+IPD,4,19:HTTP/1.1 200 OK\r\n\r\n4,CLOSED\r\n");
+    }
+}
+
+// client of TCP server sends request in one package
+static void esp_client(uart_t *u, int link, const char *text, size_t len) {
+    char buff[32];
+    snprintf(buff, sizeof(buff), "%d,CONNECT\r\n", link);
+    uart_reply(u, buff);
+    snprintf(buff, sizeof(buff), "\r\n+IPD,%d,%u:", link, (unsigned int) len);
+    uart_reply(u, buff);
+    uart_push(u, text, len);
+}
+
+static void uart_out(struct avr_irq_t *irq, uint32_t value, void *param) {
+    uart_t *u = (uart_t*) param;
+    uint8_t c = value;
+    u->tx++;
+    if (verbose) {
+        fprintf(stderr, "%c", c);
+    }
+    if (!u->esp) {
+        return;
+    }
+    if (u->espPassthrough) {
+        // "+++" ends passthrough; silence around it is not checked here
+        u->espEscape = (c == '+') ? u->espEscape + 1 : 0;
+        if (u->espEscape == 3) {
+            u->espPassthrough = 0;
+            u->lineLen = 0;
+        }
+        return;
+    }
+    if (u->espData) {
+        esp_data(u, c);
+        return;
+    }
+    if (c == '\n') {
+        u->line[u->lineLen] = '\0';
+        if (u->lineLen > 0 && u->line[u->lineLen - 1] == '\r') {
+            u->line[u->lineLen - 1] = '\0';
+        }
+        esp_command(u, u->line);
+        u->lineLen = 0;
+    } else if (u->lineLen < ESP_LINE_SIZE - 1) {
+        u->line[u->lineLen++] = c;
+    }
+}
+
+static void uart_init(avr_t *avr, int n) {
+    uart_t *u = &uarts[n];
+    u->avr = avr;
+    u->n = n;
+    uint32_t f = 0;
+    if (avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0' + n), &f) != 0) {
+        return; // no such UART on this MCU
+    }
+    f &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0' + n), &f);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0' + n), UART_IRQ_OUTPUT), uart_out, u);
+}
+
+/* ================================== Stimuli ================================= */
+
+static char* unescape(const char *s) {
+    char *out = malloc(strlen(s) + 1);
+    char *p = out;
+    while (*s) {
+        if (*s == '\\' && s[1]) {
+            s++;
+            switch (*s) {
+            case 'r':
+                *p++ = '\r';
+                break;
+            case 'n':
+                *p++ = '\n';
+                break;
+            case 't':
+                *p++ = '\t';
+                break;
+            case '0':
+                *p++ = '\0';
+                break;
+            default:
+                *p++ = *s;
+                break;
+            }
+            s++;
+        } else {
+            *p++ = *s++;
+        }
+    }
+    *p = '\0';
+    return out;
+}
+
+static int event_cmp(const void *a, const void *b) {
+    const event_t *ea = a, *eb = b;
+    if (ea->ms != eb->ms) {
+        return ea->ms < eb->ms ? -1 : 1;
+    }
+    return ea < eb ? -1 : 1;
+}
+
+static int load_stimuli(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    char line[1024];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineNo++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\0') {
+            continue;
+        }
+        int n;
+        if (sscanf(p, "esp %d", &n) == 1) {
+            if (n >= 0 && n < MAX_UARTS) {
+                uarts[n].esp = 1;
+            }
+            continue;
+        }
+        if (eventCount >= MAX_EVENTS) {
+            fprintf(stderr, "%s:%d: too many events\n", path, lineNo);
+            break;
+        }
+        event_t *e = &events[eventCount];
+        char kind[8];
+        int off = 0;
+        if (sscanf(p, "%lu %7s %n", &e->ms, kind, &off) < 2) {
+            fprintf(stderr, "%s:%d: syntax error\n", path, lineNo);
+            continue;
+        }
+        p += off;
+        if (strcmp(kind, "uart") == 0 && sscanf(p, "%d %n", &e->target, &off) >= 1) {
+            e->type = EV_UART;
+            e->text = unescape(p + off);
+            // length of unescaped text, embedded "\0" counts as one byte
+            e->value = 0;
+            for (const char *s = p + off; *s; s++, e->value++) {
+                if (*s == '\\' && s[1]) {
+                    s++;
+                }
+            }
+        } else if (strcmp(kind, "http") == 0 && sscanf(p, "%d %d %n", &e->target, &e->bit, &off) >= 2) {
+            e->type = EV_HTTP;
+            e->text = unescape(p + off);
+            e->value = strlen(e->text);
+        } else if (strcmp(kind, "adc") == 0 && sscanf(p, "%d %d", &e->target, &e->value) == 2) {
+            e->type = EV_ADC;
+        } else if (strcmp(kind, "pin") == 0) {
+            char port;
+            if (sscanf(p, "%c%d %d", &port, &e->bit, &e->value) != 3) {
+                fprintf(stderr, "%s:%d: bad pin spec\n", path, lineNo);
+                continue;
+            }
+            e->type = EV_PIN;
+            e->target = port;
+        } else {
+            fprintf(stderr, "%s:%d: unknown event\n", path, lineNo);
+            continue;
+        }
+        eventCount++;
+    }
+    fclose(f);
+    qsort(events, eventCount, sizeof(event_t), event_cmp);
+    return 0;
+}
+
+static void fire(avr_t *avr, event_t *e) {
+    switch (e->type) {
+    case EV_UART:
+        if (e->target >= 0 && e->target < MAX_UARTS) {
+            uart_push(&uarts[e->target], e->text, e->value);
+        }
+        break;
+    case EV_HTTP:
+        if (e->target >= 0 && e->target < MAX_UARTS) {
+            esp_client(&uarts[e->target], e->bit, e->text, e->value);
+        }
+        break;
+    case EV_ADC:
+        avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0 + e->target), e->value);
+        break;
+    case EV_PIN:
+        avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(e->target), e->bit), e->value);
+        break;
+    }
+}
+
+static avr_cycle_count_t stimuli_tick(avr_t *avr, avr_cycle_count_t when, void *param) {
+    while (nextEvent < eventCount
+            && avr_usec_to_cycles(avr, events[nextEvent].ms * 1000UL) <= when) {
+        fire(avr, &events[nextEvent++]);
+    }
+    if (nextEvent < eventCount) {
+        return avr_usec_to_cycles(avr, events[nextEvent].ms * 1000UL);
+    }
+    return 0;
+}
+
+/* ================================== Report ================================== */
+
+static void report(avr_t *avr) {
+    double usPerCycle = 1000000.0 / avr->frequency;
+    printf("simulated: %.3f s (%llu cycles)\n", avr->cycle * usPerCycle / 1000000.0,
+            (unsigned long long) avr->cycle);
+    printf("%-28s %8s %12s %12s %12s %12s\n", "probe", "calls", "avg cyc", "min cyc", "max cyc", "avg usec");
+    for (int i = 1; i < PROBE_COUNT; i++) {
+        probe_stat_t *s = &stats[i];
+        if (s->calls == 0) {
+            continue;
+        }
+        double avg = (double) s->total / s->calls;
+        printf("%-28s %8lu %12.0f %12llu %12llu %12.1f\n", probe_names[i], s->calls, avg,
+                (unsigned long long) s->min, (unsigned long long) s->max, avg * usPerCycle);
+    }
+    for (int i = 0; i < MAX_UARTS; i++) {
+        if (uarts[i].rx || uarts[i].tx) {
+            printf("UART%d: rx %lu bytes, tx %lu bytes\n", i, uarts[i].rx, uarts[i].tx);
+        }
+    }
+    if (unbalanced) {
+        printf("unbalanced probe marks: %lu\n", unbalanced);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *mcu = "atmega2560";
+    uint32_t freq = 16000000;
+    unsigned long durationMs = 60000;
+    const char *stimuli = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:f:t:s:v")) != -1) {
+        switch (opt) {
+        case 'm':
+            mcu = optarg;
+            break;
+        case 'f':
+            freq = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            durationMs = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            stimuli = optarg;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-m mcu] [-f freq] [-t msec] [-s stimuli] [-v] firmware.elf\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-m mcu] [-f freq] [-t msec] [-s stimuli] [-v] firmware.elf\n", argv[0]);
+        return 1;
+    }
+
+    elf_firmware_t fw;
+    memset(&fw, 0, sizeof(fw));
+    if (elf_read_firmware(argv[optind], &fw) != 0) {
+        fprintf(stderr, "simbench: can't load %s\n", argv[optind]);
+        return 1;
+    }
+    avr_t *avr = avr_make_mcu_by_name(mcu);
+    if (!avr) {
+        fprintf(stderr, "simbench: unknown MCU %s\n", mcu);
+        return 1;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &fw);
+    avr->frequency = freq;
+    avr->vcc = avr->avcc = avr->aref = 5000;
+    avr->log = LOG_ERROR;
+
+    for (int i = 0; i < MAX_UARTS; i++) {
+        uart_init(avr, i);
+    }
+    avr_register_io_write(avr, PROBE_BEGIN_ADDR, probe_begin, NULL);
+    avr_register_io_write(avr, PROBE_END_ADDR, probe_end, NULL);
+
+    if (stimuli && load_stimuli(stimuli) != 0) {
+        return 1;
+    }
+    if (eventCount > 0) {
+        avr_cycle_timer_register(avr, avr_usec_to_cycles(avr, events[0].ms * 1000UL) + 1, stimuli_tick, NULL);
+    }
+
+    avr_cycle_count_t limit = avr_usec_to_cycles(avr, durationMs * 1000UL);
+    int state = cpu_Running;
+    while (avr->cycle < limit && state != cpu_Done && state != cpu_Crashed) {
+        state = avr_run(avr);
+    }
+    if (state == cpu_Crashed) {
+        fprintf(stderr, "simbench: firmware crashed at PC 0x%04x\n", avr->pc);
+    }
+    report(avr);
+    return state == cpu_Crashed ? 1 : 0;
+}
@@ -9,7 +9,9 @@
 #include <LiquidCrystal_I2C.h>
 
 #include <debug.h>
+#include <framer.h>
 #include <jsoner.h>
+#include <sampler.h>
 
 #define __DEBUG__
 
@@ -18,6 +20,7 @@
 // Sensor pin
 const uint8_t DHT_PIN = 5;
 const uint8_t SENSOR_HEATER_CURRENT_METER_PIN = A0;
+const uint8_t SENSORS_ANALOG[] = { SENSOR_HEATER_CURRENT_METER_PIN };
 
 const uint8_t SENSOR_TEMP = (54 + 16) + (4 * 4) + 0;
 const uint8_t SENSOR_HUM = (54 + 16) + (4 * 4) + 1;
@@ -47,11 +50,14 @@ const unsigned long SENSORS_READ_INTERVAL_SEC = 10; // 10 seconds
 // heater
 const int8_t TEMP_HEATER_RESET_THRESHOLD = 17;
 const int8_t HEATER_RESET_PERIOD_SEC = 10;
-const double HEATER_ACTIVE_MIN_IAC = 0.10;
+const uint16_t HEATER_ACTIVE_MIN_IAC = 100; // mA
+const uint16_t HEATER_IAC_WINDOW = 4096; // samples, ~4.2s (~210 mains periods) with Timer0 triggered ADC
 const unsigned long HEATER_INACTIVE_MIN_PERIOD_SEC = 15 * 60; // 15 minutes
 
 const uint8_t JSON_MAX_SIZE = 64;
 const uint8_t LCD_LINE_LENGTH = 40;
+const uint8_t LCD_ROWS = 4;
+const uint16_t HEATER_VOLTAGE = 220; // V, for displayed power
 
 /*============================= Global variables ============================*/
 
@@ -59,7 +65,7 @@ const uint8_t LCD_LINE_LENGTH = 40;
 // Values
 int8_t roomTemp = 0;
 int8_t roomHum = 0;
-double heaterIac = 0; // A
+uint16_t heaterIac = 0; // mA
 
 //// Nodes
 
@@ -93,6 +99,9 @@ const int NODE_FORCED_MODE_FLAGS_EEPROM_ADDR = NODE_STATE_FLAGS_EEPROM_ADDR + si
 
 int eepromWriteCount = 0;
 
+// LCD content as it's shown
+char lcdShadow[LCD_ROWS][LCD_LINE_LENGTH];
+
 /*============================= Connectivity ================================*/
 
 // DHT sensors
@@ -102,7 +111,7 @@ DHT dht(DHT_PIN, DHT11);
 ACS712 acs712(ACS712_30A, SENSOR_HEATER_CURRENT_METER_PIN);
 
 // LCD
-LiquidCrystal_I2C lcd(0x27, LCD_LINE_LENGTH, 4);
+LiquidCrystal_I2C lcd(0x27, LCD_LINE_LENGTH, LCD_ROWS);
 
 // Serial port
 SoftwareSerial serialPort(DEBUG_SERIAL_RX_PIN, DEBUG_SERIAL_TX_PIN);
@@ -113,9 +122,14 @@ SoftwareSerial *debug = &serialPort;
 SoftwareSerial *debug = NULL;
 #endif
 
+// command input, collected across loop() passes
+char serialFrame[JSON_MAX_SIZE + 1];
+framer_t serialFramer;
+
 void setup() {
     // Setup serial ports
     serial->begin(57600);
+    framerInit(serialFramer, serialFrame, JSON_MAX_SIZE);
     if (debug) {
         debug->begin(57600);
     }
@@ -126,12 +140,20 @@ void setup() {
     pinMode(HEARTBEAT_LED, OUTPUT);
     digitalWrite(HEARTBEAT_LED, LOW);
 
-    // calibrate heater current meter
-    acs712.setZeroPoint(511);
+    // init DHT sensor. measured in background from loop()
+    dht.begin();
+
+    // heater current meter is sampled in background. zero point is tracked
+    // on every window, no calibration needed
+    acs712.setWindow(HEATER_IAC_WINDOW);
+    samplerSetHook(onSample);
+    samplerBegin(SENSORS_ANALOG, sizeof(SENSORS_ANALOG) / sizeof(SENSORS_ANALOG[0]));
 
     // turn on LCD
     lcd.begin();
     lcd.backlight();
+    // begin() clears the screen
+    memset(lcdShadow, ' ', sizeof(lcdShadow));
 
     // restore forced node state flags from EEPROM
     // default node state -- OFF
@@ -148,6 +170,7 @@ void setup() {
 
 void loop() {
     tsCurr = getTimestamp();
+    dht.update();
     if (diffTimestamps(tsCurr, tsLastSensorRead) >= SENSORS_READ_INTERVAL_SEC) {
         readSensors();
         tsLastSensorRead = tsCurr;
@@ -158,7 +181,7 @@ void loop() {
         processHeaterReset();
     }
 
-    if (serial->available() > 0) {
+    if (serial->available() > 0 || framerPending(serialFramer)) {
         processSerialMsg();
     }
 
@@ -187,6 +210,7 @@ void processHeaterReset() {
         jsonifyNodeStatus(NODE_HEATER_RESET, NODE_STATE_FLAGS & NODE_HEATER_RESET, tsNodeHeaterReset,
                 NODE_FORCED_MODE_FLAGS & NODE_HEATER_RESET_BIT, tsForcedNodeHeaterReset, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        displayNodeStatus(NODE_HEATER_RESET, tsNodeHeaterReset);
     }
 
     uint8_t sensIds[] = { SENSOR_TEMP };
@@ -265,6 +289,7 @@ void forceNodeState(uint8_t id, uint8_t state, unsigned long ts) {
         jsonifyNodeStatus(NODE_HEATER_RESET, NODE_STATE_FLAGS & NODE_HEATER_RESET_BIT, tsNodeHeaterReset,
                 NODE_FORCED_MODE_FLAGS & NODE_HEATER_RESET_BIT, tsForcedNodeHeaterReset, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        displayNodeStatus(NODE_HEATER_RESET, tsNodeHeaterReset);
     }
     // update node modes in EEPROM if forced permanently
     if (ts == 0) {
@@ -301,6 +326,7 @@ void unForceNodeState(uint8_t id) {
         jsonifyNodeStatus(NODE_HEATER_RESET, NODE_STATE_FLAGS & NODE_HEATER_RESET_BIT, tsNodeHeaterReset,
                 NODE_FORCED_MODE_FLAGS & NODE_HEATER_RESET_BIT, tsForcedNodeHeaterReset, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        displayNodeStatus(NODE_HEATER_RESET, tsNodeHeaterReset);
     }
     // update node modes in EEPROM if unforced from permanent
     if (prevPermanentlyForcedModeFlags != NODE_PERMANENTLY_FORCED_MODE_FLAGS) {
@@ -331,8 +357,14 @@ void readSensors() {
     roomHum = (int8_t) (v > 0) ? v + 0.5 : v - 0.5;
     // prevent endless heater reset when sensor disconnected
     roomHum = roomHum == 0 ? UNKNOWN_SENSOR_VALUE : roomHum;
-    v = acs712.getCurrentAC();
-    heaterIac = round(v * 100) / 100;
+    heaterIac = acs712.getCurrentACmA();
+}
+
+void onSample(const uint8_t pin, const uint16_t value) {
+    // ADC interrupt context
+    if (pin == SENSOR_HEATER_CURRENT_METER_PIN) {
+        acs712.sample(value);
+    }
 }
 
 bool validSensorValues(const int16_t values[], const uint8_t size) {
@@ -351,13 +383,17 @@ void reportStatus() {
 
     jsonifySensorValue(SENSOR_TEMP, roomTemp, json, JSON_MAX_SIZE);
     broadcastMsg(json);
+    displaySensorValue(SENSOR_TEMP, roomTemp);
     jsonifySensorValue(SENSOR_HUM, roomHum, json, JSON_MAX_SIZE);
     broadcastMsg(json);
-    jsonifySensorValue(SENSOR_HEATER_CURRENT, heaterIac, json, JSON_MAX_SIZE);
+    displaySensorValue(SENSOR_HUM, roomHum);
+    jsonifySensorDecimal(SENSOR_HEATER_CURRENT, (heaterIac + 5) / 10, 2, json, JSON_MAX_SIZE);
     broadcastMsg(json);
+    displaySensorValue(SENSOR_HEATER_CURRENT, heaterIac);
     jsonifyNodeStatus(NODE_HEATER_RESET, NODE_STATE_FLAGS & NODE_HEATER_RESET_BIT, tsNodeHeaterReset,
             NODE_FORCED_MODE_FLAGS & NODE_HEATER_RESET_BIT, tsForcedNodeHeaterReset, json, JSON_MAX_SIZE);
     broadcastMsg(json);
+    displayNodeStatus(NODE_HEATER_RESET, tsNodeHeaterReset);
 }
 
 void reportConfiguration() {
@@ -373,63 +409,17 @@ void reportTimestamp() {
 /*========================= Communication ===================================*/
 
 void processSerialMsg() {
-    char buff[JSON_MAX_SIZE + 1];
-    uint16_t l = serial->readBytesUntil('\0', buff, JSON_MAX_SIZE);
-    buff[l] = '\0';
-    parseCommand(buff);
+    uint16_t overruns = framerOverruns(serialFramer);
+    while (framerRead(serialFramer, serial) > 0) {
+        parseCommand(serialFrame);
+    }
+    if (framerOverruns(serialFramer) != overruns) {
+        dbgf(debug, F(":serial:overrun:%u\n"), framerOverruns(serialFramer));
+    }
 }
 
 void broadcastMsg(const char* msg) {
     serial->println(msg);
-    printToDisplay(msg);
-}
-
-void printToDisplay(const char* msg) {
-    DynamicJsonBuffer jsonBuffer(JSON_MAX_SIZE * 2);
-    JsonObject& root = jsonBuffer.parseObject(msg);
-    if (root.success()) {
-        if (root[F("m")] == F("csr")) {
-            if (root.containsKey(F("s"))) {
-                JsonObject& data = root[F("s")];
-                if (data.containsKey(F("id"))) {
-                    uint8_t id = data[F("id")].as<uint8_t>();
-                    char str[LCD_LINE_LENGTH + 1];
-                    if (id == SENSOR_TEMP && data.containsKey(F("v"))) {
-                        snprintf(str, LCD_LINE_LENGTH, "Temp      :%7d C", data[F("v")].as<int8_t>());
-                        lcd.setCursor(0, 0);
-                    } else if (id == SENSOR_HUM && data.containsKey(F("v"))) {
-                        snprintf(str, LCD_LINE_LENGTH, "Hum       :%7d %%", data[F("v")].as<int8_t>());
-                        lcd.setCursor(0, 1);
-                    } else if (id == SENSOR_HEATER_CURRENT && data.containsKey(F("v"))) {
-                        double v = data[F("v")].as<double>();
-                        snprintf(str, LCD_LINE_LENGTH, "Power[%3s]:%7d W", v >= HEATER_ACTIVE_MIN_IAC ? "ON" : "OFF",
-                                (int16_t) (v * 220));
-                        lcd.setCursor(0, 2);
-                    }
-                    lcd.print(str);
-                }
-            } else if (root.containsKey(F("n"))) {
-                JsonObject& data = root[F("n")];
-                if (data.containsKey(F("id"))) {
-                    uint8_t id = data[F("id")].as<uint8_t>();
-                    char str[LCD_LINE_LENGTH + 1];
-                    if (id == NODE_HEATER_RESET && data.containsKey(F("ts"))) {
-                        unsigned long ts = data[F("ts")].as<unsigned long>();
-                        if (ts > 0) {
-                            ts = getTimestamp() - ts;
-                        }
-                        int d, h, m;
-                        d = ts / 60 / 60 / 24;
-                        h = (ts / 60 / 60) % 24;
-                        m = (ts / 60) % 60;
-                        snprintf(str, LCD_LINE_LENGTH, "Last Reset:%03d:%02d:%02d", d, h, m);
-                        lcd.setCursor(0, 3);
-                    }
-                    lcd.print(str);
-                }
-            }
-        }
-    }
 }
 
 bool parseCommand(char* command) {
@@ -484,6 +474,68 @@ bool parseCommand(char* command) {
     return true;
 }
 
+/*========================= Display =========================================*/
+
+// LCD content is rendered into shadow framebuffer, only changed cells are sent
+void displaySensorValue(const uint8_t id, const int16_t value) {
+    char str[LCD_LINE_LENGTH + 1];
+    if (id == SENSOR_TEMP) {
+        snprintf(str, sizeof(str), "Temp      :%7d C", value);
+        displayRow(0, str);
+    } else if (id == SENSOR_HUM) {
+        snprintf(str, sizeof(str), "Hum       :%7d %%", value);
+        displayRow(1, str);
+    } else if (id == SENSOR_HEATER_CURRENT) {
+        // value in mA
+        uint16_t ma = value;
+        snprintf(str, sizeof(str), "Power[%3s]:%7d W", ma >= HEATER_ACTIVE_MIN_IAC ? "ON" : "OFF",
+                (int16_t) ((uint32_t) ma * HEATER_VOLTAGE / 1000));
+        displayRow(2, str);
+    }
+}
+
+void displayNodeStatus(const uint8_t id, unsigned long ts) {
+    char str[LCD_LINE_LENGTH + 1];
+    if (id == NODE_HEATER_RESET) {
+        if (ts > 0) {
+            ts = getTimestamp() - ts;
+        }
+        int d, h, m;
+        d = ts / 60 / 60 / 24;
+        h = (ts / 60 / 60) % 24;
+        m = (ts / 60) % 60;
+        snprintf(str, sizeof(str), "Last Reset:%03d:%02d:%02d", d, h, m);
+        displayRow(3, str);
+    }
+}
+
+void displayRow(const uint8_t row, const char *text) {
+    char line[LCD_LINE_LENGTH];
+    char *shadow = lcdShadow[row];
+    uint8_t len = strlen(text);
+    for (uint8_t i = 0; i < LCD_LINE_LENGTH; i++) {
+        line[i] = i < len ? text[i] : ' ';
+    }
+    uint8_t col = 0;
+    while (col < LCD_LINE_LENGTH) {
+        if (line[col] == shadow[col]) {
+            col++;
+            continue;
+        }
+        // run of changed cells. single unchanged cell is sent within the run,
+        // it's cheaper than another setCursor()
+        uint8_t end = col + 1;
+        while (end < LCD_LINE_LENGTH && (line[end] != shadow[end] || //
+                (end + 1 < LCD_LINE_LENGTH && line[end + 1] != shadow[end + 1]))) {
+            end++;
+        }
+        lcd.setCursor(col, row);
+        lcd.write((const uint8_t*) line + col, end - col);
+        memcpy(shadow + col, line + col, end - col);
+        col = end;
+    }
+}
+
 /*========================= Helper methods ==================================*/
 
 unsigned long getTimestamp() {
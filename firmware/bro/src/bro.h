@@ -34,6 +34,7 @@ void restoreNodesState();
 
 void readSensors();
 bool validSensorValues(const int16_t values[], const uint8_t size);
+void onSample(const uint8_t pin, const uint16_t value);
 
 void reportStatus();
 void reportConfiguration();
@@ -41,9 +42,12 @@ void reportTimestamp();
 
 void processSerialMsg();
 void broadcastMsg(const char* msg);
-void printToDisplay(const char* msg);
 bool parseCommand(char* command);
 
+void displaySensorValue(const uint8_t id, const int16_t value);
+void displayNodeStatus(const uint8_t id, unsigned long ts);
+void displayRow(const uint8_t row, const char *text);
+
 unsigned long getTimestamp();
 unsigned long diffTimestamps(unsigned long hi, unsigned long lo);
 
@@ -8,7 +8,16 @@
 
 #include <debug.h>
 #include <ESP8266.h>
+#ifdef WIFI_MQTT_PORT
+#include <mqtt.h>
+#if defined(WIFI_UPLINK_PORT) || defined(WIFI_TELEMETRY_PORT)
+#error "MQTT takes client link of ESP8266, uplink and telemetry can't share it"
+#endif
+#endif
+#include <framer.h>
 #include <jsoner.h>
+#include <probe.h>
+#include <sampler.h>
 
 #define __DEBUG__
 
@@ -27,6 +36,9 @@ const uint8_t SENSOR_SOLAR_SECONDARY = 62;
 const uint8_t SENSOR_TEMP_ROOM_1 = (54 + 16) + (4 * 1) + 0;
 const uint8_t SENSOR_HUM_ROOM_1 = (54 + 16) + (4 * 1) + 1;
 
+// Analog sensors sampled in background
+const uint8_t SENSORS_ANALOG[] = { SENSOR_BOILER_POWER, SENSOR_SOLAR_PRIMARY };
+
 const uint8_t SENSORS_ADDR_CFG[] = { SENSOR_SUPPLY, SENSOR_REVERSE, SENSOR_TANK, SENSOR_BOILER, SENSOR_MIX,
         SENSOR_SB_HEATER, SENSOR_SOLAR_PRIMARY, SENSOR_SOLAR_SECONDARY, /*reserved*/0, 0 };
 
@@ -72,48 +84,56 @@ const uint16_t NODE_HEATING_VALVE_BIT = 512;
 // etc
 const unsigned long MAX_TIMESTAMP = -1;
 const int8_t UNKNOWN_SENSOR_VALUE = -127;
+const int16_t UNKNOWN_TEMP_VALUE = UNKNOWN_SENSOR_VALUE * 10; // 0.1C
 const uint8_t SENSORS_PRECISION = 9;
+// calibration gain fixed point format (Q12)
+const uint8_t SENSOR_GAIN_Q = 12;
+const uint16_t SENSOR_GAIN_ONE = 1 << SENSOR_GAIN_Q;
+// PT100 divider resistor, mOhm (100Ohm + calibration)
+const int32_t PT100_R2_MOHM = 91335;
 const unsigned long NODE_SWITCH_SAFE_TIME_SEC = 60;
 
+// Temperatures are in 0.1C
+
 // Primary Heater
-const int8_t PRIMARY_HEATER_SUPPLY_REVERSE_HIST = 5;
-const int8_t PRIMARY_HEATER_SHORT_CIRCUIT_THRESHOLD_TEMP = 50;
+const int16_t PRIMARY_HEATER_SUPPLY_REVERSE_HIST = 50;
+const int16_t PRIMARY_HEATER_SHORT_CIRCUIT_THRESHOLD_TEMP = 500;
 const unsigned long PRIMARY_HEATER_SHORT_CIRCUIT_PERIOD_SEC = 1200; // 20 minutes
 
 // heating
-const int8_t HEATING_ON_TEMP_THRESHOLD = 35;
-const int8_t HEATING_OFF_TEMP_THRESHOLD = 28;
-const int8_t FLOOR_ON_TEMP_THRESHOLD = 35;
-const int8_t FLOOR_OFF_TEMP_THRESHOLD = 28;
+const int16_t HEATING_ON_TEMP_THRESHOLD = 350;
+const int16_t HEATING_OFF_TEMP_THRESHOLD = 280;
+const int16_t FLOOR_ON_TEMP_THRESHOLD = 350;
+const int16_t FLOOR_OFF_TEMP_THRESHOLD = 280;
 const unsigned long HEATING_ROOM_1_MAX_VALIDITY_PERIOD = 1800; // 30m
-const int8_t SB_HEATER_OFF_HIST = 3;
+const int16_t SB_HEATER_OFF_HIST = 30;
 
 // Boiler heating
-const int8_t TANK_BOILER_HEATING_ON_HIST = 3;
-const int8_t TANK_BOILER_HEATING_OFF_HIST = 2;
-const int8_t BOILER_SOLAR_MAX_TEMP_THRESHOLD = 46;
-const int8_t BOILER_SOLAR_MAX_TEMP_HIST = 2;
+const int16_t TANK_BOILER_HEATING_ON_HIST = 30;
+const int16_t TANK_BOILER_HEATING_OFF_HIST = 20;
+const int16_t BOILER_SOLAR_MAX_TEMP_THRESHOLD = 460;
+const int16_t BOILER_SOLAR_MAX_TEMP_HIST = 20;
 
 // Circulation
-const int8_t CIRCULATION_MIN_TEMP_THRESHOLD = 50;
-const int8_t CIRCULATION_COOLING_TEMP_THRESHOLD = 61;
+const int16_t CIRCULATION_MIN_TEMP_THRESHOLD = 500;
+const int16_t CIRCULATION_COOLING_TEMP_THRESHOLD = 610;
 const unsigned long CIRCULATION_ACTIVE_PERIOD_SEC = 180; // 3m
 const unsigned long CIRCULATION_PASSIVE_PERIOD_SEC = 3420; // 57m
 
 // Standby Heater
-const int8_t STANDBY_HEATER_ROOM_TEMP_DEFAULT_THRESHOLD = 10;
+const int16_t STANDBY_HEATER_ROOM_TEMP_DEFAULT_THRESHOLD = 100;
 
 // Tank
-const int8_t TANK_MIN_TEMP_THRESHOLD = 3;
-const int8_t TANK_MIN_TEMP_HIST = 2;
+const int16_t TANK_MIN_TEMP_THRESHOLD = 30;
+const int16_t TANK_MIN_TEMP_HIST = 20;
 
 // Solar
 const unsigned long SOLAR_PRIMARY_COLDSTART_PERIOD_SEC = 600; // 10m
-const int8_t SOLAR_PRIMARY_CRITICAL_TEMP_THRESHOLD = 110; // stagnation
-const int8_t SOLAR_PRIMARY_CRITICAL_TEMP_HIST = 10;
-const int8_t SOLAR_PRIMARY_BOILER_ON_HIST = 9;
-const int8_t SOLAR_PRIMARY_BOILER_OFF_HIST = 0;
-const int8_t SOLAR_SECONDARY_BOILER_ON_HIST = 0;
+const int16_t SOLAR_PRIMARY_CRITICAL_TEMP_THRESHOLD = 1100; // stagnation
+const int16_t SOLAR_PRIMARY_CRITICAL_TEMP_HIST = 100;
+const int16_t SOLAR_PRIMARY_BOILER_ON_HIST = 90;
+const int16_t SOLAR_PRIMARY_BOILER_OFF_HIST = 0;
+const int16_t SOLAR_SECONDARY_BOILER_ON_HIST = 0;
 
 // sensor BoilerPower
 const int8_t SENSOR_BOILER_POWER_THERSHOLD = 100;
@@ -128,18 +148,21 @@ const uint8_t JSON_MAX_SIZE = 128;
 /*============================= Global variables ============================*/
 
 //// Sensors
-// Values
-int8_t tempSupply = UNKNOWN_SENSOR_VALUE;
-int8_t tempReverse = UNKNOWN_SENSOR_VALUE;
-int8_t tempTank = UNKNOWN_SENSOR_VALUE;
-int8_t tempBoiler = UNKNOWN_SENSOR_VALUE;
-int8_t tempMix = UNKNOWN_SENSOR_VALUE;
-int8_t tempSbHeater = UNKNOWN_SENSOR_VALUE;
-int8_t tempRoom1 = UNKNOWN_SENSOR_VALUE;
+// Values. temperatures in 0.1C
+int16_t tempSupply = UNKNOWN_TEMP_VALUE;
+int16_t tempReverse = UNKNOWN_TEMP_VALUE;
+int16_t tempTank = UNKNOWN_TEMP_VALUE;
+int16_t tempBoiler = UNKNOWN_TEMP_VALUE;
+int16_t tempMix = UNKNOWN_TEMP_VALUE;
+int16_t tempSbHeater = UNKNOWN_TEMP_VALUE;
+int16_t tempRoom1 = UNKNOWN_TEMP_VALUE;
 int8_t humRoom1 = UNKNOWN_SENSOR_VALUE;
-int8_t tempSolarPrimary = UNKNOWN_SENSOR_VALUE;
-int8_t tempSolarSecondary = UNKNOWN_SENSOR_VALUE;
+int16_t tempSolarPrimary = UNKNOWN_TEMP_VALUE;
+int16_t tempSolarSecondary = UNKNOWN_TEMP_VALUE;
 int8_t sensorBoilerPowerState = 0;
+// Calibration cache, loaded from EEPROM
+uint16_t sensorsGain[sizeof(SENSORS_ADDR_CFG) / sizeof(SENSORS_ADDR_CFG[0])]; // Q12
+int16_t sensorsOffset[sizeof(SENSORS_ADDR_CFG) / sizeof(SENSORS_ADDR_CFG[0])]; // 0.1C
 
 //// Nodes
 
@@ -218,6 +241,7 @@ const int SERVER_IP_EEPROM_ADDR = WIFI_REMOTE_PW_EEPROM_ADDR + sizeof(WIFI_REMOT
 const int SERVER_PORT_EEPROM_ADDR = SERVER_IP_EEPROM_ADDR + sizeof(SERVER_IP);
 const int WIFI_LOCAL_AP_EEPROM_ADDR = SERVER_PORT_EEPROM_ADDR + sizeof(SERVER_PORT);
 const int WIFI_LOCAL_PW_EEPROM_ADDR = WIFI_LOCAL_AP_EEPROM_ADDR + sizeof(WIFI_LOCAL_AP);
+const int SENSORS_OFFSETS_EEPROM_ADDR = WIFI_LOCAL_PW_EEPROM_ADDR + sizeof(WIFI_LOCAL_PW);
 
 int eepromWriteCount = 0;
 
@@ -238,9 +262,22 @@ HardwareSerial *debug = NULL;
 // BT
 HardwareSerial *bt = &Serial1;
 
+// command input, collected across loop() passes
+char serialFrame[JSON_MAX_SIZE + 1];
+framer_t serialFramer;
+char btFrame[JSON_MAX_SIZE + 1];
+framer_t btFramer;
+
 //WiFi
 HardwareSerial *wifi = &Serial2;
 ESP8266 esp8266;
+// state of node forced by HTTP request, sent back in its response
+char wifiReply[JSON_MAX_SIZE];
+// HTTP server, "POST /" is what gateway sends
+const char * const HTTP_ROUTES[] = { "POST /", "POST /cmd", "GET /status", "GET /config" };
+enum http_route {
+    ROUTE_ROOT = 0, ROUTE_CMD = 1, ROUTE_STATUS = 2, ROUTE_CONFIG = 3,
+};
 
 /*============================= Arduino entry point =========================*/
 
@@ -249,6 +286,8 @@ void setup() {
     serial->begin(57600);
     bt->begin(57600);
     //wifi->begin(57600); // initialized in ESP8266 lib
+    framerInit(serialFramer, serialFrame, JSON_MAX_SIZE);
+    framerInit(btFramer, btFrame, JSON_MAX_SIZE);
 
     dbg(debug, F(":STARTING\n"));
 
@@ -265,6 +304,9 @@ void setup() {
     // init solar primary sensor
     pinMode(SENSOR_SOLAR_PRIMARY, INPUT);
 
+    // start background sampling of analog sensors
+    samplerBegin(SENSORS_ANALOG, sizeof(SENSORS_ANALOG) / sizeof(SENSORS_ANALOG[0]));
+
     // restore forced node state flags from EEPROM
     // default node state -- OFF
     restoreNodesState();
@@ -298,24 +340,37 @@ void setup() {
     sensors.begin();
     sensors.setResolution(SENSORS_PRECISION);
     searchSensors();
+    loadSensorsCalibration();
 
     // setup WiFi
     loadWifiConfig();
     dbgf(debug, F(":setup wifi:R_AP:%s:L_AP:%s:L_PORT:%d\n"), &WIFI_REMOTE_AP, &WIFI_LOCAL_AP, TCP_SERVER_PORT);
-    esp8266.init(wifi, MODE_STA_AP, WIFI_RST_PIN, WIFI_FAILURE_GRACE_PERIOD_SEC);
+    // circuits don't wait for WiFi: ESP is set up in loop() by update()
+    esp8266.boot(wifi, MODE_STA_AP, WIFI_RST_PIN, WIFI_FAILURE_GRACE_PERIOD_SEC);
     esp8266.startAP(&WIFI_LOCAL_AP, &WIFI_LOCAL_PW);
     esp8266.connect(&WIFI_REMOTE_AP, &WIFI_REMOTE_PW);
+    esp8266.setRoutes(HTTP_ROUTES, sizeof(HTTP_ROUTES) / sizeof(HTTP_ROUTES[0]));
     esp8266.startTcpServer(TCP_SERVER_PORT);
-    esp8266.getStaIP(WIFI_STA_IP);
-    dbgf(debug, F(":STA_IP: %d.%d.%d.%d\n"), WIFI_STA_IP[0], WIFI_STA_IP[1], WIFI_STA_IP[2], WIFI_STA_IP[3]);
+#ifdef WIFI_MQTT_PORT
+    // broker runs next to logserver, connects once WiFi is up
+    mqttBegin(&esp8266, "dad", SERVER_IP, WIFI_MQTT_PORT, processMqttMsg);
+    mqttSetDebug(debug);
+#endif
+
+    // the first loop() reads sensors and runs circuits
+    tsLastSensorsRead = getTimestamp() - SENSORS_READ_INTERVAL_SEC;
 }
 
 void loop() {
+    PROBE_BEGIN(PROBE_LOOP);
     tsCurr = getTimestamp();
     if (diffTimestamps(tsCurr, tsLastSensorsRead) >= SENSORS_READ_INTERVAL_SEC) {
+        PROBE_BEGIN(PROBE_LOOP_SENSORS);
         readSensors();
         tsLastSensorsRead = tsCurr;
+        PROBE_END(PROBE_LOOP_SENSORS);
 
+        PROBE_BEGIN(PROBE_LOOP_CIRCUITS);
         // heater <--> tank
         processSupplyCircuit();
         // tank <--> heating system
@@ -334,25 +389,39 @@ void loop() {
         processSolarSecondary();
         // standby heater
         processStandbyHeater();
+        PROBE_END(PROBE_LOOP_CIRCUITS);
 
         digitalWrite(HEARTBEAT_LED, digitalRead(HEARTBEAT_LED) ^ 1);
     }
-    if (serial->available() > 0) {
+    if (serial->available() > 0 || framerPending(serialFramer)) {
+        PROBE_BEGIN(PROBE_LOOP_SERIAL);
         processSerialMsg();
+        PROBE_END(PROBE_LOOP_SERIAL);
     }
-    if (bt->available() > 0) {
+    if (bt->available() > 0 || framerPending(btFramer)) {
+        PROBE_BEGIN(PROBE_LOOP_BT);
         processBtMsg();
+        PROBE_END(PROBE_LOOP_BT);
     }
-    if (wifi->available() > 0) {
+    if (esp8266.available() > 0) {
+        PROBE_BEGIN(PROBE_LOOP_WIFI);
         processWifiMsg();
+        PROBE_END(PROBE_LOOP_WIFI);
     }
+    esp8266.update();
+#ifdef WIFI_MQTT_PORT
+    mqttLoop();
+#endif
 
     if (diffTimestamps(tsCurr, tsLastStatusReport) >= STATUS_REPORTING_PERIOD_SEC) {
+        PROBE_BEGIN(PROBE_LOOP_REPORT);
         reportStatus();
         tsLastStatusReport = tsCurr;
+        PROBE_END(PROBE_LOOP_REPORT);
     }
 
     tsPrev = tsCurr;
+    PROBE_END(PROBE_LOOP);
 }
 
 /*========================= Node processing methods =========================*/
@@ -1103,7 +1172,7 @@ void switchNodeState(uint8_t id, uint8_t sensId[], int16_t sensVal[], uint8_t se
         // report state change
         char json[JSON_MAX_SIZE];
         jsonifyNodeStateChange(id, NODE_STATE_FLAGS & bit, *ts, NODE_FORCED_MODE_FLAGS & bit, *tsf, sensId, sensVal,
-                sensCnt, json, JSON_MAX_SIZE);
+                sensCnt, json, JSON_MAX_SIZE, 1);
         broadcastMsg(json);
     }
 }
@@ -1115,46 +1184,55 @@ void forceNodeState(uint8_t id, uint8_t state, unsigned long ts) {
         jsonifyNodeStatus(NODE_SUPPLY, NODE_STATE_FLAGS & NODE_SUPPLY_BIT, tsNodeSupply,
                 NODE_FORCED_MODE_FLAGS & NODE_SUPPLY_BIT, tsForcedNodeSupply, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_HEATING == id) {
         forceNodeState(NODE_HEATING, NODE_HEATING_BIT, state, tsForcedNodeHeating, ts);
         jsonifyNodeStatus(NODE_HEATING, NODE_STATE_FLAGS & NODE_HEATING_BIT, tsNodeHeating,
                 NODE_FORCED_MODE_FLAGS & NODE_HEATING_BIT, tsForcedNodeHeating, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_FLOOR == id) {
         forceNodeState(NODE_FLOOR, NODE_FLOOR_BIT, state, tsForcedNodeFloor, ts);
         jsonifyNodeStatus(NODE_FLOOR, NODE_STATE_FLAGS & NODE_FLOOR_BIT, tsNodeFloor,
                 NODE_FORCED_MODE_FLAGS & NODE_FLOOR_BIT, tsForcedNodeFloor, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_HOTWATER == id) {
         forceNodeState(NODE_HOTWATER, NODE_HOTWATER_BIT, state, tsForcedNodeHotwater, ts);
         jsonifyNodeStatus(NODE_HOTWATER, NODE_STATE_FLAGS & NODE_HOTWATER_BIT, tsNodeHotwater,
                 NODE_FORCED_MODE_FLAGS & NODE_HOTWATER_BIT, tsForcedNodeHotwater, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_CIRCULATION == id) {
         forceNodeState(NODE_CIRCULATION, NODE_CIRCULATION_BIT, state, tsForcedNodeCirculation, ts);
         jsonifyNodeStatus(NODE_CIRCULATION, NODE_STATE_FLAGS & NODE_CIRCULATION_BIT, tsNodeCirculation,
                 NODE_FORCED_MODE_FLAGS & NODE_CIRCULATION_BIT, tsForcedNodeCirculation, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_SB_HEATER == id) {
         forceNodeState(NODE_SB_HEATER, NODE_SB_HEATER_BIT, state, tsForcedNodeSbHeater, ts);
         jsonifyNodeStatus(NODE_SB_HEATER, NODE_STATE_FLAGS & NODE_SB_HEATER_BIT, tsNodeSbHeater,
                 NODE_FORCED_MODE_FLAGS & NODE_SB_HEATER_BIT, tsForcedNodeSbHeater, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_SOLAR_PRIMARY == id) {
         forceNodeState(NODE_SOLAR_PRIMARY, NODE_SOLAR_PRIMARY_BIT, state, tsForcedNodeSolarPrimary, ts);
         jsonifyNodeStatus(NODE_SOLAR_PRIMARY, NODE_STATE_FLAGS & NODE_SOLAR_PRIMARY_BIT, tsNodeSolarPrimary,
                 NODE_FORCED_MODE_FLAGS & NODE_SOLAR_PRIMARY_BIT, tsForcedNodeSolarPrimary, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_SOLAR_SECONDARY == id) {
         forceNodeState(NODE_SOLAR_SECONDARY, NODE_SOLAR_SECONDARY_BIT, state, tsForcedNodeSolarSecondary, ts);
         jsonifyNodeStatus(NODE_SOLAR_SECONDARY, NODE_STATE_FLAGS & NODE_SOLAR_SECONDARY_BIT, tsNodeSolarSecondary,
                 NODE_FORCED_MODE_FLAGS & NODE_SOLAR_SECONDARY_BIT, tsForcedNodeSolarSecondary, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_HEATING_VALVE == id) {
         forceNodeState(NODE_HEATING_VALVE, NODE_HEATING_VALVE_BIT, state, tsForcedNodeHeatingValve, ts);
         jsonifyNodeStatus(NODE_HEATING_VALVE, NODE_STATE_FLAGS & NODE_HEATING_VALVE_BIT, tsNodeHeatingValve,
                 NODE_FORCED_MODE_FLAGS & NODE_HEATING_VALVE_BIT, tsForcedNodeHeatingValve, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     }
     // update node modes in EEPROM if forced permanently
     if (ts == 0) {
@@ -1191,54 +1269,63 @@ void unForceNodeState(uint8_t id) {
         jsonifyNodeStatus(NODE_SUPPLY, NODE_STATE_FLAGS & NODE_SUPPLY_BIT, tsNodeSupply,
                 NODE_FORCED_MODE_FLAGS & NODE_SUPPLY_BIT, tsForcedNodeSupply, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_HEATING == id) {
         NODE_FORCED_MODE_FLAGS = NODE_FORCED_MODE_FLAGS & ~NODE_HEATING_BIT;
         NODE_PERMANENTLY_FORCED_MODE_FLAGS = NODE_PERMANENTLY_FORCED_MODE_FLAGS & ~NODE_HEATING_BIT;
         jsonifyNodeStatus(NODE_HEATING, NODE_STATE_FLAGS & NODE_HEATING_BIT, tsNodeHeating,
                 NODE_FORCED_MODE_FLAGS & NODE_HEATING_BIT, tsForcedNodeHeating, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_FLOOR == id) {
         NODE_FORCED_MODE_FLAGS = NODE_FORCED_MODE_FLAGS & ~NODE_FLOOR_BIT;
         NODE_PERMANENTLY_FORCED_MODE_FLAGS = NODE_PERMANENTLY_FORCED_MODE_FLAGS & ~NODE_FLOOR_BIT;
         jsonifyNodeStatus(NODE_FLOOR, NODE_STATE_FLAGS & NODE_FLOOR_BIT, tsNodeFloor,
                 NODE_FORCED_MODE_FLAGS & NODE_FLOOR_BIT, tsForcedNodeFloor, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_HOTWATER == id) {
         NODE_FORCED_MODE_FLAGS = NODE_FORCED_MODE_FLAGS & ~NODE_HOTWATER_BIT;
         NODE_PERMANENTLY_FORCED_MODE_FLAGS = NODE_PERMANENTLY_FORCED_MODE_FLAGS & ~NODE_HOTWATER_BIT;
         jsonifyNodeStatus(NODE_HOTWATER, NODE_STATE_FLAGS & NODE_HOTWATER_BIT, tsNodeHotwater,
                 NODE_FORCED_MODE_FLAGS & NODE_HOTWATER_BIT, tsForcedNodeHotwater, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_CIRCULATION == id) {
         NODE_FORCED_MODE_FLAGS = NODE_FORCED_MODE_FLAGS & ~NODE_CIRCULATION_BIT;
         NODE_PERMANENTLY_FORCED_MODE_FLAGS = NODE_PERMANENTLY_FORCED_MODE_FLAGS & ~NODE_CIRCULATION_BIT;
         jsonifyNodeStatus(NODE_CIRCULATION, NODE_STATE_FLAGS & NODE_CIRCULATION_BIT, tsNodeCirculation,
                 NODE_FORCED_MODE_FLAGS & NODE_CIRCULATION_BIT, tsForcedNodeCirculation, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_SB_HEATER == id) {
         NODE_FORCED_MODE_FLAGS = NODE_FORCED_MODE_FLAGS & ~NODE_SB_HEATER_BIT;
         NODE_PERMANENTLY_FORCED_MODE_FLAGS = NODE_PERMANENTLY_FORCED_MODE_FLAGS & ~NODE_SB_HEATER_BIT;
         jsonifyNodeStatus(NODE_SB_HEATER, NODE_STATE_FLAGS & NODE_SB_HEATER_BIT, tsNodeSbHeater,
                 NODE_FORCED_MODE_FLAGS & NODE_SB_HEATER_BIT, tsForcedNodeSbHeater, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_SOLAR_PRIMARY == id) {
         NODE_FORCED_MODE_FLAGS = NODE_FORCED_MODE_FLAGS & ~NODE_SOLAR_PRIMARY_BIT;
         NODE_PERMANENTLY_FORCED_MODE_FLAGS = NODE_PERMANENTLY_FORCED_MODE_FLAGS & ~NODE_SOLAR_PRIMARY_BIT;
         jsonifyNodeStatus(NODE_SOLAR_PRIMARY, NODE_STATE_FLAGS & NODE_SOLAR_PRIMARY_BIT, tsNodeSolarPrimary,
                 NODE_FORCED_MODE_FLAGS & NODE_SOLAR_PRIMARY_BIT, tsForcedNodeSolarPrimary, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_SOLAR_SECONDARY == id) {
         NODE_FORCED_MODE_FLAGS = NODE_FORCED_MODE_FLAGS & ~NODE_SOLAR_SECONDARY_BIT;
         NODE_PERMANENTLY_FORCED_MODE_FLAGS = NODE_PERMANENTLY_FORCED_MODE_FLAGS & ~NODE_SOLAR_SECONDARY_BIT;
         jsonifyNodeStatus(NODE_SOLAR_SECONDARY, NODE_STATE_FLAGS & NODE_SOLAR_SECONDARY_BIT, tsNodeSolarSecondary,
                 NODE_FORCED_MODE_FLAGS & NODE_SOLAR_SECONDARY_BIT, tsForcedNodeSolarSecondary, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_HEATING_VALVE == id) {
         NODE_FORCED_MODE_FLAGS = NODE_FORCED_MODE_FLAGS & ~NODE_HEATING_VALVE_BIT;
         NODE_PERMANENTLY_FORCED_MODE_FLAGS = NODE_PERMANENTLY_FORCED_MODE_FLAGS & ~NODE_HEATING_VALVE_BIT;
         jsonifyNodeStatus(NODE_HEATING_VALVE, NODE_STATE_FLAGS & NODE_HEATING_VALVE_BIT, tsNodeHeatingValve,
                 NODE_FORCED_MODE_FLAGS & NODE_HEATING_VALVE_BIT, tsForcedNodeHeatingValve, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     }
     // update node modes in EEPROM if unforced from permanent
     if (prevPermanentlyForcedModeFlags != NODE_PERMANENTLY_FORCED_MODE_FLAGS) {
@@ -1249,7 +1336,7 @@ void unForceNodeState(uint8_t id) {
 bool room1TempReachedMinThreshold() {
     return (tsLastSensorTempRoom1 != 0
             && diffTimestamps(tsCurr, tsLastSensorTempRoom1) < HEATING_ROOM_1_MAX_VALIDITY_PERIOD
-            && tempRoom1 > readSensorTH(SENSOR_TH_ROOM1_SB_HEATER))
+            && tempRoom1 > readSensorTH(SENSOR_TH_ROOM1_SB_HEATER) * 10)
             || (tsLastSensorTempRoom1 != 0
                     && diffTimestamps(tsCurr, tsLastSensorTempRoom1) >= HEATING_ROOM_1_MAX_VALIDITY_PERIOD)
             || (tsLastSensorTempRoom1 == 0);
@@ -1258,13 +1345,13 @@ bool room1TempReachedMinThreshold() {
 bool room1TempFailedMinThreshold() {
     return (tsLastSensorTempRoom1 != 0
             && diffTimestamps(tsCurr, tsLastSensorTempRoom1) < HEATING_ROOM_1_MAX_VALIDITY_PERIOD
-            && tempRoom1 < readSensorTH(SENSOR_TH_ROOM1_SB_HEATER));
+            && tempRoom1 < readSensorTH(SENSOR_TH_ROOM1_SB_HEATER) * 10);
 }
 
 bool room1TempSatisfyMaxThreshold() {
     return tsLastSensorTempRoom1 != 0
             && diffTimestamps(tsCurr, tsLastSensorTempRoom1) < HEATING_ROOM_1_MAX_VALIDITY_PERIOD
-            && tempRoom1 >= readSensorTH(SENSOR_TH_ROOM1_PRIMARY_HEATER);
+            && tempRoom1 >= readSensorTH(SENSOR_TH_ROOM1_PRIMARY_HEATER) * 10;
 }
 
 /*====================== Load/Save configuration in EEPROM ==================*/
@@ -1283,6 +1370,41 @@ double readSensorCF(uint8_t sensor) {
 void saveSensorCF(uint8_t sensor, double value) {
     if (sensorCfOffset(sensor) >= 0) {
         eepromWriteCount += EEPROM.updateDouble(SENSORS_FACTORS_EEPROM_ADDR + sensorCfOffset(sensor), value);
+        loadSensorCalibration(sensor);
+    }
+}
+
+int16_t readSensorCO(uint8_t sensor) {
+    int16_t v = 0;
+    if (sensorCoOffset(sensor) >= 0) {
+        // stored inverted, so erased EEPROM (0xFFFF) reads as zero offset
+        v = ~EEPROM.readInt(SENSORS_OFFSETS_EEPROM_ADDR + sensorCoOffset(sensor));
+    }
+    return v;
+}
+
+void saveSensorCO(uint8_t sensor, int16_t value) {
+    if (sensorCoOffset(sensor) >= 0) {
+        eepromWriteCount += EEPROM.updateInt(SENSORS_OFFSETS_EEPROM_ADDR + sensorCoOffset(sensor), ~value);
+        loadSensorCalibration(sensor);
+    }
+}
+
+void loadSensorsCalibration() {
+    for (uint8_t i = 0; i < sizeof(SENSORS_ADDR_CFG) / sizeof(SENSORS_ADDR_CFG[0]); i++) {
+        if (SENSORS_ADDR_CFG[i]) {
+            loadSensorCalibration(SENSORS_ADDR_CFG[i]);
+        }
+    }
+}
+
+void loadSensorCalibration(uint8_t sensor) {
+    int idx = sensorIdx(sensor);
+    if (idx >= 0) {
+        // float math only here, sensor readings use cached fixed point values
+        double gain = readSensorCF(sensor) * SENSOR_GAIN_ONE + 0.5;
+        sensorsGain[idx] = (gain < 1) ? 1 : (gain > 0xFFFF) ? 0xFFFF : (uint16_t) gain;
+        sensorsOffset[idx] = readSensorCO(sensor);
     }
 }
 
@@ -1314,6 +1436,15 @@ void saveSensorTH(uint8_t sensor, int16_t value) {
     }
 }
 
+int sensorIdx(uint8_t sensor) {
+    for (uint8_t i = 0; i < sizeof(SENSORS_ADDR_CFG) / sizeof(SENSORS_ADDR_CFG[0]); i++) {
+        if (SENSORS_ADDR_CFG[i] == sensor) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 int sensorCfOffset(uint8_t sensor) {
     int offset = 0;
     for (uint8_t i = 0; i < sizeof(SENSORS_ADDR_CFG) / sizeof(SENSORS_ADDR_CFG[0]); i++) {
@@ -1325,6 +1456,11 @@ int sensorCfOffset(uint8_t sensor) {
     return -1;
 }
 
+int sensorCoOffset(uint8_t sensor) {
+    int idx = sensorIdx(sensor);
+    return (idx >= 0) ? idx * sizeof(int16_t) : -1;
+}
+
 int sensorUidOffset(uint8_t sensor) {
     int offset = 0;
     for (uint8_t i = 0; i < sizeof(SENSORS_ADDR_CFG) / sizeof(SENSORS_ADDR_CFG[0]); i++) {
@@ -1378,11 +1514,14 @@ void validateStringParam(char* str, int maxSize) {
 }
 
 void str2uid(const char *str, DeviceAddress uid) {
-    char buf[2];
+    char buf[3];
+    buf[2] = '\0';
     for (uint8_t i = 0; i < 16; i = i + 2) {
         buf[0] = str[i];
         buf[1] = str[i + 1];
-        sscanf(buf, "%X", (unsigned int*) &uid[i / 2]);
+        unsigned int b = 0;
+        sscanf(buf, "%X", &b);
+        uid[i / 2] = b;
     }
 }
 
@@ -1424,62 +1563,56 @@ void readSensors() {
     }
 }
 
-int8_t getSensorValue(const uint8_t sensor) {
-    float result = UNKNOWN_SENSOR_VALUE;
+int16_t getSensorValue(const uint8_t sensor) {
+    PROBE_SCOPE(PROBE_SENSOR_VALUE);
+    int16_t result = UNKNOWN_TEMP_VALUE;
     if (SENSOR_SOLAR_PRIMARY == sensor) { // analog sensor
-        float vin = 5; // 5V
-        float r2 = 91.335; // 100Ohm + calibration
-        int v = 0;
-        for (int i = 0; i < 10; i++) {
-            v += analogRead(SENSOR_SOLAR_PRIMARY);
-            delay(100);
-        }
-        v = v / 10;
-        float vout = (vin / 1023.0) * v;
-        float r1 = (vin / vout - 1) * r2;
-
-        dbgf(debug, F(":SolarPrimary:%d/%dOhm/%dC\n"), v, (int) r1, (int) ((r1 - 100) / 0.39));
-
+        int v = samplerMean(SENSOR_SOLAR_PRIMARY);
         if (v > 0) {
-            result = (r1 - 100) / 0.39;
+            // r1 = (vin / vout - 1) * r2; vout = vin * v / 1023
+            int32_t r1 = PT100_R2_MOHM * (1023 - v) / v;
+            // t = (r1 - 100Ohm) / 0.39Ohm/C
+            int32_t t = (r1 - 100000L) / 39;
+            if (t > UNKNOWN_TEMP_VALUE && t < INT16_MAX) {
+                result = t;
+            }
+            dbgf(debug, F(":SolarPrimary:%d/%dOhm/%dC\n"), v, (int) (r1 / 1000), (int) (t / 10));
+        } else {
+            dbgf(debug, F(":SolarPrimary:%d\n"), v);
         }
     } else { // all other digital
         DeviceAddress uid;
         readSensorUID(sensor, uid);
         if (sensors.requestTemperaturesByAddress(uid)) {
             uint8_t retry = 0;
-            while ((result = sensors.getTempC(uid)) == DEVICE_DISCONNECTED_C && retry < 20) {
+            int16_t raw;
+            while ((raw = sensors.getTemp(uid)) == DEVICE_DISCONNECTED_RAW && retry < 20) {
                 delay(10);
                 retry++;
             }
-            if (result != DEVICE_DISCONNECTED_C) {
-                result *= readSensorCF(sensor);
-            } else {
-                result = UNKNOWN_SENSOR_VALUE;
+            int idx = sensorIdx(sensor);
+            if (raw != DEVICE_DISCONNECTED_RAW && idx >= 0) {
+                // raw is 1/128C. apply gain, then convert to 0.1C
+                int32_t t = ((int32_t) raw * sensorsGain[idx] + (SENSOR_GAIN_ONE >> 1)) >> SENSOR_GAIN_Q;
+                result = ((t * 10 + 64) >> 7) + sensorsOffset[idx];
             }
         }
     }
-    result = (result > 0) ? result + 0.5 : result - 0.5;
-    return int8_t(result);
+    return result;
 }
 
 int8_t getSensorBoilerPowerState() {
-    uint16_t max = 0;
-    for (uint8_t i = 0; i < 100; i++) {
-        uint16_t v = abs(analogRead(SENSOR_BOILER_POWER) - 512);
-        if (v > max && v < 1000) { // filter out error values. correct value should be <1000
-            max = v;
-        }
-        delay(1);
-    }
-    uint8_t state = (max > SENSOR_BOILER_POWER_THERSHOLD) ? 1 : 0;
-    dbgf(debug, F(":BoilerPower:%d/%d\n"), max, state);
+    PROBE_SCOPE(PROBE_SENSOR_POWER_STATE);
+    sampler_stats_t stats;
+    samplerStats(SENSOR_BOILER_POWER, &stats);
+    uint8_t state = (stats.peak > SENSOR_BOILER_POWER_THERSHOLD) ? 1 : 0;
+    dbgf(debug, F(":BoilerPower:%d/%d\n"), stats.peak, state);
     return state;
 }
 
 bool validSensorValues(const int16_t values[], const uint8_t size) {
     for (int i = 0; i < size; i++) {
-        if (values[i] == UNKNOWN_SENSOR_VALUE) {
+        if (values[i] == UNKNOWN_TEMP_VALUE) {
             return false;
         }
     }
@@ -1488,232 +1621,214 @@ bool validSensorValues(const int16_t values[], const uint8_t size) {
 /*============================ Reporting ====================================*/
 
 void reportStatus() {
-    char json[JSON_MAX_SIZE];
     if (nextEntryReport == 0) {
         // start reporting
         nextEntryReport = SENSOR_SUPPLY;
     }
-    switch (nextEntryReport) {
+    nextEntryReport = reportStatusEntry(nextEntryReport, reportMsg);
+}
+
+// puts status entry into out, returns the next one, 0 after the last
+uint8_t reportStatusEntry(uint8_t entry, void (*out)(const char*)) {
+    char json[JSON_MAX_SIZE];
+    switch (entry) {
     case SENSOR_SUPPLY:
-        jsonifySensorValue(SENSOR_SUPPLY, tempSupply, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = SENSOR_REVERSE;
-        break;
+        jsonifySensorDecimal(SENSOR_SUPPLY, tempSupply, 1, json, JSON_MAX_SIZE);
+        out(json);
+        return SENSOR_REVERSE;
     case SENSOR_REVERSE:
-        jsonifySensorValue(SENSOR_REVERSE, tempReverse, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = SENSOR_TANK;
-        break;
+        jsonifySensorDecimal(SENSOR_REVERSE, tempReverse, 1, json, JSON_MAX_SIZE);
+        out(json);
+        return SENSOR_TANK;
     case SENSOR_TANK:
-        jsonifySensorValue(SENSOR_TANK, tempTank, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = SENSOR_MIX;
-        break;
+        jsonifySensorDecimal(SENSOR_TANK, tempTank, 1, json, JSON_MAX_SIZE);
+        out(json);
+        return SENSOR_MIX;
     case SENSOR_MIX:
-        jsonifySensorValue(SENSOR_MIX, tempMix, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = SENSOR_SB_HEATER;
-        break;
+        jsonifySensorDecimal(SENSOR_MIX, tempMix, 1, json, JSON_MAX_SIZE);
+        out(json);
+        return SENSOR_SB_HEATER;
     case SENSOR_SB_HEATER:
-        jsonifySensorValue(SENSOR_SB_HEATER, tempSbHeater, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = SENSOR_BOILER;
-        break;
+        jsonifySensorDecimal(SENSOR_SB_HEATER, tempSbHeater, 1, json, JSON_MAX_SIZE);
+        out(json);
+        return SENSOR_BOILER;
     case SENSOR_BOILER:
-        jsonifySensorValue(SENSOR_BOILER, tempBoiler, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = SENSOR_TEMP_ROOM_1;
-        break;
+        jsonifySensorDecimal(SENSOR_BOILER, tempBoiler, 1, json, JSON_MAX_SIZE);
+        out(json);
+        return SENSOR_TEMP_ROOM_1;
     case SENSOR_TEMP_ROOM_1:
-        jsonifySensorValue(SENSOR_TEMP_ROOM_1, tempRoom1, tsLastSensorTempRoom1, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = SENSOR_HUM_ROOM_1;
-        break;
+        jsonifySensorDecimal(SENSOR_TEMP_ROOM_1, tempRoom1, 1, tsLastSensorTempRoom1, json, JSON_MAX_SIZE);
+        out(json);
+        return SENSOR_HUM_ROOM_1;
     case SENSOR_HUM_ROOM_1:
         jsonifySensorValue(SENSOR_HUM_ROOM_1, humRoom1, tsLastSensorHumRoom1, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = SENSOR_BOILER_POWER;
-        break;
+        out(json);
+        return SENSOR_BOILER_POWER;
     case SENSOR_BOILER_POWER:
         jsonifySensorValue(SENSOR_BOILER_POWER, sensorBoilerPowerState, tsSensorBoilerPower, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = SENSOR_SOLAR_PRIMARY;
-        break;
+        out(json);
+        return SENSOR_SOLAR_PRIMARY;
     case SENSOR_SOLAR_PRIMARY:
-        jsonifySensorValue(SENSOR_SOLAR_PRIMARY, tempSolarPrimary, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = SENSOR_SOLAR_SECONDARY;
-        break;
+        jsonifySensorDecimal(SENSOR_SOLAR_PRIMARY, tempSolarPrimary, 1, json, JSON_MAX_SIZE);
+        out(json);
+        return SENSOR_SOLAR_SECONDARY;
     case SENSOR_SOLAR_SECONDARY:
-        jsonifySensorValue(SENSOR_SOLAR_SECONDARY, tempSolarSecondary, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = NODE_SUPPLY;
-        break;
+        jsonifySensorDecimal(SENSOR_SOLAR_SECONDARY, tempSolarSecondary, 1, json, JSON_MAX_SIZE);
+        out(json);
+        return NODE_SUPPLY;
     case NODE_SUPPLY:
         jsonifyNodeStatus(NODE_SUPPLY, NODE_STATE_FLAGS & NODE_SUPPLY_BIT, tsNodeSupply,
                 NODE_FORCED_MODE_FLAGS & NODE_SUPPLY_BIT, tsForcedNodeSupply, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = NODE_HEATING;
-        break;
+        out(json);
+        return NODE_HEATING;
     case NODE_HEATING:
         jsonifyNodeStatus(NODE_HEATING, NODE_STATE_FLAGS & NODE_HEATING_BIT, tsNodeHeating,
                 NODE_FORCED_MODE_FLAGS & NODE_HEATING_BIT, tsForcedNodeHeating, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
+        out(json);
         jsonifySensorConfig(SENSOR_TH_ROOM1_PRIMARY_HEATER, F("v"), readSensorTH(SENSOR_TH_ROOM1_PRIMARY_HEATER), json,
                 JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = NODE_FLOOR;
-        break;
+        out(json);
+        return NODE_FLOOR;
     case NODE_FLOOR:
         jsonifyNodeStatus(NODE_FLOOR, NODE_STATE_FLAGS & NODE_FLOOR_BIT, tsNodeFloor,
                 NODE_FORCED_MODE_FLAGS & NODE_FLOOR_BIT, tsForcedNodeFloor, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = NODE_SB_HEATER;
-        break;
+        out(json);
+        return NODE_SB_HEATER;
     case NODE_SB_HEATER:
         jsonifyNodeStatus(NODE_SB_HEATER, NODE_STATE_FLAGS & NODE_SB_HEATER_BIT, tsNodeSbHeater,
                 NODE_FORCED_MODE_FLAGS & NODE_SB_HEATER_BIT, tsForcedNodeSbHeater, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
+        out(json);
         jsonifySensorConfig(SENSOR_TH_ROOM1_SB_HEATER, F("v"), readSensorTH(SENSOR_TH_ROOM1_SB_HEATER), json,
                 JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = NODE_HOTWATER;
-        break;
+        out(json);
+        return NODE_HOTWATER;
     case NODE_HOTWATER:
         jsonifyNodeStatus(NODE_HOTWATER, NODE_STATE_FLAGS & NODE_HOTWATER_BIT, tsNodeHotwater,
                 NODE_FORCED_MODE_FLAGS & NODE_HOTWATER_BIT, tsForcedNodeHotwater, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = NODE_CIRCULATION;
-        break;
+        out(json);
+        return NODE_CIRCULATION;
     case NODE_CIRCULATION:
         jsonifyNodeStatus(NODE_CIRCULATION, NODE_STATE_FLAGS & NODE_CIRCULATION_BIT, tsNodeCirculation,
                 NODE_FORCED_MODE_FLAGS & NODE_CIRCULATION_BIT, tsForcedNodeCirculation, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = NODE_SOLAR_PRIMARY;
-        break;
+        out(json);
+        return NODE_SOLAR_PRIMARY;
     case NODE_SOLAR_PRIMARY:
         jsonifyNodeStatus(NODE_SOLAR_PRIMARY, NODE_STATE_FLAGS & NODE_SOLAR_PRIMARY_BIT, tsNodeSolarPrimary,
                 NODE_FORCED_MODE_FLAGS & NODE_SOLAR_PRIMARY_BIT, tsForcedNodeSolarPrimary, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = NODE_SOLAR_SECONDARY;
-        break;
+        out(json);
+        return NODE_SOLAR_SECONDARY;
     case NODE_SOLAR_SECONDARY:
         jsonifyNodeStatus(NODE_SOLAR_SECONDARY, NODE_STATE_FLAGS & NODE_SOLAR_SECONDARY_BIT, tsNodeSolarSecondary,
                 NODE_FORCED_MODE_FLAGS & NODE_SOLAR_SECONDARY_BIT, tsForcedNodeSolarSecondary, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = NODE_HEATING_VALVE;
-        break;
+        out(json);
+        return NODE_HEATING_VALVE;
     case NODE_HEATING_VALVE:
         jsonifyNodeStatus(NODE_HEATING_VALVE, NODE_STATE_FLAGS & NODE_HEATING_VALVE_BIT, tsNodeHeatingValve,
                 NODE_FORCED_MODE_FLAGS & NODE_HEATING_VALVE_BIT, tsForcedNodeHeatingValve, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
-        nextEntryReport = 0;
-        break;
+        out(json);
+        return 0;
     default:
-        break;
+        return 0;
     }
 }
 
-void reportConfiguration() {
+// walked twice by respondItems(), so no AT commands here. lip is WIFI_STA_IP
+// as the caller has read it
+void reportConfiguration(void (*out)(const char*), bool secrets) {
     char json[JSON_MAX_SIZE];
     char buf[16];
 
     jsonifySensorConfig(SENSOR_SUPPLY, F("cf"), readSensorCF(SENSOR_SUPPLY), json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
+    jsonifySensorConfig(SENSOR_SUPPLY, F("co"), readSensorCO(SENSOR_SUPPLY), json, JSON_MAX_SIZE);
+    out(json);
     jsonifySensorConfig(SENSOR_REVERSE, F("cf"), readSensorCF(SENSOR_REVERSE), json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
+    jsonifySensorConfig(SENSOR_REVERSE, F("co"), readSensorCO(SENSOR_REVERSE), json, JSON_MAX_SIZE);
+    out(json);
     jsonifySensorConfig(SENSOR_TANK, F("cf"), readSensorCF(SENSOR_TANK), json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
+    jsonifySensorConfig(SENSOR_TANK, F("co"), readSensorCO(SENSOR_TANK), json, JSON_MAX_SIZE);
+    out(json);
     jsonifySensorConfig(SENSOR_BOILER, F("cf"), readSensorCF(SENSOR_BOILER), json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
+    jsonifySensorConfig(SENSOR_BOILER, F("co"), readSensorCO(SENSOR_BOILER), json, JSON_MAX_SIZE);
+    out(json);
     jsonifySensorConfig(SENSOR_MIX, F("cf"), readSensorCF(SENSOR_MIX), json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
+    jsonifySensorConfig(SENSOR_MIX, F("co"), readSensorCO(SENSOR_MIX), json, JSON_MAX_SIZE);
+    out(json);
     jsonifySensorConfig(SENSOR_SB_HEATER, F("cf"), readSensorCF(SENSOR_SB_HEATER), json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
+    jsonifySensorConfig(SENSOR_SB_HEATER, F("co"), readSensorCO(SENSOR_SB_HEATER), json, JSON_MAX_SIZE);
+    out(json);
     jsonifySensorConfig(SENSOR_SOLAR_PRIMARY, F("cf"), readSensorCF(SENSOR_SOLAR_PRIMARY), json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
+    jsonifySensorConfig(SENSOR_SOLAR_PRIMARY, F("co"), readSensorCO(SENSOR_SOLAR_PRIMARY), json, JSON_MAX_SIZE);
+    out(json);
     jsonifySensorConfig(SENSOR_SOLAR_SECONDARY, F("cf"), readSensorCF(SENSOR_SOLAR_SECONDARY), json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
+    jsonifySensorConfig(SENSOR_SOLAR_SECONDARY, F("co"), readSensorCO(SENSOR_SOLAR_SECONDARY), json, JSON_MAX_SIZE);
+    out(json);
 
     DeviceAddress uid;
     readSensorUID(SENSOR_SUPPLY, uid);
     uid2str(uid, buf);
     jsonifySensorConfig(SENSOR_SUPPLY, F("uid"), buf, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
     readSensorUID(SENSOR_REVERSE, uid);
     uid2str(uid, buf);
     jsonifySensorConfig(SENSOR_REVERSE, F("uid"), buf, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
     readSensorUID(SENSOR_TANK, uid);
     uid2str(uid, buf);
     jsonifySensorConfig(SENSOR_TANK, F("uid"), buf, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
     readSensorUID(SENSOR_BOILER, uid);
     uid2str(uid, buf);
     jsonifySensorConfig(SENSOR_BOILER, F("uid"), buf, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
     readSensorUID(SENSOR_MIX, uid);
     uid2str(uid, buf);
     jsonifySensorConfig(SENSOR_MIX, F("uid"), buf, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
     readSensorUID(SENSOR_SB_HEATER, uid);
     uid2str(uid, buf);
     jsonifySensorConfig(SENSOR_SB_HEATER, F("uid"), buf, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
     readSensorUID(SENSOR_SOLAR_SECONDARY, uid);
     uid2str(uid, buf);
     jsonifySensorConfig(SENSOR_SOLAR_SECONDARY, F("uid"), buf, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
 
     jsonifySensorConfig(SENSOR_TH_ROOM1_PRIMARY_HEATER, F("v"), readSensorTH(SENSOR_TH_ROOM1_PRIMARY_HEATER), json,
             JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
     jsonifySensorConfig(SENSOR_TH_ROOM1_SB_HEATER, F("v"), readSensorTH(SENSOR_TH_ROOM1_SB_HEATER), json,
             JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
 
     jsonifyConfig(F("rap"), WIFI_REMOTE_AP, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
-    jsonifyConfig(F("rpw"), WIFI_REMOTE_PW, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
+    if (secrets) {
+        jsonifyConfig(F("rpw"), WIFI_REMOTE_PW, json, JSON_MAX_SIZE);
+        out(json);
+    }
     jsonifyConfig(F("lap"), WIFI_LOCAL_AP, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
-    jsonifyConfig(F("lpw"), WIFI_LOCAL_PW, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
+    if (secrets) {
+        jsonifyConfig(F("lpw"), WIFI_LOCAL_PW, json, JSON_MAX_SIZE);
+        out(json);
+    }
 
     sprintf(buf, "%d.%d.%d.%d", SERVER_IP[0], SERVER_IP[1], SERVER_IP[2], SERVER_IP[3]);
     jsonifyConfig(F("sip"), buf, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
     jsonifyConfig(F("sp"), SERVER_PORT, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
+    out(json);
     sprintf(buf, "%d.%d.%d.%d", WIFI_STA_IP[0], WIFI_STA_IP[1], WIFI_STA_IP[2], WIFI_STA_IP[3]);
     jsonifyConfig(F("lip"), buf, json, JSON_MAX_SIZE);
-    serial->println(json);
-    bt->println(json);
-    dbgf(debug, F(":EEPROM:written:%d bytes\n"), eepromWriteCount);
+    out(json);
 }
 
 void reportTimestamp() {
@@ -1725,42 +1840,114 @@ void reportTimestamp() {
 /*========================= Communication ===================================*/
 
 void processSerialMsg() {
-    char buff[JSON_MAX_SIZE + 1];
-    while (serial->available()) {
-        uint16_t l = serial->readBytesUntil('\0', buff, JSON_MAX_SIZE);
-        buff[l] = '\0';
-        parseCommand(buff);
+    uint16_t overruns = framerOverruns(serialFramer);
+    while (framerRead(serialFramer, serial) > 0) {
+        parseCommand(serialFrame);
+    }
+    if (framerOverruns(serialFramer) != overruns) {
+        dbgf(debug, F(":serial:overrun:%u\n"), framerOverruns(serialFramer));
     }
 }
 
 void processBtMsg() {
-    char buff[JSON_MAX_SIZE + 1];
-    while (bt->available()) {
-        uint16_t l = bt->readBytesUntil('\0', buff, JSON_MAX_SIZE);
-        buff[l] = '\0';
-        parseCommand(buff);
+    uint16_t overruns = framerOverruns(btFramer);
+    while (framerRead(btFramer, bt) > 0) {
+        parseCommand(btFrame);
+    }
+    if (framerOverruns(btFramer) != overruns) {
+        dbgf(debug, F(":bt:overrun:%u\n"), framerOverruns(btFramer));
     }
 }
 
 void processWifiMsg() {
     char buff[JSON_MAX_SIZE + 1];
     unsigned long start = millis();
-    uint8_t l = esp8266.receive(buff, JSON_MAX_SIZE);
-    if (l > 0) {
-        dbgf(debug, F(":HTTP:receive:%d bytes:[%d msec]\n"), l, millis() - start);
+    switch (esp8266.request(buff, JSON_MAX_SIZE)) {
+    case ROUTE_ROOT:
+    case ROUTE_CMD:
+        dbgf(debug, F(":HTTP:receive:%d bytes:[%d msec]\n"), strlen(buff), millis() - start);
+        wifiReply[0] = '\0';
         parseCommand(buff);
+        esp8266.respond(wifiReply[0] ? wifiReply : NULL);
+        break;
+    case ROUTE_STATUS:
+        esp8266.respondItems(statusItems);
+        dbgf(debug, F(":HTTP:status:[%d msec]\n"), millis() - start);
+        break;
+    case ROUTE_CONFIG:
+        esp8266.getStaIP(WIFI_STA_IP);
+        esp8266.respondItems(configItems);
+        dbgf(debug, F(":HTTP:config:[%d msec]\n"), millis() - start);
+        break;
+    default:
+        break;
+    }
+}
+
+// snapshot of GET /status: all entries reportStatus() goes through
+void statusItems(void (*out)(const char*)) {
+    for (uint8_t entry = SENSOR_SUPPLY; entry != 0;) {
+        entry = reportStatusEntry(entry, out);
     }
 }
 
+// GET /config is open to LAN, passwords are not in it
+void configItems(void (*out)(const char*)) {
+    reportConfiguration(out, false);
+}
+
+#ifdef WIFI_MQTT_PORT
+// commands published to hk/<node>/cmd
+void processMqttMsg(const char* topic, char* payload) {
+    dbgf(debug, F(":MQTT:receive:%s\n"), topic);
+    parseCommand(payload);
+}
+#endif
+
 void broadcastMsg(const char* msg) {
+    PROBE_SCOPE(PROBE_BROADCAST);
     serial->println(msg);
     bt->println(msg);
     unsigned long start = millis();
+#if defined(WIFI_MQTT_PORT)
+    // to broker, state is retained on hk/<node>/s/<id> and hk/<node>/n/<id>
+    int status = mqttReport(msg);
+#elif defined(WIFI_UPLINK_PORT)
+    // to logserver collector over persistent connection
+    int status = esp8266.stream(SERVER_IP, WIFI_UPLINK_PORT, msg);
+#else
     int status = esp8266.send(SERVER_IP, SERVER_PORT, msg);
+#endif
     dbgf(debug, F(":HTTP:send:%d:[%d msec]\n"), status, millis() - start);
 }
 
+void reportMsg(const char* msg) {
+#ifdef WIFI_TELEMETRY_PORT
+    PROBE_SCOPE(PROBE_BROADCAST);
+    serial->println(msg);
+    bt->println(msg);
+    unsigned long start = millis();
+    int status = esp8266.datagram(SERVER_IP, WIFI_TELEMETRY_PORT, msg);
+    dbgf(debug, F(":UDP:send:%d:[%d msec]\n"), status, millis() - start);
+#else
+    broadcastMsg(msg);
+#endif
+}
+
+// to serial and BT only
+void printMsg(const char* msg) {
+    serial->println(msg);
+    bt->println(msg);
+}
+
+// response to HTTP request being processed
+void replyMsg(const char* msg) {
+    strncpy(wifiReply, msg, JSON_MAX_SIZE - 1);
+    wifiReply[JSON_MAX_SIZE - 1] = '\0';
+}
+
 bool parseCommand(char* command) {
+    PROBE_SCOPE(PROBE_PARSE_COMMAND);
     dbgf(debug, F(":parse cmd:%s\n"), command);
 
     if (strstr(command, "AT") == command) {
@@ -1782,13 +1969,13 @@ bool parseCommand(char* command) {
             if (root.containsKey(F("s"))) {
                 JsonObject& sensor = root[F("s")];
                 uint8_t id = sensor[F("id")].as<uint8_t>();
-                int8_t val = sensor[F("v")].as<int8_t>();
+                double val = sensor[F("v")].as<double>();
                 // find sensor
                 if (id == SENSOR_TEMP_ROOM_1) {
-                    tempRoom1 = val;
+                    tempRoom1 = (int16_t) ((val > 0) ? val * 10 + 0.5 : val * 10 - 0.5);
                     tsLastSensorTempRoom1 = tsCurr;
                 } else if (id == SENSOR_HUM_ROOM_1) {
-                    humRoom1 = val;
+                    humRoom1 = (int8_t) ((val > 0) ? val + 0.5 : val - 0.5);
                     tsLastSensorHumRoom1 = tsCurr;
                 } // else if(...)
             } else {
@@ -1822,6 +2009,10 @@ bool parseCommand(char* command) {
                     uint8_t id = sensor[F("id")].as<uint8_t>();
                     double cf = sensor[F("cf")].as<double>();
                     saveSensorCF(id, cf);
+                } else if (sensor.containsKey(F("id")) && sensor.containsKey(F("co"))) {
+                    uint8_t id = sensor[F("id")].as<uint8_t>();
+                    int16_t co = sensor[F("co")].as<int16_t>();
+                    saveSensorCO(id, co);
                 } else if (sensor.containsKey(F("id")) && sensor.containsKey(F("uid"))) {
                     uint8_t id = sensor[F("id")].as<uint8_t>();
                     DeviceAddress uid;
@@ -1866,8 +2057,13 @@ bool parseCommand(char* command) {
                     debug = bt;
                 }
                 esp8266.setDebug(debug);
+#ifdef WIFI_MQTT_PORT
+                mqttSetDebug(debug);
+#endif
             } else {
-                reportConfiguration();
+                esp8266.getStaIP(WIFI_STA_IP);
+                reportConfiguration(printMsg, true);
+                dbgf(debug, F(":EEPROM:written:%d bytes\n"), eepromWriteCount);
             }
         }
     } else {
@@ -43,11 +43,17 @@ bool room1TempSatisfyMaxThreshold();
 
 double readSensorCF(const uint8_t sensor);
 void saveSensorCF(const uint8_t sensor, const double value);
+int16_t readSensorCO(const uint8_t sensor);
+void saveSensorCO(const uint8_t sensor, const int16_t value);
+void loadSensorsCalibration();
+void loadSensorCalibration(const uint8_t sensor);
 void readSensorUID(const uint8_t sensor, DeviceAddress uid);
 void saveSensorUID(const uint8_t sensor, const DeviceAddress uid);
 int16_t readSensorTH(const uint8_t sensor);
 void saveSensorTH(const uint8_t sensor, const int16_t value);
+int sensorIdx(const uint8_t sensor);
 int sensorCfOffset(const uint8_t sensor);
+int sensorCoOffset(const uint8_t sensor);
 int sensorUidOffset(const uint8_t sensor);
 int sensorThOffset(const uint8_t sensor);
 void restoreNodesState();
@@ -58,18 +64,25 @@ void uid2str(const DeviceAddress *uid, char *str);
 
 void searchSensors();
 void readSensors();
-int8_t getSensorValue(const uint8_t sensor);
+int16_t getSensorValue(const uint8_t sensor);
 int8_t getSensorBoilerPowerState();
 bool validSensorValues(const int16_t values[], const uint8_t size);
 
 void reportStatus();
-void reportConfiguration();
+uint8_t reportStatusEntry(uint8_t entry, void (*out)(const char*));
+void reportConfiguration(void (*out)(const char*), bool secrets);
 void reportTimestamp();
 
 void processSerialMsg();
 void processBtMsg();
 void processWifiMsg();
+void statusItems(void (*out)(const char*));
+void configItems(void (*out)(const char*));
+void processMqttMsg(const char* topic, char* payload);
 void broadcastMsg(const char* msg);
+void reportMsg(const char* msg);
+void printMsg(const char* msg);
+void replyMsg(const char* msg);
 bool parseCommand(char* command);
 
 unsigned long getTimestamp();
@@ -1,5 +1,31 @@
 #include "ACS712.h"
 
+#ifdef SREG
+#define ATOMIC_BEGIN uint8_t oldSREG = SREG; cli()
+#define ATOMIC_END SREG = oldSREG
+#else
+#define ATOMIC_BEGIN
+#define ATOMIC_END
+#endif
+
+static uint16_t isqrt(uint32_t v) {
+	uint32_t res = 0;
+	uint32_t bit = 1UL << 30;
+	while (bit > v) {
+		bit >>= 2;
+	}
+	while (bit) {
+		if (v >= res + bit) {
+			v -= res + bit;
+			res = (res >> 1) + bit;
+		} else {
+			res >>= 1;
+		}
+		bit >>= 2;
+	}
+	return res;
+}
+
 ACS712::ACS712(ACS712_type type, uint8_t _pin) {
 	pin = _pin;
 
@@ -15,6 +41,7 @@ ACS712::ACS712(ACS712_type type, uint8_t _pin) {
 			sensitivity = 0.066;
 			break;
 	}
+	updateScale();
 }
 
 int ACS712::calibrate() {
@@ -32,6 +59,11 @@ void ACS712::setZeroPoint(int _zero) {
 
 void ACS712::setSensitivity(float sens) {
 	sensitivity = sens;
+	updateScale();
+}
+
+void ACS712::updateScale() {
+	mAPerCountQ8 = VREF * 1000 / ADC_SCALE / sensitivity * 256 + 0.5;
 }
 
 float ACS712::getCurrentDC() {
@@ -58,4 +90,55 @@ float ACS712::getCurrentAC(uint16_t frequency) {
 
 	float Irms = sqrt(Isum / measurements_count) / ADC_SCALE * VREF / sensitivity;
 	return Irms;
-}
\ No newline at end of file
+}
+
+void ACS712::setWindow(uint16_t samples) {
+	ATOMIC_BEGIN;
+	window = max(samples, (uint16_t)2);
+	// tracking starts from configured zero point
+	zeroQ16 = (int32_t)zero << 16;
+	count = 0;
+	sumSq = 0;
+	lastCount = 0;
+	ATOMIC_END;
+}
+
+void ACS712::sample(uint16_t value) {
+	// low pass zero point. time constant spans many mains periods, so ripple
+	// is small while slow sensor and supply drift is followed
+	int32_t z = zeroQ16;
+	z += (((int32_t)value << 16) - z) >> ZERO_TRACKING_SHIFT;
+	zeroQ16 = z;
+	// deviation from zero point in 1/4 count
+	int16_t d = ((int16_t)value << 2) - (int16_t)((z + (1L << 13)) >> 14);
+	sumSq += (uint32_t)((int32_t)d * d);
+	if (++count >= window) {
+		lastCount = count;
+		lastSumSq = sumSq;
+		count = 0;
+		sumSq = 0;
+	}
+}
+
+bool ACS712::hasCurrentAC() {
+	return lastCount > 0;
+}
+
+uint16_t ACS712::getCurrentACmA() {
+	ATOMIC_BEGIN;
+	uint16_t n = lastCount;
+	uint64_t sq = lastSumSq;
+	int32_t z = zeroQ16;
+	ATOMIC_END;
+	zero = (z + (1L << 15)) >> 16;
+	if (n == 0) {
+		return 0;
+	}
+	// mean square in 1/256 count^2 for sqrt in Q4
+	uint32_t rmsQ4 = isqrt(sq * 16 / n);
+	return (rmsQ4 * mAPerCountQ8 + (1UL << 11)) >> 12;
+}
+
+int ACS712::getZeroPoint() {
+	return zero;
+}
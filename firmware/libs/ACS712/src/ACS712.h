@@ -6,6 +6,8 @@
 #define ADC_SCALE 1023.0
 #define VREF 5.0
 #define DEFAULT_FREQUENCY 50
+#define DEFAULT_WINDOW 1024 // background samples per RMS window
+#define ZERO_TRACKING_SHIFT 8 // zero point filter time constant, 2^n samples
 
 enum ACS712_type {ACS712_05B, ACS712_20A, ACS712_30A};
 
@@ -18,10 +20,32 @@ public:
 	float getCurrentDC();
 	float getCurrentAC(uint16_t frequency = 50);
 
+	// Background measurement: sample() is fed with every ADC reading of the
+	// pin (e.g. from conversion complete interrupt). Zero point follows the
+	// signal mean continuously, RMS is taken over a window of samples.
+	// Readers never wait for ADC.
+	void setWindow(uint16_t samples);
+	void sample(uint16_t value);
+	bool hasCurrentAC();
+	uint16_t getCurrentACmA();
+	int getZeroPoint();
+
 private:
 	int zero = 512;
 	float sensitivity;
 	uint8_t pin;
+
+	uint32_t mAPerCountQ8; // mA per ADC count, Q8
+	uint16_t window = DEFAULT_WINDOW;
+	// ISR side: zero point Q16, window in progress, squares in 1/16 count^2
+	volatile int32_t zeroQ16 = 512L << 16;
+	volatile uint16_t count = 0;
+	volatile uint64_t sumSq = 0;
+	// last complete window
+	volatile uint16_t lastCount = 0;
+	volatile uint64_t lastSumSq = 0;
+
+	void updateScale();
 };
 
 #endif
\ No newline at end of file
@@ -1,4 +1,4 @@
-/* DHT library 
+/* DHT library
 
 MIT license
 written by Adafruit Industries
@@ -6,10 +6,16 @@ written by Adafruit Industries
 
 #include "DHT.h"
 
+// one transaction at a time, so a single edge interrupt handler is enough
+DHT *DHT::active = NULL;
+
 DHT::DHT(uint8_t pin, uint8_t type) {
   _pin = pin;
   _type = type;
   firstreading = true;
+  state = DHT_IDLE;
+  failures = 0;
+  valid = false;
 }
 
 void DHT::begin(void) {
@@ -22,7 +28,7 @@ void DHT::begin(void) {
 float DHT::readTemperature(void) {
   float f;
 
-  if (read()) {
+  if (valid) {
     switch (_type) {
     case DHT11:
       f = data[2];
@@ -45,7 +51,7 @@ float DHT::readTemperature(void) {
 
 float DHT::readHumidity(void) {
   float f;
-  if (read()) {
+  if (valid) {
     switch (_type) {
     case DHT11:
       f = data[0];
@@ -63,88 +69,145 @@ float DHT::readHumidity(void) {
   return NAN;
 }
 
+boolean DHT::busy(void) {
+  return state != DHT_IDLE;
+}
 
-boolean DHT::read(void) {
-  uint8_t laststate = HIGH;
-  uint8_t counter = 0;
-  uint8_t j = 0, i;
-  unsigned long currenttime;
+// returns true when a new good measurement is stored
+boolean DHT::update(void) {
+  unsigned long currenttime = millis();
 
-  // pull the pin high and wait 250 milliseconds
-  digitalWrite(_pin, HIGH);
-  delay(250);
+  switch (state) {
+  case DHT_IDLE:
+    if (active != NULL) {
+      // other sensor is in the middle of transaction
+      return false;
+    }
+    if (!firstreading && ((currenttime - _lastreadtime) < DHT_READ_INTERVAL)) {
+      return false;
+    }
+    firstreading = false;
+    _lastreadtime = currenttime;
+    active = this;
+
+    // pull it low for ~20 milliseconds, come back when it's over
+    pinMode(_pin, OUTPUT);
+    digitalWrite(_pin, LOW);
+    state = DHT_START;
+    return false;
+
+  case DHT_START:
+    if ((currenttime - _lastreadtime) < DHT_START_LOW) {
+      return false;
+    }
+    release();
+#ifdef DHT_USE_INTERRUPTS
+    if (digitalPinToInterrupt(_pin) != NOT_AN_INTERRUPT) {
+      state = DHT_FRAME;
+      return false;
+    }
+#endif
+    pollFrame();
+    break;
 
-  currenttime = millis();
-  if (currenttime < _lastreadtime) {
-    // ie there was a rollover
-    _lastreadtime = 0;
+  case DHT_FRAME:
+    if (falls < 42 && (currenttime - _lastreadtime) < DHT_START_LOW + DHT_FRAME_TIMEOUT) {
+      return false;
+    }
+#ifdef DHT_USE_INTERRUPTS
+    detachInterrupt(digitalPinToInterrupt(_pin));
+#endif
+    break;
   }
-  if (!firstreading && ((currenttime - _lastreadtime) < 2000)) {
-    return true; // return last correct measurement
-    //delay(2000 - (currenttime - _lastreadtime));
+
+  finish();
+  return valid && failures == 0;
+}
+
+void DHT::release(void) {
+  frame[0] = frame[1] = frame[2] = frame[3] = frame[4] = 0;
+  falls = 0;
+  lastEdge = micros();
+#ifdef DHT_USE_INTERRUPTS
+  if (digitalPinToInterrupt(_pin) != NOT_AN_INTERRUPT) {
+    attachInterrupt(digitalPinToInterrupt(_pin), edgeISR, CHANGE);
   }
-  firstreading = false;
-  /*
-    Serial.print("Currtime: "); Serial.print(currenttime);
-    Serial.print(" Lasttime: "); Serial.print(_lastreadtime);
-  */
-  _lastreadtime = millis();
-
-  data[0] = data[1] = data[2] = data[3] = data[4] = 0;
-  
-  // now pull it low for ~20 milliseconds
-  pinMode(_pin, OUTPUT);
-  digitalWrite(_pin, LOW);
-  delay(20);
-  cli();
+#endif
   digitalWrite(_pin, HIGH);
-  delayMicroseconds(40);
   pinMode(_pin, INPUT);
+}
 
-  // read in timings
-  for ( i=0; i< MAXTIMINGS; i++) {
-    counter = 0;
-    while (digitalRead(_pin) == laststate) {
-      counter++;
-      delayMicroseconds(1);
-      if (counter == 255) {
-        break;
-      }
-    }
-    laststate = digitalRead(_pin);
+void DHT::edgeISR(void) {
+  if (active != NULL) {
+    active->edge(digitalRead(active->_pin) == HIGH, micros());
+  }
+}
 
-    if (counter == 255) break;
+// sensor answers with 80us low, 80us high, then each bit is 50us low and
+// 26-28us (0) or 70us (1) high. bit value is taken on falling edge
+void DHT::edge(boolean high, unsigned long now) {
+  if (high) {
+    lastEdge = now;
+    return;
+  }
+  uint8_t f = falls;
+  if (f >= 2 && f < 42) {
+    uint8_t j = f - 2;
+    frame[j / 8] <<= 1;
+    if (now - lastEdge > DHT_BIT_THRESHOLD)
+      frame[j / 8] |= 1;
+  }
+  falls = f + 1;
+}
 
-    // ignore first 3 transitions
-    if ((i >= 4) && (i%2 == 0)) {
-      // shove each bit into the storage bytes
-      data[j/8] <<= 1;
-      if (counter > 6)
-        data[j/8] |= 1;
-      j++;
+// pin without interrupt: poll the frame with interrupts disabled, as any
+// handler longer than ~20us (ADC sampling, stepper timer, SoftwareSerial RX)
+// breaks bit timing. micros() loses timer0 overflows meanwhile and wraps every
+// DHT_CLOCK_WRAP us, elapsed time is summed from short steps instead
+void DHT::pollFrame(void) {
+  uint8_t laststate = HIGH;
+  unsigned long prev = micros();
+  unsigned long now = 0;
+  unsigned long lastchange = 0;
+  cli();
+  while (falls < 42) {
+    uint8_t s = digitalRead(_pin);
+    unsigned long t = micros();
+    now += (t - prev) % DHT_CLOCK_WRAP;
+    prev = t;
+    if (s != laststate) {
+      laststate = s;
+      lastchange = now;
+      edge(s == HIGH, now);
+    } else if (now - lastchange > DHT_PULSE_TIMEOUT) {
+      // sensor is silent or frame is broken
+      break;
     }
-
   }
-
   sei();
-  
-  /*
-  Serial.println(j, DEC);
-  Serial.print(data[0], HEX); Serial.print(", ");
-  Serial.print(data[1], HEX); Serial.print(", ");
-  Serial.print(data[2], HEX); Serial.print(", ");
-  Serial.print(data[3], HEX); Serial.print(", ");
-  Serial.print(data[4], HEX); Serial.print(" =? ");
-  Serial.println(data[0] + data[1] + data[2] + data[3], HEX);
-  */
+}
+
+void DHT::finish(void) {
+  state = DHT_IDLE;
+  active = NULL;
+  digitalWrite(_pin, HIGH);
 
   // check we read 40 bits and that the checksum matches
-  if ((j >= 40) && 
-      (data[4] == ((data[0] + data[1] + data[2] + data[3]) & 0xFF)) ) {
-    return true;
+  if ((falls >= 42) &&
+      (frame[4] == ((frame[0] + frame[1] + frame[2] + frame[3]) & 0xFF)) ) {
+    for (uint8_t i = 0; i < 5; i++) {
+      data[i] = frame[i];
+    }
+    valid = true;
+    failures = 0;
+    return;
   }
-  
-
-  return false;
 
+  // keep last good value for a while, sensor may be just disturbed
+  if (failures < DHT_MAX_FAILURES) {
+    failures++;
+  }
+  if (failures >= DHT_MAX_FAILURES) {
+    valid = false;
+  }
 }
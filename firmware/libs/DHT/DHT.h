@@ -4,10 +4,17 @@
  #include "WProgram.h"
 #endif
 
-/* DHT library 
+/* DHT library
 
 MIT license
 written by Adafruit Industries
+
+Non-blocking: update() is called from loop(), it starts a transaction every
+DHT_READ_INTERVAL ms and returns right away. Host start signal is timed by
+millis(), sensor bits are timed by external interrupt on the data pin when the
+pin has one, otherwise the frame (~5ms) is polled with interrupts disabled.
+Frame is decoded and checksummed in the background, readers get the last good
+value.
 */
 
 // how many timing transitions we need to keep track of. 2 * number bits + extra
@@ -18,17 +25,48 @@ written by Adafruit Industries
 #define DHT21 21
 #define AM2301 21
 
+#define DHT_READ_INTERVAL 2000 // ms, sensor sampling period
+#define DHT_START_LOW 20 // ms, host start signal
+#define DHT_FRAME_TIMEOUT 10 // ms, response and 40 bits take ~5ms
+#define DHT_PULSE_TIMEOUT 300 // us, longest pulse of the frame is 80us
+#define DHT_BIT_THRESHOLD 48 // us, high pulse of 0 is 26-28us, of 1 is 70us
+#define DHT_CLOCK_WRAP 1024 // us, timer0 overflow period, micros() wraps with interrupts disabled
+#define DHT_MAX_FAILURES 3 // failed reads in a row before value is unknown
+
+#if defined(digitalPinToInterrupt) && defined(NOT_AN_INTERRUPT)
+#define DHT_USE_INTERRUPTS
+#endif
+
 class DHT {
  private:
+  enum { DHT_IDLE, DHT_START, DHT_FRAME };
+
   uint8_t data[6];
   uint8_t _pin, _type;
-  boolean read(void);
   unsigned long _lastreadtime;
   boolean firstreading;
+  uint8_t state;
+  uint8_t failures;
+  boolean valid;
+
+  // frame capture, written from edge interrupt
+  volatile uint8_t frame[5];
+  volatile uint8_t falls;
+  volatile unsigned long lastEdge;
+
+  static DHT *active;
+  static void edgeISR(void);
+
+  void release(void);
+  void edge(boolean high, unsigned long now);
+  void pollFrame(void);
+  void finish(void);
 
  public:
   DHT(uint8_t pin, uint8_t type);
   void begin(void);
+  boolean update(void);
+  boolean busy(void);
   float readTemperature(void);
   float readHumidity(void);
 
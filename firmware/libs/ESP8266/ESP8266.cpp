@@ -3,16 +3,58 @@
  *
  */
 #include "ESP8266.h"
-#include <debug.h>
+#include <log.h>
 
 //#define __DEBUG__
 
 const uint8_t FAILURE_RECONNECTS_MAX_COUNT = 3;
 const unsigned long STA_RECONNECT_INTERVAL = 60000;
+// breaker opens after that many failed requests in a row, backoff doubles on
+// each failed trial
+const uint8_t BREAKER_FAILURES = 3;
+const unsigned long BREAKER_BACKOFF_MIN_MS = 5000;
+const unsigned long BREAKER_BACKOFF_MAX_MS = 300000;
+const unsigned long RECOVER_RESET_PIN_MS = 500;
+const unsigned long RECOVER_BOOT_MS = 3000;
+// ESP gives up joining in about 15s
+const unsigned long RECOVER_JOIN_MS = 20000;
+const uint16_t UPLINK_KEEPALIVE_SEC = 60;
+// silence around "+++" for ESP to take it as passthrough escape
+const uint16_t UPLINK_ESCAPE_GUARD_MS = 20;
+const uint16_t UPLINK_ESCAPE_WAIT_MS = 1000;
+const char IPD_PREFIX[] = "+IPD,";
+
+// HTTP request around Content-Length value, sent from flash as is
+const char HTTP_REQUEST_HEAD[] PROGMEM = "POST / HTTP/1.1\r\n"
+        "User-Agent: ESP8266\r\n"
+        "Accept: */*\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: ";
+const char HTTP_REQUEST_TAIL[] PROGMEM = "\r\nConnection: close\r\n\r\n";
+// headers of response with body, Content-Length value follows
+const char HTTP_RESPONSE_JSON[] PROGMEM = "Content-Type: application/json\r\n"
+        "Content-Length: ";
+const char * const DEFAULT_ROUTES[] = { "POST /" };
+// FNV-1a of ETag
+const uint32_t TAG_OFFSET = 2166136261UL;
+const uint32_t TAG_PRIME = 16777619UL;
 
 const char* esp_response_str[] { "\r\nOK\r\n", "\r\nSEND OK\r\n", "CONNECT\r\n", "\r\nWIFI CONNECTED\r\n", "\r\n>",
         "\r\nERROR\r\n" };
 
+static const char *statusText(const uint16_t httpCode) {
+    switch (httpCode) {
+    case 200:
+        return "OK";
+    case 304:
+        return "NOT MODIFIED";
+    case 404:
+        return "NOT FOUND";
+    default:
+        return "BAD REQUEST";
+    }
+}
+
 #ifdef __DEBUG__
 Stream *defaultDebug = &Serial;
 #else
@@ -27,15 +69,54 @@ const uint8_t TMP_BUFF_SIZE = 64;
 char inBuff[IN_BUFF_SIZE + 1];
 char outBuff[OUT_BUFF_SIZE + 1];
 char tmpBuff[TMP_BUFF_SIZE + 1];
+// streamed response, links keep parsing requests meanwhile
+char replyBuff[ESP_REQUEST_SIZE + 1];
 
 void ESP8266::init(HardwareSerial *port, esp_cwmode mode, uint8_t resetPin, uint16_t failureGracePeriodSec) {
+    initState(port, mode, resetPin, failureGracePeriodSec);
+
+    if (rstPin > 0) {
+        // hardware reset
+        logMsg(debug, WIFI_HW_RESET);
+        digitalWrite(rstPin, LOW);
+        delay(500);
+        digitalWrite(rstPin, HIGH);
+        delay(1000);
+    }
+
+    // reset serial port buffers
+    espSerial->end();
+    espSerial->begin(57600);
+
+    write(F("AT+RST\r\n"), EXPECT_OK, 300);
+    delay(1000);
+    setupMode();
+}
+
+// init() which returns at once: ESP is reset and set up in update() steps.
+// startAP(), connect() and startTcpServer() called meanwhile keep settings for
+// these steps, requests fail until station is up
+void ESP8266::boot(HardwareSerial *port, esp_cwmode mode, uint8_t resetPin, uint16_t failureGracePeriodSec) {
+    initState(port, mode, resetPin, failureGracePeriodSec);
+    breaker = BREAKER_OPEN;
+    backoff = 0;
+    tcpServerPort = recoveryPort = 0;
+    recoveryRestart();
+}
+
+void ESP8266::initState(HardwareSerial *port, esp_cwmode mode, uint8_t resetPin, uint16_t failureGracePeriodSec) {
     if (!persistDebug) {
         debug = defaultDebug;
     }
 
-    dbg(debug, F(":wifi:init\n"));
+    logMsg(debug, WIFI_INIT);
 
     espSerial = port;
+    if (uplink == UPLINK_PASSTHROUGH) {
+        // AT commands are not seen in passthrough
+        escape();
+    }
+    uplink = UPLINK_CLOSED;
     cwMode = mode;
     rstPin = resetPin;
     failureGracePeriod = (unsigned long) failureGracePeriodSec * 1000;
@@ -43,27 +124,33 @@ void ESP8266::init(HardwareSerial *port, esp_cwmode mode, uint8_t resetPin, uint
     staIp[0] = staIp[1] = staIp[2] = staIp[3] = 0;
     connectTs = 0;
     reconnectCount = 0;
+    breaker = BREAKER_CLOSED;
+    failures = 0;
+    recoverPending = false;
+    recovery = RECOVER_IDLE;
+    resetState();
+}
 
-    if (rstPin > 0) {
-        // hardware reset
-        dbg(debug, F(":wifi:hwReset\n"));
-        digitalWrite(rstPin, LOW);
-        delay(500);
-        digitalWrite(rstPin, HIGH);
-        delay(1000);
+// state of links and input demultiplexer, ESP restarts with none
+void ESP8266::resetState() {
+    for (uint8_t id = 0; id < ESP_SERVER_LINKS; id++) {
+        linkReset(id, LINK_IDLE);
     }
+    ipdLeft = 0;
+    clientHead = clientLen = 0;
+    clientOverrun = false;
+    noticeLen = releasePos = releaseLen = 0;
+    lineLen = 0;
+    replyId = -1;
+}
 
-    // reset serial port buffers
-    espSerial->end();
-    espSerial->begin(57600);
-
-    write(F("AT+RST\r\n"), EXPECT_OK, 300);
-    delay(1000);
+void ESP8266::setupMode() {
     write(F("AT+CIPMODE=0\r\n"), EXPECT_OK, 300);
-    snprintf(outBuff, OUT_BUFF_SIZE, "AT+CWMODE_CUR=%d\r\n", mode);
+    snprintf(outBuff, OUT_BUFF_SIZE, "AT+CWMODE_CUR=%d\r\n", cwMode);
     write(outBuff, EXPECT_OK, 300);
     write(F("AT+CIPMUX=1\r\n"), EXPECT_OK, 300);
-    write(F("AT+CIPSERVERMAXCONN=1\r\n"), EXPECT_OK, 300);
+    snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPSERVERMAXCONN=%d\r\n", ESP_SERVER_LINKS);
+    write(outBuff, EXPECT_OK, 300);
 }
 
 void ESP8266::setDebug(Stream *port) {
@@ -75,15 +162,15 @@ void ESP8266::startAP(const esp_config_t *ssid, const esp_config_t *password) {
     apSsid = (esp_config_t*) ssid;
     apPassword = (esp_config_t*) password;
 
-    if (ssid) {
+    if (ssid && recovery == RECOVER_IDLE) {
         if (cwMode == MODE_AP || cwMode == MODE_STA_AP) {
             // SSID, password, channel, enc_type, max_conn, hidden
             snprintf(outBuff, OUT_BUFF_SIZE, "AT+CWSAP_CUR=\"%s\",\"%s\",%d,%d,%d,%d\r\n", (char*) ssid,
                     (char*) password, 3, 2, 4, 0);
             if (write(outBuff, EXPECT_OK, 1000)) {
-                dbgf(debug, F(":wifi:AP:start:OK:%s\n"), ssid);
+                logMsg(debug, WIFI_AP_START_OK, (const char*) ssid);
             } else {
-                dbg(debug, F(":wifi:AP:start:FAIL:%s\n"));
+                logMsg(debug, WIFI_AP_START_FAIL, (const char*) ssid);
             }
         }
     }
@@ -93,14 +180,14 @@ void ESP8266::connect(const esp_config_t *ssid, const esp_config_t *password) {
     staSsid = (esp_config_t*) ssid;
     staPassword = (esp_config_t*) password;
 
-    if (ssid) {
+    if (ssid && recovery == RECOVER_IDLE) {
         if (cwMode == MODE_STA || cwMode == MODE_STA_AP) {
             // SSID, password
             snprintf(outBuff, OUT_BUFF_SIZE, "AT+CWJAP_CUR=\"%s\",\"%s\"\r\n", (char*) ssid, (char*) password);
             if (write(outBuff, EXPECT_WIFI_CONNECTED, 5000)) {
-                dbgf(debug, F(":wifi:STA:conn:OK:%s\n"), ssid);
+                logMsg(debug, WIFI_STA_CONN_OK, (const char*) ssid);
             } else {
-                dbgf(debug, F(":wifi:STA:conn:FAIL:%s\n"), ssid);
+                logMsg(debug, WIFI_STA_CONN_FAIL, (const char*) ssid);
             }
             waitUntilBusy(15000, 5);
             readStaIp(staIp);
@@ -115,15 +202,16 @@ void ESP8266::disconnect() {
 
     if (cwMode == MODE_STA || cwMode == MODE_STA_AP) {
         if (write(F("AT+CWQAP\r\n"), EXPECT_OK, 1000)) {
-            dbg(debug, F(":wifi:STA:disconn:OK\n"));
+            logMsg(debug, WIFI_STA_DISCONN_OK);
         } else {
-            dbg(debug, F(":wifi:STA:disconn:FAIL\n"));
+            logMsg(debug, WIFI_STA_DISCONN_FAIL);
         }
         staIp[0] = staIp[1] = staIp[2] = staIp[3] = 0;
     }
 }
 
 void ESP8266::reconnect() {
+    closeUplink();
     esp_config_t *ssid = staSsid;
     esp_config_t *password = staPassword;
     uint16_t port = tcpServerPort;
@@ -143,32 +231,48 @@ bool ESP8266::getStaIP(esp_ip_t ip) {
 }
 
 void ESP8266::startTcpServer(const uint16_t port) {
+    if (recovery != RECOVER_IDLE) {
+        // started when station is up
+        recoveryPort = port;
+        return;
+    }
     tcpServerPort = port;
     if (tcpServerPort > 0) {
         snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPSERVER=1,%d\r\n", tcpServerPort);
         if (write(outBuff, EXPECT_OK, 600, 3)) {
             write(F("AT+CIPSTO=10\r\n"), EXPECT_OK);
-            dbgf(debug, F(":wifi:TCP_SRV:up:%d\n"), tcpServerPort);
+            logMsg(debug, WIFI_TCP_SRV_UP, tcpServerPort);
         } else {
-            dbg(debug, F(":wifi:TCP_SRV:up:FAIL\n"));
+            logMsg(debug, WIFI_TCP_SRV_UP_FAIL);
         }
     }
 }
 
+void ESP8266::setRoutes(const char * const *table, const uint8_t count) {
+    routes = table;
+    routeCount = count;
+}
+
 void ESP8266::stopTcpServer() {
     if (tcpServerPort > 0) {
         if (write(F("AT+CIPSERVER=0\r\n"), EXPECT_OK, 600, 3)) {
-            dbg(debug, F(":wifi:TCP_SRV:down:OK\n"));
+            logMsg(debug, WIFI_TCP_SRV_DOWN_OK);
         } else {
-            dbg(debug, F(":wifi:TCP_SRV:down:FAIL\n"));
+            logMsg(debug, WIFI_TCP_SRV_DOWN_FAIL);
         }
     }
     tcpServerPort = 0;
 }
 
 int16_t ESP8266::send(const esp_ip_t dstIP, const uint16_t dstPort, const char* message) {
+    if (!breakerAllows()) {
+        return -1;
+    }
+    // uplink holds client link
+    closeUplink();
     int16_t status = httpSend(dstIP, dstPort, message);
-    dbgf(debug, F(":wifi:send:%d:%s\n"), status, message);
+    logMsg(debug, WIFI_SEND, status, message);
+    logFlush(debug);
     if (status == 0) {
         dropConnection();
     }
@@ -178,39 +282,161 @@ int16_t ESP8266::send(const esp_ip_t dstIP, const uint16_t dstPort, const char*
     return status;
 }
 
-size_t ESP8266::receive(char* message, size_t msize) {
-    uint16_t status = httpReceive(message, msize);
-    dbgf(debug, F(":wifi:receive:%d:%s\n"), status, message);
-    if (status == 0) {
-        dropConnection();
+int16_t ESP8266::stream(const esp_ip_t dstIP, const uint16_t dstPort, const char* message) {
+    int16_t status = -1;
+    if (!breakerAllows()) {
+        return status;
+    }
+    if (uplink == UPLINK_UDP) {
+        closeUplink();
+    }
+    if (uplink != UPLINK_CLOSED || openUplink(dstIP, dstPort)) {
+        status = sendFrame(message);
+        if (status <= 0 && uplink == UPLINK_LINK) {
+            // collector may have dropped the connection, try a fresh one
+            closeUplink();
+            if (openUplink(dstIP, dstPort)) {
+                status = sendFrame(message);
+            }
+        }
+    }
+    logMsg(debug, WIFI_STREAM, status, message);
+    logFlush(debug);
+    if (status <= 0) {
+        closeUplink();
+        errorsRecovery();
+    }
+    return status;
+}
+
+// telemetry which may get lost: no handshake, no response. fits periodic
+// status, a lost report is replaced by the next one. message (JSON object)
+// gets sequence number "q" and count of local send failures "qf", so receiver
+// counts lost datagrams
+int16_t ESP8266::datagram(const esp_ip_t dstIP, const uint16_t dstPort, const char* message) {
+    int16_t status = -1;
+    uint16_t seq = udpSeq++;
+    if (!breakerAllows()) {
+        // counted, so the gap shows up as a local failure
+        udpFailed++;
+        return status;
+    }
+    if (uplink != UPLINK_UDP) {
+        closeUplink();
     }
+    if (message[0] == '{' && (uplink == UPLINK_UDP || openUdp(dstIP, dstPort))) {
+        status = 0;
+        snprintf(inBuff, IN_BUFF_SIZE, "{\"q\":%u,\"qf\":%u%s", seq, udpFailed, message[1] == '}' ? "" : ",");
+        uint16_t length = strlen(inBuff) + strlen(message) - 1;
+        snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPSEND=4,%u\r\n", length);
+        if (write(outBuff, EXPECT_PROMPT)) {
+            logMsg(debug, WIFI_OUT, message);
+            espSerial->print(inBuff);
+            espSerial->print(message + 1);
+            esp_matcher_t m;
+            matcherInit(m);
+            matcherAdd(m, F("SEND OK"));
+            matcherAdd(m, F("SEND FAIL"));
+            matcherAdd(m, F("ERROR"));
+            if (readUntil(inBuff, IN_BUFF_SIZE, m) == 0) {
+                status = strlen(message);
+                requestSucceeded();
+            }
+        }
+    }
+    logMsg(debug, WIFI_DATAGRAM, status, seq, message);
+    logFlush(debug);
+    if (status <= 0) {
+        udpFailed++;
+        closeUplink();
+        errorsRecovery();
+    }
+    return status;
+}
+
+uint16_t ESP8266::datagramsSent() {
+    return udpSeq;
+}
+
+uint16_t ESP8266::datagramsFailed() {
+    return udpFailed;
+}
+
+void ESP8266::closeUplink() {
+    if (uplink == UPLINK_PASSTHROUGH) {
+        escape();
+        restoreMux();
+    } else if (uplink == UPLINK_LINK || uplink == UPLINK_UDP || uplink == UPLINK_CLIENT) {
+        write(F("AT+CIPCLOSE=4\r\n"), EXPECT_OK);
+    }
+    if (uplink != UPLINK_CLOSED) {
+        logMsg(debug, WIFI_UPLINK_CLOSE);
+    }
+    uplink = UPLINK_CLOSED;
+}
+
+size_t ESP8266::receive(char* message, size_t msize) {
+    request(message, msize);
     return strlen(message);
 }
 
-int ESP8266::available() {
+int8_t ESP8266::request(char* message, size_t msize) {
+    int8_t taken = httpReceive(message, msize);
+    logMsg(debug, WIFI_RECEIVE, (int) taken, message);
+    logFlush(debug);
+    return taken;
+}
+
+// answers the request taken by the last receive(). body (JSON) goes into
+// response as is, NULL gives response without body
+void ESP8266::respond(const char *body) {
     if (!espSerial) {
+        return;
+    }
+    for (uint8_t id = 0; id < ESP_SERVER_LINKS; id++) {
+        if (links[id].state == LINK_REPLY) {
+            sendResponse(id, 200, body);
+        }
+    }
+}
+
+int ESP8266::available() {
+    if (!espSerial || recovery != RECOVER_IDLE) {
         return 0;
     }
-    return espSerial->available();
+    int n = espSerial->available() + releaseLen - releasePos;
+    for (uint8_t id = 0; id < ESP_SERVER_LINKS; id++) {
+        if (links[id].state == LINK_READY || links[id].state == LINK_RESPOND) {
+            n++;
+        }
+    }
+    return n;
 }
 
 bool ESP8266::write(const char* message, esp_response expectedResponse, const uint16_t ttl, const uint8_t retryCount) {
     if (!espSerial) {
         return false;
     }
+    // records of the previous exchange
+    logFlush(debug);
     for (uint8_t retry = 0; retry < retryCount; retry++) {
-        dbgf(debug, F("wifi:>>%s"), message);
+        logMsg(debug, WIFI_OUT, message);
         if (expectedResponse != EXPECT_NOTHING) {
-            // clear input buffer
-            while (espSerial->read() >= 0)
+            // clear input buffer, requests of server links are kept
+            while (readByte() >= 0)
                 ;
         }
         espSerial->print(message);
         if (expectedResponse != EXPECT_NOTHING) {
-            if (readUntil(tmpBuff, TMP_BUFF_SIZE, esp_response_str[expectedResponse], ttl / retryCount)) {
+            esp_matcher_t m;
+            matcherInit(m);
+            matcherAdd(m, esp_response_str[expectedResponse]);
+            matcherAdd(m, esp_response_str[EXPECT_ERROR]);
+            int8_t found = readUntil(tmpBuff, TMP_BUFF_SIZE, m, ttl / retryCount);
+            if (found == 0) {
                 return true;
             }
-            if (strstr(tmpBuff, esp_response_str[EXPECT_ERROR])) {
+            if (found == 1) {
                 return false;
             }
         } else {
@@ -237,36 +463,138 @@ size_t ESP8266::read(char* buffer, size_t bsize, const uint16_t ttl) {
 }
 
 bool ESP8266::readUntil(char *buffer, size_t bsize, const char *target, const uint16_t ttl) {
-    read(buffer, bsize, target, 0, ttl);
-    return strstr(buffer, target);
+    esp_matcher_t m;
+    matcherInit(m);
+    matcherAdd(m, target);
+    return readUntil(buffer, bsize, m, ttl) == 0;
 }
 
 bool ESP8266::readUntil(char *buffer, size_t bsize, const __FlashStringHelper *target, const uint16_t ttl) {
-    int i = 0;
-    tmpBuff[i] = '\0';
-    PGM_P p = reinterpret_cast<PGM_P>(target);
-    char c;
-    while ((c = pgm_read_byte(p++)) != 0 && i < TMP_BUFF_SIZE) {
-        tmpBuff[i++] = c;
-        tmpBuff[i] = '\0';
-    }
-    return readUntil(buffer, bsize, tmpBuff, ttl);
+    esp_matcher_t m;
+    matcherInit(m);
+    matcherAdd(m, target);
+    return readUntil(buffer, bsize, m, ttl) == 0;
 }
 
 size_t ESP8266::readUntil(char *buffer, const size_t bsize, const size_t length, const uint16_t ttl) {
     return read(buffer, bsize, NULL, length, ttl);
 }
 
+int8_t ESP8266::readUntil(char *buffer, const size_t bsize, esp_matcher_t &matcher, const uint16_t ttl) {
+    matcher.found = -1;
+    read(buffer, bsize, &matcher, 0, ttl);
+    return matcher.found;
+}
+
+/* ================================ Client link ================================ */
+
+// connection for protocol on top of the driver. incoming data is taken from
+// ESP output by any read, outgoing packet is announced with clientBegin()
+bool ESP8266::clientOpen(const esp_ip_t dstIP, const uint16_t dstPort) {
+    if (!breakerAllows()) {
+        return false;
+    }
+    closeUplink();
+    clientHead = clientLen = 0;
+    clientOverrun = false;
+    if ((cwMode != MODE_STA && cwMode != MODE_STA_AP) || !validIP(staIp)) {
+        return false;
+    }
+    snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPSTART=4,\"TCP\",\"%d.%d.%d.%d\",%d,%d\r\n", dstIP[0], dstIP[1], dstIP[2],
+            dstIP[3], dstPort, UPLINK_KEEPALIVE_SEC);
+    write(outBuff);
+    esp_matcher_t m;
+    matcherInit(m);
+    matcherAdd(m, F("4,CONNECT"));
+    matcherAdd(m, F("ALREADY CONNECTED"));
+    matcherAdd(m, F("ERROR"));
+    matcherAdd(m, F("4,CLOSED"));
+    int8_t found = readUntil(inBuff, IN_BUFF_SIZE, m, 3000);
+    if (found == 0 || found == 1) {
+        uplink = UPLINK_CLIENT;
+        logMsg(debug, WIFI_UPLINK_OPEN, uplink);
+        return true;
+    }
+    logMsg(debug, WIFI_UPLINK_FAIL);
+    return false;
+}
+
+bool ESP8266::clientConnected() {
+    clientAvailable();
+    return uplink == UPLINK_CLIENT;
+}
+
+// packet of length bytes follows with clientWrite() calls
+bool ESP8266::clientBegin(const uint16_t length) {
+    if (uplink != UPLINK_CLIENT) {
+        return false;
+    }
+    snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPSEND=4,%u\r\n", length);
+    return write(outBuff, EXPECT_PROMPT);
+}
+
+void ESP8266::clientWrite(const uint8_t *data, const size_t length) {
+    espSerial->write(data, length);
+}
+
+bool ESP8266::clientEnd() {
+    esp_matcher_t m;
+    matcherInit(m);
+    matcherAdd(m, F("SEND OK"));
+    matcherAdd(m, F("SEND FAIL"));
+    matcherAdd(m, F("ERROR"));
+    if (readUntil(inBuff, IN_BUFF_SIZE, m) != 0) {
+        closeUplink();
+        return false;
+    }
+    requestSucceeded();
+    return true;
+}
+
+int ESP8266::clientAvailable() {
+    if (!espSerial || recovery != RECOVER_IDLE) {
+        return 0;
+    }
+    // route everything ESP has sent so far, the rest of output is dropped
+    while (readByte() >= 0)
+        ;
+    if (clientOverrun) {
+        // stream has a hole, protocol on top starts over
+        clientOverrun = false;
+        closeUplink();
+    }
+    return clientLen;
+}
+
+int ESP8266::clientRead() {
+    if (clientLen == 0 && clientAvailable() == 0) {
+        return -1;
+    }
+    uint8_t c = clientIn[clientHead];
+    clientHead = (clientHead + 1) % ESP_CLIENT_BUFF_SIZE;
+    clientLen--;
+    return c;
+}
+
+void ESP8266::clientPush(const char c) {
+    if (clientLen == ESP_CLIENT_BUFF_SIZE) {
+        clientOverrun = true;
+        return;
+    }
+    clientIn[(clientHead + clientLen) % ESP_CLIENT_BUFF_SIZE] = c;
+    clientLen++;
+}
+
 /* ================================== Private ================================== */
 
 int ESP8266::readApIp(esp_ip_t ip) {
     int res = 0;
     write(F("AT+CIPAP?\r\n"));
     if (readUntil(inBuff, IN_BUFF_SIZE, F("+CIPAP:ip:"))) {
-        read(inBuff, IN_BUFF_SIZE);
+        readUntil(inBuff, IN_BUFF_SIZE, F("\r\n"));
         res = sscanf(inBuff, "\"%d.%d.%d.%d\"", (int*) &ip[0], (int*) &ip[1], (int*) &ip[2], (int*) &ip[3]);
-        while (read(inBuff, IN_BUFF_SIZE))
-            ;
+        // gateway and netmask lines, without waiting for silence
+        readUntil(inBuff, IN_BUFF_SIZE, F("\r\nOK\r\n"));
     }
     return res;
 }
@@ -275,33 +603,35 @@ int ESP8266::readStaIp(esp_ip_t ip) {
     int res = 0;
     write(F("AT+CIPSTA?\r\n"));
     if (readUntil(inBuff, IN_BUFF_SIZE, F("+CIPSTA:ip:"))) {
-        read(inBuff, IN_BUFF_SIZE);
+        readUntil(inBuff, IN_BUFF_SIZE, F("\r\n"));
         res = sscanf(inBuff, "\"%d.%d.%d.%d\"", (int*) &ip[0], (int*) &ip[1], (int*) &ip[2], (int*) &ip[3]);
-        while (read(inBuff, IN_BUFF_SIZE))
-            ;
+        // gateway and netmask lines, without waiting for silence
+        readUntil(inBuff, IN_BUFF_SIZE, F("\r\nOK\r\n"));
     }
     return res;
 }
 
-size_t ESP8266::read(char *buffer, size_t bsize, const char *target, const size_t length, const uint16_t ttl) {
+size_t ESP8266::read(char *buffer, size_t bsize, esp_matcher_t *matcher, const size_t length, const uint16_t ttl) {
+    buffer[0] = '\0';
     if (!espSerial) {
         return 0;
     }
     unsigned long start = millis();
     uint16_t maxRead = length > 0 ? length : bsize;
     uint16_t i = 0;
-    buffer[i] = '\0';
-    dbgf(debug, F("wifi:<<["));
-    while (millis() - start < ttl && ((target != NULL && !strstr(buffer, target)) || (target == NULL && i < maxRead))) {
-        while (espSerial->available() > 0
-                && ((target != NULL && !strstr(buffer, target)) || (target == NULL && i < maxRead))) {
-            char c = (char) espSerial->read();
-            append(buffer, bsize, i, c);
-            dbgf(debug, F("%c"), c);
+    size_t len = 0;
+    int c;
+    while (millis() - start < ttl && ((matcher != NULL && matcher->found < 0) || (matcher == NULL && i < maxRead))) {
+        while (((matcher != NULL && matcher->found < 0) || (matcher == NULL && i < maxRead))
+                && (c = readByte()) >= 0) {
+            append(buffer, bsize, len, (char) c);
             i++;
+            if (matcher != NULL) {
+                matcher->found = matcherFeed(*matcher, (char) c);
+            }
         }
     }
-    dbgf(debug, F("]\n"));
+    logMsg(debug, WIFI_IN, buffer);
     return i;
 }
 
@@ -314,40 +644,46 @@ int16_t ESP8266::httpSend(const esp_ip_t dstIP, const uint16_t dstPort, const ch
             snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPSTART=4,\"TCP\",\"%d.%d.%d.%d\",%d,0\r\n", dstIP[0], dstIP[1],
                     dstIP[2], dstIP[3], dstPort);
             write(outBuff);
-            inBuff[0] = '\0';
-            while (readUntil(inBuff, IN_BUFF_SIZE, F("\r\n"), 3000) && strlen(inBuff) > 0) {
-                if (strstr(inBuff, "4,CONNECT") || strstr(inBuff, "ALREADY CONNECTED")) {
-                    connected = true;
-                    break;
-                } else if (strstr(inBuff, ",CONNECT") || strstr(inBuff, "ERROR")) {
-                    break;
-                } else if (strstr(inBuff, "no ip")) {
-                    staIp[0] = staIp[1] = staIp[2] = staIp[3] = 0;
-                }
+            esp_matcher_t m;
+            matcherInit(m);
+            matcherAdd(m, F("4,CONNECT"));
+            matcherAdd(m, F("ALREADY CONNECTED"));
+            matcherAdd(m, F("ERROR"));
+            matcherAdd(m, F("4,CLOSED"));
+            matcherAdd(m, F("no ip"));
+            int8_t found;
+            while ((found = readUntil(inBuff, IN_BUFF_SIZE, m, 3000)) == 4) {
+                staIp[0] = staIp[1] = staIp[2] = staIp[3] = 0;
             }
+            connected = found == 0 || found == 1;
             if (connected) {
                 status = 0;
-                // connection established. send HTTP request
-                if (write(F("AT+CIPSENDEX=4,2048\r\n"), EXPECT_PROMPT)) {
-                    write(F("POST / HTTP/1.1\r\n"));
-                    write(F("User-Agent: ESP8266\r\n"));
-                    write(F("Accept: */*\r\n"));
-                    write(F("Content-Type: application/json\r\n"));
-                    snprintf(outBuff, OUT_BUFF_SIZE, "Content-Length: %d\r\n", strlen(message));
-                    write(outBuff);
-                    write(F("Connection: close\r\n\r\n"));
-                    write(message);
-                    write("\\0");
+                // connection established, HTTP request goes in one pass.
+                // ESP takes exactly the announced length, no "\0" terminator
+                unsigned int length = strlen(message);
+                char contentLength[6];
+                snprintf(contentLength, sizeof(contentLength), "%u", length);
+                length += sizeof(HTTP_REQUEST_HEAD) - 1 + strlen(contentLength) + sizeof(HTTP_REQUEST_TAIL) - 1;
+                snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPSEND=4,%u\r\n", length);
+                if (write(outBuff, EXPECT_PROMPT)) {
+                    logMsg(debug, WIFI_OUT, message);
+                    espSerial->print(reinterpret_cast<const __FlashStringHelper*>(HTTP_REQUEST_HEAD));
+                    espSerial->print(contentLength);
+                    espSerial->print(reinterpret_cast<const __FlashStringHelper*>(HTTP_REQUEST_TAIL));
+                    espSerial->print(message);
+                    matcherInit(m);
+                    matcherAdd(m, F("SEND OK"));
+                    matcherAdd(m, F("SEND FAIL"));
+                    matcherAdd(m, F("ERROR"));
                     // handle response
-                    if (readUntil(inBuff, IN_BUFF_SIZE, F("SEND OK"))
+                    if (readUntil(inBuff, IN_BUFF_SIZE, m) == 0
                             && readUntil(inBuff, IN_BUFF_SIZE, F("+IPD,4,"), 5000)
                             && readUntil(inBuff, IN_BUFF_SIZE, F("HTTP/"))
                             && readUntil(inBuff, IN_BUFF_SIZE, F("\r\n"))) {
                         int d;
                         if (sscanf(&inBuff[0], "%d.%d %u\r\n", &d, &d, &status)) {
                             // HTTP response code parsed
-                            lastSuccessRequestTs = millis();
-                            reconnectCount = 0;
+                            requestSucceeded();
                             // consume response body if any
                             if (readUntil(inBuff, IN_BUFF_SIZE, F("+IPD,4,"), 100)
                                     && readUntil(inBuff, IN_BUFF_SIZE, F(":"))) {
@@ -369,92 +705,675 @@ int16_t ESP8266::httpSend(const esp_ip_t dstIP, const uint16_t dstPort, const ch
     return status;
 }
 
-int16_t ESP8266::httpReceive(char* message, size_t msize) {
-    int16_t status = -1;
+// passthrough (CIPMODE=1) works in single connection mode only, so nodes with
+// TCP server keep uplink on client link and announce each frame with CIPSEND
+bool ESP8266::openUplink(const esp_ip_t dstIP, const uint16_t dstPort) {
+    if ((cwMode != MODE_STA && cwMode != MODE_STA_AP) || !validIP(staIp)) {
+        return false;
+    }
+    bool passthrough = tcpServerPort == 0;
+    if (passthrough) {
+        write(F("AT+CIPMUX=0\r\n"), EXPECT_OK, 300);
+    }
+    snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPSTART=%s\"TCP\",\"%d.%d.%d.%d\",%d,%d\r\n", passthrough ? "" : "4,",
+            dstIP[0], dstIP[1], dstIP[2], dstIP[3], dstPort, UPLINK_KEEPALIVE_SEC);
+    write(outBuff);
+    esp_matcher_t m;
+    matcherInit(m);
+    matcherAdd(m, passthrough ? F("CONNECT") : F("4,CONNECT"));
+    matcherAdd(m, F("ALREADY CONNECTED"));
+    matcherAdd(m, F("ERROR"));
+    matcherAdd(m, passthrough ? F("CLOSED") : F("4,CLOSED"));
+    int8_t found = readUntil(inBuff, IN_BUFF_SIZE, m, 3000);
+    bool connected = found == 0 || found == 1;
+    if (connected && passthrough) {
+        connected = write(F("AT+CIPMODE=1\r\n"), EXPECT_OK, 300) && write(F("AT+CIPSEND\r\n"), EXPECT_PROMPT, 300);
+    }
+    if (connected) {
+        uplink = passthrough ? UPLINK_PASSTHROUGH : UPLINK_LINK;
+        logMsg(debug, WIFI_UPLINK_OPEN, uplink);
+    } else {
+        logMsg(debug, WIFI_UPLINK_FAIL);
+        if (passthrough) {
+            restoreMux();
+        }
+    }
+    return connected;
+}
+
+bool ESP8266::openUdp(const esp_ip_t dstIP, const uint16_t dstPort) {
+    if ((cwMode != MODE_STA && cwMode != MODE_STA_AP) || !validIP(staIp)) {
+        return false;
+    }
+    snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPSTART=4,\"UDP\",\"%d.%d.%d.%d\",%d\r\n", dstIP[0], dstIP[1], dstIP[2],
+            dstIP[3], dstPort);
+    write(outBuff);
+    esp_matcher_t m;
+    matcherInit(m);
+    matcherAdd(m, F("4,CONNECT"));
+    matcherAdd(m, F("ALREADY CONNECTED"));
+    matcherAdd(m, F("ERROR"));
+    int8_t found = readUntil(inBuff, IN_BUFF_SIZE, m, 1000);
+    if (found == 0 || found == 1) {
+        uplink = UPLINK_UDP;
+        logMsg(debug, WIFI_UPLINK_OPEN, uplink);
+        return true;
+    }
+    logMsg(debug, WIFI_UPLINK_FAIL);
+    return false;
+}
+
+int16_t ESP8266::sendFrame(const char* message) {
+    uint16_t length = strlen(message);
+    if (uplink == UPLINK_LINK) {
+        snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPSEND=4,%u\r\n", length + 2);
+        if (!write(outBuff, EXPECT_PROMPT)) {
+            return 0;
+        }
+    }
+    logMsg(debug, WIFI_OUT, message);
+    espSerial->write((uint8_t) (length >> 8));
+    espSerial->write((uint8_t) length);
+    espSerial->print(message);
+    if (uplink == UPLINK_LINK) {
+        esp_matcher_t m;
+        matcherInit(m);
+        matcherAdd(m, F("SEND OK"));
+        matcherAdd(m, F("SEND FAIL"));
+        matcherAdd(m, F("ERROR"));
+        if (readUntil(inBuff, IN_BUFF_SIZE, m) != 0) {
+            return 0;
+        }
+    }
+    // passthrough has no acknowledgement, ESP reconnects on its own
+    requestSucceeded();
+    return length;
+}
+
+void ESP8266::escape() {
+    delay(UPLINK_ESCAPE_GUARD_MS);
+    espSerial->print(F("+++"));
+    delay(UPLINK_ESCAPE_WAIT_MS);
+}
+
+void ESP8266::restoreMux() {
+    write(F("AT+CIPMODE=0\r\n"), EXPECT_OK, 300);
+    write(F("AT+CIPCLOSE\r\n"), EXPECT_OK, 300);
+    write(F("AT+CIPMUX=1\r\n"), EXPECT_OK, 300);
+}
+
+// serves requests queued on server links: error responses are sent right
+// away, body of the first complete request is copied into message and waits
+// for respond(). the rest stay queued for next calls. body is cut to msize
+// bytes, message must have room for one more. returns route of the request,
+// -1 if none
+int8_t ESP8266::httpReceive(char* message, size_t msize) {
+    int8_t taken = -1;
     message[0] = '\0';
-    if (readUntil(inBuff, IN_BUFF_SIZE, F("+IPD,")) && readUntil(inBuff, IN_BUFF_SIZE, F(":"))) {
-        // connection from client established
-        status = 0;
-        int connId;
-        int len;
-        bool closed = false;
-        if (sscanf(&inBuff[0], "%d,%d:", &connId, &len)) {
-            // got connId and request length
-            if (readUntil(inBuff, IN_BUFF_SIZE, F("HTTP/")) && strstr(inBuff, "POST / ")) {
-                if (readUntil(inBuff, IN_BUFF_SIZE, F("\r\n\r\n"))) { // skip headers
-                    read(message, msize, 500);
-                    snprintf(tmpBuff, TMP_BUFF_SIZE, "+IPD,%d,", connId);
-                    if (strstr(message, tmpBuff)) {
-                        // body was sent as separate package
-                        // truncate AT command +IPD,connId,len:
-                        strcpy(message, strstr(message, ":") + 1);
-                    }
-                    snprintf(tmpBuff, TMP_BUFF_SIZE, "%d,CLOSED", connId);
-                    if (strstr(message, tmpBuff)) {
-                        // client already closed connection
-                        message[strstr(message, tmpBuff) - message] = '\0';
-                        closed = true;
-                    } else {
-                        // consume rest of response until connection closed or timeout
-                        while (!readUntil(inBuff, IN_BUFF_SIZE, tmpBuff, 100) && strlen(inBuff) > 0) {
-                            if (strstr(inBuff, tmpBuff)) {
-                                closed = true;
-                            }
-                        }
-                        if (!closed) {
-                            sendResponse(status = 200, "OK");
-                        }
-                    }
-                } else {
-                    sendResponse(status = 400, "BAD REQUEST");
-                }
+    if (!espSerial || recovery != RECOVER_IDLE) {
+        return taken;
+    }
+    // request of the previous call was not answered
+    respond(NULL);
+    // route everything ESP has sent so far, the rest of output is dropped
+    while (readByte() >= 0)
+        ;
+    for (uint8_t id = 0; id < ESP_SERVER_LINKS; id++) {
+        esp_link_t *link = &links[id];
+        if (link->state == LINK_RESPOND) {
+            sendResponse(id, link->status);
+        } else if (link->state == LINK_READY && taken < 0) {
+            size_t len = min((size_t) link->length, msize);
+            memcpy(message, link->body, len);
+            message[len] = '\0';
+            link->state = LINK_REPLY;
+            taken = link->route;
+        }
+    }
+    return taken;
+}
+
+void ESP8266::sendResponse(const uint8_t id, const uint16_t httpCode, const char *body) {
+    if (!links[id].closed) {
+        snprintf(inBuff, IN_BUFF_SIZE, "HTTP/1.0 %d %s\r\n", httpCode, statusText(httpCode));
+        unsigned int length = strlen(inBuff);
+        char contentLength[6];
+        if (body) {
+            snprintf(contentLength, sizeof(contentLength), "%u", (unsigned int) strlen(body));
+            length += sizeof(HTTP_RESPONSE_JSON) - 1 + strlen(contentLength) + 4 + strlen(body);
+        }
+        snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPSEND=%d,%u\r\n", id, length);
+        if (write(outBuff, EXPECT_PROMPT)) {
+            if (body) {
+                espSerial->print(inBuff);
+                espSerial->print(reinterpret_cast<const __FlashStringHelper*>(HTTP_RESPONSE_JSON));
+                espSerial->print(contentLength);
+                espSerial->print(F("\r\n\r\n"));
+                write(body, EXPECT_SEND_OK);
             } else {
-                sendResponse(status = 404, "NOT FOUND");
+                write(inBuff, EXPECT_SEND_OK);
             }
-            if (!closed) {
-                snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPCLOSE=%d\r\n", connId);
-                write(outBuff, EXPECT_OK);
+        }
+    }
+    linkClose(id);
+}
+
+bool ESP8266::respondBegin(const uint16_t httpCode, const uint32_t tag, const uint16_t length) {
+    replyId = -1;
+    for (uint8_t id = 0; id < ESP_SERVER_LINKS; id++) {
+        if (links[id].state == LINK_REPLY) {
+            replyId = id;
+            break;
+        }
+    }
+    if (!espSerial || replyId < 0) {
+        return false;
+    }
+    snprintf(replyBuff, sizeof(replyBuff), "HTTP/1.0 %u %s\r\nETag: \"%08lx\"\r\n", httpCode,
+            statusText(httpCode), (unsigned long) tag);
+    replyLength = strlen(replyBuff);
+    if (length > 0) {
+        char contentLength[6];
+        snprintf(contentLength, sizeof(contentLength), "%u", length);
+        respondWrite(reinterpret_cast<const __FlashStringHelper*>(HTTP_RESPONSE_JSON));
+        respondWrite(contentLength);
+        respondWrite("\r\n");
+    }
+    respondWrite("\r\n");
+    return true;
+}
+
+void ESP8266::respondWrite(const char *data) {
+    while (*data) {
+        respondPut(*data++);
+    }
+}
+
+void ESP8266::respondWrite(const __FlashStringHelper *data) {
+    PGM_P p = reinterpret_cast<PGM_P>(data);
+    char c;
+    while ((c = pgm_read_byte(p++)) != 0) {
+        respondPut(c);
+    }
+}
+
+void ESP8266::respondEnd() {
+    if (replyId < 0) {
+        return;
+    }
+    respondFlush();
+    linkClose(replyId);
+    replyId = -1;
+}
+
+// passes of respondItems()
+static ESP8266 *itemsEsp = NULL;
+static uint32_t itemsTag = 0;
+static uint16_t itemsLength = 0;
+static uint16_t itemsCount = 0;
+
+static void itemsMeasure(const char *json) {
+    if (itemsCount++ > 0) {
+        itemsTag = (itemsTag ^ ',') * TAG_PRIME;
+        itemsLength++;
+    }
+    for (const char *c = json; *c; c++) {
+        itemsTag = (itemsTag ^ (uint8_t) *c) * TAG_PRIME;
+        itemsLength++;
+    }
+}
+
+static void itemsSend(const char *json) {
+    itemsEsp->respondWrite(itemsCount++ ? "," : "[");
+    itemsEsp->respondWrite(json);
+}
+
+void ESP8266::respondItems(esp_json_items_t items) {
+    itemsEsp = this;
+    itemsTag = TAG_OFFSET;
+    itemsLength = itemsCount = 0;
+    items(itemsMeasure);
+    uint32_t tag = itemsTag ? itemsTag : 1;
+    bool known = false;
+    for (uint8_t id = 0; id < ESP_SERVER_LINKS; id++) {
+        if (links[id].state == LINK_REPLY) {
+            known = links[id].tag == tag;
+            break;
+        }
+    }
+    if (known) {
+        // client has it, no body is sent
+        if (respondBegin(304, tag, 0)) {
+            respondEnd();
+        }
+        return;
+    }
+    // "[" items joined with "," "]"
+    if (respondBegin(200, tag, itemsLength + 2)) {
+        itemsCount = 0;
+        items(itemsSend);
+        respondWrite(itemsCount ? "]" : "[]");
+        respondEnd();
+    }
+}
+
+// appends c to response buffer, full buffer goes to ESP
+void ESP8266::respondPut(const char c) {
+    if (replyId < 0) {
+        return;
+    }
+    if (replyLength >= ESP_REQUEST_SIZE) {
+        respondFlush();
+    }
+    replyBuff[replyLength++] = c;
+}
+
+// the rest of response is dropped once client is gone or a new client has
+// taken the link over
+void ESP8266::respondFlush() {
+    esp_link_t *link = &links[replyId];
+    if (replyLength > 0 && link->state == LINK_REPLY && !link->closed) {
+        replyBuff[replyLength] = '\0';
+        snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPSEND=%d,%u\r\n", replyId, replyLength);
+        if ((!write(outBuff, EXPECT_PROMPT) || !write(replyBuff, EXPECT_SEND_OK)) && link->state == LINK_REPLY) {
+            link->closed = true;
+        }
+    }
+    replyLength = 0;
+}
+
+/* ================================ Server links =============================== */
+
+// next byte of ESP output for synchronous readers, -1 if there is none yet.
+// payloads of server links are taken by link parsers on the way, so requests
+// coming while a command is waiting for its response are not lost
+int ESP8266::readByte() {
+    while (true) {
+        int c;
+        if (releasePos < releaseLen) {
+            c = (uint8_t) notice[releasePos++];
+        } else {
+            c = espSerial->read();
+            if (c < 0) {
+                return -1;
+            }
+            if (demux((char) c)) {
+                continue;
             }
+        }
+        if (c == '\n') {
+            line[lineLen] = '\0';
+            lineEnd();
+            lineLen = 0;
+        } else if (lineLen < ESP_NOTICE_SIZE) {
+            line[lineLen++] = c;
+        }
+        return c;
+    }
+}
+
+// returns true when c is taken from the reader
+bool ESP8266::demux(const char c) {
+    if (ipdLeft > 0) {
+        ipdLeft--;
+        if (ipdLink == ESP_CLIENT_LINK) {
+            clientPush(c);
         } else {
-            // connId unknown, don't try to close
+            linkReceive(ipdLink, c);
         }
+        return true;
     }
-    return status;
+    if (noticeLen == 0 && c != IPD_PREFIX[0]) {
+        return false;
+    }
+    notice[noticeLen++] = c;
+    notice[noticeLen] = '\0';
+    if (noticeLen <= strlen(IPD_PREFIX)) {
+        if (c != IPD_PREFIX[noticeLen - 1]) {
+            release();
+        }
+    } else if (c == ':') {
+        int id;
+        int len;
+        if (sscanf(notice, "+IPD,%d,%d:", &id, &len) == 2 && len > 0
+                && ((id >= 0 && id < ESP_SERVER_LINKS) || (id == ESP_CLIENT_LINK && uplink == UPLINK_CLIENT))) {
+            ipdLink = id;
+            ipdLeft = len;
+            noticeLen = 0;
+        } else {
+            // response on client link
+            release();
+        }
+    } else if ((c != ',' && !isdigit(c)) || noticeLen == ESP_NOTICE_SIZE) {
+        release();
+    }
+    return true;
+}
+
+void ESP8266::release() {
+    releasePos = 0;
+    releaseLen = noticeLen;
+    noticeLen = 0;
+}
+
+// tracks "<link>,CONNECT" and "<link>,CLOSED" of server links
+void ESP8266::lineEnd() {
+    if (lineLen > 0 && line[lineLen - 1] == '\r') {
+        line[--lineLen] = '\0';
+    }
+    if (uplink == UPLINK_CLIENT && !strcmp(line, "4,CLOSED")) {
+        // by peer or ESP
+        uplink = UPLINK_CLOSED;
+        logMsg(debug, WIFI_UPLINK_CLOSE);
+        return;
+    }
+    if (lineLen < 2 || line[1] != ',' || line[0] < '0' || line[0] >= '0' + ESP_SERVER_LINKS) {
+        return;
+    }
+    uint8_t id = line[0] - '0';
+    if (!strcmp(&line[2], "CONNECT")) {
+        // also while response to previous client is on the way, see linkClose()
+        linkReset(id, LINK_REQUEST);
+    } else if (!strcmp(&line[2], "CLOSED")) {
+        if (links[id].state == LINK_READY || links[id].state == LINK_REPLY) {
+            // command is still executed, but there is nobody to answer
+            links[id].closed = true;
+        } else {
+            linkReset(id, LINK_IDLE);
+        }
+    }
+}
+
+void ESP8266::linkReceive(const uint8_t id, const char c) {
+    esp_link_t *link = &links[id];
+    switch (link->state) {
+    case LINK_IDLE:
+        // CONNECT notice was missed
+        linkReset(id, LINK_REQUEST);
+        break;
+    case LINK_REQUEST:
+    case LINK_HEADERS:
+        break;
+    case LINK_BODY:
+        if (link->length < ESP_REQUEST_SIZE) {
+            link->body[link->length] = c;
+        }
+        if (++link->length >= link->contentLength) {
+            if (link->length > ESP_REQUEST_SIZE) {
+                link->status = 400;
+                link->state = LINK_RESPOND;
+            } else {
+                link->body[link->length] = '\0';
+                link->state = LINK_READY;
+            }
+        }
+        return;
+    default:
+        // request is complete, the rest is ignored
+        return;
+    }
+    if (c == '\n') {
+        link->body[link->length] = '\0';
+        linkHeader(link);
+        link->length = 0;
+    } else if (c != '\r' && link->length < ESP_REQUEST_SIZE) {
+        link->body[link->length++] = c;
+    }
+}
+
+// request line or header is in link body
+void ESP8266::linkHeader(esp_link_t *link) {
+    if (link->state == LINK_REQUEST) {
+        if (link->length > 0) {
+            link->route = route(link->body);
+            link->status = link->route < 0 ? 404 : 0;
+            link->state = LINK_HEADERS;
+        }
+    } else if (link->length > 0) {
+        if (!strncasecmp(link->body, "Content-Length:", 15)) {
+            link->contentLength = atoi(&link->body[15]);
+        } else if (!strncasecmp(link->body, "If-None-Match:", 14)) {
+            char *tag = strchr(&link->body[14], '"');
+            link->tag = tag ? strtoul(tag + 1, NULL, 16) : 0;
+        }
+    } else if (link->status > 0) {
+        link->state = LINK_RESPOND;
+    } else {
+        link->state = link->contentLength > 0 ? LINK_BODY : LINK_READY;
+    }
+}
+
+// path matches up to query or end of request line path
+int8_t ESP8266::route(const char *requestLine) {
+    const char * const *table = routes ? routes : DEFAULT_ROUTES;
+    uint8_t count = routes ? routeCount : 1;
+    for (uint8_t i = 0; i < count; i++) {
+        size_t n = strlen(table[i]);
+        if (!strncmp(requestLine, table[i], n) && (requestLine[n] == ' ' || requestLine[n] == '?')) {
+            return i;
+        }
+    }
+    return -1;
 }
 
-void ESP8266::sendResponse(uint16_t httpCode, const char *content) {
-    if (write(F("AT+CIPSENDEX=0,2048\r\n"), EXPECT_PROMPT)) {
-        snprintf(outBuff, OUT_BUFF_SIZE, "HTTP/1.0 %d %s\r\n", httpCode, content);
-        write(outBuff);
-        write(F("\\0"), EXPECT_SEND_OK);
+void ESP8266::linkReset(const uint8_t id, const uint8_t state) {
+    esp_link_t *link = &links[id];
+    link->state = state;
+    link->closed = false;
+    link->route = -1;
+    link->status = 0;
+    link->tag = 0;
+    link->contentLength = 0;
+    link->length = 0;
+    link->body[0] = '\0';
+}
+
+// ends response on link id. "<id>,CONNECT" of a new client resets the link
+// while response is on the way; then the link is left to it
+void ESP8266::linkClose(const uint8_t id) {
+    esp_link_t *link = &links[id];
+    if (link->state != LINK_REPLY && link->state != LINK_RESPOND) {
+        return;
+    }
+    bool closed = link->closed;
+    // free before CIPCLOSE, a new client may connect during it
+    linkReset(id, LINK_IDLE);
+    if (!closed) {
+        snprintf(outBuff, OUT_BUFF_SIZE, "AT+CIPCLOSE=%d\r\n", id);
+        write(outBuff, EXPECT_OK);
     }
 }
 
+// failed request. the breaker opens after a few of them or when station looks
+// lost; the latter also schedules recovery for update()
 void ESP8266::errorsRecovery() {
     if (cwMode == MODE_STA || cwMode == MODE_STA_AP) {
-        dbg(debug, F(":wifi:ERR_RECOVERY\n"));
+        logMsg(debug, WIFI_ERR_RECOVERY);
+        if (failures < 0xFF) {
+            failures++;
+        }
         unsigned long ts = millis();
         if ((!validIP(staIp) && (ts - connectTs) > STA_RECONNECT_INTERVAL)
-                || (failureGracePeriod > 0 && abs(ts - lastSuccessRequestTs) > failureGracePeriod)) {
-            if (reconnectCount < FAILURE_RECONNECTS_MAX_COUNT) {
-                dbg(debug, F(":wifi:ERR_RECONNECT\n"));
-                reconnect();
-                lastSuccessRequestTs = millis();
-            } else {
-                // restart ESP8266
-                dbg(debug, F(":wifi:ERR_RESTART\n"));
-                init(espSerial, cwMode, rstPin, failureGracePeriod / 1000);
-                startAP(apSsid, apPassword);
-                connect(staSsid, staPassword);
-                startTcpServer(tcpServerPort);
-            }
+                || (failureGracePeriod > 0 && ts - lastSuccessRequestTs > failureGracePeriod)) {
+            recoverPending = true;
+        }
+        if (recoverPending || failures >= BREAKER_FAILURES || breaker == BREAKER_HALF_OPEN) {
+            openBreaker();
+        }
+    }
+}
+
+void ESP8266::requestSucceeded() {
+    lastSuccessRequestTs = millis();
+    reconnectCount = 0;
+    failures = 0;
+    recoverPending = false;
+    if (breaker != BREAKER_CLOSED) {
+        breaker = BREAKER_CLOSED;
+        logMsg(debug, WIFI_BREAKER_CLOSE);
+    }
+}
+
+bool ESP8266::breakerAllows() {
+    return breaker != BREAKER_OPEN;
+}
+
+void ESP8266::openBreaker() {
+    if (breaker == BREAKER_CLOSED || backoff == 0) {
+        backoff = BREAKER_BACKOFF_MIN_MS;
+    } else {
+        backoff = min(backoff * 2, BREAKER_BACKOFF_MAX_MS);
+    }
+    breaker = BREAKER_OPEN;
+    breakerTs = millis();
+    logMsg(debug, WIFI_BREAKER_OPEN, (unsigned int) (backoff / 1000));
+}
+
+esp_breaker ESP8266::breakerState() {
+    return breaker;
+}
+
+void ESP8266::update() {
+    if (!espSerial) {
+        return;
+    }
+    if (recovery != RECOVER_IDLE) {
+        recoveryStep();
+        logFlush(debug);
+        return;
+    }
+    // loop() went on without respond()
+    respond(NULL);
+    if (breaker == BREAKER_OPEN && millis() - breakerTs >= backoff) {
+        if (recoverPending) {
+            recoveryStart();
+        } else {
+            breaker = BREAKER_HALF_OPEN;
+            logMsg(debug, WIFI_BREAKER_HALF_OPEN);
         }
     }
+    logFlush(debug);
+}
+
+// same as reconnect() or init() with the rest of setup, but waits for ESP in
+// steps instead of delays
+void ESP8266::recoveryStart() {
+    recoverPending = false;
+    closeUplink();
+    recoveryPort = tcpServerPort;
+    stopTcpServer();
+    if (reconnectCount < FAILURE_RECONNECTS_MAX_COUNT) {
+        logMsg(debug, WIFI_ERR_RECONNECT);
+        reconnectCount++;
+        write(F("AT+CWQAP\r\n"), EXPECT_OK, 1000);
+        staIp[0] = staIp[1] = staIp[2] = staIp[3] = 0;
+        recoveryJoin();
+    } else {
+        // restart ESP8266
+        logMsg(debug, WIFI_ERR_RESTART);
+        recoveryRestart();
+    }
+}
+
+void ESP8266::recoveryRestart() {
+    reconnectCount = 0;
+    resetState();
+    if (rstPin > 0) {
+        logMsg(debug, WIFI_HW_RESET);
+        digitalWrite(rstPin, LOW);
+        matcherInit(recoveryMatcher);
+        recoveryWait(RECOVER_RESET_PIN, RECOVER_RESET_PIN_MS);
+    } else {
+        recoveryBoot();
+    }
+}
+
+void ESP8266::recoveryBoot() {
+    if (rstPin > 0) {
+        // ESP boots on its own after reset pin
+        digitalWrite(rstPin, HIGH);
+    } else {
+        // reset serial port buffers
+        espSerial->end();
+        espSerial->begin(57600);
+        write(F("AT+RST\r\n"));
+    }
+    matcherInit(recoveryMatcher);
+    matcherAdd(recoveryMatcher, F("ready"));
+    recoveryWait(RECOVER_BOOT, RECOVER_BOOT_MS);
+}
+
+void ESP8266::recoveryJoin() {
+    matcherInit(recoveryMatcher);
+    if (!staSsid) {
+        recoveryWait(RECOVER_JOIN, 0);
+        return;
+    }
+    snprintf(outBuff, OUT_BUFF_SIZE, "AT+CWJAP_CUR=\"%s\",\"%s\"\r\n", (char*) staSsid, (char*) staPassword);
+    write(outBuff);
+    matcherAdd(recoveryMatcher, F("\r\nOK\r\n"));
+    matcherAdd(recoveryMatcher, F("FAIL"));
+    matcherAdd(recoveryMatcher, F("ERROR"));
+    recoveryWait(RECOVER_JOIN, RECOVER_JOIN_MS);
+}
+
+void ESP8266::recoveryWait(const esp_recovery state, const unsigned long ttl) {
+    recovery = state;
+    recoveryTs = millis();
+    recoveryTtl = ttl;
+}
+
+// consumes what ESP has sent so far, moves to the next step on expected
+// output or timeout
+void ESP8266::recoveryStep() {
+    int8_t found = -1;
+    int c;
+    while (found < 0 && (c = readByte()) >= 0) {
+        found = matcherFeed(recoveryMatcher, c);
+    }
+    if (found < 0 && millis() - recoveryTs < recoveryTtl) {
+        return;
+    }
+    switch (recovery) {
+    case RECOVER_RESET_PIN:
+        recoveryBoot();
+        break;
+    case RECOVER_BOOT:
+        recovery = RECOVER_IDLE;
+        setupMode();
+        startAP(apSsid, apPassword);
+        recoveryJoin();
+        break;
+    default:
+        if (found == 0) {
+            logMsg(debug, WIFI_STA_CONN_OK, (const char*) staSsid);
+        } else if (staSsid) {
+            logMsg(debug, WIFI_STA_CONN_FAIL, (const char*) staSsid);
+        }
+        recovery = RECOVER_IDLE;
+        readStaIp(staIp);
+        connectTs = millis();
+        startTcpServer(recoveryPort);
+        lastSuccessRequestTs = millis();
+        if (validIP(staIp) && failures == 0) {
+            // boot
+            breaker = BREAKER_CLOSED;
+            logMsg(debug, WIFI_BREAKER_CLOSE);
+        } else if (validIP(staIp)) {
+            // the next request tells if recovery helped
+            breaker = BREAKER_HALF_OPEN;
+            logMsg(debug, WIFI_BREAKER_HALF_OPEN);
+        } else {
+            recoverPending = true;
+            openBreaker();
+        }
+        break;
+    }
 }
 
 void ESP8266::dropConnection() {
     int connId;
-    dbg(debug, F(":wifi:DROP_CONN\n"));
+    logMsg(debug, WIFI_DROP_CONN);
     write(F("AT+CIPSTATUS\r\n"));
     while (readUntil(inBuff, IN_BUFF_SIZE, F("\r\n"))) {
         if (strstr(inBuff, "+CIPSTATUS:")) {
@@ -472,18 +1391,84 @@ bool ESP8266::waitUntilBusy(const uint16_t ttl, const uint8_t retryCount) {
     return write(F("AT\r\n"), EXPECT_OK, ttl, retryCount);
 }
 
-void ESP8266::append(char *buffer, const size_t bsize, const size_t idx, const char c) {
-    if (idx < bsize) {
-        buffer[idx] = c;
-        buffer[idx + 1] = '\0';
-    } else {
-        size_t i = 0;
-        for (i = 0; i < bsize - 1; i++) {
-            buffer[i] = buffer[i + 1];
+// full buffer drops its older half at once, so it keeps at least bsize / 2
+// last bytes without shifting the whole buffer on every byte
+void ESP8266::append(char *buffer, const size_t bsize, size_t &len, const char c) {
+    if (len >= bsize) {
+        size_t drop = (bsize + 1) / 2;
+        memmove(buffer, buffer + drop, len - drop);
+        len -= drop;
+    }
+    buffer[len++] = c;
+    buffer[len] = '\0';
+}
+
+/* =================================== Matcher ================================= */
+
+static char tokenChar(const esp_matcher_t &m, const uint8_t i, const uint8_t k) {
+    return m.flash & (1 << i) ? pgm_read_byte(m.tokens[i] + k) : m.tokens[i][k];
+}
+
+void matcherInit(esp_matcher_t &m) {
+    m.count = 0;
+    m.flash = 0;
+    m.found = -1;
+}
+
+void matcherAdd(esp_matcher_t &m, const char *token) {
+    if (m.count < ESP_MATCH_MAX) {
+        m.tokens[m.count] = token;
+        m.length[m.count] = strlen(token);
+        m.state[m.count] = 0;
+        m.count++;
+    }
+}
+
+void matcherAdd(esp_matcher_t &m, const __FlashStringHelper *token) {
+    if (m.count < ESP_MATCH_MAX) {
+        m.tokens[m.count] = reinterpret_cast<PGM_P>(token);
+        m.length[m.count] = strlen_P(m.tokens[m.count]);
+        m.state[m.count] = 0;
+        m.flash |= 1 << m.count;
+        m.count++;
+    }
+}
+
+int8_t matcherFeed(esp_matcher_t &m, const char c) {
+    int8_t found = -1;
+    for (uint8_t i = 0; i < m.count; i++) {
+        uint8_t s = m.state[i];
+        if (tokenChar(m, i, s) == c) {
+            s++;
+        } else {
+            // longest prefix k which is suffix of matched part followed by c
+            uint8_t k = s;
+            for (; k > 0; k--) {
+                if (tokenChar(m, i, k - 1) != c) {
+                    continue;
+                }
+                uint8_t j = 0;
+                while (j < k - 1 && tokenChar(m, i, j) == tokenChar(m, i, s - k + 1 + j)) {
+                    j++;
+                }
+                if (j == k - 1) {
+                    break;
+                }
+            }
+            s = k;
+        }
+        if (s == m.length[i] && found < 0) {
+            found = i;
+        }
+        m.state[i] = s;
+    }
+    if (found >= 0) {
+        // next read starts over
+        for (uint8_t i = 0; i < m.count; i++) {
+            m.state[i] = 0;
         }
-        buffer[i] = c;
-        buffer[i + 1] = '\0';
     }
+    return found;
 }
 
 bool ESP8266::validIP(esp_ip_t ip) {
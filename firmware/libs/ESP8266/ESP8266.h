@@ -6,6 +6,32 @@
 
 #define ESP_CONFIG_TYPE_SIZE 32
 
+// concurrent TCP server connections, link ids 0..ESP_SERVER_LINKS-1
+#ifndef ESP_SERVER_LINKS
+#if defined(__AVR_ATmega2560__)
+#define ESP_SERVER_LINKS 4
+#else
+#define ESP_SERVER_LINKS 1
+#endif
+#endif
+
+// link id of outgoing connections
+#define ESP_CLIENT_LINK 4
+
+// request body, larger ones are answered with 400
+#ifndef ESP_REQUEST_SIZE
+#define ESP_REQUEST_SIZE 128
+#endif
+
+// data of client link kept for clientRead(), link is closed on overrun
+#ifndef ESP_CLIENT_BUFF_SIZE
+#if defined(__AVR_ATmega2560__)
+#define ESP_CLIENT_BUFF_SIZE 128
+#else
+#define ESP_CLIENT_BUFF_SIZE 32
+#endif
+#endif
+
 enum esp_cwmode {
     MODE_UNKNOWN = 0, MODE_STA = 1, MODE_AP = 2, MODE_STA_AP = 3,
 };
@@ -20,23 +46,135 @@ enum esp_response {
     EXPECT_ERROR = 5,
 };
 
+// stream() keeps a connection to collector (logserver/collector) and sends
+// messages as frames: 2 byte big endian length followed by message.
+// datagram() keeps UDP "connection" to logstash udp input instead
+enum esp_uplink {
+    UPLINK_CLOSED = 0,
+    UPLINK_LINK = 1, // persistent connection on client link, frame per CIPSEND
+    UPLINK_PASSTHROUGH = 2, // CIPMODE=1, frames go to ESP as is
+    UPLINK_UDP = 3, // datagram per CIPSEND on client link
+    UPLINK_CLIENT = 4, // byte stream both ways for protocol on top (libs/mqtt)
+};
+
+// requests fail at once while breaker is open, so a dead network costs no
+// time of loop(). recovery (rejoin or restart of ESP) and boot() run in
+// update() steps
+enum esp_breaker {
+    BREAKER_CLOSED = 0, // requests go through
+    BREAKER_OPEN = 1, // requests fail until backoff is over
+    BREAKER_HALF_OPEN = 2, // next request is a trial
+};
+
+enum esp_recovery {
+    RECOVER_IDLE = 0,
+    RECOVER_RESET_PIN = 1, // reset pin is low
+    RECOVER_BOOT = 2, // waiting for "ready"
+    RECOVER_JOIN = 3, // waiting for CWJAP result
+};
+
+enum esp_link_state {
+    LINK_IDLE = 0, // no connection
+    LINK_REQUEST = 1, // waiting for request line
+    LINK_HEADERS = 2,
+    LINK_BODY = 3,
+    LINK_READY = 4, // request is complete, waiting for receive()
+    LINK_RESPOND = 5, // error response is queued
+    LINK_REPLY = 6, // request is taken by receive(), waiting for respond()
+};
+
 typedef char esp_config_t[ESP_CONFIG_TYPE_SIZE];
 
+// respondItems() calls items twice with its own out: to get ETag and length of
+// the JSON array, then to stream it
+typedef void (*esp_json_out_t)(const char *json);
+typedef void (*esp_json_items_t)(esp_json_out_t out);
+
 typedef uint8_t esp_ip_t[4];
 
+// server connection. request line and headers are parsed in body buffer
+// before body comes
+typedef struct {
+    uint8_t state;
+    bool closed; // by client, response is not sent
+    int8_t route; // index in routes of request line
+    uint16_t status; // response code of queued error
+    uint32_t tag; // If-None-Match of request, 0 if none
+    uint16_t contentLength;
+    uint16_t length; // of current line or body
+    char body[ESP_REQUEST_SIZE + 1];
+} esp_link_t;
+
+// "+IPD,<link>,<length>:" header or "<link>,CLOSED" line
+#define ESP_NOTICE_SIZE 16
+
+// tokens one read waits for
+#define ESP_MATCH_MAX 6
+
+// streaming matcher: each byte of ESP output is consumed once, state of a token
+// is length of its prefix matched so far. on mismatch it falls back to the
+// longest prefix that still matches (what Aho-Corasick failure links give),
+// found without tables as tokens are short
+typedef struct {
+    const char *tokens[ESP_MATCH_MAX];
+    uint8_t length[ESP_MATCH_MAX];
+    uint8_t state[ESP_MATCH_MAX];
+    uint8_t flash; // bit per token kept in PROGMEM
+    uint8_t count;
+    int8_t found; // token which came first, -1 if none yet
+} esp_matcher_t;
+
+void matcherInit(esp_matcher_t &m);
+void matcherAdd(esp_matcher_t &m, const char *token);
+void matcherAdd(esp_matcher_t &m, const __FlashStringHelper *token);
+// index of token ending with c (the first added one if several end here), -1
+int8_t matcherFeed(esp_matcher_t &m, const char c);
+
 class ESP8266 {
 public:
     void init(HardwareSerial *port, esp_cwmode mode = MODE_STA, uint8_t resetPin = 0, uint16_t failureGracePeriodSec = 0); //
+    void boot(HardwareSerial *port, esp_cwmode mode = MODE_STA, uint8_t resetPin = 0, uint16_t failureGracePeriodSec = 0); //
     void setDebug(Stream *port); //
     void startAP(const esp_config_t *ssid, const esp_config_t *password); //
     void connect(const esp_config_t *ssid, const esp_config_t *password); //
     void disconnect(); //
     void reconnect(); //
+    // runs error recovery in background, call it from loop()
+    void update(); //
+    esp_breaker breakerState(); //
     bool getStaIP(esp_ip_t ip); //
     void startTcpServer(const uint16_t port); //
+    // request lines the server takes ("GET /status"), the rest get 404.
+    // "POST /" only until it is called
+    void setRoutes(const char * const *table, const uint8_t count); //
     void stopTcpServer(); //
     int16_t send(const esp_ip_t dstIP, const uint16_t dstPort, const char* message); //
+    int16_t stream(const esp_ip_t dstIP, const uint16_t dstPort, const char* message); //
+    int16_t datagram(const esp_ip_t dstIP, const uint16_t dstPort, const char* message); //
+    uint16_t datagramsSent(); //
+    uint16_t datagramsFailed(); //
+    void closeUplink(); //
+    bool clientOpen(const esp_ip_t dstIP, const uint16_t dstPort); //
+    bool clientConnected(); //
+    bool clientBegin(const uint16_t length); //
+    void clientWrite(const uint8_t *data, const size_t length); //
+    bool clientEnd(); //
+    int clientAvailable(); //
+    int clientRead(); //
+    // body of the next request, it is answered by respond(). like the other
+    // readers, message holds msize bytes plus the "\0" terminator
     size_t receive(char* message, size_t msize); //
+    // same as receive(), returns index of its route or -1 if there is no request
+    int8_t request(char* message, size_t msize); //
+    void respond(const char *body = NULL); //
+    // streamed response: headers, data in CIPSEND of up to ESP_REQUEST_SIZE
+    // bytes, close. length 0 sends no Content-Type and Content-Length
+    bool respondBegin(const uint16_t httpCode, const uint32_t tag, const uint16_t length); //
+    void respondWrite(const char *data); //
+    void respondWrite(const __FlashStringHelper *data); //
+    void respondEnd(); //
+    // JSON array of items with ETag, 304 if request has it already
+    void respondItems(esp_json_items_t items); //
     int available(); //
     bool write(const char *message, esp_response expectedResponse = EXPECT_NOTHING, const uint16_t ttl = 1000,
             const uint8_t retryCount = 1); //
@@ -46,6 +184,8 @@ public:
     bool readUntil(char *buffer, const size_t bsize, const char *target, const uint16_t ttl = 1000);
     bool readUntil(char *buffer, const size_t bsize, const __FlashStringHelper *target, const uint16_t ttl = 1000);
     size_t readUntil(char *buffer, const size_t bsize, const size_t length, const uint16_t ttl = 1000);
+    // reads until any token of matcher comes, returns its index or -1 on timeout
+    int8_t readUntil(char *buffer, const size_t bsize, esp_matcher_t &matcher, const uint16_t ttl = 1000);
 
 private:
     Stream *debug = NULL;
@@ -62,16 +202,76 @@ private:
     esp_ip_t staIp;
     unsigned long connectTs = 0;
     uint8_t reconnectCount = 0;bool persistDebug = false;
+    esp_breaker breaker = BREAKER_CLOSED;
+    uint8_t failures = 0; // failed requests in a row
+    unsigned long backoff = 0; // time breaker stays open
+    unsigned long breakerTs = 0;
+    bool recoverPending = false;
+    esp_recovery recovery = RECOVER_IDLE;
+    unsigned long recoveryTs = 0;
+    unsigned long recoveryTtl = 0; // of current step
+    uint16_t recoveryPort = 0; // TCP server to restore
+    esp_matcher_t recoveryMatcher;
+    esp_uplink uplink = UPLINK_CLOSED;
+    uint16_t udpSeq = 0; // next datagram sequence number
+    uint16_t udpFailed = 0;
+    uint8_t clientIn[ESP_CLIENT_BUFF_SIZE];
+    uint8_t clientHead = 0;
+    uint8_t clientLen = 0;
+    bool clientOverrun = false;
+    esp_link_t links[ESP_SERVER_LINKS];
+    const char * const *routes = NULL; // "POST /" only if not set
+    uint8_t routeCount = 0;
+    int8_t replyId = -1; // link of streamed response
+    uint16_t replyLength = 0; // of response data on the way
+    // input demultiplexer state
+    uint8_t ipdLink = 0;
+    uint16_t ipdLeft = 0; // payload bytes of server link
+    char notice[ESP_NOTICE_SIZE + 1];
+    uint8_t noticeLen = 0; // held while it may be a header of server link
+    uint8_t releasePos = 0;
+    uint8_t releaseLen = 0; // held bytes passed to reader
+    char line[ESP_NOTICE_SIZE + 1];
+    uint8_t lineLen = 0;
     int readApIp(esp_ip_t ip); //
     int readStaIp(esp_ip_t ip); //
-    size_t read(char *buffer, size_t bsize, const char *target, const size_t length, const uint16_t ttl); //
+    size_t read(char *buffer, size_t bsize, esp_matcher_t *matcher, const size_t length, const uint16_t ttl); //
     int16_t httpSend(const esp_ip_t dstIP, const uint16_t dstPort, const char* message); //
-    int16_t httpReceive(char* message, size_t msize); //
-    void sendResponse(uint16_t httpCode, const char *content); //
+    bool openUplink(const esp_ip_t dstIP, const uint16_t dstPort); //
+    bool openUdp(const esp_ip_t dstIP, const uint16_t dstPort); //
+    int16_t sendFrame(const char* message); //
+    void escape(); //
+    void restoreMux(); //
+    int8_t httpReceive(char* message, size_t msize); //
+    void sendResponse(const uint8_t id, const uint16_t httpCode, const char *body = NULL); //
+    int readByte(); //
+    bool demux(const char c); //
+    void lineEnd(); //
+    void release(); //
+    void linkReceive(const uint8_t id, const char c); //
+    void clientPush(const char c); //
+    void linkHeader(esp_link_t *link); //
+    int8_t route(const char *requestLine); //
+    void respondPut(const char c); //
+    void respondFlush(); //
+    void linkReset(const uint8_t id, const uint8_t state); //
+    void linkClose(const uint8_t id); //
     void errorsRecovery(); //
+    void requestSucceeded(); //
+    bool breakerAllows(); //
+    void openBreaker(); //
+    void recoveryStart(); //
+    void recoveryRestart(); //
+    void recoveryStep(); //
+    void recoveryBoot(); //
+    void recoveryJoin(); //
+    void recoveryWait(const esp_recovery state, const unsigned long ttl); //
+    void initState(HardwareSerial *port, esp_cwmode mode, uint8_t resetPin, uint16_t failureGracePeriodSec); //
+    void resetState(); //
+    void setupMode(); //
     void dropConnection(); //
     bool waitUntilBusy(const uint16_t ttl = 5000, const uint8_t retryCount = 1); //
-    void append(char *buffer, const size_t bsize, const size_t idx, const char c); //
+    void append(char *buffer, const size_t bsize, size_t &len, const char c); //
     bool validIP(esp_ip_t ip); //
 };
 
@@ -18,6 +18,24 @@
 #include "WProgram.h"
 #endif
 
+//--------------------------------------------------------------------------------------
+// Fixed point helpers shared by calcVI, calcIrms and continuous metering.
+// Offsets are in 1/65536 ADC counts (Q16), filtered values in 1/4 counts (Q2),
+// phase calibration in 1/256 (Q8). Squares fit 32 bits, sums are 64 bits.
+//--------------------------------------------------------------------------------------
+static inline int lowPassQ2(long &offset, int sample)
+{
+  // digital low pass filter extracts the dc offset (1/1024 time constant),
+  // then it is subtracted - signal is now centred on 0 counts
+  offset += (((long) sample << 16) - offset) >> 10;
+  return ((long) sample << 2) - ((offset + (1L << 13)) >> 14);
+}
+
+static inline int phaseShiftQ2(int lastFiltered, int filtered, int phaseCalQ8)
+{
+  return lastFiltered + (((long) phaseCalQ8 * (filtered - lastFiltered)) >> 8);
+}
+
 
 //--------------------------------------------------------------------------------------
 // Sets the pins to be used for voltage and current sensors
@@ -27,14 +45,17 @@ void EnergyMonitor::voltage(unsigned int _inPinV, double _VCAL, double _PHASECAL
   inPinV = _inPinV;
   VCAL = _VCAL;
   PHASECAL = _PHASECAL;
-  offsetV = ADC_COUNTS>>1;
+  phaseCalQ8 = (PHASECAL > 0) ? PHASECAL * 256 + 0.5 : PHASECAL * 256 - 0.5;
+  offsetV = (long) (ADC_COUNTS>>1) << 16;
+  supplyVoltage = 0;
 }
 
 void EnergyMonitor::current(unsigned int _inPinI, double _ICAL)
 {
   inPinI = _inPinI;
   ICAL = _ICAL;
-  offsetI = ADC_COUNTS>>1;
+  offsetI = (long) (ADC_COUNTS>>1) << 16;
+  supplyVoltage = 0;
 }
 
 //--------------------------------------------------------------------------------------
@@ -45,7 +66,9 @@ void EnergyMonitor::voltageTX(double _VCAL, double _PHASECAL)
   inPinV = 2;
   VCAL = _VCAL;
   PHASECAL = _PHASECAL;
-  offsetV = ADC_COUNTS>>1;
+  phaseCalQ8 = (PHASECAL > 0) ? PHASECAL * 256 + 0.5 : PHASECAL * 256 - 0.5;
+  offsetV = (long) (ADC_COUNTS>>1) << 16;
+  supplyVoltage = 0;
 }
 
 void EnergyMonitor::currentTX(unsigned int _channel, double _ICAL)
@@ -54,7 +77,24 @@ void EnergyMonitor::currentTX(unsigned int _channel, double _ICAL)
   if (_channel == 2) inPinI = 0;
   if (_channel == 3) inPinI = 1;
   ICAL = _ICAL;
-  offsetI = ADC_COUNTS>>1;
+  offsetI = (long) (ADC_COUNTS>>1) << 16;
+  supplyVoltage = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Supply voltage is measured once and cached. Bandgap measurement takes over 2ms.
+//--------------------------------------------------------------------------------------
+int EnergyMonitor::cachedVcc()
+{
+  if (supplyVoltage == 0)
+  {
+    #if defined emonTxV3
+    supplyVoltage = 3300;
+    #else
+    supplyVoltage = readVcc();
+    #endif
+  }
+  return supplyVoltage;
 }
 
 //--------------------------------------------------------------------------------------
@@ -65,11 +105,7 @@ void EnergyMonitor::currentTX(unsigned int _channel, double _ICAL)
 //--------------------------------------------------------------------------------------
 void EnergyMonitor::calcVI(unsigned int crossings, unsigned int timeout)
 {
-  #if defined emonTxV3
-  int SupplyVoltage=3300;
-  #else
-  int SupplyVoltage = readVcc();
-  #endif
+  int SupplyVoltage = cachedVcc();
 
   unsigned int crossCount = 0;                             //Used to measure number of times threshold is crossed.
   unsigned int numberOfSamples = 0;                        //This is now incremented
@@ -106,34 +142,32 @@ void EnergyMonitor::calcVI(unsigned int crossings, unsigned int timeout)
 
     //-----------------------------------------------------------------------------
     // B) Apply digital low pass filters to extract the 2.5 V or 1.65 V dc offset,
-    //     then subtract this - signal is now centred on 0 counts.
+    //     then subtract this - signal is now centred on 0 counts (Q2).
     //-----------------------------------------------------------------------------
-    offsetV = offsetV + ((sampleV-offsetV)/1024);
-    filteredV = sampleV - offsetV;
-    offsetI = offsetI + ((sampleI-offsetI)/1024);
-    filteredI = sampleI - offsetI;
+    filteredV = lowPassQ2(offsetV, sampleV);
+    filteredI = lowPassQ2(offsetI, sampleI);
 
     //-----------------------------------------------------------------------------
     // C) Root-mean-square method voltage
     //-----------------------------------------------------------------------------
-    sqV= filteredV * filteredV;                 //1) square voltage values
+    sqV = (long) filteredV * filteredV;         //1) square voltage values
     sumV += sqV;                                //2) sum
 
     //-----------------------------------------------------------------------------
     // D) Root-mean-square method current
     //-----------------------------------------------------------------------------
-    sqI = filteredI * filteredI;                //1) square current values
+    sqI = (long) filteredI * filteredI;         //1) square current values
     sumI += sqI;                                //2) sum
 
     //-----------------------------------------------------------------------------
     // E) Phase calibration
     //-----------------------------------------------------------------------------
-    phaseShiftedV = lastFilteredV + PHASECAL * (filteredV - lastFilteredV);
+    phaseShiftedV = phaseShiftQ2(lastFilteredV, filteredV, phaseCalQ8);
 
     //-----------------------------------------------------------------------------
     // F) Instantaneous power calc
     //-----------------------------------------------------------------------------
-    instP = phaseShiftedV * filteredI;          //Instantaneous Power
+    instP = (long) phaseShiftedV * filteredI;   //Instantaneous Power
     sumP +=instP;                               //Sum
 
     //-----------------------------------------------------------------------------
@@ -155,14 +189,16 @@ void EnergyMonitor::calcVI(unsigned int crossings, unsigned int timeout)
   //Calculation of the root of the mean of the voltage and current squared (rms)
   //Calibration coefficients applied.
 
+  //Sums are in Q4 (squares of Q2 values)
+
   double V_RATIO = VCAL *((SupplyVoltage/1000.0) / (ADC_COUNTS));
-  Vrms = V_RATIO * sqrt(sumV / numberOfSamples);
+  Vrms = V_RATIO * sqrt((double) sumV / numberOfSamples) / 4;
 
   double I_RATIO = ICAL *((SupplyVoltage/1000.0) / (ADC_COUNTS));
-  Irms = I_RATIO * sqrt(sumI / numberOfSamples);
+  Irms = I_RATIO * sqrt((double) sumI / numberOfSamples) / 4;
 
   //Calculation power values
-  realPower = V_RATIO * I_RATIO * sumP / numberOfSamples;
+  realPower = V_RATIO * I_RATIO * sumP / numberOfSamples / 16;
   apparentPower = Vrms * Irms;
   powerFactor=realPower / apparentPower;
 
@@ -177,31 +213,25 @@ void EnergyMonitor::calcVI(unsigned int crossings, unsigned int timeout)
 double EnergyMonitor::calcIrms(unsigned int Number_of_Samples)
 {
 
-  #if defined emonTxV3
-    int SupplyVoltage=3300;
-  #else
-    int SupplyVoltage = readVcc();
-  #endif
-
+  int SupplyVoltage = cachedVcc();
 
   for (unsigned int n = 0; n < Number_of_Samples; n++)
   {
     sampleI = analogRead(inPinI);
 
     // Digital low pass filter extracts the 2.5 V or 1.65 V dc offset,
-    //  then subtract this - signal is now centered on 0 counts.
-    offsetI = (offsetI + (sampleI-offsetI)/1024);
-    filteredI = sampleI - offsetI;
+    //  then subtract this - signal is now centered on 0 counts (Q2).
+    filteredI = lowPassQ2(offsetI, sampleI);
 
     // Root-mean-square method current
     // 1) square current values
-    sqI = filteredI * filteredI;
+    sqI = (long) filteredI * filteredI;
     // 2) sum
     sumI += sqI;
   }
 
   double I_RATIO = ICAL *((SupplyVoltage/1000.0) / (ADC_COUNTS));
-  Irms = I_RATIO * sqrt(sumI / Number_of_Samples);
+  Irms = I_RATIO * sqrt((double) sumI / Number_of_Samples) / 4;
 
   //Reset accumulators
   sumI = 0;
@@ -210,6 +240,120 @@ double EnergyMonitor::calcIrms(unsigned int Number_of_Samples)
   return Irms;
 }
 
+//--------------------------------------------------------------------------------------
+// Continuous metering
+// Same math as calcVI, but fed sample by sample from ADC interrupt and done in integers.
+// Sums of whole mains cycles (positive going zero cross of filtered voltage) are handed
+// over to meterRead(), so RMS values are not biased by a partial cycle.
+//--------------------------------------------------------------------------------------
+#define METER_MAX_CYCLE_SAMPLES 127                  //closes cycle without voltage, keeps cycle sums in 32 bits
+
+void EnergyMonitor::meterBegin(unsigned int pairUsec)
+{
+  cachedVcc();                                       //uses ADC, call before sampling is started
+
+  // PHASECAL moves voltage by (PHASECAL - 1) sample pairs. Same move in time
+  // takes more pairs when they come faster than in calcVI()
+  double phaseCal = 1 + (PHASECAL - 1) * CALCVI_PAIR_USEC / pairUsec;
+  meterPhaseCalQ8 = (phaseCal > 0) ? phaseCal * 256 + 0.5 : phaseCal * 256 - 0.5;
+
+  meterSampleV = -1;
+  meterOffsetV = (long) (ADC_COUNTS>>1) << 16;
+  meterOffsetI = (long) (ADC_COUNTS>>1) << 16;
+  meterLastV = 0;
+  meterLastPositive = false;
+  cycleSumV = 0;
+  cycleSumI = 0;
+  cycleSumP = 0;
+  cycleSamples = 0;
+  totalSumV = 0;
+  totalSumI = 0;
+  totalSumP = 0;
+  totalSamples = 0;
+  meterLastRead = micros();
+  realEnergy = 0;
+}
+
+void EnergyMonitor::meterSample(unsigned int pin, int sample)
+{
+  if (pin == inPinV)
+  {
+    meterSampleV = sample;                           //wait for current sample to make a pair
+    return;
+  }
+  if (pin != inPinI || meterSampleV < 0) return;
+
+  //-----------------------------------------------------------------------------
+  // A) Low pass filters extract the dc offset, filtered values are in Q2
+  //-----------------------------------------------------------------------------
+  int fV = lowPassQ2(meterOffsetV, meterSampleV);
+  int fI = lowPassQ2(meterOffsetI, sample);
+
+  //-----------------------------------------------------------------------------
+  // B) Phase calibration and sums
+  //-----------------------------------------------------------------------------
+  int shiftedV = phaseShiftQ2(meterLastV, fV, meterPhaseCalQ8);
+  cycleSumV += (long) fV * fV;
+  cycleSumI += (long) fI * fI;
+  cycleSumP += (long) shiftedV * fI;
+  cycleSamples++;
+
+  //-----------------------------------------------------------------------------
+  // C) Positive going zero cross closes the mains cycle
+  //-----------------------------------------------------------------------------
+  boolean positive = fV >= 0;
+  if ((positive && !meterLastPositive) || cycleSamples >= METER_MAX_CYCLE_SAMPLES) meterFoldCycle();
+  meterLastPositive = positive;
+  meterLastV = fV;
+}
+
+void EnergyMonitor::meterFoldCycle()
+{
+  totalSumV += cycleSumV;
+  totalSumI += cycleSumI;
+  totalSumP += cycleSumP;
+  totalSamples += cycleSamples;
+  cycleSumV = 0;
+  cycleSumI = 0;
+  cycleSumP = 0;
+  cycleSamples = 0;
+}
+
+boolean EnergyMonitor::meterRead()
+{
+  noInterrupts();
+  unsigned long long sumV = totalSumV;
+  unsigned long long sumI = totalSumI;
+  long long sumP = totalSumP;
+  unsigned long numberOfSamples = totalSamples;
+  totalSumV = 0;
+  totalSumI = 0;
+  totalSumP = 0;
+  totalSamples = 0;
+  interrupts();
+
+  // no whole cycle yet. time goes to the next call
+  if (numberOfSamples == 0) return false;
+
+  unsigned long now = micros();
+  unsigned long elapsed = now - meterLastRead;
+  meterLastRead = now;
+
+  double V_RATIO = VCAL *((supplyVoltage/1000.0) / (ADC_COUNTS));
+  Vrms = V_RATIO * sqrt((double) sumV / numberOfSamples) / 4;
+
+  double I_RATIO = ICAL *((supplyVoltage/1000.0) / (ADC_COUNTS));
+  Irms = I_RATIO * sqrt((double) sumI / numberOfSamples) / 4;
+
+  realPower = V_RATIO * I_RATIO * sumP / numberOfSamples / 16;
+  apparentPower = Vrms * Irms;
+  powerFactor = (apparentPower != 0) ? realPower / apparentPower : 0;
+
+  //mean power of every sample taken in the interval times interval length
+  realEnergy = realPower * elapsed / 1000000.0;
+  return true;
+}
+
 void EnergyMonitor::serialprint()
 {
   Serial.print(realPower);
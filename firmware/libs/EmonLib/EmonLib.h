@@ -41,6 +41,12 @@
 
 #define ADC_COUNTS  (1<<ADC_BITS)
 
+// time between voltage samples of original calcVI() loop on 16MHz AVR (~53 pairs
+// per 50Hz cycle). PHASECAL values in use are tuned for it
+#ifndef CALCVI_PAIR_USEC
+#define CALCVI_PAIR_USEC 377
+#endif
+
 
 class EnergyMonitor
 {
@@ -57,12 +63,23 @@ class EnergyMonitor
     void serialprint();
 
     long readVcc();
+
+    //Continuous metering. meterSample() is fed from ADC interrupt with every
+    //voltage and current sample, meterRead() computes values below over all
+    //whole mains cycles sampled since previous call. Nothing is skipped
+    //between calls, so realEnergy integrates without gaps. pairUsec is time
+    //between voltage samples, PHASECAL is rescaled to it from calcVI() timing.
+    void meterBegin(unsigned int pairUsec);
+    void meterSample(unsigned int pin, int sample);
+    boolean meterRead();
+
     //Useful value variables
     double realPower,
       apparentPower,
       powerFactor,
       Vrms,
-      Irms;
+      Irms,
+      realEnergy;                                     //Ws, since previous meterRead()
 
   private:
 
@@ -81,19 +98,45 @@ class EnergyMonitor
     int sampleV;                        //sample_ holds the raw analog read value
     int sampleI;
 
-    double lastFilteredV,filteredV;          //Filtered_ is the raw analog value minus the DC offset
-    double filteredI;
-    double offsetV;                          //Low-pass filter output
-    double offsetI;                          //Low-pass filter output
+    //Fixed point: filtered values in 1/4 ADC counts (Q2), offsets in 1/65536 counts (Q16)
+    int lastFilteredV,filteredV;             //Filtered_ is the raw analog value minus the DC offset
+    int filteredI;
+    long offsetV;                            //Low-pass filter output
+    long offsetI;                            //Low-pass filter output
 
-    double phaseShiftedV;                             //Holds the calibrated phase shifted voltage.
+    int phaseShiftedV;                                //Holds the calibrated phase shifted voltage.
+    int phaseCalQ8;                                   //PHASECAL * 256
 
-    double sqV,sumV,sqI,sumI,instP,sumP;              //sq = squared, sum = Sum, inst = instantaneous
+    long sqV,sqI,instP;                               //sq = squared, sum = Sum, inst = instantaneous
+    unsigned long long sumV,sumI;
+    long long sumP;
+
+    int supplyVoltage;                                //mV, cached readVcc() result
+    int cachedVcc();
 
     int startV;                                       //Instantaneous voltage at start of sample window.
 
     boolean lastVCross, checkVCross;                  //Used to measure number of times threshold is crossed.
 
+    //--------------------------------------------------------------------------------------
+    // Continuous metering state. Updated in interrupt context, same fixed point format.
+    //--------------------------------------------------------------------------------------
+    volatile int meterSampleV;                        //last voltage sample, waits for current one
+    long meterOffsetV, meterOffsetI;
+    int meterPhaseCalQ8;                              //PHASECAL for meter sample timing * 256
+    int meterLastV;
+    boolean meterLastPositive;
+
+    unsigned long cycleSumV, cycleSumI;               //running mains cycle
+    long cycleSumP;
+    unsigned char cycleSamples;
+
+    volatile unsigned long long totalSumV, totalSumI; //whole cycles since previous meterRead()
+    volatile long long totalSumP;
+    volatile unsigned long totalSamples;
+    unsigned long meterLastRead;                      //micros()
+
+    void meterFoldCycle();
 
 };
 
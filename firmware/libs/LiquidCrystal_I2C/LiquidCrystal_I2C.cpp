@@ -29,10 +29,16 @@ LiquidCrystal_I2C::LiquidCrystal_I2C(uint8_t lcd_addr, uint8_t lcd_cols, uint8_t
 	_rows = lcd_rows;
 	_charsize = charsize;
 	_backlightval = LCD_BACKLIGHT;
+	_mode = 0;
+	_busyUsec = 0;
+	_lastSend = 0;
+	_clock = 100000;
+	_byteUsec = 9000000UL / _clock;
 }
 
 void LiquidCrystal_I2C::begin() {
 	Wire.begin();
+	Wire.setClock(_clock);
 	_displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
 
 	if (_rows > 1) {
@@ -91,15 +97,22 @@ void LiquidCrystal_I2C::begin() {
 	home();
 }
 
+void LiquidCrystal_I2C::setClock(uint32_t clock) {
+	_clock = clock;
+	// start/address/stop overhead is not counted, it only makes bytes later
+	_byteUsec = 9000000UL / clock;
+	Wire.setClock(clock);
+}
+
 /********** high level commands, for the user! */
 void LiquidCrystal_I2C::clear(){
 	command(LCD_CLEARDISPLAY);// clear display, set cursor position to zero
-	delayMicroseconds(2000);  // this command takes a long time!
+	_busyUsec = LCD_HOME_USEC;  // this command takes a long time!
 }
 
 void LiquidCrystal_I2C::home(){
 	command(LCD_RETURNHOME);  // set cursor position to zero
-	delayMicroseconds(2000);  // this command takes a long time!
+	_busyUsec = LCD_HOME_USEC;  // this command takes a long time!
 }
 
 void LiquidCrystal_I2C::setCursor(uint8_t col, uint8_t row){
@@ -208,15 +221,58 @@ inline size_t LiquidCrystal_I2C::write(uint8_t value) {
 	return 1;
 }
 
+size_t LiquidCrystal_I2C::write(const uint8_t *buffer, size_t size) {
+	send(buffer, size, Rs);
+	return size;
+}
+
 
 /************ low level data pushing commands **********/
 
 // write either command or data
 void LiquidCrystal_I2C::send(uint8_t value, uint8_t mode) {
-	uint8_t highnib=value&0xf0;
-	uint8_t lownib=(value<<4)&0xf0;
-	write4bits((highnib)|mode);
-	write4bits((lownib)|mode);
+	send(&value, 1, mode);
+}
+
+// write a run of commands or data, batched into transmissions
+void LiquidCrystal_I2C::send(const uint8_t *values, size_t size, uint8_t mode) {
+	// next instruction is latched on enable low of its high nibble, 2 bytes
+	// into the batch. when it's not enough to execute the previous one (bus
+	// much faster than 400kHz), send one byte per transmission
+	uint8_t perBatch = (2 * _byteUsec >= LCD_EXEC_USEC) ? LCD_I2C_BATCH / 4 : 1;
+	size_t i = 0;
+	while (i < size) {
+		waitReady();
+		uint8_t n = 0;
+		Wire.beginTransmission(_addr);
+		if (mode != _mode) {
+			// Rs must settle before enable goes high
+			Wire.write(mode | _backlightval);
+			_mode = mode;
+			n = 1;
+		}
+		for (; i < size && n + 4 <= LCD_I2C_BATCH && n / 4 < perBatch; i++, n += 4) {
+			uint8_t highnib = (values[i] & 0xf0) | mode | _backlightval;
+			uint8_t lownib = ((values[i] << 4) & 0xf0) | mode | _backlightval;
+			Wire.write(highnib | En);
+			Wire.write(highnib);
+			Wire.write(lownib | En);
+			Wire.write(lownib);
+		}
+		Wire.endTransmission();
+		_lastSend = micros();
+		_busyUsec = LCD_EXEC_USEC;
+	}
+}
+
+// wait until the last instruction is executed. the next one is latched 3 bytes
+// into the next transmission (address, high nibble with and without enable)
+void LiquidCrystal_I2C::waitReady() {
+	uint16_t covered = 3 * _byteUsec;
+	if (_busyUsec > covered) {
+		while (micros() - _lastSend < (unsigned long) (_busyUsec - covered));
+	}
+	_busyUsec = 0;
 }
 
 void LiquidCrystal_I2C::write4bits(uint8_t value) {
@@ -225,6 +281,7 @@ void LiquidCrystal_I2C::write4bits(uint8_t value) {
 }
 
 void LiquidCrystal_I2C::expanderWrite(uint8_t _data){
+	_mode = _data & Rs;
 	Wire.beginTransmission(_addr);
 	Wire.write((int)(_data) | _backlightval);
 	Wire.endTransmission();
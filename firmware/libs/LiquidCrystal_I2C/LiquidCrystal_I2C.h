@@ -50,12 +50,31 @@
 #define Rw B00000010  // Read/Write bit
 #define Rs B00000001  // Register select bit
 
+// execution time of HD44780 instructions, us
+#define LCD_EXEC_USEC 37
+#define LCD_HOME_USEC 2000	// clear and home, 1.52ms by datasheet, slower on clones
+
+// bytes per I2C transmission, Wire buffer size
+#ifndef LCD_I2C_BATCH
+#ifdef BUFFER_LENGTH
+#define LCD_I2C_BATCH BUFFER_LENGTH
+#else
+#define LCD_I2C_BATCH 32
+#endif
+#endif
+
 /**
  * This is the driver for the Liquid Crystal LCD displays that use the I2C bus.
  *
  * After creating an instance of this class, first call begin() before anything else.
  * The backlight is on by default, since that is the most likely operating mode in
  * most cases.
+ *
+ * Characters and commands are packed into as few I2C transmissions as the Wire
+ * buffer allows: each byte is 4 expander writes (nibble with enable high, nibble
+ * with enable low). Bus time of the next nibbles covers execution time of the
+ * previous instruction, only clear() and home() leave a wait, which is done
+ * before the next transfer instead of right away.
  */
 class LiquidCrystal_I2C : public Print {
 public:
@@ -75,6 +94,14 @@ public:
 	 */
 	void begin();
 
+	/**
+	 * Set I2C clock, 100000 (default) or 400000 for fast mode. PCF8574 is specified
+	 * for 100kHz only, most backpacks work at 400kHz though.
+	 *
+	 * @param clock	I2C clock, Hz
+	 */
+	void setClock(uint32_t clock);
+
 	 /**
 	  * Remove all the characters currently shown. Next print/write operation will start
 	  * from the first position on LCD display.
@@ -135,6 +162,8 @@ public:
 	void createChar(uint8_t, uint8_t[]);
 	void setCursor(uint8_t, uint8_t);
 	virtual size_t write(uint8_t);
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	using Print::write;
 	void command(uint8_t);
 
 	inline void blink_on() { blink(); }
@@ -149,6 +178,8 @@ public:
 
 private:
 	void send(uint8_t, uint8_t);
+	void send(const uint8_t *, size_t, uint8_t);
+	void waitReady();
 	void write4bits(uint8_t);
 	void expanderWrite(uint8_t);
 	void pulseEnable(uint8_t);
@@ -160,6 +191,11 @@ private:
 	uint8_t _rows;
 	uint8_t _charsize;
 	uint8_t _backlightval;
+	uint8_t _mode;			// Rs currently on expander output
+	uint8_t _byteUsec;		// I2C bus time of one byte
+	uint16_t _busyUsec;		// execution time of the last instruction
+	unsigned long _lastSend;	// end of the last transmission
+	uint32_t _clock;
 };
 
 #endif // FDB_LIQUID_CRYSTAL_I2C_H
@@ -51,6 +51,16 @@ SoftwareSerial *SoftwareSerial::active_object = 0;
 uint8_t SoftwareSerial::_receive_buffer[_SS_MAX_RX_BUFF]; 
 volatile uint8_t SoftwareSerial::_receive_buffer_tail = 0;
 volatile uint8_t SoftwareSerial::_receive_buffer_head = 0;
+SoftwareSerial *SoftwareSerial::transmit_object = 0;
+uint8_t SoftwareSerial::_transmit_buffer[_SS_MAX_TX_BUFF];
+volatile uint8_t SoftwareSerial::_transmit_buffer_tail = 0;
+volatile uint8_t SoftwareSerial::_transmit_buffer_head = 0;
+
+// transmitter state, bits left in current frame (start and data bits, stop
+// bit) and fraction of timer tick carried to the next bit
+static uint8_t tx_shift;
+static uint8_t tx_bits = 0;
+static uint16_t tx_ticks_acc;
 
 //
 // Debugging
@@ -243,6 +253,59 @@ ISR(PCINT2_vect, ISR_ALIASOF(PCINT0_vect));
 ISR(PCINT3_vect, ISR_ALIASOF(PCINT0_vect));
 #endif
 
+// Called once per bit time while transmitting. Start bit is sent one bit time
+// after the byte is taken from the buffer, stop bit lasts until the next call.
+/* static */
+inline void SoftwareSerial::handle_tx_interrupt()
+{
+#ifdef _SS_TX_INTERRUPT
+  SoftwareSerial *o = transmit_object;
+  volatile uint8_t *reg = o->_transmitPortRegister;
+  uint8_t mark = o->_inverse_logic ? 0 : o->_transmitBitMask;
+
+  if (tx_bits == 0)
+  {
+    if (_transmit_buffer_head == _transmit_buffer_tail)
+    {
+      // nothing more to send, line stays idle
+      TIMSK2 &= ~_BV(OCIE2A);
+      TCCR2B = 0;
+      return;
+    }
+    tx_shift = _transmit_buffer[_transmit_buffer_head];
+    _transmit_buffer_head = (_transmit_buffer_head + 1) % _SS_MAX_TX_BUFF;
+    tx_bits = 9;
+    *reg = (*reg & ~o->_transmitBitMask) | (o->_transmitBitMask & ~mark);
+  }
+  else if (tx_bits > 1)
+  {
+    // buffer keeps bytes already inverted for inverse logic
+    if (tx_shift & 1)
+      *reg |= o->_transmitBitMask;
+    else
+      *reg &= ~o->_transmitBitMask;
+    tx_shift >>= 1;
+    tx_bits--;
+  }
+  else
+  {
+    *reg = (*reg & ~o->_transmitBitMask) | mark;
+    tx_bits = 0;
+  }
+
+  // bit time is not whole number of ticks, carry the fraction over
+  tx_ticks_acc = (tx_ticks_acc & 0xFF) + o->_tx_ticks;
+  OCR2A = (tx_ticks_acc >> 8) - 1;
+#endif
+}
+
+#ifdef _SS_TX_INTERRUPT
+ISR(TIMER2_COMPA_vect)
+{
+  SoftwareSerial::handle_tx_interrupt();
+}
+#endif
+
 //
 // Constructor
 //
@@ -251,6 +314,8 @@ SoftwareSerial::SoftwareSerial(uint8_t receivePin, uint8_t transmitPin, bool inv
   _rx_delay_intrabit(0),
   _rx_delay_stopbit(0),
   _tx_delay(0),
+  _tx_ticks(0),
+  _tx_clock_select(0),
   _buffer_overflow(false),
   _inverse_logic(inverse_logic)
 {
@@ -315,6 +380,28 @@ void SoftwareSerial::begin(long speed)
   // timings are the most critical (deviations stack 8 times)
   _tx_delay = subtract_cap(bit_delay, 15 / 4);
 
+#ifdef _SS_TX_INTERRUPT
+  // smallest Timer2 prescaler which fits bit time into 8 bit compare
+  // register, ticks are kept with 8 bit fraction. bit time must leave room
+  // for the interrupt handler, higher speeds are bit-banged as before
+  static const uint16_t prescalers[] = { 1, 8, 32, 64, 128, 256, 1024 };
+  _tx_ticks = 0;
+  for (uint8_t cs = 0; cs < sizeof(prescalers) / sizeof(prescalers[0]); cs++)
+  {
+    uint32_t clock = F_CPU / prescalers[cs];
+    uint32_t ticks = ((clock / speed) << 8) + ((clock % speed) << 8) / speed;
+    if (ticks < (255UL << 8))
+    {
+      if (cs > 0 || ticks >= (128UL << 8))
+      {
+        _tx_ticks = ticks;
+        _tx_clock_select = cs + 1;
+      }
+      break;
+    }
+  }
+#endif
+
   // Only setup rx when we have a valid PCINT for this pin
   if (digitalPinToPCICR(_receivePin)) {
     #if GCC_VERSION > 40800
@@ -419,6 +506,79 @@ size_t SoftwareSerial::write(uint8_t b)
     return 0;
   }
 
+#ifdef _SS_TX_INTERRUPT
+  if (_tx_ticks == 0)
+    return writeBlocking(b);
+
+  if (transmit_object != this)
+  {
+    // other instance owns the timer, let it finish
+    flush();
+  }
+
+  uint8_t next = (_transmit_buffer_tail + 1) % _SS_MAX_TX_BUFF;
+  while (next == _transmit_buffer_head)
+  {
+    // buffer is full, wait for the interrupt to free a slot
+    txPoll();
+  }
+
+  uint8_t oldSREG = SREG;
+  cli();
+  _transmit_buffer[_transmit_buffer_tail] = _inverse_logic ? ~b : b;
+  _transmit_buffer_tail = next;
+  if (!txActive())
+    startTx();
+  SREG = oldSREG;
+  return 1;
+#else
+  return writeBlocking(b);
+#endif
+}
+
+#ifdef _SS_TX_INTERRUPT
+// called with interrupts disabled
+void SoftwareSerial::startTx()
+{
+  transmit_object = this;
+  tx_bits = 0;
+  tx_ticks_acc = _tx_ticks;
+  TCCR2A = _BV(WGM21); // CTC
+  TCCR2B = _tx_clock_select;
+  OCR2A = (tx_ticks_acc >> 8) - 1;
+  TCNT2 = 0;
+  TIFR2 = _BV(OCF2A);
+  TIMSK2 |= _BV(OCIE2A);
+}
+#endif
+
+/* static */
+bool SoftwareSerial::txActive()
+{
+#ifdef _SS_TX_INTERRUPT
+  return TIMSK2 & _BV(OCIE2A);
+#else
+  return false;
+#endif
+}
+
+// run the transmitter by hand when interrupts are disabled, as
+// HardwareSerial does
+/* static */
+void SoftwareSerial::txPoll()
+{
+#ifdef _SS_TX_INTERRUPT
+  if (!(SREG & _BV(SREG_I)) && (TIFR2 & _BV(OCF2A)))
+  {
+    TIFR2 = _BV(OCF2A);
+    handle_tx_interrupt();
+  }
+#endif
+}
+
+// bit-bang a byte with interrupts disabled
+size_t SoftwareSerial::writeBlocking(uint8_t b)
+{
   // By declaring these as local variables, the compiler will put them
   // in registers _before_ disabling interrupts and entering the
   // critical timing sections below, which makes it a lot easier to
@@ -469,7 +629,9 @@ size_t SoftwareSerial::write(uint8_t b)
 
 void SoftwareSerial::flush()
 {
-  // There is no tx buffering, simply return
+  // wait until TX buffer is sent out
+  while (txActive())
+    txPoll();
 }
 
 int SoftwareSerial::peek()
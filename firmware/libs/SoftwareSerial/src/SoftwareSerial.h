@@ -43,6 +43,20 @@ http://arduiniana.org.
 #define _SS_MAX_RX_BUFF 64 // RX buffer size
 #endif
 
+#ifndef _SS_MAX_TX_BUFF
+#define _SS_MAX_TX_BUFF 64 // TX buffer size
+#endif
+
+// Transmit is interrupt driven where Timer2 is available: write() puts the
+// byte into TX buffer and returns, Timer2 compare match interrupt shifts bits
+// out one per bit time. Only one instance transmits at a time. Interrupts stay
+// enabled, but receiving a byte blocks them for a byte time as before, so a
+// byte received during transmit corrupts the byte being sent (before, it was
+// the received byte which was lost).
+#if defined(TIMER2_COMPA_vect)
+#define _SS_TX_INTERRUPT
+#endif
+
 #ifndef GCC_VERSION
 #define GCC_VERSION (__GNUC__ * 10000 + __GNUC_MINOR__ * 100 + __GNUC_PATCHLEVEL__)
 #endif
@@ -65,6 +79,10 @@ private:
   uint16_t _rx_delay_stopbit;
   uint16_t _tx_delay;
 
+  // Timer2 bit time, in timer ticks * 256, and clock select bits
+  uint16_t _tx_ticks;
+  uint8_t _tx_clock_select;
+
   uint16_t _buffer_overflow:1;
   uint16_t _inverse_logic:1;
 
@@ -73,6 +91,10 @@ private:
   static volatile uint8_t _receive_buffer_tail;
   static volatile uint8_t _receive_buffer_head;
   static SoftwareSerial *active_object;
+  static uint8_t _transmit_buffer[_SS_MAX_TX_BUFF];
+  static volatile uint8_t _transmit_buffer_tail;
+  static volatile uint8_t _transmit_buffer_head;
+  static SoftwareSerial *transmit_object;
 
   // private methods
   inline void recv() __attribute__((__always_inline__));
@@ -80,6 +102,10 @@ private:
   void setTX(uint8_t transmitPin);
   void setRX(uint8_t receivePin);
   inline void setRxIntMsk(bool enable) __attribute__((__always_inline__));
+  size_t writeBlocking(uint8_t byte);
+  void startTx();
+  static bool txActive();
+  static void txPoll();
 
   // Return num - sub, or 1 if the result would be < 1
   static uint16_t subtract_cap(uint16_t num, uint16_t sub);
@@ -109,6 +135,7 @@ public:
 
   // public only for easy access by interrupt handlers
   static inline void handle_interrupt() __attribute__((__always_inline__));
+  static inline void handle_tx_interrupt() __attribute__((__always_inline__));
 };
 
 // Arduino 0012 workaround
@@ -1,6 +1,7 @@
 #include "debug.h"
 
 #include <MemoryFree.h>
+#include <probe.h>
 
 const uint8_t MAX_DEBUG_BUFFER_SIZE = 64;
 
@@ -31,6 +32,7 @@ void dbg(Stream *s, const __FlashStringHelper *msg) {
 
 void dbgf(Stream *s, const char *format, ...) {
     if (s) {
+        PROBE_SCOPE(PROBE_DBGF);
         char buf[MAX_DEBUG_BUFFER_SIZE];
         va_list args;
         va_start(args, format);
@@ -47,6 +49,7 @@ void dbgf(Stream *s, const char *format, ...) {
 
 void dbgf(Stream *s, const __FlashStringHelper *format, ...) {
     if (s) {
+        PROBE_SCOPE(PROBE_DBGF);
         // read from flash to memory
         char mfmt[MAX_DEBUG_BUFFER_SIZE];
         int i = 0;
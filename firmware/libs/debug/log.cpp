@@ -0,0 +1,122 @@
+#include "log.h"
+
+#include <MemoryFree.h>
+
+// records are kept as length byte followed by record bytes
+static uint8_t buffer[LOG_BUFFER_SIZE];
+static uint16_t head = 0; // next record to send
+static uint16_t used = 0;
+static uint16_t dropped = 0;
+
+/*============================= Record ======================================*/
+
+static void put(log_record_t &r, const void *value, const uint8_t size) {
+    if (r.length + size > LOG_MAX_RECORD) {
+        // too many arguments, record is dropped on commit
+        r.length = LOG_MAX_RECORD + 1;
+        return;
+    }
+    // AVR and host are both little endian
+    memcpy(r.data + r.length, value, size);
+    r.length += size;
+}
+
+void logBegin(log_record_t &r, const uint16_t id, const bool header) {
+    r.length = 0;
+    put(r, &id, sizeof(id));
+    if (header) {
+        uint32_t ts = millis();
+        int16_t mem = freeMemory();
+        put(r, &ts, sizeof(ts));
+        put(r, &mem, sizeof(mem));
+    }
+}
+
+void logArg(log_record_t &r, const int value) {
+    int16_t v = value;
+    put(r, &v, sizeof(v));
+}
+
+void logArg(log_record_t &r, const unsigned int value) {
+    uint16_t v = value;
+    put(r, &v, sizeof(v));
+}
+
+void logArg(log_record_t &r, const long value) {
+    int32_t v = value;
+    put(r, &v, sizeof(v));
+}
+
+void logArg(log_record_t &r, const unsigned long value) {
+    uint32_t v = value;
+    put(r, &v, sizeof(v));
+}
+
+void logArg(log_record_t &r, const char *value) {
+    size_t len = value ? strnlen(value, LOG_MAX_STRING) : 0;
+    put(r, value, len);
+    put(r, "", 1);
+}
+
+void logArg(log_record_t &r, const __FlashStringHelper *value) {
+    PGM_P p = reinterpret_cast<PGM_P>(value);
+    char c;
+    uint8_t len = 0;
+    while (len++ < LOG_MAX_STRING && (c = pgm_read_byte(p++)) != '\0') {
+        put(r, &c, 1);
+    }
+    put(r, "", 1);
+}
+
+/*============================= Ring buffer =================================*/
+
+void logCommit(log_record_t &r) {
+    if (r.length > LOG_MAX_RECORD || used + r.length + 1 > LOG_BUFFER_SIZE) {
+        if (dropped < 0xFFFF) {
+            dropped++;
+        }
+        return;
+    }
+    uint16_t tail = (head + used) % LOG_BUFFER_SIZE;
+    buffer[tail] = r.length;
+    for (uint8_t i = 0; i < r.length; i++) {
+        tail = (tail + 1) % LOG_BUFFER_SIZE;
+        buffer[tail] = r.data[i];
+    }
+    used += r.length + 1;
+}
+
+// COBS: each run of non-zero bytes is preceded by its length + 1
+static void sendFrame(Stream *s, const uint8_t *data, const uint8_t length) {
+    s->write((uint8_t) 0);
+    uint8_t start = 0;
+    for (uint8_t i = 0; i <= length; i++) {
+        if (i == length || data[i] == 0 || i - start == 254) {
+            s->write((uint8_t) (i - start + 1));
+            s->write(data + start, i - start);
+            start = (i < length && data[i] == 0) ? i + 1 : i;
+        }
+    }
+    s->write((uint8_t) 0);
+}
+
+void logFlush(Stream *s) {
+    if (!s) {
+        return;
+    }
+    uint8_t record[LOG_MAX_RECORD];
+    while (used > 0) {
+        uint8_t length = buffer[head];
+        for (uint8_t i = 0; i < length; i++) {
+            record[i] = buffer[(head + 1 + i) % LOG_BUFFER_SIZE];
+        }
+        head = (head + length + 1) % LOG_BUFFER_SIZE;
+        used -= length + 1;
+        sendFrame(s, record, length);
+    }
+    if (dropped > 0) {
+        uint16_t d[] = { LOG_DROPPED, dropped };
+        dropped = 0;
+        sendFrame(s, (const uint8_t*) d, sizeof(d));
+    }
+}
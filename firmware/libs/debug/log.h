@@ -0,0 +1,133 @@
+#ifndef LOG_H_
+#define LOG_H_
+
+/*
+ * Binary debug log for hot paths.
+ *
+ * A call site puts 16 bit message id and raw argument bytes into a ring
+ * buffer, logFlush() sends buffered records to debug port later, out of the
+ * hot path. Format strings never get into firmware: host decoder
+ * (firmware/bench logdecode) prints text from the same LOG_LIST table.
+ * Messages above LOG_LEVEL compile to nothing.
+ *
+ * On the wire each record is a frame: 0x00, COBS encoded record, 0x00, so text
+ * written by dbg() to the same port stays readable between frames. Record:
+ * id (2 bytes), millis() (4) and freeMemory() (2) when format starts with ':'
+ * (as dbg() prefix), then arguments: char and int types as 2 bytes, long as 4,
+ * strings with terminating zero (cut to LOG_MAX_STRING). Multibyte values are
+ * little endian.
+ */
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+#define LOG_LEVEL_TRACE 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#ifndef LOG_BUFFER_SIZE
+#if defined(__AVR_ATmega2560__)
+#define LOG_BUFFER_SIZE 256
+#else
+#define LOG_BUFFER_SIZE 96
+#endif
+#endif
+
+#define LOG_MAX_RECORD 64
+#define LOG_MAX_STRING 40
+
+// messages. keep order stable -- ids of logs taken from older firmware
+// depend on it. X(name, level, format)
+#define LOG_LIST(X) \
+    X(WIFI_INIT, LOG_LEVEL_INFO, ":wifi:init\n") \
+    X(WIFI_HW_RESET, LOG_LEVEL_INFO, ":wifi:hwReset\n") \
+    X(WIFI_AP_START_OK, LOG_LEVEL_INFO, ":wifi:AP:start:OK:%s\n") \
+    X(WIFI_AP_START_FAIL, LOG_LEVEL_ERROR, ":wifi:AP:start:FAIL:%s\n") \
+    X(WIFI_STA_CONN_OK, LOG_LEVEL_INFO, ":wifi:STA:conn:OK:%s\n") \
+    X(WIFI_STA_CONN_FAIL, LOG_LEVEL_ERROR, ":wifi:STA:conn:FAIL:%s\n") \
+    X(WIFI_STA_DISCONN_OK, LOG_LEVEL_INFO, ":wifi:STA:disconn:OK\n") \
+    X(WIFI_STA_DISCONN_FAIL, LOG_LEVEL_ERROR, ":wifi:STA:disconn:FAIL\n") \
+    X(WIFI_TCP_SRV_UP, LOG_LEVEL_INFO, ":wifi:TCP_SRV:up:%d\n") \
+    X(WIFI_TCP_SRV_UP_FAIL, LOG_LEVEL_ERROR, ":wifi:TCP_SRV:up:FAIL\n") \
+    X(WIFI_TCP_SRV_DOWN_OK, LOG_LEVEL_INFO, ":wifi:TCP_SRV:down:OK\n") \
+    X(WIFI_TCP_SRV_DOWN_FAIL, LOG_LEVEL_ERROR, ":wifi:TCP_SRV:down:FAIL\n") \
+    X(WIFI_SEND, LOG_LEVEL_DEBUG, ":wifi:send:%d:%s\n") \
+    X(WIFI_RECEIVE, LOG_LEVEL_DEBUG, ":wifi:receive:%d:%s\n") \
+    X(WIFI_OUT, LOG_LEVEL_TRACE, "wifi:>>%s") \
+    X(WIFI_IN, LOG_LEVEL_TRACE, "wifi:<<[%s]\n") \
+    X(WIFI_ERR_RECOVERY, LOG_LEVEL_ERROR, ":wifi:ERR_RECOVERY\n") \
+    X(WIFI_ERR_RECONNECT, LOG_LEVEL_ERROR, ":wifi:ERR_RECONNECT\n") \
+    X(WIFI_ERR_RESTART, LOG_LEVEL_ERROR, ":wifi:ERR_RESTART\n") \
+    X(WIFI_DROP_CONN, LOG_LEVEL_INFO, ":wifi:DROP_CONN\n") \
+    X(WIFI_STREAM, LOG_LEVEL_DEBUG, ":wifi:stream:%d:%s\n") \
+    X(WIFI_UPLINK_OPEN, LOG_LEVEL_INFO, ":wifi:uplink:open:%d\n") \
+    X(WIFI_UPLINK_FAIL, LOG_LEVEL_ERROR, ":wifi:uplink:FAIL\n") \
+    X(WIFI_UPLINK_CLOSE, LOG_LEVEL_INFO, ":wifi:uplink:close\n") \
+    X(WIFI_DATAGRAM, LOG_LEVEL_DEBUG, ":wifi:datagram:%d:%u:%s\n") \
+    X(MQTT_CONNECT, LOG_LEVEL_INFO, ":mqtt:connect:%d\n") \
+    X(MQTT_PUBLISH, LOG_LEVEL_DEBUG, ":mqtt:publish:%d:%s\n") \
+    X(MQTT_RECEIVE, LOG_LEVEL_DEBUG, ":mqtt:receive:%u:%s\n") \
+    X(MQTT_SUBSCRIBE_FAIL, LOG_LEVEL_ERROR, ":mqtt:subscribe:FAIL\n") \
+    X(MQTT_TIMEOUT, LOG_LEVEL_ERROR, ":mqtt:timeout\n") \
+    X(WIFI_BREAKER_OPEN, LOG_LEVEL_ERROR, ":wifi:breaker:open:%u\n") \
+    X(WIFI_BREAKER_HALF_OPEN, LOG_LEVEL_INFO, ":wifi:breaker:half-open\n") \
+    X(WIFI_BREAKER_CLOSE, LOG_LEVEL_INFO, ":wifi:breaker:close\n")
+
+#define LOG_ENUM(name, level, format) LOG_##name,
+#define LOG_ATTR_ENUM(name, level, format) \
+    LOG_LEVEL_OF_##name = (level), \
+    LOG_HEADER_OF_##name = ((format)[0] == ':' && (format)[1] != '\0'),
+
+enum log_id {
+    LOG_NONE = 0, //
+    LOG_DROPPED, // records lost on full buffer, %u
+    LOG_LIST(LOG_ENUM) //
+    LOG_COUNT
+};
+
+enum log_attr {
+    LOG_LIST(LOG_ATTR_ENUM) //
+};
+
+// puts message into the buffer when s is set and level is enabled
+#define logMsg(s, name, ...) do { \
+        if (LOG_LEVEL_OF_##name <= LOG_LEVEL && (s)) { \
+            log_record_t __log_record; \
+            logBegin(__log_record, LOG_##name, LOG_HEADER_OF_##name); \
+            logArgs(__log_record, ##__VA_ARGS__); \
+            logCommit(__log_record); \
+        } \
+    } while (0)
+
+typedef struct {
+    uint8_t data[LOG_MAX_RECORD];
+    uint8_t length;
+} log_record_t;
+
+void logBegin(log_record_t &r, const uint16_t id, const bool header);
+void logArg(log_record_t &r, const int value);
+void logArg(log_record_t &r, const unsigned int value);
+void logArg(log_record_t &r, const long value);
+void logArg(log_record_t &r, const unsigned long value);
+void logArg(log_record_t &r, const char *value);
+void logArg(log_record_t &r, const __FlashStringHelper *value);
+void logCommit(log_record_t &r);
+
+// sends buffered records to s
+void logFlush(Stream *s);
+
+inline void logArgs(log_record_t &) {
+}
+
+template<class T, class ... A>
+inline void logArgs(log_record_t &r, const T value, const A ... args) {
+    logArg(r, value);
+    logArgs(r, args...);
+}
+
+#endif /* LOG_H_ */
@@ -0,0 +1,60 @@
+#include "framer.h"
+
+void framerInit(framer_t &f, char *buff, const uint16_t size) {
+    f.buff = buff;
+    f.size = size;
+    f.length = 0;
+    f.complete = false;
+    f.overrun = false;
+    f.overruns = 0;
+    f.lastByteTs = 0;
+    f.buff[0] = '\0';
+}
+
+static uint16_t frameEnd(framer_t &f) {
+    uint16_t length = f.length;
+    bool dropped = f.overrun;
+    f.buff[length] = '\0';
+    f.length = 0;
+    f.overrun = false;
+    if (dropped || length == 0) {
+        // nothing to dispatch: cut frame or '\0' between frames
+        return 0;
+    }
+    f.complete = true;
+    return length;
+}
+
+uint16_t framerRead(framer_t &f, Stream *port) {
+    if (f.complete) {
+        f.complete = false;
+        f.buff[0] = '\0';
+    }
+    int c;
+    while ((c = port->read()) >= 0) {
+        f.lastByteTs = millis();
+        if (c == '\0') {
+            uint16_t length = frameEnd(f);
+            if (length > 0) {
+                return length;
+            }
+        } else if (f.length < f.size) {
+            f.buff[f.length++] = c;
+        } else if (!f.overrun) {
+            f.overrun = true;
+            f.overruns++;
+        }
+    }
+    if ((f.length > 0 || f.overrun) && millis() - f.lastByteTs >= FRAMER_IDLE_MS) {
+        return frameEnd(f);
+    }
+    return 0;
+}
+
+bool framerPending(const framer_t &f) {
+    return f.length > 0 || f.overrun;
+}
+
+uint16_t framerOverruns(const framer_t &f) {
+    return f.overruns;
+}
@@ -0,0 +1,40 @@
+#ifndef FRAMER_H_
+#define FRAMER_H_
+
+/*
+ * Incremental framer of command input (serial, Bluetooth).
+ *
+ * Each call takes only bytes the port already has, so a message coming slowly
+ * is collected over several loop() passes instead of blocking in
+ * readBytesUntil(). A frame ends with '\0', or with FRAMER_IDLE_MS of silence
+ * after its last byte (what Stream timeout of readBytesUntil() did for senders
+ * without terminator). Frame longer than buffer is dropped up to its end and
+ * counted as overrun.
+ */
+
+#include <Arduino.h>
+
+#define FRAMER_IDLE_MS 1000
+
+typedef struct {
+    char *buff;
+    uint16_t size; // of frame, buffer has one more byte for '\0'
+    uint16_t length;
+    bool complete; // buff holds frame returned by the last read
+    bool overrun; // rest of frame is dropped
+    uint16_t overruns;
+    unsigned long lastByteTs;
+} framer_t;
+
+void framerInit(framer_t &f, //
+        char *buff, //
+        const uint16_t size);
+// length of frame completed in buff, 0 if none yet. call again until 0, the
+// next call reuses buff
+uint16_t framerRead(framer_t &f, //
+        Stream *port);
+// part of frame is waiting for more bytes or idle timeout
+bool framerPending(const framer_t &f);
+uint16_t framerOverruns(const framer_t &f);
+
+#endif /* FRAMER_H_ */
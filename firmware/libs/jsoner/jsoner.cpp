@@ -1,6 +1,36 @@
 #include "jsoner.h"
 
 #include <ArduinoJson.h>
+#include <probe.h>
+
+#define DECIMAL_MAX_SIZE 10
+
+/*
+ * Formats fixed-point value (value / 10^decimals) without float math.
+ * Returns pointer into provided buffer (DECIMAL_MAX_SIZE bytes).
+ */
+static const char* formatDecimal(const int16_t value, //
+        const uint8_t decimals, //
+        char *buf) {
+    uint16_t v = (value < 0) ? -(int32_t) value : value;
+    char *p = buf + DECIMAL_MAX_SIZE;
+    *--p = '\0';
+    for (uint8_t i = 0; i < decimals && i < 5; i++) {
+        *--p = '0' + v % 10;
+        v /= 10;
+    }
+    if (decimals) {
+        *--p = '.';
+    }
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v > 0);
+    if (value < 0) {
+        *--p = '-';
+    }
+    return p;
+}
 
 void jsonifyNodeStatus(const uint8_t id, //
         const uint16_t ns, //
@@ -9,6 +39,7 @@ void jsonifyNodeStatus(const uint8_t id, //
         const unsigned long tsf, //
         char *buffer, //
         const size_t bsize) {
+    PROBE_SCOPE(PROBE_JSONIFY_NODE_STATUS);
     DynamicJsonBuffer jsonBuffer(bsize * 2);
     JsonObject& root = jsonBuffer.createObject();
     root[F("m")] = F("csr");
@@ -36,7 +67,9 @@ void jsonifyNodeStateChange(const uint8_t id, //
         const int16_t sensVal[], //
         const uint8_t sensCnt, //
         char *buffer, //
-        const size_t bsize) {
+        const size_t bsize, //
+        const uint8_t decimals) {
+    PROBE_SCOPE(PROBE_JSONIFY_NODE_STATE_CHANGE);
     DynamicJsonBuffer jsonBuffer(bsize * 2);
     JsonObject& root = jsonBuffer.createObject();
     root[F("m")] = F("nsc");
@@ -51,7 +84,12 @@ void jsonifyNodeStateChange(const uint8_t id, //
     for (unsigned int i = 0; i < sensCnt; i++) {
         JsonObject& sens = jsonBuffer.createObject();
         sens[F("id")] = sensId[i];
-        sens[F("v")] = sensVal[i];
+        if (decimals) {
+            char buf[DECIMAL_MAX_SIZE];
+            sens[F("v")] = RawJson(jsonBuffer.strdup(formatDecimal(sensVal[i], decimals, buf)));
+        } else {
+            sens[F("v")] = sensVal[i];
+        }
         sensors.add(sens);
     }
 
@@ -62,6 +100,7 @@ void jsonifySensorValue(const uint8_t id, //
         const int8_t value, //
         char *buffer, //
         const size_t bsize) {
+    PROBE_SCOPE(PROBE_JSONIFY_SENSOR_VALUE);
     DynamicJsonBuffer jsonBuffer(bsize * 2);
     JsonObject& root = jsonBuffer.createObject();
     root[F("m")] = F("csr");
@@ -79,6 +118,7 @@ void jsonifySensorValue(const uint8_t id, //
         const double value, //
         char *buffer, //
         const size_t bsize) {
+    PROBE_SCOPE(PROBE_JSONIFY_SENSOR_VALUE);
     DynamicJsonBuffer jsonBuffer(bsize * 2);
     JsonObject& root = jsonBuffer.createObject();
     root[F("m")] = F("csr");
@@ -97,6 +137,7 @@ void jsonifySensorValue(const uint8_t id, //
         const unsigned long ts, //
         char *buffer, //
         const size_t bsize) {
+    PROBE_SCOPE(PROBE_JSONIFY_SENSOR_VALUE);
     DynamicJsonBuffer jsonBuffer(bsize * 2);
     JsonObject& root = jsonBuffer.createObject();
     root[F("m")] = F("csr");
@@ -111,11 +152,54 @@ void jsonifySensorValue(const uint8_t id, //
     root.printTo(buffer, bsize);
 }
 
+void jsonifySensorDecimal(const uint8_t id, //
+        const int16_t value, //
+        const uint8_t decimals, //
+        char *buffer, //
+        const size_t bsize) {
+    PROBE_SCOPE(PROBE_JSONIFY_SENSOR_VALUE);
+    DynamicJsonBuffer jsonBuffer(bsize * 2);
+    JsonObject& root = jsonBuffer.createObject();
+    root[F("m")] = F("csr");
+
+    char buf[DECIMAL_MAX_SIZE];
+    JsonObject& sens = jsonBuffer.createObject();
+    sens[F("id")] = id;
+    sens[F("v")] = RawJson(formatDecimal(value, decimals, buf));
+
+    root[F("s")] = sens;
+
+    root.printTo(buffer, bsize);
+}
+
+void jsonifySensorDecimal(const uint8_t id, //
+        const int16_t value, //
+        const uint8_t decimals, //
+        const unsigned long ts, //
+        char *buffer, //
+        const size_t bsize) {
+    PROBE_SCOPE(PROBE_JSONIFY_SENSOR_VALUE);
+    DynamicJsonBuffer jsonBuffer(bsize * 2);
+    JsonObject& root = jsonBuffer.createObject();
+    root[F("m")] = F("csr");
+
+    char buf[DECIMAL_MAX_SIZE];
+    JsonObject& sens = jsonBuffer.createObject();
+    sens[F("id")] = id;
+    sens[F("v")] = RawJson(formatDecimal(value, decimals, buf));
+    sens[F("ts")] = ts;
+
+    root[F("s")] = sens;
+
+    root.printTo(buffer, bsize);
+}
+
 void jsonifySensorConfig(const uint8_t id, //
         const __FlashStringHelper *key, //
         const double value, //
         char *buffer, //
         const size_t bsize) {
+    PROBE_SCOPE(PROBE_JSONIFY_SENSOR_CONFIG);
     DynamicJsonBuffer jsonBuffer(bsize * 2);
     JsonObject& root = jsonBuffer.createObject();
     root[F("m")] = F("cfg");
@@ -134,6 +218,7 @@ void jsonifySensorConfig(const uint8_t id, //
         const char *value, //
         char *buffer, //
         const size_t bsize) {
+    PROBE_SCOPE(PROBE_JSONIFY_SENSOR_CONFIG);
     DynamicJsonBuffer jsonBuffer(bsize * 2);
     JsonObject& root = jsonBuffer.createObject();
     root[F("m")] = F("cfg");
@@ -152,6 +237,7 @@ void jsonifySensorConfig(const uint8_t id, //
         const int16_t value, //
         char *buffer, //
         const size_t bsize) {
+    PROBE_SCOPE(PROBE_JSONIFY_SENSOR_CONFIG);
     DynamicJsonBuffer jsonBuffer(bsize * 2);
     JsonObject& root = jsonBuffer.createObject();
     root[F("m")] = F("cfg");
@@ -169,6 +255,7 @@ void jsonifyConfig(const __FlashStringHelper *key, //
         const int value, //
         char *buffer, //
         const size_t bsize) {
+    PROBE_SCOPE(PROBE_JSONIFY_CONFIG);
     DynamicJsonBuffer jsonBuffer(bsize * 2);
     JsonObject& root = jsonBuffer.createObject();
     root[F("m")] = F("cfg");
@@ -181,6 +268,7 @@ void jsonifyConfig(const __FlashStringHelper *key, //
         const char *value, //
         char *buffer, //
         const size_t bsize) {
+    PROBE_SCOPE(PROBE_JSONIFY_CONFIG);
     DynamicJsonBuffer jsonBuffer(bsize * 2);
     JsonObject& root = jsonBuffer.createObject();
     root[F("m")] = F("cfg");
@@ -192,6 +280,7 @@ void jsonifyConfig(const __FlashStringHelper *key, //
 void jsonifyClockSync(const unsigned long value, //
         char *buffer, //
         const size_t bsize) {
+    PROBE_SCOPE(PROBE_JSONIFY_CLOCK_SYNC);
     DynamicJsonBuffer jsonBuffer(bsize * 2);
     JsonObject& root = jsonBuffer.createObject();
     root[F("m")] = F("cls");
@@ -21,7 +21,8 @@ void jsonifyNodeStateChange(const uint8_t id, //
         const int16_t sensVal[], //
         const uint8_t sensCnt, //
         char *buffer, //
-        const size_t bsize);
+        const size_t bsize, //
+        const uint8_t decimals = 0);
 void jsonifySensorValue(const uint8_t id, //
         const int8_t value, //
         char *buffer, //
@@ -35,6 +36,17 @@ void jsonifySensorValue(const uint8_t id, //
         const unsigned long ts, //
         char *buffer, //
         const size_t bsize);
+void jsonifySensorDecimal(const uint8_t id, //
+        const int16_t value, //
+        const uint8_t decimals, //
+        char *buffer, //
+        const size_t bsize);
+void jsonifySensorDecimal(const uint8_t id, //
+        const int16_t value, //
+        const uint8_t decimals, //
+        const unsigned long ts, //
+        char *buffer, //
+        const size_t bsize);
 void jsonifySensorConfig(const uint8_t id, //
         const __FlashStringHelper *key, //
         const double value, //
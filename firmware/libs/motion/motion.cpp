@@ -0,0 +1,214 @@
+#include "motion.h"
+
+// timer tick with prescaler 64
+#define MOTION_TICK_USEC 4
+
+static uint8_t motorPins[MOTION_PIN_COUNT];
+// profile, step intervals in us along the ramp and at max speed
+static uint16_t rampUsec[MOTION_RAMP_MAX];
+static uint16_t cruiseUsec = 0;
+static uint16_t ramp = 1;
+
+// running move (steps left, signed) and queued one
+static volatile long currentMove = 0;
+static volatile long nextMove = 0;
+// steps done in running move
+static volatile long moveDone = 0;
+static volatile long position = 0;
+static volatile uint8_t phase = 0;
+
+#ifdef SREG
+#define ATOMIC_BEGIN uint8_t oldSREG = SREG; cli()
+#define ATOMIC_END SREG = oldSREG
+#else
+#define ATOMIC_BEGIN
+#define ATOMIC_END
+#endif
+
+static uint16_t isqrt(uint32_t v) {
+    uint32_t res = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
+// same coil sequence as Stepper library 4 wire mode: 1010 0110 0101 1001
+static void energize(const uint8_t p) {
+    static const uint8_t PATTERNS[] = { 0b1010, 0b0110, 0b0101, 0b1001 };
+    uint8_t pattern = PATTERNS[p & 0x03];
+    for (uint8_t i = 0; i < MOTION_PIN_COUNT; i++) {
+        digitalWrite(motorPins[i], (pattern & (0b1000 >> i)) ? HIGH : LOW);
+    }
+}
+
+// interval of a step at speed v, v^2 given in (steps/s)^2
+static uint16_t stepUsec(const uint32_t vSq) {
+    // speed in Q4 for sub step/s resolution at low speed
+    return min(16000000UL / isqrt(vSq << 8), 0xFFFFUL);
+}
+
+// interval to the next step, looked up in the profile
+static unsigned long interval() {
+    long left = currentMove < 0 ? -currentMove : currentMove;
+    long n = min(moveDone, left - 1);
+    return n < ramp ? rampUsec[n] : cruiseUsec;
+}
+
+/*============================= Timer interrupt =============================*/
+
+#ifdef TIMER3_COMPA_vect
+
+static void timerStart(const unsigned long us) {
+    OCR3A = us / MOTION_TICK_USEC - 1;
+    TCNT3 = 0;
+    TIFR3 = (1 << OCF3A);
+    TIMSK3 |= (1 << OCIE3A);
+}
+
+static void timerStop() {
+    TIMSK3 &= ~(1 << OCIE3A);
+}
+
+ISR(TIMER3_COMPA_vect) {
+    unsigned long us = motionTick();
+    if (us == 0) {
+        timerStop();
+    } else {
+        OCR3A = us / MOTION_TICK_USEC - 1;
+    }
+}
+
+#else
+
+static void timerStart(const unsigned long) {
+}
+
+static void timerStop() {
+}
+
+#endif
+
+/*============================= Public API ==================================*/
+
+void motionBegin(const uint8_t pins[], //
+        const uint16_t maxSpeed, //
+        const uint16_t startSpeed, //
+        const uint16_t rampSteps) {
+    timerStop();
+    for (uint8_t i = 0; i < MOTION_PIN_COUNT; i++) {
+        motorPins[i] = pins[i];
+        pinMode(motorPins[i], OUTPUT);
+    }
+    // v^2 grows linearly with steps on the ramp, i.e. constant acceleration.
+    // computed once here, timer interrupt only looks intervals up
+    uint32_t maxSpeedSq = (uint32_t) maxSpeed * maxSpeed;
+    uint32_t startSpeedSq = (uint32_t) min(startSpeed, maxSpeed) * min(startSpeed, maxSpeed);
+    ramp = constrain(rampSteps, 1, MOTION_RAMP_MAX);
+    for (uint16_t n = 0; n < ramp; n++) {
+        rampUsec[n] = stepUsec(startSpeedSq + (maxSpeedSq - startSpeedSq) / ramp * n);
+    }
+    cruiseUsec = stepUsec(maxSpeedSq);
+    currentMove = nextMove = moveDone = 0;
+#ifdef TIMER3_COMPA_vect
+    // CTC mode, prescaler 64
+    TCCR3A = 0;
+    TCCR3B = (1 << WGM32) | (1 << CS31) | (1 << CS30);
+#endif
+}
+
+void motionMove(const long steps) {
+    if (steps == 0) {
+        return;
+    }
+    ATOMIC_BEGIN;
+    if (currentMove == 0) {
+        currentMove = steps;
+        moveDone = 0;
+        timerStart(interval());
+    } else if ((currentMove > 0) == (steps > 0)) {
+        // same direction -> cancel
+        nextMove = 0;
+    } else {
+        nextMove = steps;
+    }
+    ATOMIC_END;
+}
+
+void motionStop() {
+    ATOMIC_BEGIN;
+    nextMove = 0;
+    // slow down along the ramp instead of losing steps
+    long n = min(moveDone, (long) ramp);
+    if (currentMove > n) {
+        currentMove = n;
+    } else if (currentMove < -n) {
+        currentMove = -n;
+    }
+    ATOMIC_END;
+}
+
+bool motionBusy() {
+    ATOMIC_BEGIN;
+    bool busy = currentMove != 0 || nextMove != 0;
+    ATOMIC_END;
+    return busy;
+}
+
+long motionPosition() {
+    ATOMIC_BEGIN;
+    long p = position;
+    ATOMIC_END;
+    return p;
+}
+
+long motionRemaining() {
+    ATOMIC_BEGIN;
+    long r = currentMove;
+    ATOMIC_END;
+    return r;
+}
+
+// issues one step, returns interval to the next one in us or 0 if motor stops.
+// called from timer interrupt
+unsigned long motionTick() {
+    if (currentMove == 0) {
+        currentMove = nextMove;
+        nextMove = 0;
+        moveDone = 0;
+        if (currentMove == 0) {
+            return 0;
+        }
+    }
+    if (currentMove > 0) {
+        phase++;
+        position++;
+        currentMove--;
+    } else {
+        phase--;
+        position--;
+        currentMove++;
+    }
+    moveDone++;
+    energize(phase);
+    if (currentMove == 0 && nextMove == 0) {
+        return 0;
+    }
+    if (currentMove == 0) {
+        // reversal starts from standstill
+        currentMove = nextMove;
+        nextMove = 0;
+        moveDone = 0;
+    }
+    return interval();
+}
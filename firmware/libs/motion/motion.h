@@ -0,0 +1,35 @@
+#ifndef MOTION_H_
+#define MOTION_H_
+
+/*
+ * Timer driven step generator for 4 wire stepper motor.
+ *
+ * Steps are issued from Timer3 compare match interrupt (ATmega2560), so motor
+ * speed does not depend on loop() load. Every move runs trapezoidal profile:
+ * speed rises from start speed to max speed over ramp steps with constant
+ * acceleration, and falls back before the move ends. Step intervals are 16 bit
+ * us, so start speed is at least 16 steps/s.
+ *
+ * Moves are queued the same way as current/next move pair: a move requested
+ * while motor runs becomes the next one. Next move in the same direction as
+ * the running one is cancelled, opposite one runs after the running move ends.
+ */
+
+#include <Arduino.h>
+
+#define MOTION_PIN_COUNT 4
+// longest ramp, its step intervals are computed by motionBegin()
+#define MOTION_RAMP_MAX 256
+
+void motionBegin(const uint8_t pins[], //
+        const uint16_t maxSpeed, //
+        const uint16_t startSpeed, //
+        const uint16_t rampSteps);
+void motionMove(const long steps);
+void motionStop();
+bool motionBusy();
+long motionPosition();
+long motionRemaining();
+unsigned long motionTick();
+
+#endif /* MOTION_H_ */
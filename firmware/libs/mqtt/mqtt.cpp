@@ -0,0 +1,357 @@
+#include "mqtt.h"
+#include <log.h>
+
+// fixed header: packet type and flags
+const uint8_t PKT_CONNECT = 0x10;
+const uint8_t PKT_CONNACK = 0x20;
+const uint8_t PKT_PUBLISH = 0x30;
+const uint8_t PKT_PUBACK = 0x40;
+const uint8_t PKT_SUBSCRIBE = 0x82;
+const uint8_t PKT_SUBACK = 0x90;
+const uint8_t PKT_PINGREQ = 0xC0;
+const uint8_t PKT_DISCONNECT = 0xE0;
+
+const uint8_t FLAG_RETAIN = 0x01;
+const uint8_t SUBACK_FAILURE = 0x80;
+
+// protocol name and level, flags (will retain, will, no clean session), keep alive
+const uint8_t CONNECT_HEADER[] = { 0, 4, 'M', 'Q', 'T', 'T', 4, 0x24, MQTT_KEEPALIVE_SEC >> 8, MQTT_KEEPALIVE_SEC
+        & 0xFF };
+const unsigned long PING_INTERVAL_MS = MQTT_KEEPALIVE_SEC * 500UL;
+// broker drops the client after 1.5 keep alive, the client does the same
+const unsigned long RX_TIMEOUT_MS = MQTT_KEEPALIVE_SEC * 1500UL;
+
+enum mqtt_in_state {
+    IN_TYPE = 0, IN_LENGTH = 1, IN_BODY = 2,
+};
+
+static ESP8266 *esp = NULL;
+static Stream *debug = NULL;
+static const char *nodeName = "";
+static const uint8_t *broker = NULL;
+static uint16_t port = 0;
+static mqtt_handler_t onMessage = NULL;
+
+static bool connected = false; // CONNACK accepted
+static int16_t connack = -1; // return code of the last CONNACK
+static uint16_t packetId = 0;
+static unsigned long lastTx = 0;
+static unsigned long lastRx = 0;
+static unsigned long lastPing = 0;
+static unsigned long lastAttempt = 0;
+
+// incoming packet
+static uint8_t packet[MQTT_PACKET_SIZE + 1];
+static uint8_t inState = IN_TYPE;
+static uint8_t inType = 0;
+static uint8_t inShift = 0;
+static uint16_t inLength = 0; // remaining length
+static uint16_t inGot = 0;
+
+static void drop() {
+    connected = false;
+    esp->closeUplink();
+}
+
+/*============================= Outgoing ====================================*/
+
+// fixed header, length bytes of packet follow
+static bool begin(const uint8_t type, const uint16_t length) {
+    uint8_t header[3];
+    uint8_t n = 0;
+    uint16_t l = length;
+    header[n++] = type;
+    do {
+        header[n] = l & 0x7F;
+        l >>= 7;
+        if (l > 0) {
+            header[n] |= 0x80;
+        }
+        n++;
+    } while (l > 0);
+    if (!esp->clientBegin(n + length)) {
+        drop();
+        return false;
+    }
+    esp->clientWrite(header, n);
+    return true;
+}
+
+static void putWord(const uint16_t w) {
+    uint8_t b[] = { (uint8_t) (w >> 8), (uint8_t) w };
+    esp->clientWrite(b, sizeof(b));
+}
+
+static void putString(const char *s) {
+    uint16_t n = strlen(s);
+    putWord(n);
+    esp->clientWrite((const uint8_t*) s, n);
+}
+
+static bool end() {
+    if (!esp->clientEnd()) {
+        connected = false;
+        return false;
+    }
+    lastTx = millis();
+    return true;
+}
+
+static uint16_t nextPacketId() {
+    // zero is not a valid id
+    packetId = packetId % 0xFFFF + 1;
+    return packetId;
+}
+
+static void subscribe(const char *topic) {
+    uint8_t qos = 1;
+    if (begin(PKT_SUBSCRIBE, 2 + 2 + strlen(topic) + 1)) {
+        putWord(nextPacketId());
+        putString(topic);
+        esp->clientWrite(&qos, 1);
+        end();
+    }
+}
+
+static void ack(const uint16_t id) {
+    if (begin(PKT_PUBACK, 2)) {
+        putWord(id);
+        end();
+    }
+}
+
+/*============================= Incoming ====================================*/
+
+static void receive(const uint16_t length) {
+    uint8_t qos = (inType >> 1) & 0x03;
+    if (length < 2) {
+        return;
+    }
+    uint16_t topicLength = (packet[0] << 8) | packet[1];
+    uint16_t pos = 2 + topicLength;
+    uint16_t id = 0;
+    if (qos > 0 && pos + 2 <= length) {
+        id = (packet[pos] << 8) | packet[pos + 1];
+        pos += 2;
+    }
+    if (pos > length) {
+        return;
+    }
+    char topic[MQTT_TOPIC_SIZE + 1];
+    uint16_t n = min(topicLength, (uint16_t) MQTT_TOPIC_SIZE);
+    memcpy(topic, packet + 2, n);
+    topic[n] = '\0';
+    logMsg(debug, MQTT_RECEIVE, qos, topic);
+    logFlush(debug);
+    // payload of cut packet is not a command
+    if (inGot <= MQTT_PACKET_SIZE && onMessage) {
+        packet[length] = '\0';
+        onMessage(topic, (char*) packet + pos);
+    }
+    if (qos > 0) {
+        // QoS 2 is never subscribed, broker downgrades it
+        ack(id);
+    }
+}
+
+static void handle() {
+    uint16_t length = min(inGot, (uint16_t) MQTT_PACKET_SIZE);
+    lastRx = millis();
+    switch (inType & 0xF0) {
+    case PKT_CONNACK:
+        connack = length >= 2 ? packet[1] : 0xFF;
+        connected = connack == 0;
+        break;
+    case PKT_PUBLISH:
+        receive(length);
+        break;
+    case PKT_SUBACK:
+        if (length >= 3 && packet[2] == SUBACK_FAILURE) {
+            logMsg(debug, MQTT_SUBSCRIBE_FAIL);
+        }
+        break;
+    default:
+        // PINGRESP
+        break;
+    }
+}
+
+// true when c completes a packet
+static bool feed(const uint8_t c) {
+    switch (inState) {
+    case IN_TYPE:
+        inType = c;
+        inLength = inGot = 0;
+        inShift = 0;
+        inState = IN_LENGTH;
+        return false;
+    case IN_LENGTH:
+        inLength |= (uint16_t) (c & 0x7F) << inShift;
+        inShift += 7;
+        if (c & 0x80) {
+            if (inShift > 7) {
+                // packets over 16KB are never sent to the node
+                inState = IN_TYPE;
+                drop();
+            }
+            return false;
+        }
+        inState = inLength > 0 ? IN_BODY : IN_TYPE;
+        return inLength == 0;
+    default:
+        if (inGot < MQTT_PACKET_SIZE) {
+            packet[inGot] = c;
+        }
+        inGot++;
+        if (inGot < inLength) {
+            return false;
+        }
+        inState = IN_TYPE;
+        return true;
+    }
+}
+
+static void pump() {
+    int c;
+    while ((c = esp->clientRead()) >= 0) {
+        if (feed(c)) {
+            handle();
+        }
+    }
+}
+
+/*============================= Session =====================================*/
+
+void mqttBegin(ESP8266 *e, const char *node, const uint8_t *brokerIP, const uint16_t brokerPort,
+        mqtt_handler_t handler) {
+    esp = e;
+    nodeName = node;
+    broker = brokerIP;
+    port = brokerPort;
+    onMessage = handler;
+    connected = false;
+    lastAttempt = millis() - MQTT_RECONNECT_MS;
+}
+
+void mqttSetDebug(Stream *s) {
+    debug = s;
+}
+
+bool mqttConnect() {
+    char clientId[MQTT_TOPIC_SIZE];
+    char topic[MQTT_TOPIC_SIZE];
+    lastAttempt = millis();
+    connected = false;
+    connack = -1;
+    inState = IN_TYPE;
+    if (!esp || !esp->clientOpen(broker, port)) {
+        logMsg(debug, MQTT_CONNECT, connack);
+        return false;
+    }
+    snprintf(clientId, sizeof(clientId), "hk-%s", nodeName);
+    snprintf(topic, sizeof(topic), "hk/%s/online", nodeName);
+    uint16_t length = sizeof(CONNECT_HEADER) + 2 + strlen(clientId) + 2 + strlen(topic) + 2 + 1;
+    if (begin(PKT_CONNECT, length)) {
+        esp->clientWrite(CONNECT_HEADER, sizeof(CONNECT_HEADER));
+        putString(clientId);
+        putString(topic);
+        putString("0");
+        if (end()) {
+            unsigned long start = millis();
+            while (connack < 0 && millis() - start < MQTT_CONNECT_TIMEOUT_MS && esp->clientConnected()) {
+                pump();
+            }
+        }
+    }
+    logMsg(debug, MQTT_CONNECT, connack);
+    logFlush(debug);
+    if (!connected) {
+        drop();
+        return false;
+    }
+    lastPing = lastRx = millis();
+    mqttPublish(topic, "1", true);
+    snprintf(topic, sizeof(topic), "hk/%s/cmd", nodeName);
+    subscribe(topic);
+    return connected;
+}
+
+bool mqttConnected() {
+    return connected;
+}
+
+void mqttLoop() {
+    if (!esp) {
+        return;
+    }
+    if (connected && !esp->clientConnected()) {
+        connected = false;
+    }
+    if (!connected) {
+        // no attempt is spent while ESP boots or recovers
+        if (millis() - lastAttempt >= MQTT_RECONNECT_MS && esp->breakerState() != BREAKER_OPEN) {
+            mqttConnect();
+        }
+        return;
+    }
+    pump();
+    unsigned long now = millis();
+    if (now - lastRx > RX_TIMEOUT_MS) {
+        logMsg(debug, MQTT_TIMEOUT);
+        logFlush(debug);
+        drop();
+    } else if (now - lastTx >= PING_INTERVAL_MS
+            || (now - lastRx >= PING_INTERVAL_MS && now - lastPing >= PING_INTERVAL_MS)) {
+        // keeps connection alive and checks that broker still answers
+        lastPing = now;
+        if (begin(PKT_PINGREQ, 0)) {
+            end();
+        }
+    }
+}
+
+int16_t mqttPublish(const char *topic, const char *payload, const bool retain) {
+    int16_t status = -1;
+    uint16_t length = strlen(payload);
+    if (connected && begin(PKT_PUBLISH | (retain ? FLAG_RETAIN : 0), 2 + strlen(topic) + length)) {
+        putString(topic);
+        esp->clientWrite((const uint8_t*) payload, length);
+        if (end()) {
+            status = length;
+        }
+    }
+    logMsg(debug, MQTT_PUBLISH, status, topic);
+    logFlush(debug);
+    return status;
+}
+
+// csr goes to retained state topic of its sensor or node, the rest to topic
+// named after message type
+int16_t mqttReport(const char *json) {
+    char topic[MQTT_TOPIC_SIZE];
+    char kind;
+    int id;
+    char m[8];
+    if (sscanf(json, "{\"m\":\"csr\",\"%c\":{\"id\":%d", &kind, &id) == 2) {
+        snprintf(topic, sizeof(topic), "hk/%s/%c/%d", nodeName, kind, id);
+        return mqttPublish(topic, json, true);
+    }
+    if (sscanf(json, "{\"m\":\"%7[^\"]\"", m) != 1) {
+        strcpy(m, "msg");
+    }
+    snprintf(topic, sizeof(topic), "hk/%s/%s", nodeName, m);
+    return mqttPublish(topic, json, false);
+}
+
+void mqttDisconnect() {
+    char topic[MQTT_TOPIC_SIZE];
+    if (connected) {
+        // will is not sent on DISCONNECT
+        snprintf(topic, sizeof(topic), "hk/%s/online", nodeName);
+        mqttPublish(topic, "0", true);
+        if (begin(PKT_DISCONNECT, 0)) {
+            end();
+        }
+        drop();
+    }
+}
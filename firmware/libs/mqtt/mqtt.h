@@ -0,0 +1,53 @@
+#ifndef MQTT_H_
+#define MQTT_H_
+
+/*
+ * MQTT 3.1.1 client on client link of ESP8266 driver.
+ *
+ * Topics of a node (name given to mqttBegin()):
+ *   hk/<node>/s/<id>, hk/<node>/n/<id>  state of sensor and node (csr), retained
+ *   hk/<node>/<m>                       other messages (nsc, ...)
+ *   hk/<node>/online                    "1", will message "0", retained
+ *   hk/<node>/cmd                       commands, subscribed with QoS 1
+ *
+ * Messages are published with QoS 0. Session is persistent (clean session
+ * off), so broker keeps commands while the node is offline and sends them
+ * again until PUBACK. PUBACK goes after handler returns, a command may come
+ * twice if connection drops in between.
+ *
+ * mqttLoop() from loop() takes packets which came from ESP, sends PINGREQ and
+ * reconnects. Connect waits for CONNACK, up to 3s.
+ */
+
+#include <Arduino.h>
+#include <ESP8266.h>
+
+#define MQTT_KEEPALIVE_SEC 60
+#define MQTT_RECONNECT_MS 15000 // between connect attempts
+#define MQTT_CONNECT_TIMEOUT_MS 3000
+#define MQTT_TOPIC_SIZE 32
+#ifndef MQTT_PACKET_SIZE
+#define MQTT_PACKET_SIZE 160 // incoming packet, payload of larger one is cut
+#endif
+
+typedef void (*mqtt_handler_t)(const char *topic, //
+        char *payload);
+
+void mqttBegin(ESP8266 *esp, //
+        const char *node, //
+        const uint8_t *brokerIP, //
+        const uint16_t brokerPort, //
+        mqtt_handler_t handler);
+void mqttSetDebug(Stream *port);
+bool mqttConnect();
+bool mqttConnected();
+void mqttLoop();
+// payload length, -1 if it's not sent
+int16_t mqttPublish(const char *topic, //
+        const char *payload, //
+        const bool retain);
+// JSON message of node to its topic
+int16_t mqttReport(const char *json);
+void mqttDisconnect();
+
+#endif /* MQTT_H_ */
@@ -0,0 +1,72 @@
+#ifndef PROBE_H_
+#define PROBE_H_
+
+/*
+ * Cycle probes for simavr based benchmarking (see firmware/bench/simavr).
+ *
+ * Probe begin/end marks are written to GPIOR1/GPIOR2. Each mark is a single
+ * OUT instruction, simulator catches the write and records cycle counter.
+ * Probes compile to nothing unless BENCH_PROBES is defined.
+ */
+
+// probe ids. keep order stable -- simbench reports use the same table
+#define PROBE_LIST(X) \
+    X(LOOP) \
+    X(LOOP_SENSORS) \
+    X(LOOP_CIRCUITS) \
+    X(LOOP_SERIAL) \
+    X(LOOP_BT) \
+    X(LOOP_WIFI) \
+    X(LOOP_REPORT) \
+    X(SENSOR_VALUE) \
+    X(SENSOR_POWER_STATE) \
+    X(PARSE_COMMAND) \
+    X(BROADCAST) \
+    X(DBGF) \
+    X(JSONIFY_NODE_STATUS) \
+    X(JSONIFY_NODE_STATE_CHANGE) \
+    X(JSONIFY_SENSOR_VALUE) \
+    X(JSONIFY_SENSOR_CONFIG) \
+    X(JSONIFY_CONFIG) \
+    X(JSONIFY_CLOCK_SYNC)
+
+#define PROBE_ENUM(name) PROBE_##name,
+
+enum probe_id {
+    PROBE_NONE = 0, //
+    PROBE_LIST(PROBE_ENUM) //
+    PROBE_COUNT
+};
+
+#ifdef BENCH_PROBES
+
+#include <avr/io.h>
+
+#define PROBE_BEGIN(id) (GPIOR1 = (id))
+#define PROBE_END(id) (GPIOR2 = (id))
+
+#ifdef __cplusplus
+class ProbeScope {
+public:
+    ProbeScope(const uint8_t id) :
+            id(id) {
+        PROBE_BEGIN(id);
+    }
+    ~ProbeScope() {
+        PROBE_END(id);
+    }
+private:
+    const uint8_t id;
+};
+#define PROBE_SCOPE(id) ProbeScope __probe_scope(id)
+#endif
+
+#else
+
+#define PROBE_BEGIN(id)
+#define PROBE_END(id)
+#define PROBE_SCOPE(id)
+
+#endif
+
+#endif /* PROBE_H_ */
@@ -0,0 +1,223 @@
+#include "sampler.h"
+
+typedef struct {
+    uint8_t pin;
+    uint8_t head;
+    uint8_t count;
+    uint16_t last;
+    uint32_t sum;
+    uint16_t buf[SAMPLER_BUFFER_SIZE];
+} sampler_channel_t;
+
+static volatile sampler_channel_t channels[SAMPLER_MAX_CHANNELS];
+static uint8_t channelCount = 0;
+static uint8_t triggerMode = SAMPLER_TRIGGER_TIMER0;
+static sampler_hook_t sampleHook = NULL;
+
+#ifdef SREG
+#define ATOMIC_BEGIN uint8_t oldSREG = SREG; cli()
+#define ATOMIC_END SREG = oldSREG
+#else
+#define ATOMIC_BEGIN
+#define ATOMIC_END
+#endif
+
+static int channelIdx(const uint8_t pin) {
+    for (uint8_t i = 0; i < channelCount; i++) {
+        if (channels[i].pin == pin) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static uint16_t isqrt(uint32_t v) {
+    uint32_t res = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
+/*============================= ADC interrupt ===============================*/
+
+#ifdef ADC_vect
+
+// channel of completed conversion and channel of the next one
+static volatile uint8_t current = 0;
+static volatile uint8_t next = 0;
+
+static void selectChannel(uint8_t pin) {
+    if (pin >= A0) {
+        pin -= A0;
+    }
+#ifdef MUX5
+    ADCSRB = (ADCSRB & ~(1 << MUX5)) | (((pin >> 3) & 0x01) << MUX5);
+#endif
+    // AVcc reference, same as analogRead() default
+    ADMUX = (1 << REFS0) | (pin & 0x07);
+}
+
+ISR(ADC_vect) {
+    uint16_t v = ADC;
+    samplerPush(current, v);
+    if (triggerMode == SAMPLER_TRIGGER_FREE) {
+        // next conversion is already running with previously selected channel
+        current = next;
+    }
+    if (++next >= channelCount) {
+        next = 0;
+    }
+    if (triggerMode != SAMPLER_TRIGGER_FREE) {
+        current = next;
+    }
+    selectChannel(channels[next].pin);
+}
+
+#endif
+
+/*============================= Public API ==================================*/
+
+void samplerBegin(const uint8_t pins[], //
+        const uint8_t count, //
+        const uint8_t trigger) {
+    samplerStop();
+    triggerMode = trigger;
+    channelCount = min(count, (uint8_t) SAMPLER_MAX_CHANNELS);
+    for (uint8_t i = 0; i < channelCount; i++) {
+        channels[i].pin = pins[i];
+        channels[i].head = 0;
+        channels[i].count = 0;
+        channels[i].last = 0;
+        channels[i].sum = 0;
+    }
+    samplerStart();
+}
+
+void samplerSetHook(sampler_hook_t hook) {
+    ATOMIC_BEGIN;
+    sampleHook = hook;
+    ATOMIC_END;
+}
+
+void samplerStart() {
+#ifdef ADC_vect
+    if (channelCount == 0) {
+        return;
+    }
+    ATOMIC_BEGIN;
+    current = next = 0;
+    selectChannel(channels[0].pin);
+    // auto trigger source: Timer0 overflow or free running
+    ADCSRB &= ~((1 << ADTS2) | (1 << ADTS1) | (1 << ADTS0));
+    if (triggerMode != SAMPLER_TRIGGER_FREE) {
+        ADCSRB |= (1 << ADTS2);
+    }
+    // enable, auto trigger, interrupt, clear pending flag, prescaler 128
+    ADCSRA = (1 << ADEN) | (1 << ADATE) | (1 << ADIE) | (1 << ADIF) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+    if (triggerMode == SAMPLER_TRIGGER_FREE) {
+        // first conversion starts free running mode
+        ADCSRA |= (1 << ADSC);
+    }
+    ATOMIC_END;
+#endif
+}
+
+void samplerStop() {
+#ifdef ADC_vect
+    ADCSRA &= ~((1 << ADATE) | (1 << ADIE));
+    // let conversion in progress finish before analogRead() takes ADC over
+    while (ADCSRA & (1 << ADSC))
+        ;
+#endif
+}
+
+void samplerPush(const uint8_t idx, //
+        const uint16_t value) {
+    if (idx >= channelCount) {
+        return;
+    }
+    volatile sampler_channel_t *ch = &channels[idx];
+    uint16_t old = ch->buf[ch->head];
+    ch->buf[ch->head] = value;
+    ch->head = (ch->head + 1) & (SAMPLER_BUFFER_SIZE - 1);
+    if (ch->count < SAMPLER_BUFFER_SIZE) {
+        ch->count++;
+    } else {
+        ch->sum -= old;
+    }
+    ch->sum += value;
+    ch->last = value;
+    if (sampleHook) {
+        sampleHook(ch->pin, value);
+    }
+}
+
+uint16_t samplerLast(const uint8_t pin) {
+    int idx = channelIdx(pin);
+    if (idx < 0) {
+        return 0;
+    }
+    ATOMIC_BEGIN;
+    uint16_t v = channels[idx].last;
+    ATOMIC_END;
+    return v;
+}
+
+uint16_t samplerMean(const uint8_t pin) {
+    int idx = channelIdx(pin);
+    if (idx < 0) {
+        return 0;
+    }
+    ATOMIC_BEGIN;
+    uint8_t n = channels[idx].count;
+    uint32_t sum = channels[idx].sum;
+    ATOMIC_END;
+    return (n > 0) ? (sum + n / 2) / n : 0;
+}
+
+bool samplerStats(const uint8_t pin, //
+        sampler_stats_t *stats) {
+    stats->count = stats->mean = stats->peak = stats->rms = 0;
+    int idx = channelIdx(pin);
+    if (idx < 0) {
+        return false;
+    }
+    volatile sampler_channel_t *ch = &channels[idx];
+    ATOMIC_BEGIN;
+    uint8_t n = ch->count;
+    uint32_t sum = ch->sum;
+    ATOMIC_END;
+    if (n == 0) {
+        return false;
+    }
+    uint16_t mean = (sum + n / 2) / n;
+    uint16_t peak = 0;
+    uint32_t sq = 0;
+    // window keeps moving while scanned. it's fine for statistics
+    for (uint8_t i = 0; i < n; i++) {
+        ATOMIC_BEGIN;
+        uint16_t v = ch->buf[i];
+        ATOMIC_END;
+        uint16_t d = (v > mean) ? v - mean : mean - v;
+        if (d > peak) {
+            peak = d;
+        }
+        sq += (uint32_t) d * d;
+    }
+    stats->count = n;
+    stats->mean = mean;
+    stats->peak = peak;
+    stats->rms = isqrt(sq / n);
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+/*
+ * Background ADC sampler.
+ *
+ * ADC conversions are auto triggered by Timer0 overflow (~976Hz with Arduino
+ * core timer settings) or free running (~9.6kHz, prescaler 128). Conversion
+ * complete interrupt stores the result into per channel ring buffer and
+ * switches multiplexer to the next configured channel. Readers get the latest
+ * value, window mean, peak and RMS instantly. Optional hook gets every sample
+ * in interrupt context.
+ *
+ * analogRead() must not be used while sampler is running. Call samplerStop()
+ * before it and samplerStart() after.
+ */
+
+#include <Arduino.h>
+
+#define SAMPLER_MAX_CHANNELS 4
+#define SAMPLER_TRIGGER_TIMER0 0
+#define SAMPLER_TRIGGER_FREE 1
+#ifndef SAMPLER_BUFFER_SIZE
+#define SAMPLER_BUFFER_SIZE 64 // samples per channel. power of 2, max 128
+#endif
+
+typedef struct {
+    uint8_t count; // samples in window
+    uint16_t mean;
+    uint16_t peak; // max deviation from mean
+    uint16_t rms; // deviation from mean
+} sampler_stats_t;
+
+typedef void (*sampler_hook_t)(const uint8_t pin, const uint16_t value);
+
+void samplerBegin(const uint8_t pins[], //
+        const uint8_t count, //
+        const uint8_t trigger = SAMPLER_TRIGGER_TIMER0);
+void samplerSetHook(sampler_hook_t hook);
+void samplerStart();
+void samplerStop();
+void samplerPush(const uint8_t idx, //
+        const uint16_t value);
+uint16_t samplerLast(const uint8_t pin);
+uint16_t samplerMean(const uint8_t pin);
+bool samplerStats(const uint8_t pin, //
+        sampler_stats_t *stats);
+
+#endif /* SAMPLER_H_ */
@@ -5,13 +5,22 @@
 #include <EEPROMex.h>
 #include <ArduinoJson.h>
 #include <SoftwareSerial.h>
-#include <Stepper.h>
+#include <motion.h>
 #include <Servo.h>
 #include <EmonLib.h>
 
 #include <debug.h>
 #include <ESP8266.h>
+#ifdef WIFI_MQTT_PORT
+#include <mqtt.h>
+#if defined(WIFI_UPLINK_PORT) || defined(WIFI_TELEMETRY_PORT)
+#error "MQTT takes client link of ESP8266, uplink and telemetry can't share it"
+#endif
+#endif
+#include <framer.h>
 #include <jsoner.h>
+#include <probe.h>
+#include <sampler.h>
 
 #define __DEBUG__
 
@@ -24,6 +33,9 @@ const uint8_t SENSOR_CURRENT_METER_PIN = A0;
 const uint8_t SENSOR_VOLTAGE_METER_PIN = A1;
 const uint8_t SENSOR_WATER_PUMP_POWER_PIN = A2;
 
+// Analog sensors sampled in background. voltage goes right before current
+const uint8_t SENSORS_ANALOG[] = { SENSOR_VOLTAGE_METER_PIN, SENSOR_CURRENT_METER_PIN, SENSOR_WATER_PUMP_POWER_PIN };
+
 const uint8_t SENSOR_TEMP_IN = (54 + 16) + (4 * 2) + 0;
 const uint8_t SENSOR_HUM_IN = (54 + 16) + (4 * 2) + 1;
 const uint8_t SENSOR_TEMP_OUT = (54 + 16) + (4 * 2) + 2;
@@ -44,7 +56,11 @@ const uint8_t MOTOR_PIN_2 = 9;
 const uint8_t MOTOR_PIN_3 = 10;
 const uint8_t MOTOR_PIN_4 = 11;
 const uint8_t MOTOR_PIN_5 = 12; // red
-const uint8_t MOTOR_STEPS = 32;
+// coil order as Stepper library takes it
+const uint8_t MOTOR_PINS[] = { MOTOR_PIN_1, MOTOR_PIN_3, MOTOR_PIN_2, MOTOR_PIN_4 };
+const uint16_t MOTOR_MAX_SPEED = 427; // steps/s, ~2.3ms per step
+const uint16_t MOTOR_START_SPEED = 100; // steps/s
+const uint16_t MOTOR_RAMP_STEPS = 256;
 const uint16_t MOTOR_STEPS_PER_REVOLUTION = 2048;
 const uint8_t REVOLUTION_COUNT = 15; // max 15
 
@@ -68,6 +84,7 @@ const uint8_t HEARTBEAT_LED = 13;
 // etc
 const unsigned long MAX_TIMESTAMP = -1;
 const int16_t UNKNOWN_SENSOR_VALUE = -127;
+const int16_t UNKNOWN_TEMP_VALUE = UNKNOWN_SENSOR_VALUE * 10; // 0.1C
 const unsigned long NODE_SWITCH_SAFE_TIME_SEC = 30;
 const uint8_t NODE_ERROR_STATE = 2;
 
@@ -77,10 +94,12 @@ const unsigned long SENSORS_READ_INTERVAL_SEC = 10; // 10 seconds
 const uint16_t WIFI_FAILURE_GRACE_PERIOD_SEC = 180; // 3 minutes
 
 // ventilation
-const int8_t TEMP_IN_OUT_HIST = 3;
+const int16_t TEMP_IN_OUT_HIST = 30; // 0.1C
 
 // sensor WaterPumpPower
 const int8_t SENSOR_WATER_PUMP_POWER_THERSHOLD = 60;
+// state change is accepted after this number of consecutive reads
+const uint8_t SENSOR_WATER_PUMP_POWER_CONFIRM_COUNT = 2;
 
 // min grid voltage
 const uint8_t MIN_UAC_VALUE = 90;
@@ -89,6 +108,8 @@ const uint8_t MIN_UAC_VALUE = 90;
 const uint8_t SERVO_POSITION_OFF = 18;
 const uint8_t SERVO_POSITION_ON = 108;
 const uint8_t SERVO_POSITION_EXTRA = 12;
+const unsigned long SERVO_MOVE_MS = 1000;
+const unsigned long PV_LOAD_SENSOR_TIMEOUT_MS = 500;
 
 const uint8_t JSON_MAX_SIZE = 64;
 
@@ -96,15 +117,16 @@ const uint8_t JSON_MAX_SIZE = 64;
 
 //// Sensors
 // Values
-int8_t tempIn = 0;
-int8_t humIn = 0;
-int8_t tempOut = 0;
-int8_t humOut = 0;
+int16_t tempIn = 0; // 0.1C
+int16_t humIn = 0; // 0.1%
+int16_t tempOut = 0; // 0.1C
+int16_t humOut = 0; // 0.1%
 double uac = 0; // V
 double iac = 0; // A
 double pac = 0; // W
-double eac = 0; // Wh
+int32_t eac = 0; // Ws
 int8_t sensorWaterPumpPowerState = 0;
+uint8_t sensorWaterPumpPowerChangeCount = 0;
 
 //// Nodes
 
@@ -119,13 +141,16 @@ uint16_t NODE_PERMANENTLY_FORCED_MODE_FLAGS = 0;
 // setup mode for servo (set it to 0)
 uint8_t SERVO_SETUP_MODE = 0;
 
-// Stepper moves
-int motorCurrentMove = 0;
-int motorNextMove = 0;
 
 // Servo switch error timestamp
 unsigned long tsNodePvLoadSwitchError = 0;
 
+// Actuator sequence in progress
+actuator_step_t actuatorSteps[ACTUATOR_MAX_STEPS];
+uint8_t actuatorStepCount = 0;
+uint8_t actuatorStepIdx = 0;
+unsigned long tsActuatorStep = 0; // ms
+
 // Nodes switch timestamps
 unsigned long tsNodeVentilation = 0;
 unsigned long tsNodePvLoadSwitch = 0;
@@ -176,8 +201,6 @@ DHT dhtOut(DHT_OUT_PIN, DHT22);
 // Energy monitor
 EnergyMonitor emon;
 
-// Stepper
-Stepper motor(MOTOR_STEPS, MOTOR_PIN_1, MOTOR_PIN_3, MOTOR_PIN_2, MOTOR_PIN_4);
 
 // Servo
 Servo servo;
@@ -190,14 +213,26 @@ HardwareSerial *debug = serial;
 HardwareSerial *debug = NULL;
 #endif
 
+// command input, collected across loop() passes
+char serialFrame[JSON_MAX_SIZE + 1];
+framer_t serialFramer;
+
 //WiFi
 HardwareSerial *wifi = &Serial3;
 ESP8266 esp8266;
+// state of node forced by HTTP request, sent back in its response
+char wifiReply[JSON_MAX_SIZE];
+// HTTP server, "POST /" is what gateway sends
+const char * const HTTP_ROUTES[] = { "POST /", "POST /cmd", "GET /status", "GET /config" };
+enum http_route {
+    ROUTE_ROOT = 0, ROUTE_CMD = 1, ROUTE_STATUS = 2, ROUTE_CONFIG = 3,
+};
 
 void setup() {
     // Setup serial ports
     serial->begin(57600);
     // wifi->begin(57600); // initialized in ESP8266 lib
+    framerInit(serialFramer, serialFrame, JSON_MAX_SIZE);
 
     dbg(debug, F(":STARTING\n"));
 
@@ -205,6 +240,10 @@ void setup() {
     pinMode(HEARTBEAT_LED, OUTPUT);
     digitalWrite(HEARTBEAT_LED, LOW);
 
+    // init DHT sensors. measured in background from loop()
+    dhtIn.begin();
+    dhtOut.begin();
+
     // init water pump power sensor
     pinMode(SENSOR_WATER_PUMP_POWER_PIN, INPUT);
 
@@ -218,13 +257,19 @@ void setup() {
     // init energy meter
     emon.current(SENSOR_CURRENT_METER_PIN, 42.00);    // 47 Ohm - 42.55
     emon.voltage(SENSOR_VOLTAGE_METER_PIN, 190, -1.3); // ~ 1024000 / Vcc
+    // one 104us ADC conversion per sampled channel
+    emon.meterBegin(sizeof(SENSORS_ANALOG) / sizeof(SENSORS_ANALOG[0]) * 104);
+
+    // start background sampling of analog sensors. ~3.2kHz per channel
+    samplerSetHook(onSample);
+    samplerBegin(SENSORS_ANALOG, sizeof(SENSORS_ANALOG) / sizeof(SENSORS_ANALOG[0]), SAMPLER_TRIGGER_FREE);
 
-    // init motor
+    // init motor. steps are issued from timer interrupt
     pinMode(MOTOR_PIN_5, OUTPUT);
     digitalWrite(MOTOR_PIN_5, HIGH);
-    motor.setSpeed(800);
+    motionBegin(MOTOR_PINS, MOTOR_MAX_SPEED, MOTOR_START_SPEED, MOTOR_RAMP_STEPS);
     // default: closed state
-    motorCurrentMove = MOTOR_STEPS_PER_REVOLUTION * REVOLUTION_COUNT;
+    motionMove((long) MOTOR_STEPS_PER_REVOLUTION * REVOLUTION_COUNT);
 
     // restore forced node state flags from EEPROM
     // default node state -- OFF
@@ -232,7 +277,7 @@ void setup() {
 
     // open ventilation valve if needed
     if (NODE_STATE_FLAGS & NODE_VENTILATION_BIT) {
-        motorNextMove = -MOTOR_STEPS_PER_REVOLUTION * REVOLUTION_COUNT;
+        motionMove(-(long) MOTOR_STEPS_PER_REVOLUTION * REVOLUTION_COUNT);
     }
 
     // init esp8266 hw reset pin. N/A
@@ -241,51 +286,83 @@ void setup() {
     // setup WiFi
     loadWifiConfig();
     dbgf(debug, F(":setup wifi:R_AP:%s\n"), &WIFI_REMOTE_AP);
-    esp8266.init(wifi, MODE_STA, WIFI_RST_PIN, WIFI_FAILURE_GRACE_PERIOD_SEC);
+    // circuits don't wait for WiFi: ESP is set up in loop() by update()
+    esp8266.boot(wifi, MODE_STA, WIFI_RST_PIN, WIFI_FAILURE_GRACE_PERIOD_SEC);
     esp8266.connect(&WIFI_REMOTE_AP, &WIFI_REMOTE_PW);
+    esp8266.setRoutes(HTTP_ROUTES, sizeof(HTTP_ROUTES) / sizeof(HTTP_ROUTES[0]));
     esp8266.startTcpServer(TCP_SERVER_PORT);
-    esp8266.getStaIP(WIFI_STA_IP);
-    dbgf(debug, F("STA IP: %d.%d.%d.%d\n"), WIFI_STA_IP[0], WIFI_STA_IP[1], WIFI_STA_IP[2], WIFI_STA_IP[3]);
+#ifdef WIFI_MQTT_PORT
+    // broker runs next to logserver, connects once WiFi is up
+    mqttBegin(&esp8266, "mom", SERVER_IP, WIFI_MQTT_PORT, processMqttMsg);
+    mqttSetDebug(debug);
+#endif
+
+    // the first loop() reads sensors and runs circuits
+    tsLastSensorRead = getTimestamp() - SENSORS_READ_INTERVAL_SEC;
 }
 
 void loop() {
+    PROBE_BEGIN(PROBE_LOOP);
     tsCurr = getTimestamp();
+    // DHT transactions, only one sensor is busy at a time
+    dhtIn.update();
+    dhtOut.update();
     if (diffTimestamps(tsCurr, tsLastSensorRead) >= SENSORS_READ_INTERVAL_SEC) {
+        PROBE_BEGIN(PROBE_LOOP_SENSORS);
         readSensors();
         tsLastSensorRead = tsCurr;
+        PROBE_END(PROBE_LOOP_SENSORS);
 
+        PROBE_BEGIN(PROBE_LOOP_CIRCUITS);
         // pv load switch
         processPvLoadSwitch();
         // ventilation valve
         processVentilationValve();
+        PROBE_END(PROBE_LOOP_CIRCUITS);
 
         digitalWrite(HEARTBEAT_LED, digitalRead(HEARTBEAT_LED) ^ 1);
     }
 
-    if (serial->available() > 0) {
+    if (serial->available() > 0 || framerPending(serialFramer)) {
+        PROBE_BEGIN(PROBE_LOOP_SERIAL);
         processSerialMsg();
+        PROBE_END(PROBE_LOOP_SERIAL);
     }
-    if (wifi->available() > 0) {
+    if (esp8266.available() > 0) {
+        PROBE_BEGIN(PROBE_LOOP_WIFI);
         processWifiMsg();
+        PROBE_END(PROBE_LOOP_WIFI);
     }
+    esp8266.update();
+#ifdef WIFI_MQTT_PORT
+    mqttLoop();
+#endif
 
     if (diffTimestamps(tsCurr, tsLastStatusReport) >= STATUS_REPORTING_PERIOD_SEC) {
+        PROBE_BEGIN(PROBE_LOOP_REPORT);
         reportStatus();
         tsLastStatusReport = tsCurr;
+        PROBE_END(PROBE_LOOP_REPORT);
     }
 
-    stepMotor();
+    // PV load switch servos
+    stepActuators();
 
     tsPrev = tsCurr;
+    PROBE_END(PROBE_LOOP);
 }
 
 /*========================= Node processing methods =========================*/
 
 void processPvLoadSwitch() {
     if (SERVO_SETUP_MODE) {
-        // servo setup mode. position all servos to OFF
-        moveServo(PV_LOAD_SWITCH_ON_GRID_PIN, SERVO_POSITION_OFF);
-        moveServo(PV_LOAD_SWITCH_OFF_GRID_PIN, SERVO_POSITION_OFF);
+        if (!actuatorsBusy()) {
+            setupPvLoadSwitches();
+        }
+        return;
+    }
+    if (actuatorsBusy()) {
+        // switches are moving, feedback is not settled yet
         return;
     }
     uint16_t wasForceMode = NODE_FORCED_MODE_FLAGS & NODE_PV_LOAD_SWITCH_BIT;
@@ -412,9 +489,9 @@ void switchNodeState(uint8_t id, uint8_t sensId[], int16_t sensVal[], uint8_t se
         NODE_STATE_FLAGS = NODE_STATE_FLAGS ^ bit;
 
         if (NODE_STATE_FLAGS & NODE_VENTILATION_BIT) {
-            motorNextMove = -MOTOR_STEPS_PER_REVOLUTION * REVOLUTION_COUNT;
+            motionMove(-(long) MOTOR_STEPS_PER_REVOLUTION * REVOLUTION_COUNT);
         } else {
-            motorNextMove = MOTOR_STEPS_PER_REVOLUTION * REVOLUTION_COUNT;
+            motionMove((long) MOTOR_STEPS_PER_REVOLUTION * REVOLUTION_COUNT);
         }
 
         *ts = getTimestamp();
@@ -435,7 +512,7 @@ void switchNodeState(uint8_t id, uint8_t sensId[], int16_t sensVal[], uint8_t se
     if (ts != NULL) {
         char json[JSON_MAX_SIZE];
         jsonifyNodeStateChange(id, nodeState(bit), *ts, NODE_FORCED_MODE_FLAGS & bit, *tsf, sensId, sensVal, sensCnt,
-                               json, JSON_MAX_SIZE);
+                               json, JSON_MAX_SIZE, 1);
         broadcastMsg(json);
     }
 }
@@ -447,12 +524,15 @@ void forceNodeState(uint8_t id, uint8_t state, unsigned long ts) {
         jsonifyNodeStatus(NODE_VENTILATION, nodeState(NODE_VENTILATION_BIT), tsNodeVentilation,
                 NODE_FORCED_MODE_FLAGS & NODE_VENTILATION_BIT, tsForcedNodeVentilation, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_PV_LOAD_SWITCH == id) {
         forceNodeState(NODE_PV_LOAD_SWITCH, NODE_PV_LOAD_SWITCH_BIT, state, tsForcedNodePvLoadSwitch, ts);
         char json[JSON_MAX_SIZE];
         jsonifyNodeStatus(NODE_PV_LOAD_SWITCH, nodeState(NODE_PV_LOAD_SWITCH_BIT), tsNodePvLoadSwitch,
                           NODE_FORCED_MODE_FLAGS & NODE_PV_LOAD_SWITCH_BIT, tsForcedNodePvLoadSwitch, json,
                           JSON_MAX_SIZE);
+        broadcastMsg(json);
+        replyMsg(json);
     }
     // update node modes in EEPROM if forced permanently
     if (ts == 0) {
@@ -489,6 +569,7 @@ void unForceNodeState(uint8_t id) {
         jsonifyNodeStatus(NODE_VENTILATION, nodeState(NODE_VENTILATION_BIT), tsNodeVentilation,
                           NODE_FORCED_MODE_FLAGS & NODE_VENTILATION_BIT, tsForcedNodeVentilation, json, JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     } else if (NODE_PV_LOAD_SWITCH == id) {
         NODE_FORCED_MODE_FLAGS = NODE_FORCED_MODE_FLAGS & ~NODE_PV_LOAD_SWITCH_BIT;
         NODE_PERMANENTLY_FORCED_MODE_FLAGS = NODE_PERMANENTLY_FORCED_MODE_FLAGS & ~NODE_PV_LOAD_SWITCH_BIT;
@@ -497,6 +578,7 @@ void unForceNodeState(uint8_t id) {
                           NODE_FORCED_MODE_FLAGS & NODE_PV_LOAD_SWITCH_BIT, tsForcedNodePvLoadSwitch, json,
                           JSON_MAX_SIZE);
         broadcastMsg(json);
+        replyMsg(json);
     }
     // update node modes in EEPROM if unforced from permanent
     if (prevPermanentlyForcedModeFlags != NODE_PERMANENTLY_FORCED_MODE_FLAGS) {
@@ -504,28 +586,6 @@ void unForceNodeState(uint8_t id) {
     }
 }
 
-void stepMotor() {
-    if (motorCurrentMove == 0) {
-        motorCurrentMove = motorNextMove;
-        motorNextMove = 0;
-    }
-    if (motorCurrentMove > 0) {
-        motor.step(1); //close
-        motorCurrentMove--;
-        if (motorNextMove > 0) {
-            // same direction -> cancel
-            motorNextMove = 0;
-        }
-    } else if (motorCurrentMove < 0) {
-        motor.step(-1); //open
-        motorCurrentMove++;
-        if (motorNextMove < 0) {
-            // same direction -> cancel
-            motorNextMove = 0;
-        }
-    }
-}
-
 void syncPvLoadSwitches() {
     // clear error
     NODE_ERROR_FLAGS = NODE_ERROR_FLAGS & ~NODE_PV_LOAD_SWITCH_BIT;
@@ -534,61 +594,113 @@ void syncPvLoadSwitches() {
     dbgf(debug, F(":SyncPvSwitch:ong/offg/err/errTs:%d/%d/%d/%d\n"), digitalRead(PV_LOAD_SENSOR_ON_GRID_PIN),
          digitalRead(PV_LOAD_SENSOR_OFF_GRID_PIN), NODE_ERROR_FLAGS & NODE_PV_LOAD_SWITCH_BIT, tsNodePvLoadSwitchError);
 
+    uint8_t offSwitch, offSensor, onSwitch, onSensor;
     if (NODE_STATE_FLAGS & NODE_PV_LOAD_SWITCH_BIT) {
         // On-grid requested
-        // 1. switch OFF off-grid
-        moveServo(PV_LOAD_SWITCH_OFF_GRID_PIN, SERVO_POSITION_OFF - SERVO_POSITION_EXTRA);
-        moveServo(PV_LOAD_SWITCH_OFF_GRID_PIN, SERVO_POSITION_OFF);
-        // check state
-        if (digitalRead(PV_LOAD_SENSOR_OFF_GRID_PIN) == LOW) {
-            // step 1 success. continue
-            // 2. switch ON on-grid
-            moveServo(PV_LOAD_SWITCH_ON_GRID_PIN, SERVO_POSITION_ON + SERVO_POSITION_EXTRA);
-            moveServo(PV_LOAD_SWITCH_ON_GRID_PIN, SERVO_POSITION_ON);
-            // check state
-            if (digitalRead(PV_LOAD_SENSOR_ON_GRID_PIN) == LOW) {
-                // still OFF. Error!
-                NODE_ERROR_FLAGS = NODE_ERROR_FLAGS | NODE_PV_LOAD_SWITCH_BIT;
-                tsNodePvLoadSwitchError = tsCurr;
-            }
-        } else {
-            // still ON. Error!
-            NODE_ERROR_FLAGS = NODE_ERROR_FLAGS | NODE_PV_LOAD_SWITCH_BIT;
-            tsNodePvLoadSwitchError = tsCurr;
-        }
+        offSwitch = PV_LOAD_SWITCH_OFF_GRID_PIN;
+        offSensor = PV_LOAD_SENSOR_OFF_GRID_PIN;
+        onSwitch = PV_LOAD_SWITCH_ON_GRID_PIN;
+        onSensor = PV_LOAD_SENSOR_ON_GRID_PIN;
     } else {
         // Off-grid requested
-        // 1. switch OFF on-grid
-        moveServo(PV_LOAD_SWITCH_ON_GRID_PIN, SERVO_POSITION_OFF - SERVO_POSITION_EXTRA);
-        moveServo(PV_LOAD_SWITCH_ON_GRID_PIN, SERVO_POSITION_OFF);
-        // check state
-        if (digitalRead(PV_LOAD_SENSOR_ON_GRID_PIN) == LOW) {
-            // step 1 success. continue
-            // 2. switch ON off-grid
-            moveServo(PV_LOAD_SWITCH_OFF_GRID_PIN, SERVO_POSITION_ON + SERVO_POSITION_EXTRA);
-            moveServo(PV_LOAD_SWITCH_OFF_GRID_PIN, SERVO_POSITION_ON);
-            // check state
-            if (digitalRead(PV_LOAD_SENSOR_OFF_GRID_PIN) == LOW) {
-                // still OFF. Error
-                NODE_ERROR_FLAGS = NODE_ERROR_FLAGS | NODE_PV_LOAD_SWITCH_BIT;
-                tsNodePvLoadSwitchError = tsCurr;
+        offSwitch = PV_LOAD_SWITCH_ON_GRID_PIN;
+        offSensor = PV_LOAD_SENSOR_ON_GRID_PIN;
+        onSwitch = PV_LOAD_SWITCH_OFF_GRID_PIN;
+        onSensor = PV_LOAD_SENSOR_OFF_GRID_PIN;
+    }
+    // 1. switch OFF the other inverter, 2. switch ON requested one.
+    // each switch is overdriven first, then released to its position
+    const actuator_step_t steps[] = { //
+            { ACTUATOR_SERVO, offSwitch, SERVO_POSITION_OFF - SERVO_POSITION_EXTRA }, //
+            { ACTUATOR_SERVO, offSwitch, SERVO_POSITION_OFF }, //
+            { ACTUATOR_WAIT_SENSOR, offSensor, LOW }, //
+            { ACTUATOR_SERVO, onSwitch, SERVO_POSITION_ON + SERVO_POSITION_EXTRA }, //
+            { ACTUATOR_SERVO, onSwitch, SERVO_POSITION_ON }, //
+            { ACTUATOR_WAIT_SENSOR, onSensor, HIGH } };
+    startActuators(steps, sizeof(steps) / sizeof(steps[0]));
+}
+
+void setupPvLoadSwitches() {
+    // servo setup mode. position all servos to OFF
+    const actuator_step_t steps[] = { //
+            { ACTUATOR_SERVO, PV_LOAD_SWITCH_ON_GRID_PIN, SERVO_POSITION_OFF }, //
+            { ACTUATOR_SERVO, PV_LOAD_SWITCH_OFF_GRID_PIN, SERVO_POSITION_OFF } };
+    startActuators(steps, sizeof(steps) / sizeof(steps[0]));
+}
+
+/*========================= Actuator sequencer ==============================*/
+
+void startActuators(const actuator_step_t steps[], const uint8_t count) {
+    // new sequence replaces running one. it starts from switching OFF, so
+    // it's safe at any point
+    servo.detach();
+    actuatorStepCount = min(count, ACTUATOR_MAX_STEPS);
+    for (uint8_t i = 0; i < actuatorStepCount; i++) {
+        actuatorSteps[i] = steps[i];
+    }
+    actuatorStepIdx = 0;
+    beginActuatorStep();
+}
+
+void beginActuatorStep() {
+    tsActuatorStep = millis();
+    if (actuatorStepIdx >= actuatorStepCount) {
+        return;
+    }
+    const actuator_step_t *step = &actuatorSteps[actuatorStepIdx];
+    if (step->action == ACTUATOR_SERVO) {
+        servo.write(step->value);
+        servo.attach(step->pin);
+    }
+}
+
+bool actuatorsBusy() {
+    return actuatorStepIdx < actuatorStepCount;
+}
+
+// called from loop(). steps running sequence without waiting
+void stepActuators() {
+    if (!actuatorsBusy()) {
+        return;
+    }
+    const actuator_step_t *step = &actuatorSteps[actuatorStepIdx];
+    unsigned long elapsed = millis() - tsActuatorStep;
+    if (step->action == ACTUATOR_SERVO) {
+        if (elapsed < SERVO_MOVE_MS) {
+            return;
+        }
+        servo.detach();
+    } else if (step->action == ACTUATOR_WAIT_SENSOR) {
+        if (digitalRead(step->pin) != step->value) {
+            if (elapsed < PV_LOAD_SENSOR_TIMEOUT_MS) {
+                return;
             }
-        } else {
-            // still ON. Error
+            // switch didn't follow. Error!
+            actuatorStepCount = 0;
             NODE_ERROR_FLAGS = NODE_ERROR_FLAGS | NODE_PV_LOAD_SWITCH_BIT;
             tsNodePvLoadSwitchError = tsCurr;
+            finishActuators();
+            return;
         }
     }
+    actuatorStepIdx++;
+    beginActuatorStep();
+    if (!actuatorsBusy()) {
+        finishActuators();
+    }
+}
 
+void finishActuators() {
     dbgf(debug, F(":SyncPvSwitch:ong/offg/err/errTs:%d/%d/%d/%d\n"), digitalRead(PV_LOAD_SENSOR_ON_GRID_PIN),
          digitalRead(PV_LOAD_SENSOR_OFF_GRID_PIN), NODE_ERROR_FLAGS & NODE_PV_LOAD_SWITCH_BIT, tsNodePvLoadSwitchError);
-}
-
-void moveServo(uint8_t servoId, uint8_t pos) {
-    servo.write(pos);
-    servo.attach(servoId);
-    delay(1000);
-    servo.detach();
+    if (NODE_ERROR_FLAGS & NODE_PV_LOAD_SWITCH_BIT) {
+        // state change was reported when sequence started
+        char json[JSON_MAX_SIZE];
+        jsonifyNodeStatus(NODE_PV_LOAD_SWITCH, nodeState(NODE_PV_LOAD_SWITCH_BIT), tsNodePvLoadSwitch,
+                          NODE_FORCED_MODE_FLAGS & NODE_PV_LOAD_SWITCH_BIT, tsForcedNodePvLoadSwitch, json,
+                          JSON_MAX_SIZE);
+        broadcastMsg(json);
+    }
 }
 
 /*====================== Load/Save configuration in EEPROM ==================*/
@@ -622,39 +734,33 @@ void validateStringParam(char* str, int maxSize) {
 /*====================== Sensors processing methods =========================*/
 
 void readSensors() {
-    float v;
-    v = dhtIn.readTemperature();
-    tempIn = (int8_t) (v > 0) ? v + 0.5 : v - 0.5;
-    v = dhtIn.readHumidity();
-    humIn = (int8_t) (v > 0) ? v + 0.5 : v - 0.5;
+    tempIn = toDeci(dhtIn.readTemperature());
+    humIn = toDeci(dhtIn.readHumidity());
     dbgf(debug, F(":tempIn/humIn:%d/%d\n"), tempIn, humIn);
-    v = dhtOut.readTemperature();
-    tempOut = (int8_t) (v > 0) ? v + 0.5 : v - 0.5;
-    v = dhtOut.readHumidity();
-    humOut = (int8_t) (v > 0) ? v + 0.5 : v - 0.5;
+    tempOut = toDeci(dhtOut.readTemperature());
+    humOut = toDeci(dhtOut.readHumidity());
     dbgf(debug, F(":tempOut/humOut:%d/%d\n"), tempOut, humOut);
 
-    emon.calcVI(20, 2000);
-    uac = emon.Vrms;
-    iac = emon.Irms;
-    pac = emon.realPower;
-    if (pac < 0) {
-        // reverse flow (production)
-        iac = iac * (-1);
+    if (emon.meterRead()) {
+        uac = emon.Vrms;
+        iac = emon.Irms;
+        pac = emon.realPower;
+        if (pac < 0) {
+            // reverse flow (production)
+            iac = iac * (-1);
+        }
+        eac += lround(emon.realEnergy);
     }
-    eac += (pac / (60 * 60)) * (tsCurr - tsLastSensorRead);
     dbgf(debug, F(":uac/iac/pac:%d/%d/%d\n"), (int) round(uac), (int) round(iac), (int) round(pac));
 
     // read sensorWaterPumpPower value
-    uint8_t retry = 3;
-    int8_t state = 0;
-    // if state changed perform several retries to sort out possible errors
-    while (retry > 0 && (state = getSensorWaterPumpPowerState()) != sensorWaterPumpPowerState) {
-        delay(1000);
-        retry--;
-    }
-    if (state != sensorWaterPumpPowerState) {
+    int8_t state = getSensorWaterPumpPowerState();
+    // if state changed wait for confirmation to sort out possible errors
+    if (state == sensorWaterPumpPowerState) {
+        sensorWaterPumpPowerChangeCount = 0;
+    } else if (++sensorWaterPumpPowerChangeCount >= SENSOR_WATER_PUMP_POWER_CONFIRM_COUNT) {
         // state changed
+        sensorWaterPumpPowerChangeCount = 0;
         sensorWaterPumpPowerState = state;
         tsSensorWaterPumpPower = tsCurr;
         char json[JSON_MAX_SIZE];
@@ -664,23 +770,31 @@ void readSensors() {
     }
 }
 
-int8_t getSensorWaterPumpPowerState() {
-    uint16_t max = 0;
-    for (uint8_t i = 0; i < 100; i++) {
-        uint16_t v = abs(analogRead(SENSOR_WATER_PUMP_POWER_PIN) - 512);
-        if (v > max && v < 1000) { // filter out error values. correct value should be <1000
-            max = v;
-        }
-        delay(1);
+void onSample(const uint8_t pin, const uint16_t value) {
+    // ADC interrupt context
+    emon.meterSample(pin, value);
+}
+
+int16_t toDeci(const float v) {
+    // DHT lib reports NaN on read failure
+    if (isnan(v)) {
+        return UNKNOWN_TEMP_VALUE;
     }
-    uint8_t state = (max > SENSOR_WATER_PUMP_POWER_THERSHOLD) ? 1 : 0;
-    dbgf(debug, F(":WaterPumpPower:%d/%d\n"), max, state);
+    return (int16_t) ((v > 0) ? v * 10 + 0.5 : v * 10 - 0.5);
+}
+
+int8_t getSensorWaterPumpPowerState() {
+    PROBE_SCOPE(PROBE_SENSOR_POWER_STATE);
+    sampler_stats_t stats;
+    samplerStats(SENSOR_WATER_PUMP_POWER_PIN, &stats);
+    uint8_t state = (stats.peak > SENSOR_WATER_PUMP_POWER_THERSHOLD) ? 1 : 0;
+    dbgf(debug, F(":WaterPumpPower:%d/%d\n"), stats.peak, state);
     return state;
 }
 
 bool validSensorValues(const int16_t values[], const uint8_t size) {
     for (int i = 0; i < size; i++) {
-        if (values[i] == UNKNOWN_SENSOR_VALUE) {
+        if (values[i] == UNKNOWN_TEMP_VALUE) {
             return false;
         }
     }
@@ -690,54 +804,65 @@ bool validSensorValues(const int16_t values[], const uint8_t size) {
 /*============================ Reporting ====================================*/
 
 void reportStatus() {
+    statusItems(reportMsg);
+    eac = 0; // reset energy counter
+}
+
+// entries of status report, snapshot of GET /status. meter values change on
+// every read, so ETag of the snapshot follows them and polls rarely get 304
+void statusItems(void (*out)(const char*)) {
     char json[JSON_MAX_SIZE];
 
-    jsonifySensorValue(SENSOR_TEMP_IN, tempIn, json, JSON_MAX_SIZE);
-    broadcastMsg(json);
-    jsonifySensorValue(SENSOR_HUM_IN, humIn, json, JSON_MAX_SIZE);
-    broadcastMsg(json);
-    jsonifySensorValue(SENSOR_TEMP_OUT, tempOut, json, JSON_MAX_SIZE);
-    broadcastMsg(json);
-    jsonifySensorValue(SENSOR_HUM_OUT, humOut, json, JSON_MAX_SIZE);
-    broadcastMsg(json);
+    jsonifySensorDecimal(SENSOR_TEMP_IN, tempIn, 1, json, JSON_MAX_SIZE);
+    out(json);
+    jsonifySensorDecimal(SENSOR_HUM_IN, humIn, 1, json, JSON_MAX_SIZE);
+    out(json);
+    jsonifySensorDecimal(SENSOR_TEMP_OUT, tempOut, 1, json, JSON_MAX_SIZE);
+    out(json);
+    jsonifySensorDecimal(SENSOR_HUM_OUT, humOut, 1, json, JSON_MAX_SIZE);
+    out(json);
 
     jsonifySensorValue(SENSOR_UAC, uac, json, JSON_MAX_SIZE);
-    broadcastMsg(json);
+    out(json);
     jsonifySensorValue(SENSOR_IAC, iac, json, JSON_MAX_SIZE);
-    broadcastMsg(json);
+    out(json);
     jsonifySensorValue(SENSOR_PAC, pac, json, JSON_MAX_SIZE);
-    broadcastMsg(json);
-    jsonifySensorValue(SENSOR_EAC, eac, json, JSON_MAX_SIZE);
-    broadcastMsg(json);
-    eac = 0; // reset energy counter
+    out(json);
+    // Ws -> 0.1Wh
+    jsonifySensorDecimal(SENSOR_EAC, (int16_t) ((eac > 0) ? (eac + 180) / 360 : (eac - 180) / 360), 1, json,
+                         JSON_MAX_SIZE);
+    out(json);
     jsonifySensorValue(SENSOR_WATER_PUMP_POWER, sensorWaterPumpPowerState, tsSensorWaterPumpPower, json, JSON_MAX_SIZE);
-    broadcastMsg(json);
+    out(json);
 
     jsonifyNodeStatus(NODE_VENTILATION, nodeState(NODE_VENTILATION_BIT), tsNodeVentilation,
                       NODE_FORCED_MODE_FLAGS & NODE_VENTILATION_BIT, tsForcedNodeVentilation, json, JSON_MAX_SIZE);
-    broadcastMsg(json);
+    out(json);
     jsonifyNodeStatus(NODE_PV_LOAD_SWITCH, nodeState(NODE_PV_LOAD_SWITCH_BIT), tsNodePvLoadSwitch,
                       NODE_FORCED_MODE_FLAGS & NODE_PV_LOAD_SWITCH_BIT, tsForcedNodePvLoadSwitch, json, JSON_MAX_SIZE);
-    broadcastMsg(json);
+    out(json);
 }
 
-void reportConfiguration() {
+// walked twice by respondItems(), so no AT commands here. lip is WIFI_STA_IP
+// as the caller has read it
+void reportConfiguration(void (*out)(const char*), bool secrets) {
     char json[JSON_MAX_SIZE];
     char ip[16];
 
     jsonifyConfig(F("rap"), WIFI_REMOTE_AP, json, JSON_MAX_SIZE);
-    serial->println(json);
-    jsonifyConfig(F("rpw"), WIFI_REMOTE_PW, json, JSON_MAX_SIZE);
-    serial->println(json);
+    out(json);
+    if (secrets) {
+        jsonifyConfig(F("rpw"), WIFI_REMOTE_PW, json, JSON_MAX_SIZE);
+        out(json);
+    }
     sprintf(ip, "%d.%d.%d.%d", SERVER_IP[0], SERVER_IP[1], SERVER_IP[2], SERVER_IP[3]);
     jsonifyConfig(F("sip"), ip, json, JSON_MAX_SIZE);
-    serial->println(json);
+    out(json);
     jsonifyConfig(F("sp"), SERVER_PORT, json, JSON_MAX_SIZE);
-    serial->println(json);
+    out(json);
     sprintf(ip, "%d.%d.%d.%d", WIFI_STA_IP[0], WIFI_STA_IP[1], WIFI_STA_IP[2], WIFI_STA_IP[3]);
     jsonifyConfig(F("lip"), ip, json, JSON_MAX_SIZE);
-    serial->println(json);
-    dbgf(debug, F(":EEPROM:written:%d bytes\n"), eepromWriteCount);
+    out(json);
 }
 
 void reportTimestamp() {
@@ -758,30 +883,94 @@ uint16_t nodeState(uint16_t bit) {
 /*========================= Communication ===================================*/
 
 void processSerialMsg() {
-    char buff[JSON_MAX_SIZE + 1];
-    uint16_t l = serial->readBytesUntil('\0', buff, JSON_MAX_SIZE);
-    buff[l] = '\0';
-    parseCommand(buff);
+    uint16_t overruns = framerOverruns(serialFramer);
+    while (framerRead(serialFramer, serial) > 0) {
+        parseCommand(serialFrame);
+    }
+    if (framerOverruns(serialFramer) != overruns) {
+        dbgf(debug, F(":serial:overrun:%u\n"), framerOverruns(serialFramer));
+    }
 }
 
 void processWifiMsg() {
     char buff[JSON_MAX_SIZE + 1];
     unsigned long start = millis();
-    uint8_t l = esp8266.receive(buff, JSON_MAX_SIZE);
-    if (l > 0) {
-        dbgf(debug, F(":HTTP:receive:%d bytes:[%d msec]\n"), l, millis() - start);
+    switch (esp8266.request(buff, JSON_MAX_SIZE)) {
+    case ROUTE_ROOT:
+    case ROUTE_CMD:
+        dbgf(debug, F(":HTTP:receive:%d bytes:[%d msec]\n"), strlen(buff), millis() - start);
+        wifiReply[0] = '\0';
         parseCommand(buff);
+        esp8266.respond(wifiReply[0] ? wifiReply : NULL);
+        break;
+    case ROUTE_STATUS:
+        esp8266.respondItems(statusItems);
+        dbgf(debug, F(":HTTP:status:[%d msec]\n"), millis() - start);
+        break;
+    case ROUTE_CONFIG:
+        esp8266.getStaIP(WIFI_STA_IP);
+        esp8266.respondItems(configItems);
+        dbgf(debug, F(":HTTP:config:[%d msec]\n"), millis() - start);
+        break;
+    default:
+        break;
     }
 }
 
+// GET /config is open to LAN, password is not in it
+void configItems(void (*out)(const char*)) {
+    reportConfiguration(out, false);
+}
+
+#ifdef WIFI_MQTT_PORT
+// commands published to hk/<node>/cmd
+void processMqttMsg(const char* topic, char* payload) {
+    dbgf(debug, F(":MQTT:receive:%s\n"), topic);
+    parseCommand(payload);
+}
+#endif
+
 void broadcastMsg(const char* msg) {
+    PROBE_SCOPE(PROBE_BROADCAST);
     serial->println(msg);
     unsigned long start = millis();
+#if defined(WIFI_MQTT_PORT)
+    // to broker, state is retained on hk/<node>/s/<id> and hk/<node>/n/<id>
+    int status = mqttReport(msg);
+#elif defined(WIFI_UPLINK_PORT)
+    // to logserver collector over persistent connection
+    int status = esp8266.stream(SERVER_IP, WIFI_UPLINK_PORT, msg);
+#else
     int status = esp8266.send(SERVER_IP, SERVER_PORT, msg);
+#endif
     dbgf(debug, F(":HTTP:send:%d:[%d msec]\n"), status, millis() - start);
 }
 
+void reportMsg(const char* msg) {
+#ifdef WIFI_TELEMETRY_PORT
+    PROBE_SCOPE(PROBE_BROADCAST);
+    serial->println(msg);
+    unsigned long start = millis();
+    int status = esp8266.datagram(SERVER_IP, WIFI_TELEMETRY_PORT, msg);
+    dbgf(debug, F(":UDP:send:%d:[%d msec]\n"), status, millis() - start);
+#else
+    broadcastMsg(msg);
+#endif
+}
+
+// to serial only
+void printMsg(const char* msg) {
+    serial->println(msg);
+}
+
+// response to HTTP request being processed
+void replyMsg(const char* msg) {
+    strncpy(wifiReply, msg, JSON_MAX_SIZE - 1);
+    wifiReply[JSON_MAX_SIZE - 1] = '\0';
+}
+
 bool parseCommand(char* command) {
+    PROBE_SCOPE(PROBE_PARSE_COMMAND);
     dbgf(debug, F(":parse cmd:%s\n"), command);
 
     if (strstr(command, "AT") == command) {
@@ -846,8 +1035,13 @@ bool parseCommand(char* command) {
                     debug = serial;
                 }
                 esp8266.setDebug(debug);
+#ifdef WIFI_MQTT_PORT
+                mqttSetDebug(debug);
+#endif
             } else {
-                reportConfiguration();
+                esp8266.getStaIP(WIFI_STA_IP);
+                reportConfiguration(printMsg, true);
+                dbgf(debug, F(":EEPROM:written:%d bytes\n"), eepromWriteCount);
             }
         } else if (root[F("m")] == F("sstp")) {
             // servo setup mode
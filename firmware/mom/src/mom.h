@@ -9,6 +9,16 @@
 #include "Arduino.h"
 //add your includes for the project mom here
 
+#define ACTUATOR_MAX_STEPS 6
+#define ACTUATOR_SERVO 0 // move servo to value position, wait SERVO_MOVE_MS
+#define ACTUATOR_WAIT_SENSOR 1 // wait till sensor reads value, fail on timeout
+
+typedef struct {
+    uint8_t action;
+    uint8_t pin;
+    uint8_t value;
+} actuator_step_t;
+
 //end of add your includes here
 #ifdef __cplusplus
 extern "C" {
@@ -30,26 +40,38 @@ void switchNodeState(uint8_t id, uint8_t sensId[], int16_t sensVal[], uint8_t se
 void forceNodeState(uint8_t id, uint8_t state, unsigned long ts);
 void forceNodeState(uint8_t id, uint16_t bit, uint8_t state, unsigned long &nodeTs, unsigned long ts);
 void unForceNodeState(uint8_t id);
-void stepMotor();
 void syncPvLoadSwitches();
-void moveServo(uint8_t servoId, uint8_t pos);
+void setupPvLoadSwitches();
+void startActuators(const actuator_step_t steps[], const uint8_t count);
+void beginActuatorStep();
+bool actuatorsBusy();
+void stepActuators();
+void finishActuators();
 
 void restoreNodesState();
 void loadWifiConfig();
 void validateStringParam(char* str, int maxSize);
 
 void readSensors();
+void onSample(const uint8_t pin, const uint16_t value);
+int16_t toDeci(const float v);
 int8_t getSensorWaterPumpPowerState();
 bool validSensorValues(const int16_t values[], const uint8_t size);
 
 void reportStatus();
-void reportConfiguration();
+void statusItems(void (*out)(const char*));
+void reportConfiguration(void (*out)(const char*), bool secrets);
 void reportTimestamp();
 uint16_t nodeState(uint16_t nodeBit);
 
 void processSerialMsg();
 void processWifiMsg();
+void configItems(void (*out)(const char*));
+void processMqttMsg(const char* topic, char* payload);
 void broadcastMsg(const char* msg);
+void reportMsg(const char* msg);
+void printMsg(const char* msg);
+void replyMsg(const char* msg);
 bool parseCommand(char* command);
 
 unsigned long getTimestamp();
@@ -8,6 +8,7 @@
 
 #include <debug.h>
 #include <ESP8266.h>
+#include <framer.h>
 #include <jsoner.h>
 
 #define __DEBUG__
@@ -95,6 +96,10 @@ SoftwareSerial *debug = serial;
 SoftwareSerial *debug = NULL;
 #endif
 
+// command input, collected across loop() passes
+char serialFrame[JSON_MAX_SIZE + 1];
+framer_t serialFramer;
+
 //WiFi
 HardwareSerial *wifi = &Serial;
 ESP8266 esp8266;
@@ -105,6 +110,7 @@ void setup() {
     // Setup serial ports
     serial->begin(57600);
     wifi->begin(57600);
+    framerInit(serialFramer, serialFrame, JSON_MAX_SIZE);
 
     dbg(debug, F(":STARTING\n"));
 
@@ -112,6 +118,9 @@ void setup() {
     pinMode(HEARTBEAT_LED, OUTPUT);
     digitalWrite(HEARTBEAT_LED, LOW);
 
+    // init DHT sensor. measured in background from loop()
+    dht.begin();
+
     // init esp8266 hw reset pin. N/A
     //pinMode(WIFI_RST_PIN, OUTPUT);
 
@@ -126,18 +135,20 @@ void setup() {
 
 void loop() {
     tsCurr = getTimestamp();
+    dht.update();
     if (diffTimestamps(tsCurr, tsLastSensorRead) >= SENSORS_READ_INTERVAL_SEC) {
         readSensors();
         tsLastSensorRead = tsCurr;
 
         digitalWrite(HEARTBEAT_LED, digitalRead(HEARTBEAT_LED) ^ 1);
     }
-    if (serial->available() > 0) {
+    if (serial->available() > 0 || framerPending(serialFramer)) {
         processSerialMsg();
     }
-    if (wifi->available() > 0) {
+    if (esp8266.available() > 0) {
         processWifiMsg();
     }
+    esp8266.update();
 
     if (diffTimestamps(tsCurr, tsLastStatusReport) >= STATUS_REPORTING_PERIOD_SEC) {
         reportStatus();
@@ -225,12 +236,12 @@ void reportStatus() {
     switch (nextEntryReport) {
     case SENSOR_TEMP:
         jsonifySensorValue(SENSOR_TEMP, tempRoom, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
+        reportMsg(json);
         nextEntryReport = SENSOR_HUM;
         break;
     case SENSOR_HUM:
         jsonifySensorValue(SENSOR_HUM, humRoom, json, JSON_MAX_SIZE);
-        broadcastMsg(json);
+        reportMsg(json);
         nextEntryReport = 0;
         break;
     default:
@@ -264,10 +275,13 @@ void reportConfiguration() {
 /*========================= Communication ===================================*/
 
 void processSerialMsg() {
-    char buff[JSON_MAX_SIZE + 1];
-    uint16_t l = serial->readBytesUntil('\0', buff, JSON_MAX_SIZE);
-    buff[l] = '\0';
-    parseCommand(buff);
+    uint16_t overruns = framerOverruns(serialFramer);
+    while (framerRead(serialFramer, serial) > 0) {
+        parseCommand(serialFrame);
+    }
+    if (framerOverruns(serialFramer) != overruns) {
+        dbgf(debug, F(":serial:overrun:%u\n"), framerOverruns(serialFramer));
+    }
 }
 
 void processWifiMsg() {
@@ -277,16 +291,33 @@ void processWifiMsg() {
     if (l > 0) {
         dbgf(debug, F(":HTTP:receive:%d bytes:[%d msec]\n"), l, millis() - start);
         parseCommand(buff);
+        esp8266.respond();
     }
 }
 
 void broadcastMsg(const char* msg) {
     serial->println(msg);
     unsigned long start = millis();
+#ifdef WIFI_UPLINK_PORT
+    // to logserver collector over persistent connection
+    int status = esp8266.stream(SERVER_IP, WIFI_UPLINK_PORT, msg);
+#else
     int status = esp8266.send(SERVER_IP, SERVER_PORT, msg);
+#endif
     dbgf(debug, F(":HTTP:send:%d:[%d msec]\n"), status, millis() - start);
 }
 
+void reportMsg(const char* msg) {
+#ifdef WIFI_TELEMETRY_PORT
+    serial->println(msg);
+    unsigned long start = millis();
+    int status = esp8266.datagram(SERVER_IP, WIFI_TELEMETRY_PORT, msg);
+    dbgf(debug, F(":UDP:send:%d:[%d msec]\n"), status, millis() - start);
+#else
+    broadcastMsg(msg);
+#endif
+}
+
 bool parseCommand(char* command) {
     dbgf(debug, F(":parse cmd:%s\n"), command);
 
@@ -38,6 +38,7 @@ void reportConfiguration();
 void processSerialMsg();
 void processWifiMsg();
 void broadcastMsg(const char* msg);
+void reportMsg(const char* msg);
 bool parseCommand(char* command);
 
 unsigned long getTimestamp();
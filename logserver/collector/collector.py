@@ -0,0 +1,79 @@
+"""
+Uplink collector.
+
+Controllers with uplink enabled (ESP8266::stream()) keep one TCP connection
+here and send messages as frames: 2 byte big endian length followed by JSON
+message. Each frame is relayed to logstash http input the way controller would
+post it itself, so logstash and gateway see the same events. Address of the
+controller is passed in X-HK-Host header.
+"""
+import http.client
+import os
+import socketserver
+import struct
+
+COLLECTOR_HOST = os.environ.get('COLLECTOR_HOST', default='0.0.0.0')
+COLLECTOR_PORT = int(os.environ.get('COLLECTOR_PORT', default=8087))
+LOGSERVER_HOST = os.environ.get('LOGSERVER_HOST', default='logstash')
+LOGSERVER_PORT = int(os.environ.get('LOGSERVER_PORT', default=8085))
+LOGSERVER_TIMEOUT_SEC = 5
+DEBUG = os.environ.get('COLLECTOR_DEBUG', default='false') == 'true'
+
+
+class Logserver:
+
+    def __init__(self):
+        self.conn = None
+
+    def send(self, body, host):
+        headers = {'User-Agent': 'ESP8266', 'Content-Type': 'application/json', 'X-HK-Host': host}
+        # one retry on connection closed by logstash between frames
+        for retry in range(2):
+            try:
+                if not self.conn:
+                    self.conn = http.client.HTTPConnection(LOGSERVER_HOST, LOGSERVER_PORT,
+                                                           timeout=LOGSERVER_TIMEOUT_SEC)
+                self.conn.request('POST', '/', body, headers)
+                self.conn.getresponse().read()
+                return
+            except (http.client.HTTPException, OSError) as e:
+                if DEBUG : print('>>>LOGSERVER: %s' % e)
+                self.conn.close()
+                self.conn = None
+
+
+class UplinkHandler(socketserver.BaseRequestHandler):
+
+    def read(self, n):
+        data = b''
+        while len(data) < n:
+            chunk = self.request.recv(n - len(data))
+            if not chunk:
+                return None
+            data += chunk
+        return data
+
+    def handle(self):
+        host = self.client_address[0]
+        logserver = Logserver()
+        if DEBUG : print('UPLINK: %s connected' % host)
+        while True:
+            header = self.read(2)
+            if header is None:
+                break
+            body = self.read(struct.unpack('>H', header)[0])
+            if body is None:
+                break
+            if DEBUG : print('<<<UPLINK: %s; %s' % (host, body))
+            logserver.send(body, host)
+        if DEBUG : print('UPLINK: %s closed' % host)
+
+
+class UplinkServer(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+if __name__ == "__main__":
+    with UplinkServer((COLLECTOR_HOST, COLLECTOR_PORT), UplinkHandler) as server:
+        server.serve_forever()
@@ -83,6 +83,13 @@ def controller_send(conf, body):
             retry = retry + 1
         if rcode != 200:
             raise Exception("unable to contact controller")
+        # controller answers nsc with resulting node state (csr message)
+        if r.headers.get('Content-Type', '').startswith('application/json'):
+            try:
+                return r.json()
+            except ValueError:
+                pass
+        return None
     else:
         raise ValueError("unknown controller")
 
@@ -217,9 +224,23 @@ class NodeControlApi(Resource):
             if args['period'] > 0:
                 req['ft'] = args['period'] * 60
         try:
-            controller_send(identify_target_controller(req), req)
+            conf = identify_target_controller(req)
+            reply = controller_send(conf, req)
             logserver_send(req)
-            return {"success": "200 OK"}, 200
+            response = {"success": "200 OK"}
+            if reply and 'n' in reply:
+                delta = None
+                if conf and ccd[conf['host']]['timestamp'] > 0:
+                    delta = ccd[conf['host']]['value']
+                response['state'] = \
+                    'ON' if reply['n']['ns'] == 1 else \
+                    'OFF' if reply['n']['ns'] == 0 else \
+                    'ERR'
+                response['forced'] = reply['n']['ff'] == 1
+                response['ts'] = int(int(reply['n']['ts']) + delta) if delta and int(reply['n']['ts']) > 0 else 0
+                if 'ft' in reply['n']:
+                    response['ft'] = int(int(reply['n']['ft']) + delta) if delta and int(reply['n']['ft']) > 0 else 0
+            return response, 200
         except ValueError as e:
             if app.debug : print(e)
             return {"error": str(e)}, 400